@@ -0,0 +1,76 @@
+/* ------------------------ import_bench.cpp -------------------------
+ * times importing glTF files and reports the peak resident memory of
+ * the process afterwards.
+ *
+ *   import_bench [--process] [--runs N] <file.gltf|file.glb>
+ *
+ * only the parse is timed unless --process is given, which also runs
+ * the optional import stages (ModelImportOptions). import one file per
+ * run of the benchmark, the peak memory covers the whole process.
+ * -------------------------------------------------------------------
+ */
+#include "config.hpp"
+#include "data_structures.hpp"
+#include "model.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+int main(int argc, char **argv) {
+  tuco::ModelImportOptions options;
+  options.optimize = false;
+  options.lod_count = 0;
+  options.build_meshlets = false;
+
+  int runs = 5;
+  std::string path;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--process") == 0) {
+      options.optimize = true;
+      options.lod_count = MAX_LOD_COUNT - 1;
+      options.build_meshlets = true;
+    } else if (std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+      runs = std::max(std::atoi(argv[++i]), 1);
+    } else {
+      path = argv[i];
+    }
+  }
+  if (path.empty()) {
+    std::fprintf(stderr,
+                 "usage: import_bench [--process] [--runs N] <file>\n");
+    return 1;
+  }
+
+  double best_ms = 0.0;
+  double total_ms = 0.0;
+  size_t vertices = 0;
+  size_t indices = 0;
+  for (int run = 0; run < runs; run++) {
+    // no name, so the mesh cache is never read or written.
+    tuco::Model model;
+    auto start = std::chrono::steady_clock::now();
+    if (!model.add_mesh(path, std::nullopt, options)) {
+      std::fprintf(stderr, "could not import %s\n", path.c_str());
+      return 1;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    best_ms = run == 0 ? ms : std::min(best_ms, ms);
+    total_ms += ms;
+    vertices = model.model_vertices.size();
+    indices = model.model_indices.size();
+  }
+
+  std::printf("%s: %zu vertices, %zu indices\n", path.c_str(), vertices,
+              indices);
+  std::printf("import: %.2f ms best, %.2f ms average over %d runs\n", best_ms,
+              total_ms / runs, runs);
+  std::printf("peak rss: %.1f mb\n",
+              get_peak_memory_usage() / (1024.0 * 1024.0));
+  return 0;
+}
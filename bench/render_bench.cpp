@@ -0,0 +1,177 @@
+/* ------------------------ render_bench.cpp -------------------------
+ * draws a scene of copies of one model and reports frame times and
+ * what the backend uploaded for it.
+ *
+ *   render_bench [--frames N] [--warmup N] [--copies N]
+ *                [--skinning cpu|gpu] [--animation NAME] <file.gltf|glb>
+ *
+ * the model is imported and streamed in during the warm up frames,
+ * only the frames after it are timed. with --animation every copy of
+ * a skinned model plays it, e.g. --copies 100, 1000 and 10000 with
+ * either skinning mode to compare the two backends.
+ * -------------------------------------------------------------------
+ */
+#include "antuco.hpp"
+#include "antuco_enums.hpp"
+#include "api_graphics.hpp"
+#include <scene.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+int main(int argc, char **argv) {
+  int frames = 600;
+  int warmup = 120;
+  int copies = 1;
+  tuco::SkinningMode skinning = tuco::SkinningMode::Cpu;
+  std::string animation;
+  std::string path;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frames = std::max(std::atoi(argv[++i]), 1);
+    } else if (std::strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+      warmup = std::max(std::atoi(argv[++i]), 0);
+    } else if (std::strcmp(argv[i], "--copies") == 0 && i + 1 < argc) {
+      copies = std::max(std::atoi(argv[++i]), 1);
+    } else if (std::strcmp(argv[i], "--skinning") == 0 && i + 1 < argc) {
+      skinning = std::strcmp(argv[++i], "gpu") == 0 ? tuco::SkinningMode::Gpu
+                                                     : tuco::SkinningMode::Cpu;
+    } else if (std::strcmp(argv[i], "--animation") == 0 && i + 1 < argc) {
+      animation = argv[++i];
+    } else {
+      path = argv[i];
+    }
+  }
+  if (path.empty()) {
+    std::fprintf(stderr, "usage: render_bench [--frames N] [--warmup N] "
+                         "[--copies N] [--skinning cpu|gpu] "
+                         "[--animation NAME] <file>\n");
+    return 1;
+  }
+
+  tuco::Antuco &antuco = tuco::Antuco::get_engine();
+  tuco::Window *window = antuco.init_window(1600, 900, "render_bench");
+  antuco.init_graphics(tuco::RenderEngine::Vulkan);
+  antuco.get_backend()->set_skinning_mode(skinning);
+
+  // far enough back to see a grid of copies one unit apart.
+  int side = static_cast<int>(std::ceil(std::sqrt(copies)));
+  glm::vec3 eye = glm::vec3(0.0f, 1.0f, 2.0f + side);
+  tuco::Camera *camera =
+      antuco.create_camera(eye, glm::vec3(0.0f, 0.0f, -1.0f),
+                           glm::vec3(0.0f, -1.0f, 0.0f), glm::radians(45.0f),
+                           0.01f, 150.0f);
+  antuco.create_spotlight(glm::vec3(-3.58448f, 7.69584f, 11.7122f),
+                          glm::vec3(0.0f), glm::vec3(1.0f),
+                          glm::vec3(0.0f, 1.0f, 0.0f), true);
+  antuco.create_scene();
+
+  // the same import stages main.cpp turns on.
+  tuco::ModelImportOptions import_options;
+  import_options.optimize = true;
+  import_options.lod_count = MAX_LOD_COUNT - 1;
+  import_options.build_meshlets = true;
+  antuco.get_asset_manager().set_import_options(import_options);
+
+  std::vector<tuco::GameObject *> objects;
+  for (int i = 0; i < copies; i++) {
+    tuco::GameObject *object = antuco.create_object();
+    object->add_mesh(path);
+    object->translate(glm::vec3(static_cast<float>(i % side - side / 2), 0.0f,
+                                -static_cast<float>(i / side)));
+    objects.push_back(object);
+  }
+  antuco.get_asset_manager().wait_idle();
+
+  for (int i = 0; i < warmup; i++) {
+    camera->update(eye, glm::vec3(0.0f, 0.0f, -1.0f));
+    antuco.render();
+    window->check_window_status(tuco::WindowStatus::CLOSE_REQUEST);
+  }
+
+  // models are swapped into their objects while rendering, so the animation
+  // can only be found once the warm up frames ran.
+  if (!animation.empty()) {
+    for (tuco::GameObject *object : objects) {
+      if (!object->play_animation(animation)) {
+        std::fprintf(stderr, "%s has no animation %s\n", path.c_str(),
+                     animation.c_str());
+        return 1;
+      }
+    }
+  }
+
+  std::vector<double> times;
+  times.reserve(frames);
+  for (int i = 0; i < frames; i++) {
+    auto start = std::chrono::steady_clock::now();
+    camera->update(eye, glm::vec3(0.0f, 0.0f, -1.0f));
+    antuco.render();
+    window->check_window_status(tuco::WindowStatus::CLOSE_REQUEST);
+    auto end = std::chrono::steady_clock::now();
+    times.push_back(
+        std::chrono::duration<double, std::milli>(end - start).count());
+  }
+
+  double total = 0.0;
+  for (double time : times)
+    total += time;
+  std::sort(times.begin(), times.end());
+  std::printf("%s x%d: %d frames, %.3f ms average, %.3f ms median, %.3f ms "
+              "99th percentile\n",
+              path.c_str(), copies, frames, total / frames,
+              times[times.size() / 2], times[times.size() * 99 / 100]);
+
+  tuco::GraphicsImpl *backend = antuco.get_backend();
+  const tuco::MeshUploadStats &uploads = backend->get_upload_stats();
+  std::printf("uploads: %u meshes, %llu vertices at %.1f bytes/vertex "
+              "(%llu bytes as tuco::Vertex), %u/%u primitives with 16 bit "
+              "indices, %llu index bytes\n",
+              uploads.meshes, (unsigned long long)uploads.vertices,
+              uploads.get_bytes_per_vertex(),
+              (unsigned long long)uploads.cpu_vertex_bytes,
+              uploads.narrow_primitives, uploads.primitives,
+              (unsigned long long)uploads.index_bytes);
+  std::printf("shared: %u objects reused an upload, %llu bytes not "
+              "uploaded\n",
+              uploads.shared,
+              (unsigned long long)backend->get_shared_geometry_bytes());
+
+  // everything the import streamed in, most of it during the warm up frames.
+  const mem::StagingStats &staging =
+      backend->get_staging_ring().get_stats();
+  double staging_seconds = staging.busy_ms / 1000.0;
+  std::printf("staging: %.2f mb in %llu batches over %llu frames, %.2f mb "
+              "largest frame, %.1f mb/s while batches were in flight, %llu "
+              "stalls\n",
+              staging.bytes / 1e6, (unsigned long long)staging.batches,
+              (unsigned long long)staging.frames,
+              staging.peak_frame_bytes / 1e6,
+              staging_seconds > 0.0
+                  ? staging.completed_bytes / 1e6 / staging_seconds
+                  : 0.0,
+              (unsigned long long)staging.stalls);
+
+  const tuco::ClusterCullStats &clusters = backend->get_cluster_cull_stats();
+  std::printf("clusters (last frame): %u tested, %u culled, %u visible, %u "
+              "indirect draws\n",
+              clusters.tested, clusters.get_culled(), clusters.visible,
+              clusters.commands);
+
+  const tuco::SkinningStats &skinned = backend->get_skinning_stats();
+  std::printf("skinning (last frame, %s): %zu objects, %zu vertices, %zu "
+              "morph targets, %.3f ms animating, %.3f ms skinning on the "
+              "cpu\n",
+              skinning == tuco::SkinningMode::Gpu ? "gpu" : "cpu",
+              skinned.objects, skinned.vertices, skinned.morph_targets,
+              skinned.animate_ms, skinned.skin_ms);
+
+  window->close();
+  return 0;
+}
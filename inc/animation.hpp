@@ -0,0 +1,88 @@
+/* -------------------------- animation.hpp --------------------------
+ * gltf animations: keyframed samplers driving the trs of nodes in a
+ * model's NodeHierarchy and its morph weights. sampling only writes
+ * the node trs, world transforms (and joint matrices) follow on the
+ * next update_world().
+ * -------------------------------------------------------------------
+ */
+
+#pragma once
+
+#include "node.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tuco {
+
+enum class AnimationPath {
+  Translation,
+  Rotation,
+  Scale,
+  Weights, // morph target weights of a node's mesh
+};
+
+enum class AnimationInterpolation {
+  Step,
+  Linear,
+  CubicSpline,
+};
+
+struct AnimationSampler {
+  std::vector<float> times; // ascending, in seconds
+  // width values per key, three times as many (in tangents, values, out
+  // tangents) for cubic splines. rotations are quaternions stored x, y, z, w,
+  // morph weights are one target per value (in x).
+  std::vector<glm::vec4> values;
+  uint32_t width = 1;
+  AnimationInterpolation interpolation = AnimationInterpolation::Linear;
+};
+
+struct AnimationChannel {
+  uint32_t sampler;
+  uint32_t node; // in the model's NodeHierarchy
+  AnimationPath path;
+  // AnimationPath::Weights only, the node's block of morph weights.
+  uint32_t weight_start = 0;
+  uint32_t weight_count = 0;
+};
+
+struct Animation {
+  std::string name;
+  std::vector<AnimationSampler> samplers;
+  std::vector<AnimationChannel> channels;
+  float duration = 0.0f; // last key time over all samplers
+};
+
+// what a GameObject is currently playing.
+struct AnimationState {
+  int32_t animation = -1; // index into the model's animations, -1 if stopped
+  float time = 0.0f;
+  float speed = 1.0f;
+  bool loop = true;
+};
+
+// EFFECTS: evaluates element (< sampler.width) of sampler at time (clamped
+//          to its keys), rotations are slerped and renormalized.
+glm::vec4 sample_animation(const AnimationSampler &sampler, float time,
+                           AnimationPath path, uint32_t element = 0);
+
+// MODIFIES: nodes, morph_weights
+// EFFECTS: writes the value of every channel of animation at time into the
+//          trs of its node (nodes given as a matrix are left alone) or its
+//          morph weights.
+void apply_animation(const Animation &animation, float time,
+                     model::NodeHierarchy &nodes,
+                     std::vector<float> &morph_weights);
+
+// MODIFIES: state
+// EFFECTS: advances state by seconds, wrapping or clamping at the end of
+//          animation. returns false once a non-looping animation is done.
+bool advance_animation(const Animation &animation, float seconds,
+                       AnimationState &state);
+
+} // namespace tuco
@@ -6,6 +6,7 @@
 #pragma once
 
 #include "window.hpp"
+#include "asset_manager.hpp"
 #include "world_objects.hpp"
 #include "graphics.hpp"
 #include "config.hpp"
@@ -32,11 +33,16 @@ public:
     PointLight& create_point_light(glm::vec3 pos, glm::vec3 colour);
 	Camera* create_camera(glm::vec3 eye, glm::vec3 target, glm::vec3 up, float yfov, float near, float far);
 	GameObject* create_object();
+	// releases what the object holds in the renderer and deletes it, a mesh
+	// still being imported into it is waited for first.
+	void destroy_object(GameObject* object);
 
 	// Creates a scene for the game, we currently assume that the game will only create a single scene.
 	SceneData* create_scene();
 	SceneData* get_scene() { return scene.get(); }
 
+	AssetManager& get_asset_manager() { return asset_manager; }
+
 
 /* Rendering */
 public:
@@ -53,6 +59,10 @@ private:
 	std::vector<int> shadow_casters;
 
 	std::unique_ptr<SceneData> scene;
+
+	// declared after the objects so it is destroyed (and its workers joined)
+	// before any model a job could still be writing into.
+	AssetManager asset_manager;
 	/* Antuco Initalization */
 public:
 	//delete copy trait
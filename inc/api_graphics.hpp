@@ -20,8 +20,12 @@
 #include "config.hpp"
 #include "data_structures.hpp"
 #include "descriptor_set.hpp"
+#include "frame_arena.hpp"
+#include "geometry_registry.hpp"
 #include "memory_allocator.hpp"
 #include "mesh.hpp"
+#include "skinning.hpp"
+#include "texture_cache.hpp"
 #include "world_objects.hpp"
 #include <scene.hpp>
 
@@ -38,7 +42,9 @@
 #include "render_pass.hpp"
 
 #include <math.h>
+#include <chrono>
 #include <optional>
+#include <unordered_map>
 #include <vector>
 
 const uint32_t API_VERSION_1_0 = 0;
@@ -47,7 +53,11 @@ const uint32_t API_VERSION_1_0 = 0;
 //       recompilation
 const uint32_t SHADOW_TRANSFER_BUFFERS = MAX_SHADOW_CASTERS;
 
-const uint32_t BUFFER_SIZE = 2e8;
+// starting size of the vertex and index buffers, they grow with the meshes
+// uploaded into them.
+const uint32_t GEOMETRY_BUFFER_SIZE = 8 << 20;
+// the uniform buffer is a chain of blocks of this size.
+const uint32_t UNIFORM_BLOCK_SIZE = 1 << 20;
 
 // CHANGING THIS IS NOT RECOMMENDED
 const uint32_t SHADOWMAP_SIZE = 2048;
@@ -66,9 +76,12 @@ public:
 
     void update_camera(glm::mat4 world_to_camera, glm::mat4 projection,
                         glm::vec4 eye);
-    void update_light(std::vector<DirectionalLight> lights,
-                    std::vector<int> shadow_casters);
+    void update_light(const std::vector<DirectionalLight> &lights,
+                    const std::vector<int> &shadow_casters);
     void update_draw(std::vector<std::unique_ptr<GameObject>> &game_objects);
+    // gives back everything the object was handed on upload, before it is
+    // removed from the objects passed to update_draw.
+    void release_object(GameObject &object);
 
     void initialize_scene(SceneData *scene);
 
@@ -76,8 +89,32 @@ public:
     vk::CommandPool& get_command_pool() { return command_pool; }
     mem::StackBuffer& get_vertex_buffer() { return vertex_buffer; }
     mem::StackBuffer& get_index_buffer() { return index_buffer; }
+    mem::StagingRing& get_staging_ring() { return staging_ring; }
     mem::SearchBuffer& get_model_buffer() { return uniform_buffer; }
     TucoPipeline& get_forward_pipeline() { return graphics_pipelines[1]; }
+    TextureCache& get_texture_cache() { return texture_cache; }
+
+    // switching modes re-records the command buffers on the next frame.
+    void set_cluster_cull_mode(ClusterCullMode mode);
+    ClusterCullMode get_cluster_cull_mode() const { return cluster_cull_mode; }
+    // totals of the last finished frame.
+    const ClusterCullStats& get_cluster_cull_stats() const { return cluster_stats; }
+
+    // switching modes re-records the command buffers on the next frame.
+    void set_skinning_mode(SkinningMode mode);
+    SkinningMode get_skinning_mode() const { return skinning_mode; }
+    // timings of the last frame.
+    const SkinningStats& get_skinning_stats() const { return skinning_stats; }
+    // every mesh uploaded so far, see upload_mesh.
+    const MeshUploadStats& get_upload_stats() const { return upload_stats; }
+    // bytes not uploaded because objects shared geometry.
+    size_t get_shared_geometry_bytes() const { return geometry_registry.get_saved_bytes(); }
+
+    // device memory per memory type, heap and category.
+    mem::AllocatorStats get_memory_stats();
+    // writes the allocator's json report (heaps, pools, categories and the
+    // largest allocations) to path, false if the file could not be written.
+    bool write_memory_report(const std::string& path);
 
 
 private:
@@ -175,7 +212,45 @@ public:
     uint32_t add_draw_data(br::GPUResource* resource);
 
 private:
-    VkDescriptorSetLayout ubo_layout;
+    // textures of every material, shared between objects and models.
+    TextureCache texture_cache;
+    // materials built from model materials, keyed by their factors and textures.
+    std::unordered_map<uint64_t, uint32_t> material_lookup;
+
+    // fills object.primitive_materials, creating the materials its model needs.
+    void register_materials(GameObject& object);
+    // the material matching description, created on first use.
+    uint32_t find_material(const Model& model, const MaterialDescription& description);
+
+    // with descriptor indexing every material is an element of material_table and every texture a
+    // slot of one sampler array, both in bindless_set, so the forward pass binds its material set
+    // once and picks the material with a push constant. slot 0 is uninitalized_image.
+    bool bindless_materials = false;
+    uint32_t bindless_texture_count = 0;
+    uint32_t bindless_set = UINT32_MAX;
+    std::unique_ptr<mem::Pool> bindless_pool;
+    // one region of material_table_capacity materials per swapchain image, the command buffer of
+    // image i reads region i. a written material reaches a region once its image is acquired again,
+    // so frames in flight never see the table change under them.
+    mem::CPUBuffer material_table;
+    uint32_t material_table_capacity = 0;
+    // every material's MaterialBufferObject by table index, and the indices each region is missing.
+    std::vector<MaterialBufferObject> material_data;
+    std::vector<std::vector<uint32_t>> material_table_writes;
+    std::unordered_map<const br::Image*, uint32_t> texture_slots;
+
+    // REQUIRES: create_graphics_pipeline and create_default_images have run.
+    void create_material_table();
+    // EFFECTS: the texture table slot holding image (0 for nullptr), written on first use.
+    uint32_t get_texture_slot(br::Image* image);
+    void write_material_table(Material* material);
+    // EFFECTS: replaces the table with one of capacity materials per region (waits for the device).
+    void resize_material_table(uint32_t capacity);
+    // REQUIRES: the last submission reading image_index's region has finished.
+    void flush_material_table(uint32_t image_index);
+public:
+
+private:
     VkDescriptorSetLayout texture_layout;
     VkDescriptorSetLayout matLayout;
     VkDescriptorSetLayout light_layout;
@@ -211,7 +286,6 @@ private:
     // pool for all sets.
     std::shared_ptr<mem::Pool> set_pool;
 
-    std::vector<std::vector<VkDescriptorSet>> uboSets;
     std::vector<std::vector<VkDescriptorSet>> matSets; // model -> mesh
 
     // game object -> mesh -> swapchain image
@@ -222,9 +296,6 @@ private:
     vk::CommandPool command_pool;
     std::vector<vk::CommandBuffer> command_buffers;
 
-    std::vector<VkDeviceSize>
-        ubo_offsets; // holds the offset data for a objects ubo information within
-                    // the uniform buffer
     std::vector<VkDeviceSize> matOffsets;
     std::vector<std::vector<br::Image>> texture_images;
 
@@ -297,9 +368,11 @@ public:
 private:
     void create_pipeline();
     void create_graphics_pipeline();
-    void create_ubo_layout();
     void create_ubo_pool();
-    void createUboSets(uint32_t setCount);
+    void create_transform_table();
+    void assign_transforms(GameObject& object, uint32_t node_count);
+    void release_transforms(GameObject& object);
+    void update_transforms(std::vector<std::unique_ptr<GameObject>>& game_objects);
     void createMaterialLayout();
     void createMaterialPool();
     void createMaterialCollection();
@@ -342,7 +415,6 @@ private:
     fill_shader_stage_struct(VkShaderStageFlagBits stage,
                             VkShaderModule shaderModule);
 
-    void write_to_ubo();
     MaterialGpuInfo setupMaterialBuffers();
     void updateMaterialResources(Material &material);
     void write_scene(SceneData* scene);
@@ -376,9 +448,10 @@ private:
 
   // helper functions
 private:
-    VkDescriptorBufferInfo allocateDescriptorBuffer(uint32_t size);
+    VkDescriptorBufferInfo allocateDescriptorBuffer(uint32_t size, VkDeviceSize& offset);
     void update_descriptor_set(VkDescriptorBufferInfo buffer_info,
-                                uint32_t dst_binding, VkDescriptorSet set);
+                                uint32_t dst_binding, VkDescriptorSet set,
+                                VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
     vk::Framebuffer create_frame_buffer(vk::RenderPass pass,
                                         uint32_t attachment_count,
                                         vk::ImageView *p_attachments,
@@ -399,9 +472,45 @@ private:
     mem::StackBuffer vertex_buffer;
     mem::StackBuffer index_buffer;
     mem::SearchBuffer uniform_buffer;
+    // object and scene transforms, rewritten every frame. command_buffers[i]
+    // reads region i, which is brought up to date once the image is acquired.
+    mem::UniformRing uniform_ring;
+    // model and normal matrices of every node (see assign_transforms), a
+    // storage buffer in uniform_ring read through transform_set.
+    VkDeviceSize transform_table_offset = 0;
+    uint32_t transform_count = 0; // slots handed out
+    // slot ranges (start, count, sorted by start) given back by objects that
+    // were uploaded again or destroyed, reused before new ones are handed out.
+    std::vector<std::pair<uint32_t, uint32_t>> free_transforms;
+    uint32_t transform_set = UINT32_MAX;
+    // cpu copy the moved nodes' matrices are computed in before they are
+    // written to the ring, and the objects that moved this frame.
+    std::vector<TransformObject> transform_objects;
+    std::vector<GameObject*> moved_objects;
+    // vertex_buffer and index_buffer are written through this, flushed once a frame.
+    mem::StagingRing staging_ring;
+    uint64_t staging_frame = 0;
+    // StagingStats::frames at the last staging readout.
+    uint64_t staging_logged_frames = 0;
+    // scratch memory of the render loop, a slot per frame in flight.
+    mem::FrameArena frame_arena;
+    // frames drawn, the heaps are checked against their budget every
+    // MEMORY_BUDGET_INTERVAL of them.
+    uint64_t memory_frame = 0;
+    // StagingStats::bytes when the allocator stats were last logged.
+    VkDeviceSize memory_logged_bytes = 0;
+    // ranges relocate_geometry followed since the compaction pass started.
+    size_t compaction_vertex_moves = 0;
+    size_t compaction_index_moves = 0;
+    // which ranges of vertex_buffer/index_buffer hold which model.
+    GeometryRegistry geometry_registry;
+    MeshUploadStats upload_stats;
 
 private:
     void create_uniform_buffer();
+    void create_uniform_ring();
+    void create_staging_ring();
+    void create_frame_arena();
     void create_vertex_buffer();
     void create_index_buffer();
 
@@ -411,8 +520,97 @@ private:
                     VkDeviceSize dst_offset, VkDeviceSize data_size);
 
 public:
-    int32_t update_vertex_buffer(std::vector<Vertex> vertex_data);
-    int32_t update_index_buffer(std::vector<uint32_t> indices_data);
+    int32_t update_vertex_buffer(const std::vector<Vertex>& vertex_data);
+    int32_t update_index_buffer(const std::vector<uint32_t>& indices_data);
+    void upload_mesh(GameObject& object);
+    void release_geometry(GameObject& object);
+    // follows the moves vertex_buffer/index_buffer made while compacting.
+    void relocate_geometry(std::vector<std::unique_ptr<GameObject>>& game_objects);
+    // picks the level of detail of every primitive of object from the current
+    // camera, returns true if any of them changed (command buffers need to be
+    // re-recorded).
+    bool select_lods(GameObject& object);
+
+    // cluster culling
+private:
+    ClusterCullMode cluster_cull_mode = ClusterCullMode::Cpu;
+
+    // per swapchain image, read by the command buffer recorded for that image.
+    std::vector<mem::CPUBuffer> cluster_command_buffers;
+    std::vector<mem::CPUBuffer> cluster_job_buffers;
+    // GpuCluster per command slot, only read by the compute pass.
+    mem::CPUBuffer gpu_cluster_buffer;
+    TucoPipeline cluster_cull_pipeline;
+
+    // next free command slot/job, handed out in upload_mesh.
+    uint32_t cluster_command_count = 0;
+    uint32_t cluster_job_count = 0;
+    // command ranges (start, count, sorted by start) and jobs given back by
+    // objects that were uploaded again, reused before new ones are handed out.
+    std::vector<std::pair<uint32_t, uint32_t>> free_cluster_commands;
+    std::vector<uint32_t> free_cluster_jobs;
+
+    std::vector<VkDrawIndexedIndirectCommand> cluster_commands;
+    std::vector<GpuClusterJob> cluster_jobs;
+    std::vector<uint8_t> cluster_visibility;
+    ClusterCullStats cluster_stats;
+    uint64_t cluster_frame = 0;
+
+private:
+    void create_cluster_culling();
+    void destroy_cluster_culling();
+    void register_clusters(GameObject& object);
+    void release_clusters(GameObject& object);
+    void write_gpu_clusters(const GameObject& object, size_t primitive);
+    void update_cluster_culling(std::vector<std::unique_ptr<GameObject>>& game_objects);
+    void write_cluster_draws(uint32_t image_index);
+    void record_cluster_cull(size_t i);
+
+    // skinning
+private:
+    SkinningMode skinning_mode = SkinningMode::Cpu;
+
+    // per swapchain image, the skinned vertices (MeshVertexLayout) the forward
+    // pass of that image reads and what the compute pass builds them from.
+    std::vector<mem::CPUBuffer> skinned_vertex_buffers;
+    std::vector<mem::CPUBuffer> skin_joint_buffers;
+    std::vector<mem::CPUBuffer> skin_job_buffers;
+    // GpuSkinVertex of every skinned object, only read by the compute pass.
+    mem::CPUBuffer skin_source_buffer;
+    TucoPipeline skinning_pipeline;
+
+    // next free vertex/joint/job, handed out in upload_mesh.
+    uint32_t skinned_vertex_count = 0;
+    uint32_t skin_joint_count = 0;
+    uint32_t skin_job_count = 0;
+    // vertex and joint ranges (start, count, sorted by start) and jobs given
+    // back by objects that were uploaded again, reused before new ones.
+    std::vector<std::pair<uint32_t, uint32_t>> free_skinned_vertices;
+    std::vector<std::pair<uint32_t, uint32_t>> free_skin_joints;
+    std::vector<uint32_t> free_skin_jobs;
+
+    // filled every frame and copied to the image's buffers in write_skinning.
+    std::vector<unsigned char> skinned_vertices;
+    std::vector<glm::mat4> skin_joint_matrices;
+    std::vector<GpuSkinJob> skin_jobs;
+    // vertex count of every job, what record_skinning dispatches for.
+    std::vector<uint32_t> skin_job_vertices;
+    // objects skinned on the cpu this frame and their ranges, in gpu mode
+    // only the ones with blend shapes in use (there is no morph pass).
+    std::vector<GameObject*> cpu_skinned;
+    std::vector<std::pair<uint32_t, uint32_t>> cpu_skinned_ranges;
+    SkinningStats skinning_stats;
+    uint64_t skinning_frame = 0;
+    std::chrono::steady_clock::time_point last_animation_time{};
+
+private:
+    void create_skinning();
+    void destroy_skinning();
+    void register_skinning(GameObject& object);
+    void release_skinning(GameObject& object);
+    void update_skinning(std::vector<std::unique_ptr<GameObject>>& game_objects);
+    void write_skinning(uint32_t image_index);
+    void record_skinning(size_t i);
 
   // draw commands
 };
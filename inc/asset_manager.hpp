@@ -0,0 +1,99 @@
+/* ---------------------- asset_manager.hpp -----------------------
+ * loads assets (currently glTF models) on the job system and hands
+ * back handles that can be polled from the render thread.
+ * ----------------------------------------------------------------
+ */
+
+#pragma once
+
+#include "data_structures.hpp"
+
+#include <bedrock/job_system.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace tuco {
+
+class Model;
+
+enum class AssetState : uint32_t {
+  Pending, // queued, no worker has picked it up yet.
+  Loading, // a worker is parsing the file.
+  Ready,   // cpu-side data is complete and safe to read from any thread.
+  Failed,  // the import failed, the target holds no usable data.
+};
+
+// shared between the handle(s) and the worker that fills the asset.
+struct AssetRecord {
+  uint32_t id = 0;
+  std::string path;
+  std::atomic<AssetState> state{AssetState::Pending};
+  double import_ms = 0.0; // only valid once state is Ready/Failed.
+};
+
+class AssetHandle {
+  friend class AssetManager;
+
+private:
+  std::shared_ptr<AssetRecord> record;
+
+  explicit AssetHandle(std::shared_ptr<AssetRecord> record)
+      : record(std::move(record)) {}
+
+public:
+  AssetHandle() = default;
+
+  // an empty handle refers to no asset (e.g object never had a mesh added).
+  bool valid() const { return record != nullptr; }
+
+  // acquire load, pairs with the release store done by the worker so that
+  // everything the worker wrote is visible once this returns Ready.
+  AssetState get_state() const;
+
+  bool is_ready() const { return get_state() == AssetState::Ready; }
+  bool is_pending() const;
+  bool has_failed() const { return get_state() == AssetState::Failed; }
+
+  uint32_t get_id() const { return record ? record->id : 0; }
+};
+
+class AssetManager {
+private:
+  // the shared job system, looked up on first load so that constructing the
+  // engine singleton does not spin up threads.
+  br::JobSystem *jobs = nullptr;
+  std::mutex jobs_lock;
+
+  std::atomic<uint32_t> next_id{1};
+
+  ModelImportOptions import_options;
+  std::mutex options_lock;
+
+public:
+  AssetManager() = default;
+  ~AssetManager();
+
+  AssetManager(const AssetManager &) = delete;
+  AssetManager &operator=(const AssetManager &) = delete;
+
+  // REQUIRES: target outlives the load and is not read until the handle is
+  //           Ready.
+  // EFFECTS: queues a glTF import into target and returns immediately.
+  AssetHandle load_model(Model *target, const std::string &file_path,
+                         std::optional<std::string> name = std::nullopt);
+
+  // blocks until every queued load has finished.
+  void wait_idle();
+
+  // applies to models queued after this call.
+  void set_import_options(const ModelImportOptions &options);
+
+private:
+  br::JobSystem &get_jobs();
+};
+
+} // namespace tuco
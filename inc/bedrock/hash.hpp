@@ -0,0 +1,19 @@
+/* ---------------------------- hash.hpp -----------------------------
+ * content hashing shared by the caches (mesh cache, textures,
+ * materials, descriptor sets). fast and good enough to tell contents
+ * apart, not meant to resist collisions made on purpose.
+ * ---------------------------------------------------------------
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace br
+{
+
+// EFFECTS: hashes size bytes of data, never returns 0.
+uint64_t hash_bytes(const void* data, size_t size);
+
+} // namespace br
@@ -10,6 +10,8 @@
 
 #include <memory_allocator.hpp>
 
+#include <bedrock/texture_ingest.hpp>
+
 #define MAX_VIEWS 35
 
 namespace br
@@ -33,6 +35,9 @@ struct ImageCreateInfo
     const uint32_t* pQueueFamilyIndices;
 
     vk::MemoryPropertyFlags memory_properties;
+
+    // what the image is used for, for memory accounting.
+    mem::MemoryCategory category = mem::MemoryCategory::Texture;
 };
 
 struct ImageViewCreateInfo
@@ -65,7 +70,6 @@ struct ImageData
 struct RawImageData
 {
     uint32_t image_count;
-    std::vector<unsigned char*> images;
     int width;
     int height;
     int channels; // how many 8 bit components each pixel has (e.g RGB texture has 3*4 = 12 8 bit components)
@@ -78,7 +82,9 @@ struct RawImageData
 enum class ImageFormat
 {
     RGBA_COLOR,
+    RGBA_LINEAR, // 8 bit data that isn't colour (metallic/roughness), sampled without srgb decoding
     HDR_COLOR,
+    HDR_HALF, // loaded from float images, stored as half floats
     DEPTH,
     R_COLOR,
     RG_COLOR,
@@ -117,7 +123,7 @@ private:
     std::vector<vk::ImageView> image_views;
     uint32_t view_index = 0;
 
-    VkDeviceMemory memory;
+    mem::Allocation memory;
     vk::Sampler sampler;
 
     vk::CommandPool command_pool;
@@ -134,11 +140,17 @@ public:
     ~Image();
 
     void init(std::string name, bool handle_destruction = false);
+    //! what the loaders' memory is accounted as, textures unless set (before loading).
+    void set_memory_category(mem::MemoryCategory category) { data.image_info.category = category; }
     //! loads color image from filepath, creating device accessible image. (assumes that Antuco graphics already initialized).
     void load_color_image(std::string file_path);
     void load_cubemap(std::vector<std::string>& file_path, ImageFormat image_format);
     void load_image(std::string &file_path, ImageFormat image_format, ImageType type);
     void load_float_image(std::string& file_path, ImageFormat image_format, ImageType type);
+    //! creates a 2d image from pixels already decoded into image_format (width * height texels).
+    void load_pixels(const unsigned char* pixels, uint32_t width, uint32_t height, ImageFormat image_format);
+    //! false until one of the loaders succeeded.
+    bool is_loaded() const { return static_cast<bool>(image); }
     void set_image_sampler(VkFilter filter, VkSamplerMipmapMode mipMapFilter, VkSamplerAddressMode addressMode);
     void load_blank(ImageDetails info, uint32_t width, uint32_t height, uint32_t layers, uint32_t mip_count);
     void create_view(uint32_t layer_count, uint32_t base_layer, uint32_t base_mip, ImageType type);
@@ -165,6 +177,12 @@ public:
         std::optional<vk::Extent3D> map_size, vk::Queue queue,
         std::optional<vk::CommandBuffer> command_buffer = std::nullopt);
 
+    //! copies image_count layers of image_size bytes each from buffer and leaves the image shader readable
+    //! on the graphics queue. the copy runs on the transfer queue, with a dedicated transfer family the
+    //! image is then handed over to the graphics family. only this upload is waited for.
+    void upload(vk::Buffer buffer, uint32_t image_count, uint32_t image_size,
+                std::optional<vk::Extent3D> map_size = std::nullopt);
+
     void set_write(bool write) { Image::write = write; }
 
     static vk::Format get_vk_format(ImageFormat image_format, uint32_t* channels, uint32_t* size);
@@ -181,10 +199,12 @@ private:
     bool is_3d_image(ImageFormat image_format);
 
     void init_buffer(uint32_t buffer_size, mem::CPUBuffer* buffer);
-    // adds data to buffer, returns offset to end of where last data was allocated.
-    uint32_t add_to_buffer(RawImageData& data, uint32_t image_index, uint32_t offset, mem::CPUBuffer* buffer);
+    // writes the decoded images one after another into a new staging buffer as channels
+    // components of size bytes, then frees them. every image must be the same size.
+    void stage_images(DecodedImage* images, uint32_t image_count, uint32_t channels, uint32_t size,
+                      mem::CPUBuffer* buffer);
 
-    void load_to_gpu(vk::Format format, ImageType type);
+    void load_to_gpu(vk::Format format, ImageType type, mem::CPUBuffer& buffer);
 };
 
 
@@ -0,0 +1,120 @@
+/* ----------------------- job_system.hpp ------------------------
+ * small fixed-size worker pool used to run cpu-side jobs (asset
+ * importing, decoding, etc) off of the main/render thread, and to
+ * split loops across the cores (parallel_for).
+ * ---------------------------------------------------------------
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace br
+{
+
+class JobSystem
+{
+public:
+	using Job = std::function<void()>;
+
+private:
+	// an index range shared by the caller of parallel_for and the workers
+	// helping it. helpers that start after every index was claimed find nothing
+	// left and only touch this, so it lives as long as the last of them.
+	struct ParallelRange
+	{
+		std::atomic<size_t> next{ 0 };
+		std::atomic<uint32_t> running{ 0 }; // helpers inside the range
+		size_t count = 0;
+		void (*call)(void* function, size_t i) = nullptr;
+		void* function = nullptr;
+
+		std::mutex lock;
+		std::condition_variable finished;
+		// the first exception thrown by a call, guarded by lock.
+		std::exception_ptr error;
+	};
+
+	std::vector<std::thread> workers;
+	std::deque<Job> jobs;
+
+	std::mutex queue_lock;
+	std::condition_variable queue_signal;
+	std::condition_variable idle_signal;
+
+	uint32_t active_jobs = 0;
+	bool stopping = false;
+
+public:
+	// a thread_count of 0 will pick a count based on the hardware concurrency
+	// (leaving one core for the render thread).
+	explicit JobSystem(uint32_t thread_count = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// queues a job to be picked up by the next free worker. jobs must not throw,
+	// any exception escaping a job is caught and logged by the worker.
+	void submit(Job job);
+
+	// blocks the calling thread until the queue is empty and no jobs are running.
+	void wait_idle();
+
+	// runs function(i) for every i in [0, count) on the calling thread and
+	// whichever workers are free, returns once every call has finished. the
+	// helpers go ahead of queued jobs. safe to call from inside a job, the
+	// caller only waits on workers that picked up part of the range. if a call
+	// throws, the indices nobody claimed yet are skipped and the first
+	// exception is rethrown here once every helper has left the range.
+	template <typename Function>
+	void parallel_for(size_t count, Function&& function);
+
+	uint32_t get_thread_count() const { return static_cast<uint32_t>(workers.size()); }
+
+	// the pool shared by the engine (asset imports and parallel loops), created
+	// on first use and never destroyed, so it outlives whatever may still wait
+	// on it during static destruction.
+	static JobSystem& get_shared();
+
+private:
+	void worker_loop();
+	void run_range(const std::shared_ptr<ParallelRange>& range, size_t helpers);
+};
+
+template <typename Function>
+void JobSystem::parallel_for(size_t count, Function&& function)
+{
+	size_t helpers = std::min(count, workers.size() + 1) - (count > 0 ? 1 : 0);
+	if (helpers == 0)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			function(i);
+		}
+		return;
+	}
+
+	auto range = std::make_shared<ParallelRange>();
+	range->count = count;
+	range->function = &function;
+	range->call = [](void* f, size_t i)
+	{
+		(*static_cast<std::remove_reference_t<Function>*>(f))(i);
+	};
+	run_range(range, helpers);
+}
+
+}
@@ -0,0 +1,45 @@
+/* ----------------------- mapped_file.hpp ------------------------
+ * read-only memory mapping of a file, lets loaders read cooked data
+ * straight out of the page cache without going through streams.
+ * ----------------------------------------------------------------
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace br
+{
+
+class MappedFile
+{
+private:
+	const unsigned char* mapped_data = nullptr;
+	size_t mapped_size = 0;
+
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#else
+	int file_descriptor = -1;
+#endif
+
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// EFFECTS: maps the whole file, returns false if the file does not exist,
+	//          is empty or could not be mapped.
+	bool open(const std::string& path);
+	void close();
+
+	bool is_open() const { return mapped_data != nullptr; }
+	const unsigned char* data() const { return mapped_data; }
+	size_t size() const { return mapped_size; }
+};
+
+}
@@ -0,0 +1,28 @@
+/* ---------------------- parallel_for.hpp -----------------------
+ * splits an index range over the workers of the shared job system
+ * and the calling thread. also used from work that already runs
+ * inside a job (mesh processing during import), the caller never
+ * waits on helpers that didn't get to start.
+ * ---------------------------------------------------------------
+ */
+
+#pragma once
+
+#include <bedrock/job_system.hpp>
+
+#include <cstddef>
+#include <utility>
+
+namespace br
+{
+
+// EFFECTS: runs function(i) for every i in [0, count), spread over the
+//          available cores. returns once every call has finished, the
+//          first exception a call threw is rethrown after that.
+template <typename Function>
+void parallel_for(size_t count, Function&& function)
+{
+	JobSystem::get_shared().parallel_for(count, std::forward<Function>(function));
+}
+
+} // namespace br
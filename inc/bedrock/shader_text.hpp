@@ -2,6 +2,8 @@
 #pragma once
 
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <shaderc/shaderc.hpp>
 #include <vulkan/vulkan.h>
@@ -21,6 +23,14 @@ enum class ShaderKind {
     ComputeShader = shaderc_compute_shader,
 };
 
+// a runtime sized array in a shader (e.g. sampler2D textures[]), reflection
+// gives it no size so the layout is told how many descriptors it holds.
+struct DescriptorArray {
+    uint32_t set;
+    uint32_t binding;
+    uint32_t count;
+};
+
 class ShaderText {
 private:
     std::unordered_map<ShaderKind, std::vector<uint32_t>> compiled_code;
@@ -47,7 +57,12 @@ public:
     // ShaderText supports the ability to compile multiple shaders, but the expectation is that the given shaders
     // are part of a single PSO (and hence would share descriptor layouts)
     void compile(std::string shader_code_path, ShaderKind kind);
-    void create_layouts(std::shared_ptr<v::Device> device);
+    // dynamic_uniforms lists the uniform and storage buffers (set, binding) that are bound with a
+    // dynamic offset, reflection can't tell them apart from plain ones. descriptor_arrays are made partially bound and
+    // writable while bound (VK_EXT_descriptor_indexing).
+    void create_layouts(std::shared_ptr<v::Device> device,
+                        const std::vector<std::pair<uint32_t, uint32_t>>& dynamic_uniforms = {},
+                        const std::vector<DescriptorArray>& descriptor_arrays = {});
 
 private:
     // Compiles a shader to SPIR-V assembly. Returns the assembly text
@@ -0,0 +1,83 @@
+/* --------------------- texture_ingest.hpp ----------------------
+ * decodes image files with stb and writes their pixels in the
+ * layout the upload path copies to the gpu. decoding keeps the
+ * file's own channel count, the rgba expansion and the float to
+ * half conversion happen afterwards with sse2/f16c, straight into
+ * mapped staging memory.
+ * ---------------------------------------------------------------
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace br
+{
+
+// the component type texels are written as.
+enum class TexelFormat
+{
+	Unorm8,
+	Float16,
+	Float32
+};
+
+// below this many pixels an image is converted on the calling thread alone.
+const size_t TEXEL_PARALLEL_PIXELS = 1 << 20;
+
+// pixels as stb decoded them.
+struct DecodedImage
+{
+	void* pixels = nullptr; // unsigned char or float, see is_float
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t channels = 0;
+	bool is_float = false;
+};
+
+// EFFECTS: the bytes one component of format takes.
+size_t get_texel_size(TexelFormat format);
+
+// EFFECTS: decodes the image in bytes. a channels of 0 keeps the image's own
+//          channel count (write_texels expands it), otherwise stb converts it.
+//          returns false if the data could not be decoded.
+bool decode_image(const unsigned char* bytes, size_t size, uint32_t channels, bool is_float,
+	DecodedImage& image);
+
+// REQUIRES: images holds count elements.
+// MODIFIES: images
+// EFFECTS: decodes every file of paths concurrently, see decode_image. returns false (and
+//          frees whatever was decoded) if any of them could not be read.
+bool decode_image_files(const std::string* paths, size_t count, uint32_t channels, bool is_float,
+	DecodedImage* images);
+
+// MODIFIES: image
+// EFFECTS: releases the decoded pixels.
+void free_decoded_image(DecodedImage& image);
+
+// REQUIRES: src holds pixel_count pixels of src_channels (1 to 4) bytes, dst holds
+//           pixel_count * 4 bytes.
+// MODIFIES: dst
+// EFFECTS: writes the pixels as rgba, grey is replicated into rgb, missing alpha is opaque.
+void expand_to_rgba8(const unsigned char* src, uint32_t src_channels, size_t pixel_count,
+	unsigned char* dst);
+
+// same as expand_to_rgba8 for float pixels.
+void expand_to_rgba32f(const float* src, uint32_t src_channels, size_t pixel_count, float* dst);
+
+// same as expand_to_rgba32f, but writes half floats (rounded to nearest even).
+void expand_to_rgba16f(const float* src, uint32_t src_channels, size_t pixel_count, uint16_t* dst);
+
+// EFFECTS: value as a half float, rounded to nearest even.
+uint16_t float_to_half(float value);
+
+// REQUIRES: image.channels == channels, or channels == 4. image.is_float unless format is
+//           Unorm8. dst holds width * height * channels * get_texel_size(format) bytes.
+// MODIFIES: dst
+// EFFECTS: writes the pixels of image to dst as channels components of format. large
+//          images are split over the available cores.
+void write_texels(const DecodedImage& image, uint32_t channels, TexelFormat format, void* dst);
+
+}
@@ -0,0 +1,120 @@
+/* ------------------------ cluster_culling.hpp ------------------------
+ * per-meshlet frustum and back-face (normal cone) culling. the cpu
+ * path tests four clusters at a time, the gpu path (cluster_cull.comp)
+ * does the same test per thread. both write VkDrawIndexedIndirectCommands
+ * that draw straight out of the shared vertex/index buffers.
+ * ---------------------------------------------------------------------
+ */
+
+#pragma once
+
+#include "meshlet.hpp"
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tuco {
+
+enum class ClusterCullMode {
+  Off, // primitives are drawn whole
+  Cpu, // clusters are culled on the cpu right before submitting the frame
+  Gpu, // clusters are culled by a compute pass at the start of the frame
+};
+
+// upper bound on the indirect commands (one per meshlet) per frame.
+const uint32_t MAX_CLUSTER_COMMANDS = 1 << 16;
+// upper bound on primitives that are cluster culled.
+const uint32_t MAX_CLUSTER_JOBS = 1 << 12;
+// workgroup size of cluster_cull.comp.
+const uint32_t CLUSTER_CULL_GROUP_SIZE = 64;
+
+// meshlet bounds of an object in model space, split into one array per
+// component so four clusters can be loaded at once.
+struct ClusterBounds {
+  std::vector<float> center_x;
+  std::vector<float> center_y;
+  std::vector<float> center_z;
+  std::vector<float> radius;
+  std::vector<float> axis_x;
+  std::vector<float> axis_y;
+  std::vector<float> axis_z;
+  std::vector<float> cutoff;
+
+  // where the meshlet's indices ended up in the index buffer.
+  std::vector<uint32_t> first_index;
+  std::vector<uint32_t> index_count;
+
+  size_t size() const { return radius.size(); }
+  void clear();
+  void push_back(const Meshlet &meshlet, uint32_t first_index,
+                 uint32_t index_count);
+};
+
+struct ClusterCullStats {
+  uint32_t tested = 0;
+  // passed both tests. in gpu mode this is read back from the last frame
+  // drawn to the same swapchain image.
+  uint32_t visible = 0;
+  uint32_t frustum_culled = 0; // cpu mode only
+  uint32_t cone_culled = 0;    // cpu mode only
+  uint32_t commands = 0; // indirect draws left after merging neighbours
+
+  uint32_t get_culled() const { return tested > visible ? tested - visible : 0; }
+};
+
+// mirrors ClusterData in cluster_cull.comp (std430).
+struct GpuCluster {
+  glm::vec4 sphere; // xyz center, w radius
+  glm::vec4 cone;   // xyz axis, w cutoff
+  uint32_t first_index;
+  uint32_t index_count;
+  int32_t vertex_offset;
+  uint32_t job; // UINT32_MAX for the slots of released primitives
+};
+
+// mirrors CullJob in cluster_cull.comp (std430), one per cluster culled
+// primitive, rewritten every frame.
+struct GpuClusterJob {
+  glm::vec4 planes[6]; // in the primitive's model space
+  glm::vec4 eye;       // in the primitive's model space, w = 0 skips cones
+  uint32_t command_slot;
+  uint32_t enabled;
+  uint32_t visible_count; // reset to 0 by the cpu, bumped by the shader
+  uint32_t padding;
+};
+
+static_assert(sizeof(GpuCluster) == 48, "layout has to match the shader");
+static_assert(sizeof(GpuClusterJob) == 128, "layout has to match the shader");
+
+// EFFECTS: extracts the six planes of the frustum described by clip
+//          (projection * view * model), normalized and pointing inwards, so
+//          they are in model space.
+void extract_frustum_planes(const glm::mat4 &clip, glm::vec4 planes[6]);
+
+// REQUIRES: visible holds count entries, planes and eye are in the same space
+//           as bounds.
+// MODIFIES: visible, stats
+// EFFECTS: tests clusters [first, first + count) against the frustum and their
+//          normal cones (unless test_cones is false, e.g. for mirroring
+//          transforms that flip the winding), visible[i] is set to 0 for
+//          clusters that can't be seen and to 1 otherwise.
+void cull_clusters(const ClusterBounds &bounds, size_t first, size_t count,
+                   const glm::vec4 planes[6], const glm::vec3 &eye,
+                   bool test_cones, uint8_t *visible, ClusterCullStats &stats);
+
+// MODIFIES: commands, stats
+// EFFECTS: writes one command per run of visible, neighbouring clusters into
+//          commands[0, count) and zeroes the rest, so the whole range can be
+//          drawn with one indirect call. returns the number of commands
+//          written.
+uint32_t write_cluster_commands(const ClusterBounds &bounds, size_t first,
+                                size_t count, const uint8_t *visible,
+                                int32_t vertex_offset,
+                                VkDrawIndexedIndirectCommand *commands,
+                                ClusterCullStats &stats);
+
+} // namespace tuco
@@ -19,6 +19,50 @@
 #include <string>
 
 const uint32_t MAX_SHADOW_CASTERS = 4;
+
+// a level of detail is drawn while its simplification error covers less than
+// this many pixels on screen.
+const float LOD_PIXEL_ERROR = 1.0f;
+// moving to a coarser level also needs the error to be this fraction under
+// LOD_PIXEL_ERROR, so objects sitting at a boundary don't switch every frame.
+const float LOD_HYSTERESIS = 0.25f;
+// frames between two cluster culling readouts in the log.
+const uint32_t CLUSTER_STATS_INTERVAL = 120;
+// frames between two skinning readouts in the log.
+const uint32_t SKINNING_STATS_INTERVAL = 120;
+// frames between two staging readouts in the log, only written when something
+// was staged since the last one.
+const uint32_t STAGING_STATS_INTERVAL = 120;
+// bytes of the persistently mapped ring vertex and index uploads are staged in.
+const uint64_t STAGING_RING_SIZE = 64ull << 20;
+// bytes of mesh data uploaded per frame at most, objects over it wait for a
+// later frame (a single object larger than this still goes alone).
+const uint64_t STAGING_FRAME_BUDGET = 16ull << 20;
+// bytes of mesh data the vertex and index buffers each move per frame at most
+// while compacting.
+const uint64_t GEOMETRY_COMPACTION_BUDGET = 4ull << 20;
+// bytes of per frame uniform data (object and scene transforms) one region of
+// the uniform ring holds, there is a region per swapchain image.
+const uint64_t UNIFORM_RING_REGION_SIZE = 4ull << 20;
+// bytes every frame in flight starts with for render loop temporaries, the
+// frame arena takes more blocks when a frame needs them.
+const size_t FRAME_ARENA_BLOCK_SIZE = 1ull << 20;
+// nodes the transform table (in the uniform ring) has room for.
+const uint32_t MAX_TRANSFORMS = 8192;
+// normal matrices are computed across threads once this many nodes moved.
+const uint32_t TRANSFORM_PARALLEL_NODES = 1024;
+// frames between two checks of the device memory heaps against their budget.
+const uint32_t MEMORY_BUDGET_INTERVAL = 60;
+// share of a heap's budget in use at which the renderer warns and gives spare
+// memory back.
+const float MEMORY_BUDGET_WARNING = 0.9f;
+// allocations listed by the memory report, largest first.
+const size_t MEMORY_REPORT_LARGEST = 32;
+// slots of the bindless texture table (fewer if the device can't hold as
+// many) and materials the bindless material table starts with (it doubles
+// when they are used up).
+const uint32_t BINDLESS_TEXTURE_COUNT = 4096;
+const uint32_t BINDLESS_MATERIAL_COUNT = 4096;
 const char PROJECT_ROOT[7] = "Antuco";
 
 
@@ -48,3 +92,7 @@ extern std::vector<char> read_file(const std::string& filename);
 //REQUIRES: filename should be a string representing a path to a file
 //EFFECTS: returns the extension of the file given
 extern std::string get_extension_from_file_path(const std::string& filename);
+
+//EFFECTS: returns the peak resident memory of the process in bytes (0 if the
+//         platform doesn't expose it)
+extern size_t get_peak_memory_usage();
@@ -6,12 +6,15 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
 #include <memory>
 #include <optional>
 #include <string>
 #include <vector>
 
 const uint32_t MATERIALS_POOL_SIZE = 5;
+// levels of detail per primitive, including the imported mesh (level 0).
+const uint32_t MAX_LOD_COUNT = 4;
 
 namespace tuco {
 struct PushFragConstant {
@@ -23,10 +26,15 @@ public:
   glm::vec4 position;
   glm::vec4 normal;
   glm::vec2 tex_coord;
+  // skinning influences, joints index Model::joint_nodes. vertices of models
+  // without skins leave both zeroed.
+  glm::u16vec4 joints;
+  glm::vec4 weights;
 
 public:
+  Vertex() = default;
   Vertex(glm::vec4 pos, glm::vec4 norm, glm::vec2 tex);
-  ~Vertex();
+  ~Vertex() = default;
 
   std::string to_string();
   // restructure the data stored into a linear array of floats: [positions,
@@ -40,6 +48,14 @@ struct UniformBufferObject {
   glm::mat4 projection;
 };
 
+// one node's entry in the transform table shader.vert reads.
+struct TransformObject {
+  glm::mat4 model_to_world;
+  // inverse transpose of model_to_world without the position dequantization,
+  // only the upper 3x3 is used.
+  glm::mat4 normal_matrix;
+};
+
 struct LightObject {
   glm::vec4 color;
   glm::vec4 direction;
@@ -52,6 +68,13 @@ struct LightBufferObject {
   glm::mat4 projection;
 };
 
+// a simplified version of a primitive, references the same vertices.
+struct PrimitiveLod {
+  uint32_t index_start;
+  uint32_t index_count;
+  float error; // how far (in model units) the surface may have moved
+};
+
 struct Primitive {
   uint32_t index_start;
   uint32_t index_count;
@@ -59,6 +82,34 @@ struct Primitive {
   int mat_index;
   int image_index;
   bool is_transparent;
+
+  // levels 1 and up, from finest to coarsest.
+  uint32_t lod_count;
+  PrimitiveLod lods[MAX_LOD_COUNT - 1];
+
+  // range in Model::meshlets, the meshlets split up level 0.
+  uint32_t meshlet_start;
+  uint32_t meshlet_count;
+};
+
+// what happens to a mesh between parsing it and handing it to the renderer.
+// every stage is off by default, the mesh is then drawn as it was imported
+// (one level of detail, no cluster culling).
+struct ModelImportOptions {
+  // run the mesh optimizer (mesh_optimizer.hpp) over the imported primitives.
+  bool optimize = false;
+  // simplified levels generated per primitive on top of the imported one
+  // (mesh_simplifier.hpp), clamped to MAX_LOD_COUNT - 1.
+  uint32_t lod_count = 0;
+  // fraction of triangles every level keeps from the level before it.
+  float lod_ratio = 0.5f;
+  // split level 0 of every primitive into meshlets (meshlet.hpp) for cluster
+  // culling.
+  bool build_meshlets = false;
+
+  // EFFECTS: packs the options into MeshCacheHeader::flags, so caches cooked
+  //          with different options are not picked up.
+  uint32_t get_cache_flags() const;
 };
 
 struct ImageBuffer {
@@ -68,6 +119,22 @@ struct ImageBuffer {
   // image dimensions
   uint32_t width;
   uint32_t height;
+
+  // identifies the image in the texture cache (texture_cache.hpp): its path
+  // if it came from a file, its contents otherwise.
+  uint64_t key = 0;
+};
+
+// a gltf metallic-roughness material as imported. the images index
+// Model::model_images, -1 if the factor is used alone. every member has a
+// fixed width so it can be cooked into the mesh cache as is.
+struct MaterialDescription {
+  glm::vec4 base_color = glm::vec4(1.0f);
+  float metallic = 1.0f;
+  float roughness = 1.0f;
+  int32_t base_color_image = -1;
+  int32_t metallic_roughness_image = -1; // roughness in g, metallic in b
+  uint32_t blend = 0;                    // alphaMode BLEND
 };
 
 struct TransparentMesh {
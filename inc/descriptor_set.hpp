@@ -6,6 +6,7 @@
 #include "vulkan/vulkan_core.h"
 #include "vulkan_wrapper/device.hpp"
 
+#include <unordered_map>
 #include <vector>
 #include <vulkan/vulkan.hpp>
 
@@ -46,11 +47,38 @@ struct ImageDescription
     VkSampler sampler;
 };
 
+// one binding of a set written by ResourceCollection::acquire_set, buffer is
+// read for buffer types and image for image types.
+struct ResourceBinding {
+    uint32_t binding;
+    VkDescriptorType type;
+    VkDescriptorBufferInfo buffer{};
+    VkDescriptorImageInfo image{};
+};
+
+struct SetCacheStats {
+    uint64_t hits = 0;     // acquire_set calls answered with a set in use
+    uint64_t writes = 0;   // acquire_set calls that wrote a set
+    uint64_t releases = 0; // sets given back to the pool
+};
+
 class ResourceCollection {
 private:
+    // a set handed out by acquire_set, shared by everyone asking for the same
+    // bindings.
+    struct SharedSet {
+        uint64_t key = 0;
+        uint32_t references = 0;
+        std::vector<ResourceBinding> bindings;
+    };
+
     v::Device *device;
 
     std::vector<VkDescriptorSet> sets;
+    std::vector<SharedSet> shared_sets; // by set index, acquired sets only
+    std::unordered_multimap<uint64_t, uint32_t> set_cache; // key to set index
+    std::vector<uint32_t> free_indices; // released, their set went back
+    SetCacheStats cache_stats;
     std::vector<std::vector<ResourceWriteInfo>> setsUpdateInfo;
     std::vector<VkDescriptorImageInfo> descriptorImageInfo;
     std::vector<VkDescriptorBufferInfo> descriptorBufferInfo;
@@ -72,6 +100,22 @@ public:
     void updateSet(size_t i);
     uint32_t addSets(uint32_t setCount, mem::Pool &pool);
 
+    // EFFECTS: index of a set holding bindings. while a set with the same
+    //          bindings is in use it is the one returned (and counted),
+    //          otherwise a set from pool is written.
+    uint32_t acquire_set(const std::vector<ResourceBinding> &bindings,
+                         mem::Pool &pool);
+    // REQUIRES: index came from acquire_set, pool is the one it was given.
+    // EFFECTS: drops a reference, the last one gives the set back to pool and
+    //          the index may be handed out again.
+    void release_set(uint32_t index, mem::Pool &pool);
+    const SetCacheStats &get_cache_stats() const { return cache_stats; }
+
+    // REQUIRES: set_index came from addSets.
+    // EFFECTS: writes binding to element of its array in the set, right away.
+    void write_element(uint32_t set_index, uint32_t element,
+                       const ResourceBinding &binding);
+
     void addImage(uint32_t binding, VkDescriptorType type,
                   VkImageLayout image_layout, br::Image& image,
                   vk::Sampler &image_sampler);
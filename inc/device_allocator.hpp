@@ -0,0 +1,266 @@
+/* ----------------------- device_allocator.hpp ----------------------
+ * sub-allocates device memory for buffers and images. every memory
+ * type gets a heap of large blocks, a block is split between
+ * resources with a two level segregated fit (tlsf) allocator, so the
+ * number of vkAllocateMemory calls stays small and allocating or
+ * freeing is constant time. large resources (and images the driver
+ * wants on their own) get dedicated allocations. host visible blocks
+ * are mapped once, for their whole lifetime.
+ *
+ * every allocation is tagged with what it holds, so memory can be
+ * accounted per category, and the heaps are checked against the
+ * budget VK_EXT_memory_budget reports (or an estimate without it).
+ * -------------------------------------------------------------------
+ */
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mem {
+
+// size of the blocks resources are sub-allocated from, heaps smaller than
+// ALLOCATOR_SMALL_HEAP use an eighth of the heap instead.
+const VkDeviceSize ALLOCATOR_BLOCK_SIZE = 64ull << 20;
+const VkDeviceSize ALLOCATOR_SMALL_HEAP = 1ull << 30;
+// share of a heap assumed to be available without VK_EXT_memory_budget.
+const float ALLOCATOR_ESTIMATED_BUDGET = 0.8f;
+
+// what an allocation holds, for accounting.
+enum class MemoryCategory : uint32_t {
+  Geometry,
+  Texture,
+  RenderTarget,
+  Uniform,
+  Staging,
+  Environment,
+  Other,
+  Count
+};
+const uint32_t MEMORY_CATEGORY_COUNT =
+    static_cast<uint32_t>(MemoryCategory::Count);
+
+const char *get_category_name(MemoryCategory category);
+
+struct Allocation {
+  vk::DeviceMemory memory;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  // the allocation's first byte, for host visible memory.
+  unsigned char *mapped = nullptr;
+  uint32_t memory_type = UINT32_MAX;
+  // where the allocation came from, heap is UINT32_MAX for dedicated ones.
+  uint32_t heap = UINT32_MAX;
+  uint32_t block = 0;
+  uint32_t node = 0;
+  MemoryCategory category = MemoryCategory::Other;
+  uint64_t id = 0; // key of the allocation in the allocator's report
+
+  bool valid() const { return static_cast<bool>(memory); }
+};
+
+struct AllocationInfo {
+  vk::MemoryPropertyFlags required;
+  // picked over other types with the required flags when available.
+  vk::MemoryPropertyFlags preferred;
+  // optimal tiled images are kept apart from buffers and linear images, so
+  // neighbours never share a bufferImageGranularity page.
+  bool optimal_image = false;
+  // gets its own VkDeviceMemory. large requests always do.
+  bool dedicated = false;
+  // the resource a dedicated allocation is for (VkMemoryDedicatedAllocateInfo).
+  vk::Image dedicated_image;
+  vk::Buffer dedicated_buffer;
+  MemoryCategory category = MemoryCategory::Other;
+  // shows up in the memory report, copied.
+  const char *name = nullptr;
+};
+
+struct MemoryTypeStats {
+  uint32_t blocks = 0;
+  VkDeviceSize block_bytes = 0;
+  uint32_t allocations = 0;
+  VkDeviceSize allocated_bytes = 0; // in blocks
+  uint32_t dedicated = 0;
+  VkDeviceSize dedicated_bytes = 0;
+};
+
+struct CategoryStats {
+  uint32_t allocations = 0;
+  VkDeviceSize bytes = 0;
+};
+
+struct HeapBudget {
+  VkDeviceSize size = 0;
+  // what the process may use and uses, as of the last update_budget(). from
+  // VK_EXT_memory_budget when available, an estimate from what this
+  // allocator holds otherwise.
+  VkDeviceSize budget = 0;
+  VkDeviceSize usage = 0;
+  VkDeviceSize allocated = 0; // blocks and dedicated allocations of this heap
+  bool device_local = false;
+};
+
+struct AllocatorStats {
+  std::vector<MemoryTypeStats> types; // per memory type
+  std::vector<HeapBudget> heaps;      // per memory heap
+  std::array<CategoryStats, MEMORY_CATEGORY_COUNT> categories;
+  uint32_t device_allocations = 0;    // live vkAllocateMemory allocations
+  uint32_t max_device_allocations = 0; // maxMemoryAllocationCount
+  bool memory_budget = false;         // VK_EXT_memory_budget is in use
+};
+
+// free space of one block, see "TLSF: a new dynamic memory allocator for
+// real-time systems" (Masmano et al). free ranges are binned by the position
+// of their highest bit and SL_COUNT linear steps below it.
+class TlsfBlock {
+public:
+  static const uint32_t SL_BITS = 4;
+  static const uint32_t SL_COUNT = 1 << SL_BITS;
+  static const uint32_t FL_COUNT = 64;
+  static const uint32_t NONE = UINT32_MAX;
+
+private:
+  struct Node {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint32_t prev_physical;
+    uint32_t next_physical;
+    uint32_t prev_free;
+    uint32_t next_free;
+    bool free;
+  };
+
+  std::vector<Node> nodes;
+  std::vector<uint32_t> unused_nodes;
+
+  uint64_t fl_bitmap = 0;
+  uint32_t sl_bitmap[FL_COUNT];
+  uint32_t heads[FL_COUNT][SL_COUNT];
+
+  VkDeviceSize size = 0;
+  VkDeviceSize free_bytes = 0;
+
+public:
+  void init(VkDeviceSize size);
+
+  // EFFECTS: the offset of size free bytes aligned to alignment, and the node
+  //          that frees them. false if the block has no range large enough.
+  bool allocate(VkDeviceSize size, VkDeviceSize alignment,
+                VkDeviceSize &offset, uint32_t &node);
+  // REQUIRES: node was returned by allocate and not freed since.
+  void free(uint32_t node);
+
+  bool empty() const { return free_bytes == size; }
+  VkDeviceSize get_free_bytes() const { return free_bytes; }
+  VkDeviceSize get_largest_free() const;
+
+private:
+  uint32_t create_node(VkDeviceSize offset, VkDeviceSize size);
+  void release_node(uint32_t node);
+  void insert_free(uint32_t node);
+  void remove_free(uint32_t node);
+  // EFFECTS: a free node of at least size bytes, NONE if there is none.
+  uint32_t find_free(VkDeviceSize size);
+};
+
+class DeviceAllocator {
+private:
+  struct Block {
+    vk::DeviceMemory memory;
+    unsigned char *mapped = nullptr;
+    TlsfBlock space;
+  };
+
+  struct Heap {
+    uint32_t memory_type;
+    bool optimal_image;
+    VkDeviceSize block_size;
+    std::vector<std::unique_ptr<Block>> blocks; // freed blocks leave nullptr
+  };
+
+  struct LiveAllocation {
+    std::string name;
+    MemoryCategory category;
+    VkDeviceSize size;
+    uint32_t memory_type;
+    bool dedicated;
+  };
+
+  vk::Device device;
+  vk::PhysicalDevice physical_device;
+  vk::PhysicalDeviceMemoryProperties properties;
+  VkDeviceSize image_granularity = 1;
+
+  std::vector<Heap> heaps;
+  std::unordered_map<uint64_t, LiveAllocation> live; // by Allocation::id
+  uint64_t next_id = 1;
+  std::vector<bool> over_budget; // per memory heap, as of the last check
+  AllocatorStats stats;
+  std::mutex mutex;
+
+public:
+  // memory_budget: VK_EXT_memory_budget was enabled on device.
+  void init(vk::PhysicalDevice physical_device, vk::Device device,
+            bool memory_budget = false);
+  // REQUIRES: every allocation has been freed, or is never used again.
+  void destroy();
+
+  // EFFECTS: memory for requirements, from the best memory type that has the
+  //          required flags. throws if no type can hold it.
+  Allocation allocate(const vk::MemoryRequirements &requirements,
+                      const AllocationInfo &info);
+  // MODIFIES: allocation
+  // EFFECTS: returns the memory to its block (or the driver), allocation is
+  //          left invalid.
+  void free(Allocation &allocation);
+
+  // EFFECTS: the memory types in type_bits with every required flag, the ones
+  //          with the most preferred and fewest other flags first.
+  std::vector<uint32_t> get_memory_types(uint32_t type_bits,
+                                         vk::MemoryPropertyFlags required,
+                                         vk::MemoryPropertyFlags preferred) const;
+
+  // EFFECTS: queries the heaps' budget and usage.
+  void update_budget();
+  // EFFECTS: updates the budget, warns about every heap that went past
+  //          warning (a share of its budget) and gives the spare empty blocks
+  //          of those heaps back. true if any heap is past it.
+  bool check_budget(float warning);
+  // EFFECTS: frees the empty blocks kept around for reuse, of memory_heap
+  //          only unless it is UINT32_MAX. the bytes released.
+  VkDeviceSize trim(uint32_t memory_heap = UINT32_MAX);
+
+  AllocatorStats get_stats();
+  // logs every memory type and category in use.
+  void log_stats();
+  // EFFECTS: json describing the heaps (budget and usage), the allocator's
+  //          pools (usage and fragmentation), the categories and the
+  //          largest_count largest allocations.
+  std::string get_report(size_t largest_count);
+
+private:
+  bool allocate_from_heap(uint32_t heap_index, VkDeviceSize size,
+                          VkDeviceSize alignment, Allocation &allocation);
+  bool allocate_dedicated(uint32_t memory_type, VkDeviceSize size,
+                          const AllocationInfo &info, Allocation &allocation);
+  uint32_t get_heap(uint32_t memory_type, bool optimal_image);
+  vk::DeviceMemory allocate_memory(uint32_t memory_type, VkDeviceSize size,
+                                   const void *p_next);
+  void release_memory(vk::DeviceMemory memory);
+  bool is_host_visible(uint32_t memory_type) const;
+  void track(Allocation &allocation, const AllocationInfo &info);
+  void untrack(const Allocation &allocation);
+  // REQUIRES: mutex is held.
+  void refresh_budget();
+  VkDeviceSize release_spare_blocks(uint32_t memory_heap);
+};
+
+} // namespace mem
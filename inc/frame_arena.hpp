@@ -0,0 +1,106 @@
+/* -------------------------- frame_arena.hpp -------------------------
+ * linear (bump) allocator for temporaries of the render loop. every
+ * frame in flight has its own slot. a slot is rewound when its frame
+ * comes around again, by which point the frame's fence has signalled.
+ * a slot keeps its blocks across frames, so after the first few frames
+ * the render loop's scratch vectors never reach the heap.
+ * -------------------------------------------------------------------
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace mem {
+
+struct FrameArenaStats {
+  size_t frame_bytes = 0; // handed out since the last begin_frame()
+  size_t peak_bytes = 0;  // most any frame has used
+  size_t block_bytes = 0; // held by every slot
+  uint32_t blocks = 0;
+  // blocks allocated since the last take_grows(), past the ones init()
+  // set up. a steady state frame shouldn't add any.
+  uint32_t grows = 0;
+  uint64_t frame = 0; // begin_frame() calls
+};
+
+class FrameArena {
+private:
+  struct Block {
+    std::unique_ptr<unsigned char[]> data;
+    size_t size;
+  };
+
+  struct Slot {
+    std::vector<Block> blocks;
+    size_t block = 0; // the block being bumped
+    size_t head = 0;  // next free byte of that block
+  };
+
+  std::vector<Slot> slots;
+  uint32_t current = 0;
+  size_t block_size = 0;
+  FrameArenaStats stats;
+
+public:
+  FrameArena() = default;
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  // every slot starts with a block of block_size bytes.
+  void init(size_t block_size, uint32_t slot_count);
+  void destroy();
+
+  // REQUIRES: the frame that last used the next slot has finished.
+  // MODIFIES: this
+  // EFFECTS: moves to the next slot and rewinds it, what was allocated from
+  //          it before is gone.
+  void begin_frame();
+
+  // EFFECTS: size bytes aligned to alignment, alive until the slot is
+  //          rewound. takes a new block when the current ones are full.
+  void *allocate(size_t size, size_t alignment);
+
+  // EFFECTS: the number of blocks that were allocated since the last call,
+  //          so callers can tell a frame that reached the heap.
+  uint32_t take_grows();
+
+  const FrameArenaStats &get_stats() const { return stats; }
+
+private:
+  void add_block(Slot &slot, size_t size);
+};
+
+// stl allocator handing out memory of a FrameArena. deallocate does nothing,
+// the memory comes back when the arena's slot is rewound.
+template <typename T> class FrameAllocator {
+public:
+  using value_type = T;
+
+  FrameArena *arena;
+
+  FrameAllocator(FrameArena &arena) noexcept : arena(&arena) {}
+  template <typename U>
+  FrameAllocator(const FrameAllocator<U> &other) noexcept
+      : arena(other.arena) {}
+
+  T *allocate(size_t count) {
+    return static_cast<T *>(arena->allocate(count * sizeof(T), alignof(T)));
+  }
+  void deallocate(T *, size_t) noexcept {}
+
+  template <typename U> bool operator==(const FrameAllocator<U> &other) const {
+    return arena == other.arena;
+  }
+  template <typename U> bool operator!=(const FrameAllocator<U> &other) const {
+    return arena != other.arena;
+  }
+};
+
+// a vector that lives for one frame. reserve up front where the size is
+// known, growing leaves the old storage behind in the arena.
+template <typename T> using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+} // namespace mem
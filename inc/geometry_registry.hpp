@@ -0,0 +1,93 @@
+/* ----------------------- geometry_registry.hpp -----------------------
+ * keeps track of the mesh data uploaded to the backend's vertex/index
+ * buffers. uploads are keyed by the source they were built from, so
+ * objects using the same file share one copy on the gpu. the key's
+ * hash covers the buffers and images the file references as well
+ * (hash_gltf), editing any of them makes a new entry.
+ * ---------------------------------------------------------------------
+ */
+
+#pragma once
+
+#include "world_objects.hpp"
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tuco {
+
+struct GeometryKey {
+  std::string path;
+  // Model::source_hash, 0 means the geometry can't be shared.
+  uint64_t hash = 0;
+
+  bool operator==(const GeometryKey &other) const {
+    return hash == other.hash && path == other.path;
+  }
+};
+
+struct GeometryKeyHash {
+  size_t operator()(const GeometryKey &key) const {
+    return std::hash<std::string>{}(key.path) ^
+           static_cast<size_t>(key.hash * 0x9E3779B97F4A7C15ull);
+  }
+};
+
+// one upload, everything an object needs to draw it.
+struct SharedGeometry {
+  VkDeviceSize vertex_location = 0; // bytes into the vertex buffer
+  VkDeviceSize index_location = 0;  // bytes into the index buffer
+  uint32_t buffer_vertex_offset = 0;
+  uint32_t buffer_index_offset = 0;
+  glm::mat4 dequantization = glm::mat4(1.0f);
+  // level 0 selected and no cluster slots handed out, objects copy these.
+  std::vector<PrimitiveDraw> primitive_draws;
+  size_t vertex_bytes = 0;
+  size_t index_bytes = 0;
+
+  GeometryKey key;
+  uint32_t ref_count = 0;
+};
+
+class GeometryRegistry {
+private:
+  std::unordered_map<uint32_t, SharedGeometry> entries;
+  std::unordered_map<GeometryKey, uint32_t, GeometryKeyHash> lookup;
+  uint32_t next_id = 0;
+
+public:
+  // EFFECTS: returns the id of the geometry uploaded for key and takes a
+  //          reference to it, or nullopt if there is none (or key can't be
+  //          shared).
+  std::optional<uint32_t> acquire(const GeometryKey &key);
+
+  // EFFECTS: records a new upload for key with one reference and returns its
+  //          id.
+  uint32_t add(const GeometryKey &key, SharedGeometry geometry);
+
+  // REQUIRES: id came from acquire/add and still holds a reference.
+  // MODIFIES: this, released
+  // EFFECTS: drops a reference, returns true and moves the entry into released
+  //          once nobody uses it anymore (the caller frees its ranges).
+  bool release(uint32_t id, SharedGeometry &released);
+
+  const SharedGeometry &get(uint32_t id) const { return entries.at(id); }
+  SharedGeometry &get(uint32_t id) { return entries.at(id); }
+
+  // EFFECTS: the id of the upload whose vertices (indices) start at location,
+  //          nullopt if there is none.
+  std::optional<uint32_t> find_vertices(VkDeviceSize location) const;
+  std::optional<uint32_t> find_indices(VkDeviceSize location) const;
+
+  size_t get_upload_count() const { return entries.size(); }
+  // bytes that would have been uploaded without sharing.
+  size_t get_saved_bytes() const;
+};
+
+} // namespace tuco
@@ -30,8 +30,8 @@ public:
 public:
 	void update_camera(glm::mat4 world_to_camera, glm::mat4 projection, glm::vec4 pos);
 	void update_light(
-            std::vector<tuco::DirectionalLight> lights, 
-            std::vector<int> shadow_indices);
+            const std::vector<tuco::DirectionalLight>& lights,
+            const std::vector<int>& shadow_indices);
 
 	void update_draw(std::vector<std::unique_ptr<GameObject>>& game_objects);
 
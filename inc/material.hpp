@@ -15,7 +15,8 @@ namespace tuco
 struct MaterialGpuInfo
 {
 	VkDeviceSize bufferOffset;
-	uint32_t setIndex;
+	uint32_t setIndex = UINT32_MAX; // UINT32_MAX until the material is written
+	uint32_t tableIndex = UINT32_MAX; // element of the bindless material table
 };
 
 struct MaterialBufferObject
@@ -24,8 +25,11 @@ struct MaterialBufferObject
 	glm::vec4 pbrParameters = glm::vec4(0.0);
 	glm::vec4 hasTexture = glm::vec4(0.0); // hasBaseTexture, hasMetallic, hasRoughness
 	glm::vec4 albedo = glm::vec4(0.0);
+	// texture table slots of the base, roughness metallic and metallic textures, only read by the
+	// bindless shaders.
+	glm::uvec4 textures = glm::uvec4(0);
 
-	glm::vec4 padding[2] = { glm::vec4(0), glm::vec4(0) };
+	glm::vec4 padding = glm::vec4(0);
 
 	std::vector<float> linearize();
 };
@@ -33,9 +37,10 @@ struct MaterialBufferObject
 class Material : public br::GPUResource
 {
 private:
-	br::Image baseColorImage;
-	br::Image roughnessMetallicTexture;
-	br::Image metallicTexture;
+	// owned by the texture cache (texture_cache.hpp), materials sharing an image share the texture.
+	br::Image* baseColorImage = nullptr;
+	br::Image* roughnessMetallicTexture = nullptr;
+	br::Image* metallicTexture = nullptr;
 public:
 	// uint32_t image_index;
 	// std::optional<std::string> texturePath;
@@ -64,7 +69,8 @@ public:
 
 
 	void setBaseColorTexture(std::string filePath);
-	br::Image& getBaseColorImage() { return baseColorImage; }
+	void setBaseColorImage(br::Image* image);
+	br::Image& getBaseColorImage() { return *baseColorImage; }
 
 	// [TODO] - If roughness and metallic textures are provided separately, then they will need to be
 	// combined into a single texture before passing to shader.
@@ -75,10 +81,11 @@ public:
 	//br::Image& getMetallicImage() { return metallicimage; }
 
 	void setRoughnessMetallicTexture(std::string filePath);
-	br::Image& getRoughnessMetallicImage() { return roughnessMetallicTexture; }
+	void setRoughnessMetallicImage(br::Image* image);
+	br::Image& getRoughnessMetallicImage() { return *roughnessMetallicTexture; }
 
 	void setMetallicTexture(std::string& filePath);
-	br::Image& getMetallicTexture() { return metallicTexture; }
+	br::Image& getMetallicTexture() { return *metallicTexture; }
 
 protected:
 	void UpdateGPU() override;
@@ -7,15 +7,22 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include "device_allocator.hpp"
 #include "vulkan_wrapper/device.hpp"
 
+#include <chrono>
+#include <deque>
 #include <list>
+#include <map>
 #include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include <memory>
 
-const VkDeviceSize INTER_BUFFER_SIZE = 1e8;
+// bytes of holes a StackBuffer needs before compaction is worth its copies.
 const VkDeviceSize MINIMUM_SORT_DISTANCE = 1e5;
 
 // 100 mb of data per allocation
@@ -68,6 +75,9 @@ struct BufferCreateInfo {
   uint32_t queue_family_index_count;
   const uint32_t *p_queue_family_indices;
   vk::MemoryPropertyFlags memory_properties;
+  // what the buffer holds and what it is called, for memory accounting.
+  MemoryCategory category = MemoryCategory::Other;
+  const char *name = nullptr;
 };
 
 // buffer visible to the CPU, used for mapping data from the CPU to the GPU.
@@ -76,7 +86,7 @@ struct BufferCreateInfo {
 class CPUBuffer {
 private:
   vk::Buffer buffer;
-  vk::DeviceMemory memory;
+  Allocation allocation; // host visible and coherent, mapped while it lives
 
   v::Device *device;
 
@@ -84,23 +94,45 @@ public:
   void init(v::PhysicalDevice &physical_device, v::Device &device,
             BufferCreateInfo &buffer_info);
   void map(vk::DeviceSize size, vk::DeviceSize offset, const void *data);
+  // REQUIRES: the buffer is host coherent and the gpu is done writing to it.
+  void read(vk::DeviceSize size, vk::DeviceSize offset, void *data);
+  // EFFECTS: [offset, offset + size) of the buffer, to be written in place.
+  //          the memory is mapped for the buffer's lifetime, so this is free.
+  void *map_range(vk::DeviceSize size, vk::DeviceSize offset);
+  void unmap();
   void destroy();
 
   vk::Buffer &get() { return buffer; }
 };
 
+// host visible buffer that uniform data is sub-allocated from, linearly. it is
+// a chain of blocks of the size it was created with, a block is added whenever
+// an allocation doesn't fit the last one, so existing ranges (and the
+// descriptors pointing at them) never move. offsets span the chain, block i
+// starts at i * block size, get_buffer()/get_offset() turn one into a binding.
 class SearchBuffer {
 private:
+  struct Block {
+    vk::Buffer buffer;
+    Allocation allocation; // host visible and coherent, mapped while it lives
+  };
+
   std::vector<VkDeviceSize> memory_locations;
   vk::DeviceSize memory_offset;
-  vk::DeviceMemory buffer_memory;
+  vk::DeviceSize block_size;
+  std::vector<Block> blocks;
 
-  v::Device *api_device;
+  vk::BufferUsageFlags usage;
+  vk::SharingMode sharing_mode;
+  std::vector<uint32_t> queue_families;
+  vk::MemoryPropertyFlags memory_properties;
+  MemoryCategory category;
+  std::string name;
 
-public:
-  vk::Buffer buffer;
+  v::Device *api_device;
 
 public:
+  // buffer_info.size is the size of every block.
   void init(v::PhysicalDevice &physical_device, v::Device &device,
             BufferCreateInfo &buffer_info);
 
@@ -112,48 +144,354 @@ public:
                    VkDeviceSize dstOffset, VkDeviceSize dataSize,
                    VkBuffer srcBuffer, VkCommandBuffer cmdBuffer);
 
+  // REQUIRES: allocation_size is at most the block size.
+  // EFFECTS: offset of allocation_size bytes aligned to alignment, the range
+  //          lies within one block.
   VkDeviceSize allocate(VkDeviceSize allocation_size, uint32_t alignment = 1);
   void free(VkDeviceSize offset);
+
+  // EFFECTS: the block holding offset and where in it offset lies.
+  vk::Buffer get_buffer(VkDeviceSize offset) const {
+    return blocks[offset / block_size].buffer;
+  }
+  VkDeviceSize get_offset(VkDeviceSize offset) const {
+    return offset % block_size;
+  }
+  size_t get_block_count() const { return blocks.size(); }
+
+private:
+  void add_block();
+};
+
+struct StagingStats {
+  VkDeviceSize bytes = 0;           // staged since init
+  VkDeviceSize completed_bytes = 0; // of those, copied by finished batches
+  uint64_t copies = 0;
+  uint64_t batches = 0;
+  uint64_t stalls = 0;    // times a copy had to wait for ring space
+  uint64_t frames = 0;    // frames that staged anything
+  VkDeviceSize peak_frame_bytes = 0;
+  double busy_ms = 0.0;   // submit until the batch was seen finished, summed
+  uint64_t released_ranges = 0; // handed from the transfer to graphics family
+};
+
+// persistently mapped upload ring. copies are written straight into the ring
+// and recorded into one command buffer per batch, a batch is submitted on
+// flush() (or when the ring runs out of space) and its bytes are reused once
+// its fence signals.
+//
+// batches go to the device's transfer queue. with a dedicated transfer
+// family the written ranges are released to the graphics family at the end of
+// the batch, and a second command buffer acquiring them is submitted to the
+// graphics queue, waiting on the batch's semaphore. without one the batch runs
+// on the graphics queue and ends with a barrier. either way the barrier on the
+// graphics queue is against vertex, index and shader reads, so anything
+// submitted there after flush() sees the data without waiting on the cpu, and
+// frames without uploads wait on nothing.
+class StagingRing {
+private:
+  struct Copy {
+    vk::Buffer dst;
+    VkBufferCopy region;
+  };
+
+  struct Batch {
+    vk::Fence fence; // signals once the data is usable by the graphics queue
+    vk::CommandBuffer command_buffer;
+    // only with a dedicated transfer family: acquires the written ranges on
+    // the graphics queue once semaphore signals.
+    vk::CommandBuffer acquire_buffer;
+    vk::Semaphore semaphore;
+    VkDeviceSize bytes = 0;  // ring bytes held, padding included
+    VkDeviceSize staged = 0; // bytes copied
+    std::chrono::steady_clock::time_point submitted;
+  };
+
+  vk::Buffer buffer;
+  Allocation allocation;
+  unsigned char *mapped = nullptr;
+  VkDeviceSize ring_size = 0;
+  VkDeviceSize head = 0; // next byte to write
+  VkDeviceSize used = 0; // held by pending and in flight batches
+
+  VkDeviceSize frame_budget = 0;
+  VkDeviceSize frame_bytes = 0;
+
+  std::vector<Copy> pending;
+  VkDeviceSize pending_bytes = 0;
+  VkDeviceSize pending_staged = 0;
+  std::deque<Batch> in_flight;
+  std::vector<Batch> idle_batches;
+
+  vk::CommandPool command_pool; // of the transfer family
+  vk::CommandPool acquire_pool; // of the graphics family, dedicated only
+  bool dedicated = false;       // the device has a dedicated transfer family
+  std::vector<VkBufferMemoryBarrier> ownership_barriers;
+  v::Device *device = nullptr;
+  StagingStats stats;
+
+public:
+  void init(v::PhysicalDevice &physical_device, v::Device &device,
+            VkDeviceSize size, VkDeviceSize frame_budget);
+
+  // REQUIRES: dst is a transfer destination, the range isn't read by work
+  //           submitted before the next flush().
+  // EFFECTS: stages data and queues its copy to dst at dst_offset. copies
+  //          larger than the ring are split up.
+  void copy(vk::Buffer dst, VkDeviceSize dst_offset, VkDeviceSize size,
+            const void *data);
+  // EFFECTS: submits every queued copy as one batch.
+  void flush();
+  // EFFECTS: retires finished batches and restarts the frame's byte count.
+  void begin_frame();
+  // EFFECTS: true if size more bytes fit the frame's upload budget. the first
+  //          upload of a frame always fits, however large it is.
+  bool has_budget(VkDeviceSize size) const;
+  VkDeviceSize get_frame_bytes() const { return frame_bytes; }
+  const StagingStats &get_stats() const { return stats; }
+  void wait_idle();
+  void destroy();
+
+private:
+  // EFFECTS: ring offset of size free bytes, waits on the oldest batch while
+  //          there isn't enough room.
+  VkDeviceSize reserve(VkDeviceSize size);
+  void retire(bool wait);
+  // REQUIRES: pending is sorted by destination.
+  // EFFECTS: ownership_barriers covers every destination range written by
+  //          pending once, ranges that touch are merged.
+  void gather_ownership_barriers();
+};
+
+struct UniformRingStats {
+  VkDeviceSize used_bytes = 0;    // allocated, the same in every region
+  VkDeviceSize region_bytes = 0;
+  uint32_t regions = 0;
+  VkDeviceSize flushed_bytes = 0; // copied into regions since init
+  uint64_t flushes = 0;           // flush() calls that copied anything
+};
+
+// persistently mapped uniform buffer for data rewritten every frame, split
+// into one region per command buffer that reads it. an allocation is bumped
+// once and lies at the same offset in every region, its descriptor points at
+// region 0 and is bound with the region's dynamic offset. allocations may be
+// bound as storage buffers too (for arrays past the uniform range limit).
+//
+// writes land in a cpu copy of a region. every region remembers the range
+// written since it was last flushed, flush() brings one region up to date
+// with a single memcpy. a region is only flushed once the command buffer
+// reading it has finished, so the gpu never sees a half written frame.
+class UniformRing {
+private:
+  struct Dirty {
+    VkDeviceSize begin;
+    VkDeviceSize end; // nothing to copy while begin >= end
+  };
+
+  vk::Buffer buffer;
+  Allocation allocation;
+  VkDeviceSize region_size = 0;
+  VkDeviceSize alignment = 1;
+  VkDeviceSize head = 0; // next free byte of every region
+
+  std::vector<unsigned char> shadow; // what every region should hold
+  std::vector<Dirty> dirty;          // per region
+
+  v::Device *device = nullptr;
+  UniformRingStats stats;
+
+public:
+  // region_size is rounded up to the uniform and storage offset alignments.
+  void init(v::PhysicalDevice &physical_device, v::Device &device,
+            VkDeviceSize region_size, uint32_t region_count);
+  void destroy();
+
+  // EFFECTS: offset of size bytes in every region, aligned for a uniform or
+  //          storage buffer binding. throws if the region is full.
+  VkDeviceSize allocate(VkDeviceSize size);
+  // REQUIRES: [offset, offset + size) was allocated.
+  // EFFECTS: the data reaches each region on its next flush().
+  void write(VkDeviceSize offset, VkDeviceSize size, const void *data);
+  // REQUIRES: nothing submitted that reads region is still running.
+  // EFFECTS: copies what was written since region was last flushed.
+  void flush(uint32_t region);
+
+  vk::Buffer get_buffer() const { return buffer; }
+  // EFFECTS: the dynamic offset region is bound with.
+  uint32_t get_dynamic_offset(uint32_t region) const {
+    return static_cast<uint32_t>(region * region_size);
+  }
+  const UniformRingStats &get_stats() const { return stats; }
+};
+
+struct Relocation {
+  VkDeviceSize from; // offset the allocation had
+  VkDeviceSize to;   // offset it has now
 };
 
-// Buffer that sorts itself to maintain constant time allocations.
+struct GeometryHeapStats {
+  VkDeviceSize used_bytes = 0;
+  VkDeviceSize free_bytes = 0;   // ready to be handed out
+  VkDeviceSize retired_bytes = 0; // freed, waiting for the frames in flight
+  VkDeviceSize largest_free = 0;
+  size_t allocations = 0;
+  size_t free_ranges = 0;
+  uint64_t moves = 0;          // finished compaction moves since init
+  VkDeviceSize moved_bytes = 0;
+  VkDeviceSize buffer_bytes = 0; // current size of the buffer
+  uint32_t grows = 0;
+};
+
+// device local buffer that vertex and index data is sub-allocated from. free
+// ranges are kept coalesced and handed out best fit, a freed range is only
+// reused once the frames that could still be reading it are done.
+//
+// the buffer starts at the size it was created with. when an allocation
+// doesn't fit, the contents are copied into a new buffer at least twice as
+// large and the old one is destroyed once the frames in flight are done with
+// it. offsets stay the same, only `buffer` changes, so whatever recorded it
+// has to record again (uploads do that anyway).
+//
+// compact() moves relocatable allocations into holes further down, a bounded
+// number of bytes at a time. the copies run on the queue that owns the buffer
+// while the allocation keeps being read at its old offset; once they finished
+// the move is reported through take_relocations() and the old range is
+// retired like any other free.
 class StackBuffer {
 private:
+  struct Range {
+    VkDeviceSize size;
+    VkDeviceSize alignment;
+    bool relocatable;
+    bool moving; // source of a move that hasn't finished
+  };
+
+  struct Retired {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint64_t frame; // begin_frame() count when it was freed
+  };
+
+  struct Move {
+    VkDeviceSize from;
+    VkDeviceSize to;
+    VkDeviceSize size;
+    bool cancelled; // the source was freed while its copy was in flight
+  };
+
+  struct MoveBatch {
+    vk::Fence fence;
+    vk::CommandBuffer command_buffer;
+    std::vector<Move> moves;
+  };
+
+  struct RetiredBuffer {
+    vk::Buffer buffer;
+    Allocation allocation;
+    uint64_t frame;
+  };
+
   VkDeviceSize buffer_size;
-  VkDeviceSize offset;
-  VkDeviceMemory buffer_memory;
-  // i need a shared pointer of the device...
-  vk::CommandPool command_pool;
-  // pair with allocation size and offset?
-  std::vector<std::pair<VkDeviceSize, VkDeviceSize>> allocations;
+  Allocation allocation;
 
-  vk::Queue transfer_queue;
-  uint32_t transfer_family;
+  std::map<VkDeviceSize, Range> allocations;           // by offset
+  std::map<VkDeviceSize, VkDeviceSize> free_ranges;    // offset to size
+  std::set<std::pair<VkDeviceSize, VkDeviceSize>> free_sizes; // size, offset
+  std::deque<Retired> retired;
+  std::deque<RetiredBuffer> retired_buffers; // replaced by grow()
+  uint64_t frame = 0;
 
-  vk::Buffer inter_buffer;
-  vk::DeviceMemory inter_memory;
+  vk::BufferUsageFlags usage;
+  vk::SharingMode sharing_mode;
+  std::vector<uint32_t> queue_families;
+  vk::MemoryPropertyFlags memory_properties;
+  MemoryCategory category;
+  std::string name;
+
+  std::deque<MoveBatch> moves_in_flight;
+  std::vector<MoveBatch> idle_batches;
+  std::vector<Relocation> relocations;
+  // scratch of compact(), kept so the frames that call it without moving
+  // anything don't allocate.
+  std::vector<VkDeviceSize> compact_candidates;
+  std::vector<Move> compact_moves;
+  std::vector<VkBufferCopy> compact_regions;
+
+  // the queue family the buffer is exclusive to, uploads without a staging
+  // ring and compaction moves are submitted there.
+  vk::CommandPool command_pool;
+  vk::Queue queue;
+  uint32_t queue_family;
 
-  v::Device *device;
+  v::Device *device = nullptr;
   v::PhysicalDevice *phys_device;
 
+  // uploads go through here when set, see map().
+  StagingRing *staging = nullptr;
+  GeometryHeapStats stats;
+
 public:
   vk::Buffer buffer;
 
 public:
+  // buffer_info.size is the starting size, the buffer is made a transfer
+  // source and destination for growing and compaction.
   void init(v::PhysicalDevice &physical_device, v::Device &device,
             BufferCreateInfo &p_buffer_info);
-
-  VkDeviceSize map(VkDeviceSize data_size, void *data);
+  void set_staging(StagingRing *ring) { staging = ring; }
+
+  // alignment does not have to be a power of 2 (e.g vertex strides). with a
+  // staging ring the data lands once the ring is flushed, otherwise before
+  // this returns. relocatable allocations may be moved by compact(), their
+  // owner has to follow take_relocations(). grows the buffer if the data
+  // doesn't fit, throws if no larger buffer can be allocated.
+  VkDeviceSize map(VkDeviceSize data_size, const void *data,
+                   VkDeviceSize alignment = 1, bool relocatable = false);
   void destroy();
-  void free(VkDeviceSize delete_offset);
-  void sort();
+  // REQUIRES: offset was returned by map() (or reported by take_relocations)
+  //           and not freed since.
+  // EFFECTS: the range is reused MAX_FRAMES_IN_FLIGHT frames from now.
+  void free(VkDeviceSize offset);
+
+  // EFFECTS: picks up finished moves and hands back the ranges retired long
+  //          enough ago. call once a frame, before the frame's draws are
+  //          recorded.
+  void begin_frame();
+  // REQUIRES: every upload to the buffer has been submitted (the staging ring
+  //           is flushed).
+  // EFFECTS: if more than MINIMUM_SORT_DISTANCE bytes lie in holes below the
+  //          highest allocation and no moves are in flight, submits moves for
+  //          up to max_bytes of relocatable allocations (the first move goes
+  //          whatever its size). returns true while moves are in flight, a
+  //          compaction pass is done once this returns false.
+  bool compact(VkDeviceSize max_bytes);
+  // EFFECTS: the moves finished since the last call, in the order they
+  //          finished.
+  std::vector<Relocation> take_relocations();
+
+  GeometryHeapStats get_stats() const;
 
 private:
-  void setup_queues();
   void create_inter_buffer(vk::DeviceSize buffer_size,
                            vk::MemoryPropertyFlags memory_properties,
-                           vk::Buffer &buffer, vk::DeviceMemory &memory);
-  VkDeviceSize allocate(VkDeviceSize allocation_size);
+                           vk::Buffer &buffer, Allocation &allocation);
+  VkDeviceSize allocate(VkDeviceSize allocation_size, VkDeviceSize alignment,
+                        bool relocatable);
+  void create_buffer(VkDeviceSize size, vk::Buffer &buffer,
+                     Allocation &allocation);
+  // EFFECTS: moves the contents into a larger buffer, one that has room for
+  //          size bytes at alignment.
+  void grow(VkDeviceSize size, VkDeviceSize alignment);
+  // EFFECTS: takes the best fitting free range that can hold size bytes at
+  //          alignment and ends at or below limit. false if there is none.
+  bool take_free(VkDeviceSize size, VkDeviceSize alignment,
+                 VkDeviceSize limit, VkDeviceSize &offset);
+  void insert_free(VkDeviceSize offset, VkDeviceSize size);
+  void erase_free(std::map<VkDeviceSize, VkDeviceSize>::iterator it);
+  void retire(VkDeviceSize offset, VkDeviceSize size);
+  // EFFECTS: finishes the batches whose fence signaled, waits for all of them
+  //          if wait is set.
+  void finish_moves(bool wait);
   void copyBuffer(VkBuffer src_buffer, VkBuffer dst_buffer,
                   VkDeviceSize dst_offset, VkDeviceSize data_size);
 };
@@ -163,28 +501,65 @@ struct PoolCreateInfo {
   VkDescriptorType set_type;
 };
 
-// there are more functions that the pool class will need, but since i don't
-// need them yet, and hence won't know exactly what i want from them, ill leave
-// them unfinished for now.
+struct DescriptorPoolStats {
+  uint32_t pools = 0;
+  uint64_t recycled_sets = 0; // handed out again after free_sets()
+  size_t free_sets = 0;       // ready to be handed out again
+  size_t retired_sets = 0;    // waiting for the frames in flight
+};
+
+// descriptor pools of one set of sizes. persistent sets come from pools that
+// are added whenever the last one runs out, sets given back with free_sets()
+// are handed out again (to a request for the same layout) once the frames
+// that could still bind them are done, the pools never free a set themselves.
+// there are no per-frame pools: nothing in the renderer takes a set per
+// frame, per-frame data is reached through dynamic offsets into the
+// UniformRing or per-image buffers bound once. a set that only lives for a
+// frame is given back with free_sets(), which recycles it once that frame is
+// done just like resetting a per-frame pool would.
 class Pool {
 private:
-  // we'll have to create many different types of pools, but for now
-  // since we already know exactly which pools we want we'll just include them
-  // and made the system expandable.
+  struct RetiredSet {
+    VkDescriptorSetLayout layout;
+    VkDescriptorSet set;
+    uint64_t frame; // begin_frame() count when it was freed
+  };
 
   // handle a vector of all the pools we'll be allocating
   std::vector<uint32_t> allocations;
   std::vector<PoolCreateInfo> poolInfo;
+  VkDescriptorPoolCreateFlags pool_flags = 0;
+
+  std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>>
+      free_layout_sets;
+  std::deque<RetiredSet> retired_sets;
+  uint64_t frame = 0;
 
   std::shared_ptr<v::Device> api_device;
+  DescriptorPoolStats stats;
 
 public:
-  Pool(std::shared_ptr<v::Device> device, std::vector<PoolCreateInfo> info);
+  // flags: given to every descriptor pool, e.g. update after bind for sets
+  //        with bindless arrays.
+  Pool(std::shared_ptr<v::Device> device, std::vector<PoolCreateInfo> info,
+       VkDescriptorPoolCreateFlags flags = 0);
   ~Pool();
 
+  // EFFECTS: setCount sets of layout, sets freed long enough ago first.
   void allocateDescriptorSets(v::Device &device, uint32_t setCount,
                               VkDescriptorSetLayout layout,
                               VkDescriptorSet *sets);
+  // REQUIRES: sets were allocated with allocateDescriptorSets for layout and
+  //           are not used again by the caller.
+  // EFFECTS: the sets are handed out again MAX_FRAMES_IN_FLIGHT frames from
+  //          now, they have to be written again by whoever gets them.
+  void free_sets(VkDescriptorSetLayout layout, uint32_t count,
+                 const VkDescriptorSet *sets);
+  // EFFECTS: hands back the sets retired long enough ago. call once a
+  //          frame, before the frame's sets are allocated.
+  void begin_frame();
+
+  const DescriptorPoolStats &get_stats() const { return stats; }
 
 public:
   std::vector<VkDescriptorPool> pools;
@@ -200,6 +575,10 @@ private:
   VkResult attemptAllocation(v::Device &device, uint32_t setCount,
                              VkDescriptorSetLayout layout,
                              VkDescriptorSet *sets);
+  VkResult allocate_from(VkDescriptorPool pool, uint32_t set_count,
+                         const VkDescriptorSetLayout *layouts,
+                         VkDescriptorSet *sets);
+  VkDescriptorPool create_descriptor_pool();
 };
 
 class CommandPool
@@ -257,7 +636,4 @@ struct MemoryData {
   size_t offsetIndex;
 };
 
-uint32_t findMemoryType(v::PhysicalDevice &physical_device, uint32_t typeFilter,
-                        vk::MemoryPropertyFlags properties);
-
 } // namespace mem
@@ -0,0 +1,116 @@
+/* ------------------------ mesh_cache.hpp -------------------------
+ * on-disk layout of cooked models (.tucomesh). a file is a header,
+ * a table of sections and then the section blobs, every blob is
+ * aligned so it can be used straight out of a memory mapping.
+ * -----------------------------------------------------------------
+ */
+
+#pragma once
+
+#include "data_structures.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace tuco {
+
+const uint32_t MESH_CACHE_MAGIC = 0x4D435554; // "TUCM"
+// bump whenever the importer or any of the structs below change, older files
+// are then ignored and re-cooked.
+const uint32_t MESH_CACHE_VERSION = 7;
+const uint64_t MESH_CACHE_ALIGNMENT = 16;
+
+const char MESH_CACHE_EXTENSION[] = ".tucomesh";
+
+// MeshCacheHeader::flags, a cache is only used if its flags match the import
+// settings (see ModelImportOptions::get_cache_flags).
+const uint32_t MESH_CACHE_FLAG_OPTIMIZED = 1 << 0;
+const uint32_t MESH_CACHE_FLAG_MESHLETS = 1 << 1;
+const uint32_t MESH_CACHE_LOD_COUNT_SHIFT = 8;  // 8 bits
+const uint32_t MESH_CACHE_LOD_RATIO_SHIFT = 16; // 8 bits, ratio * 255
+
+enum class MeshCacheSectionType : uint32_t {
+  Vertices = 0,   // tuco::Vertex[]
+  Indices = 1,    // uint32_t[]
+  Primitives = 2, // MeshCachePrimitive[]
+  Nodes = 3,      // MeshCacheNode[]
+  Images = 4,     // MeshCacheImage[]
+  ImageData = 5,  // raw pixel bytes referenced by MeshCacheImage
+  Meshlets = 6,   // tuco::Meshlet[]
+  Materials = 7,  // tuco::MaterialDescription[]
+};
+
+struct MeshCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t source_hash;
+  uint64_t file_size;
+  uint32_t section_count;
+  uint32_t flags;
+};
+
+struct MeshCacheSection {
+  uint32_t type;   // MeshCacheSectionType
+  uint32_t stride; // size of a single element, used to reject layout changes
+  uint64_t count;
+  uint64_t offset; // from the start of the file
+};
+
+struct MeshCacheLod {
+  uint32_t index_start;
+  uint32_t index_count;
+  float error;
+};
+
+// explicit-width copy of tuco::Primitive so the file doesn't depend on padding.
+struct MeshCachePrimitive {
+  uint32_t index_start;
+  uint32_t index_count;
+  uint32_t transform_index;
+  int32_t mat_index;
+  int32_t image_index;
+  uint32_t is_transparent;
+  uint32_t lod_count;
+  MeshCacheLod lods[MAX_LOD_COUNT - 1];
+  uint32_t meshlet_start;
+  uint32_t meshlet_count;
+};
+
+// a node of the flattened hierarchy (see node.hpp), parents come first.
+struct MeshCacheNode {
+  int32_t parent;   // relative to the first cached node, -1 for roots
+  uint32_t has_trs; // 0 if the node was given as a matrix
+  float translation[3];
+  float rotation[4]; // x, y, z, w
+  float scale[3];
+  float local[16];
+};
+
+struct MeshCacheImage {
+  uint32_t width;
+  uint32_t height;
+  uint64_t size;
+  uint64_t data_offset; // from the start of the ImageData section
+  uint64_t key;         // ImageBuffer::key
+};
+
+// EFFECTS: hashes the contents of the file at path, returns 0 if it could not
+//          be read.
+uint64_t hash_file(const std::string &path);
+
+// EFFECTS: hashes a .gltf/.glb together with every external buffer and image
+//          its json references (resolved next to it), so editing any of them
+//          changes the hash. returns 0 if one of them could not be read.
+uint64_t hash_gltf(const std::string &path);
+
+// EFFECTS: returns where the cooked version of source_path named name lives
+//          (next to the source file).
+std::string get_mesh_cache_path(const std::string &source_path,
+                                const std::string &name);
+
+inline uint64_t align_cache_offset(uint64_t offset) {
+  return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+}
+
+} // namespace tuco
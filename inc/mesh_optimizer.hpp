@@ -0,0 +1,92 @@
+/* ----------------------- mesh_optimizer.hpp ------------------------
+ * import-time index/vertex reordering: vertex welding, post-transform
+ * cache ordering (tipsify), overdraw ordering of the resulting
+ * clusters and vertex fetch remapping.
+ * -------------------------------------------------------------------
+ */
+
+#pragma once
+
+#include "data_structures.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tuco {
+
+const uint32_t DEFAULT_VERTEX_CACHE_SIZE = 16;
+// a cluster reordering for overdraw is only kept if it makes the vertex cache
+// at most this much worse.
+const float DEFAULT_OVERDRAW_THRESHOLD = 1.05f;
+
+struct VertexCacheStats {
+  size_t misses = 0;
+  size_t triangles = 0;
+  size_t vertices = 0; // unique vertices referenced
+
+  // average cache miss ratio, 0.5 is optimal for large grids, 3 is the worst.
+  float get_acmr() const { return triangles ? float(misses) / triangles : 0.0f; }
+  // average transformed vertex ratio, 1 is optimal.
+  float get_atvr() const { return vertices ? float(misses) / vertices : 0.0f; }
+
+  void add(const VertexCacheStats &other) {
+    misses += other.misses;
+    triangles += other.triangles;
+    vertices += other.vertices;
+  }
+};
+
+struct MeshOptimizeStats {
+  VertexCacheStats before;
+  VertexCacheStats after;
+  size_t vertices_before = 0;
+  size_t vertices_after = 0;
+};
+
+// EFFECTS: simulates a fifo post-transform cache of cache_size entries.
+VertexCacheStats analyze_vertex_cache(const uint32_t *indices,
+                                      size_t index_count, size_t vertex_count,
+                                      uint32_t cache_size);
+
+// MODIFIES: vertices, indices
+// EFFECTS: merges bitwise identical vertices, returns the new vertex count.
+size_t weld_vertices(std::vector<Vertex> &vertices,
+                     std::vector<uint32_t> &indices);
+
+// MODIFIES: indices
+// EFFECTS: reorders triangles for vertex cache locality (tipsify, Sander et
+//          al. 2007). clusters receives the index offset of every point the
+//          algorithm had to restart, these make good overdraw sort units.
+void optimize_vertex_cache(std::vector<uint32_t> &indices, size_t vertex_count,
+                           uint32_t cache_size,
+                           std::vector<size_t> *clusters = nullptr);
+
+// MODIFIES: indices
+// EFFECTS: sorts clusters so outward facing ones are drawn first, keeps the
+//          new order only if the acmr grows by less than threshold.
+void optimize_overdraw(std::vector<uint32_t> &indices,
+                       const std::vector<Vertex> &vertices,
+                       const std::vector<size_t> &clusters, uint32_t cache_size,
+                       float threshold = DEFAULT_OVERDRAW_THRESHOLD);
+
+// MODIFIES: vertices, indices
+// EFFECTS: reorders vertices in order of first use and drops unreferenced
+//          ones, returns the new vertex count.
+size_t optimize_vertex_fetch(std::vector<Vertex> &vertices,
+                             std::vector<uint32_t> &indices);
+
+// REQUIRES: every primitive from first_primitive onward references only its
+//           own contiguous range of vertices, all of which lie at or after
+//           vertex_begin, and their indices start at index_begin.
+// MODIFIES: vertices, indices, primitives
+// EFFECTS: runs every pass above on each primitive (in parallel) and
+//          rebuilds the tail of the vertex/index arrays.
+MeshOptimizeStats optimize_mesh(std::vector<Vertex> &vertices,
+                                std::vector<uint32_t> &indices,
+                                std::vector<Primitive> &primitives,
+                                size_t first_primitive, size_t vertex_begin,
+                                size_t index_begin,
+                                uint32_t cache_size = DEFAULT_VERTEX_CACHE_SIZE);
+
+} // namespace tuco
@@ -0,0 +1,50 @@
+/* ----------------------- mesh_simplifier.hpp -----------------------
+ * quadric error edge collapse (Garland & Heckbert 1997) used to
+ * build a level of detail chain for every primitive at import.
+ * -------------------------------------------------------------------
+ */
+
+#pragma once
+
+#include "data_structures.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tuco {
+
+// every level keeps this fraction of the triangles of the level before it.
+const float DEFAULT_LOD_RATIO = 0.5f;
+// primitives smaller than this are not worth simplifying.
+const uint32_t MIN_LOD_TRIANGLES = 64;
+
+struct SimplifiedLevel {
+  std::vector<uint32_t> indices;
+  float error = 0.0f; // in the units of the vertex positions
+};
+
+// EFFECTS: repeatedly collapses the cheapest edges of the triangle list
+//          indices (referencing vertex_count vertices) and returns a copy of
+//          the index list each time it drops below the next target, the i-th
+//          target being index_count * ratio^(i + 1). stops after level_count
+//          levels or once no edge can be collapsed.
+//          edges are only collapsed onto existing vertices, so the levels can
+//          share the vertex buffer, and border vertices (including uv seams)
+//          never move.
+std::vector<SimplifiedLevel> simplify_mesh(const Vertex *vertices,
+                                           size_t vertex_count,
+                                           const std::vector<uint32_t> &indices,
+                                           uint32_t level_count, float ratio);
+
+// REQUIRES: primitives from first_primitive onward are triangle lists.
+// MODIFIES: indices, primitives
+// EFFECTS: simplifies every primitive from first_primitive onward (in
+//          parallel), appending up to lod_count levels per primitive to the end
+//          of indices and recording them in Primitive::lods.
+void generate_lods(const std::vector<Vertex> &vertices,
+                   std::vector<uint32_t> &indices,
+                   std::vector<Primitive> &primitives, size_t first_primitive,
+                   uint32_t lod_count, float ratio = DEFAULT_LOD_RATIO);
+
+} // namespace tuco
@@ -0,0 +1,56 @@
+/* --------------------------- meshlet.hpp ---------------------------
+ * splits primitives into small clusters of triangles (meshlets) that
+ * carry their own bounding sphere and normal cone, so parts of a mesh
+ * can be culled on their own (see cluster_culling.hpp).
+ * -------------------------------------------------------------------
+ */
+
+#pragma once
+
+#include "data_structures.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tuco {
+
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// written to the mesh cache as is, keep the layout free of padding.
+struct Meshlet {
+  // bounding sphere in model space.
+  glm::vec3 center;
+  float radius;
+  // every triangle normal lies within the cone around cone_axis, a cluster is
+  // back facing from eye when
+  //   dot(center - eye, cone_axis) >= cone_cutoff * |center - eye| + radius
+  // a cutoff of 1 disables the test (normals spread too wide).
+  glm::vec3 cone_axis;
+  float cone_cutoff;
+
+  uint32_t index_start; // into Model::model_indices
+  uint32_t index_count;
+  uint32_t vertex_count;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(Meshlet) == 48, "Meshlet is stored in the mesh cache");
+
+// REQUIRES: primitives from first_primitive onward are triangle lists.
+// MODIFIES: primitives, meshlets
+// EFFECTS: walks the (level 0) triangles of every primitive from
+//          first_primitive onward in order and cuts them into meshlets of at
+//          most MESHLET_MAX_VERTICES unique vertices and MESHLET_MAX_TRIANGLES
+//          triangles. the triangle order is left alone, so every meshlet is a
+//          contiguous range of the primitive's indices (run the vertex cache
+//          optimizer first to get tight meshlets).
+void build_meshlets(const std::vector<Vertex> &vertices,
+                    const std::vector<uint32_t> &indices,
+                    std::vector<Primitive> &primitives, size_t first_primitive,
+                    std::vector<Meshlet> &meshlets);
+
+} // namespace tuco
@@ -0,0 +1,64 @@
+/* ------------------------ meshopt_codec.hpp ------------------------
+ * decoders for the EXT_meshopt_compression bitstream: the vertex
+ * (attribute) codec, both index codecs and the post-decode filters.
+ * the formats are the ones defined by the gltf extension, so files
+ * produced by gltfpack/meshoptimizer decode bit-exact.
+ * -------------------------------------------------------------------
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace tuco {
+
+enum class MeshoptMode {
+  Attributes, // vertex codec, any stride that is a multiple of 4
+  Triangles,  // index codec for triangle lists
+  Indices,    // index sequence codec (non-triangle index data)
+};
+
+enum class MeshoptFilter {
+  None,
+  Octahedral,  // unit vectors, 4 or 8 byte stride
+  Quaternion,  // unit quaternions, 8 byte stride
+  Exponential, // floats as 24 bit mantissa + 8 bit exponent
+};
+
+// EFFECTS: parses the mode/filter names used by the extension, returns false
+//          for unknown names.
+bool parse_meshopt_mode(const std::string &name, MeshoptMode &mode);
+bool parse_meshopt_filter(const std::string &name, MeshoptFilter &filter);
+
+// REQUIRES: dst holds count * stride bytes.
+// MODIFIES: dst
+// EFFECTS: decodes count vertices of stride bytes, returns false if the stream
+//          is malformed (dst is then partially written).
+bool decode_vertex_buffer(unsigned char *dst, size_t count, size_t stride,
+                          const unsigned char *src, size_t size);
+
+// REQUIRES: dst holds count * index_size bytes, count is a multiple of 3,
+//           index_size is 2 or 4.
+// MODIFIES: dst
+// EFFECTS: decodes a triangle list, returns false if the stream is malformed.
+bool decode_index_buffer(unsigned char *dst, size_t count, size_t index_size,
+                         const unsigned char *src, size_t size);
+
+// REQUIRES: dst holds count * index_size bytes, index_size is 2 or 4.
+// MODIFIES: dst
+// EFFECTS: decodes an index sequence, returns false if the stream is
+//          malformed.
+bool decode_index_sequence(unsigned char *dst, size_t count, size_t index_size,
+                           const unsigned char *src, size_t size);
+
+// REQUIRES: data holds count elements of stride bytes decoded with
+//           decode_vertex_buffer.
+// MODIFIES: data
+// EFFECTS: undoes the filter in place, returns false if the stride isn't valid
+//          for it.
+bool apply_meshopt_filter(MeshoptFilter filter, unsigned char *data,
+                          size_t count, size_t stride);
+
+} // namespace tuco
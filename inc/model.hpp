@@ -5,7 +5,10 @@
  */
 #pragma once
 
+#include "animation.hpp"
 #include "mesh.hpp"
+#include "meshlet.hpp"
+#include "morph.hpp"
 
 #include "config.hpp"
 #include "node.hpp"
@@ -32,11 +35,24 @@ public:
   Model(const Model &) = delete;
   Model &operator=(const Model &) = delete;
 
-  void add_mesh(const std::string& fileName,
-                std::optional<std::string> name = std::nullopt);
+  // EFFECTS: parses the file into this model, returns false if the import
+  //          failed. safe to call off the render thread as long as nothing
+  //          else touches this model until it returns.
+  // the processed (optimized, simplified) result is what gets cooked into
+  // the cache.
+  bool add_mesh(const std::string& fileName,
+                std::optional<std::string> name = std::nullopt,
+                const ModelImportOptions& options = {});
 
   std::vector<Primitive>& get_prims() { return primitives; }
 
+  // true if any vertex is moved by joint_nodes, the whole model is then drawn
+  // from skinned vertices (see skinning.hpp). models with morph targets are
+  // always skinned, their vertices are morphed before they are skinned.
+  bool is_skinned() const { return !joint_nodes.empty(); }
+  // EFFECTS: index of the animation called name, -1 if there is none.
+  int32_t find_animation(const std::string &name) const;
+
   // TODO - move to separate class (DrawItem)
   std::vector<Vertex> model_vertices;
   std::vector<uint32_t> model_indices;
@@ -44,9 +60,11 @@ public:
 private:
   // if name is left null, then model will not be saved/loaded from file
   bool check_gltf(const std::string &filepath);
-  void add_gltf_model(const std::string &filepath);
+  bool add_gltf_model(const std::string &filepath);
 
-  void process_gltf_vertices(tinygltf::Model model,
+  // accessors are read in place (honoring byteStride and component types)
+  // and written straight into the already sized destination vectors.
+  void process_gltf_vertices(const tinygltf::Model &model,
                              const tinygltf::Primitive &primitive,
                              std::vector<Vertex> &vertices);
 
@@ -54,43 +72,110 @@ private:
                    std::vector<Material> materials,
                    std::vector<br::Image> images);
 
-  void process_gltf_indices(tinygltf::Model model,
+  void process_gltf_indices(const tinygltf::Model &model,
                             const tinygltf::Primitive &primitive,
                             uint32_t &index_count,
                             std::vector<uint32_t> &indices,
                             uint32_t &index_start, uint32_t &vertex_start);
 
-  void process_gltf_materials(tinygltf::Model model,
-                              std::vector<Material> &materials);
-
-  void process_gltf_nodes(tinygltf::Node &node, tinygltf::Model &model,
-                          model::Node *parent_node = nullptr);
-
-  void process_gltf_textures(tinygltf::Model model,
+  // appends the metallic-roughness materials of model, whose images start at
+  // image_start in model_images.
+  void process_gltf_materials(const tinygltf::Model &model,
+                              uint32_t image_start);
+
+  // where the nodes of the gltf file being imported ended up.
+  struct GltfNodeContext {
+    uint32_t material_start = 0;         // first model_materials entry
+    std::vector<int32_t> node_map;       // gltf node -> our node, -1 if unused
+    std::vector<uint32_t> skin_offsets;  // gltf skin -> first joint_nodes entry
+    // gltf node -> its block of morph weights (-1 if it has none) and size.
+    std::vector<int32_t> node_weights;
+    std::vector<uint32_t> node_weight_counts;
+  };
+
+  // adds node (and its subtree) to the hierarchy under parent.
+  void process_gltf_nodes(int node_index, const tinygltf::Model &model,
+                          GltfNodeContext &context,
+                          int32_t parent = model::NO_PARENT);
+
+  // appends the joints and inverse bind matrices of every skin, fills in
+  // context.skin_offsets.
+  void process_gltf_skins(const tinygltf::Model &model,
+                          GltfNodeContext &context);
+
+  // resolves the skins' joint nodes once the hierarchy is built.
+  void resolve_gltf_joints(const tinygltf::Model &model,
+                           const GltfNodeContext &context);
+
+  // stores the targets of primitive, whose vertices were just appended at
+  // vertex_start, as sparse deltas weighted from weight_start on.
+  void process_gltf_morph_targets(const tinygltf::Model &model,
+                                  const tinygltf::Primitive &primitive,
+                                  uint32_t vertex_start, uint32_t vertex_count,
+                                  uint32_t weight_start);
+
+  void process_gltf_animations(const tinygltf::Model &model,
+                               const GltfNodeContext &context);
+
+  // MODIFIES: this
+  // EFFECTS: gives vertices without influences a joint that follows their
+  //          node, so a skinned model can be drawn from skinned vertices
+  //          alone.
+  void assign_rigid_joints();
+
+  // decodes every image of model concurrently and expands it to rgba, the
+  // encoded bytes held by model are released. filepath resolves the images
+  // given by uri.
+  void process_gltf_textures(tinygltf::Model &model,
+                             const std::string &filepath,
                              std::vector<ImageBuffer> &images);
 
 
 private:
   std::string model_name;
-  // push the model loading onto a different thread
-
-  // reading and writing to file
-  void write_to_file();
-  bool file_exists(std::string model_name);
-  void read_from_file();
-  std::vector<Vertex> read_vertices(std::ifstream *file);
-  std::vector<uint32_t> read_indices(std::ifstream *file);
-  std::vector<Material> read_materials(std::ifstream *file);
-  std::vector<ImageBuffer> read_images(std::ifstream *file);
-  std::string get_texture(std::ifstream *file);
-  std::vector<uint32_t> linearlize_primitive(Primitive primitive);
+
+  // what the geometry was built from, models with the same source share their
+  // upload (see geometry_registry.hpp). source_path lists every file added
+  // (';' separated) and source_hash mixes their contents (with the buffers
+  // and images they reference, see hash_gltf) with the import flags, it is 0
+  // when a file couldn't be hashed and the model can't be shared.
+  std::string source_path;
+  uint64_t source_hash = 0;
+
+  // reading and writing the cooked (.tucomesh) version of the model, see
+  // mesh_cache.hpp for the layout.
+  // EFFECTS: loads the model from cache_path if it was cooked from a source
+  //          with file_hash and the same import flags (MESH_CACHE_FLAG_*),
+  //          leaves the model untouched and returns false
+  //          otherwise.
+  bool read_from_file(const std::string &cache_path, uint64_t file_hash,
+                      uint32_t flags);
+  void write_to_file(const std::string &cache_path, uint64_t file_hash,
+                     uint32_t flags);
+
+  // MODIFIES: this
+  // EFFECTS: records file_name (imported with flags) as part of what the
+  //          geometry was built from, first starts a new source.
+  void add_source(const std::string &file_name, uint64_t file_hash,
+                  uint32_t flags, bool first);
 
 private:
 
   std::vector<ImageBuffer> model_images;
+  // Primitive::mat_index indexes these, -1 uses the object's own material.
+  std::vector<MaterialDescription> model_materials;
   std::vector<Primitive> primitives;
-  std::vector<std::unique_ptr<model::Node>> nodes;
-  std::vector<glm::mat4> transforms;
+  std::vector<Meshlet> meshlets;
+  // Primitive::transform_index is the index of the node it belongs to.
+  model::NodeHierarchy nodes;
+
+  // the joint palette Vertex::joints index, joint i is moved by
+  // nodes.get_world(joint_nodes[i]) * inverse_bind_matrices[i].
+  std::vector<uint32_t> joint_nodes;
+  std::vector<glm::mat4> inverse_bind_matrices;
+  std::vector<Animation> animations;
+  // blend shapes of the primitives, applied before skinning.
+  MorphData morphs;
 };
 
 } // namespace tuco
@@ -0,0 +1,88 @@
+/* ---------------------------- morph.hpp ----------------------------
+ * gltf morph targets (blend shapes) stored as sparse delta streams:
+ * a target only keeps the vertices it actually moves. evaluation
+ * restores the vertices a primitive's targets touch and adds the
+ * deltas of every target with a non-zero weight, so idle targets
+ * cost nothing.
+ * -------------------------------------------------------------------
+ */
+
+#pragma once
+
+#include "data_structures.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tuco {
+
+// the w components are 0 so a delta can be added to a vertex as is.
+struct MorphDelta {
+  glm::vec4 position;
+  glm::vec4 normal;
+};
+
+struct MorphTarget {
+  uint32_t delta_start; // in MorphData::deltas/delta_vertices
+  uint32_t delta_count;
+};
+
+// a primitive with morph targets, its targets are weighted by the weights of
+// the node it belongs to.
+struct MorphRange {
+  uint32_t target_start; // in MorphData::targets
+  uint32_t target_count;
+  uint32_t weight_start; // in MorphData::weights
+  uint32_t touched_start; // in MorphData::touched_vertices
+  uint32_t touched_count;
+};
+
+struct MorphData {
+  std::vector<MorphRange> ranges;
+  std::vector<MorphTarget> targets;
+  std::vector<MorphDelta> deltas;
+  // the model vertex every delta moves, ascending within a target.
+  std::vector<uint32_t> delta_vertices;
+  // every vertex moved by any target of a range, ascending within the range.
+  std::vector<uint32_t> touched_vertices;
+  // current weights, one block per node with a morphed mesh. animations
+  // write here, see AnimationPath::Weights.
+  std::vector<float> weights;
+
+  bool empty() const { return ranges.empty(); }
+};
+
+// per object bookkeeping of what evaluate_morphs left in its output.
+struct MorphState {
+  std::vector<uint8_t> dirty; // per range, output differs from the base
+};
+
+// REQUIRES: count entries in deltas and vertices, every vertex indexes out.
+// MODIFIES: out
+// EFFECTS: adds weight * delta to the position and normal of each vertex.
+void apply_morph_target(const MorphDelta *deltas, const uint32_t *vertices,
+                        size_t count, float weight, Vertex *out);
+
+// REQUIRES: base and out hold every vertex morphs refers to, out matches
+//           base outside the touched vertices.
+// MODIFIES: out, state
+// EFFECTS: blends every range whose targets have non-zero weights into out,
+//          ranges left dirty by an earlier call are restored from base.
+//          returns the number of targets that were applied.
+size_t evaluate_morphs(const MorphData &morphs, const Vertex *base,
+                       Vertex *out, MorphState &state);
+
+// EFFECTS: the number of targets of morphs with a non-zero weight.
+size_t count_active_morphs(const MorphData &morphs);
+
+// MODIFIES: extents
+// EFFECTS: for each of count vertices, the summed length of its position
+//          deltas over every target: how far blending can move it from its
+//          base position while the weights stay within [-1, 1].
+void compute_morph_extents(const MorphData &morphs, size_t count,
+                           std::vector<float> &extents);
+
+} // namespace tuco
@@ -1,30 +1,79 @@
-//tracks the state of a node within a model
+//tracks the state of the nodes within a model
 //a node is a subset of a model consisting of its own transform and primitives that behave under it.
+//the hierarchy is stored flattened: every node comes after its parent, so world transforms are
+//resolved in a single pass over contiguous arrays.
 
 #pragma once
 
 #include "data_structures.hpp"
 #include <glm/glm.hpp>
-#include <memory>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <vector>
 
 namespace model {
-	class Node {
+	const int32_t NO_PARENT = -1;
+
+	// EFFECTS: out = a * b, out may not alias a.
+	void multiply_mat4(const glm::mat4& a, const glm::mat4& b, glm::mat4& out);
+
+	// EFFECTS: returns translate(t) * mat4(r) * scale(s).
+	glm::mat4 compose_trs(const glm::vec3& t, const glm::quat& r, const glm::vec3& s);
+
+	class NodeHierarchy {
 	private:
-		glm::mat4 matrix;
-		std::vector<std::unique_ptr<Node>> children;
-		Node* parent_node; //the parent of the parent will manage the lifetime
+		enum DirtyBits : uint8_t {
+			DIRTY_LOCAL = 1 << 0, // trs changed, local has to be recomposed
+			DIRTY_WORLD = 1 << 1, // local or an ancestor changed
+		};
+
+		// indexed by node, parents[i] < i.
+		std::vector<int32_t> parents;
+		std::vector<glm::vec3> translations;
+		std::vector<glm::quat> rotations;
+		std::vector<glm::vec3> scales;
+		std::vector<glm::mat4> locals;
+		std::vector<glm::mat4> worlds;
+		std::vector<uint8_t> dirty;
+		std::vector<uint8_t> trs; // 0 for nodes that were given as a matrix
+		bool any_dirty = false;
 
 	public:
-		Node(const glm::mat4& matrix, Node* parent_node = nullptr);
-		Node(Node* parent_node = nullptr);
-		Node(const Node&) = delete;
-		Node& operator=(const Node&) = delete;
-
-		void add_matrix(const glm::mat4& matrix);
-		void add_node(std::unique_ptr<Node> node);
-		void add_parent(Node* parent_node);
-
-		glm::mat4 get_transform() ;
-		Node* get_parent() ;
-};
-}
\ No newline at end of file
+		// REQUIRES: parent is NO_PARENT or an existing node.
+		// EFFECTS: appends a node and returns its index, its world transform is
+		//          valid after the next update_world().
+		uint32_t add_node(int32_t parent, const glm::vec3& translation,
+			const glm::quat& rotation, const glm::vec3& scale);
+		// nodes given as a matrix can't have their trs changed afterwards (gltf
+		// doesn't allow animating them either).
+		uint32_t add_node(int32_t parent, const glm::mat4& local);
+
+		void reserve(size_t count);
+		void clear();
+		size_t size() const { return parents.size(); }
+
+		// REQUIRES: has_trs(node)
+		// MODIFIES: this
+		// EFFECTS: changes the node's local transform, it and its descendants
+		//          are updated by the next update_world().
+		void set_translation(uint32_t node, const glm::vec3& translation);
+		void set_rotation(uint32_t node, const glm::quat& rotation);
+		void set_scale(uint32_t node, const glm::vec3& scale);
+
+		int32_t get_parent(uint32_t node) const { return parents[node]; }
+		bool has_trs(uint32_t node) const { return trs[node] != 0; }
+		const glm::vec3& get_translation(uint32_t node) const { return translations[node]; }
+		const glm::quat& get_rotation(uint32_t node) const { return rotations[node]; }
+		const glm::vec3& get_scale(uint32_t node) const { return scales[node]; }
+		const glm::mat4& get_local(uint32_t node) const { return locals[node]; }
+		const glm::mat4& get_world(uint32_t node) const { return worlds[node]; }
+
+		// MODIFIES: this
+		// EFFECTS: recomputes the world transform of every node that changed (or
+		//          whose ancestor changed) since the last call, returns how many
+		//          were updated.
+		size_t update_world();
+	};
+}
@@ -3,6 +3,7 @@
 //an api wrapper for vulkan pipeline
 //
 #include "data_structures.hpp"
+#include "vertex_layout.hpp"
 #include <bedrock/shader_text.hpp>
 #include <descriptor_set.hpp>
 
@@ -14,6 +15,7 @@
 #include <vector>
 #include <optional>
 #include <string>
+#include <utility>
 
 namespace tuco
 {
@@ -37,6 +39,10 @@ namespace tuco
  *      the pipeline will be used by.
  *  blend_colours : when set to true, :the alpha value of a fragment will be accounted for when computing
  *      the final colour of a pixel.
+ *  dynamic_uniforms : (set, binding) of the uniform and storage buffers bound with a dynamic offset,
+ *      their layouts use the _DYNAMIC descriptor types.
+ *  descriptor_arrays : runtime sized descriptor arrays of the shaders and how many descriptors
+ *      they hold, needs VK_EXT_descriptor_indexing.
  *
  * --------------------------------------------------------------------------------
 */
@@ -61,33 +67,17 @@ struct PipelineConfig
 
 	std::vector<VkPushConstantRange> push_ranges = std::vector<VkPushConstantRange>(0);
 
+	std::vector<std::pair<uint32_t, uint32_t>> dynamic_uniforms;
+
+	std::vector<br::DescriptorArray> descriptor_arrays;
+
+	// pipelines drawing scene meshes should use MeshVertexLayout instead (see vertex_layout.hpp)
 	std::vector<vk::VertexInputBindingDescription>
-		binding_descriptions = {
-			vk::VertexInputBindingDescription({
-				0,
-				sizeof(Vertex),
-				VK_VERTEX_INPUT_RATE_VERTEX})
-	};
+		binding_descriptions = StandardVertexLayout::binding_descriptions();
 
 	//attribute description
 	std::vector<vk::VertexInputAttributeDescription>
-		attribute_descriptions = {
-			vk::VertexInputAttributeDescription({
-					0,
-					0,
-					VK_FORMAT_R32G32B32_SFLOAT,
-					offsetof(Vertex, position)}), //position
-			vk::VertexInputAttributeDescription({
-					1,
-					0,
-					VK_FORMAT_R32G32B32_SFLOAT,
-					offsetof(Vertex, normal)}), //normal
-			vk::VertexInputAttributeDescription({
-					2,
-					0,
-					VK_FORMAT_R32G32_SFLOAT,
-					offsetof(Vertex, tex_coord)}) //texture coord
-	};
+		attribute_descriptions = StandardVertexLayout::attribute_descriptions();
 
 	VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
 	VkFrontFace front_face = VK_FRONT_FACE_CLOCKWISE;
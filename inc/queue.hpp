@@ -41,24 +41,19 @@ private:
 
         int i = 0;
 
-        bool found = false;
         for (const auto& queue : queueFamilies) {
             if (queue.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
                 graphicsFamily = i;
-            }
-            if (queue.queueFlags & VK_QUEUE_TRANSFER_BIT) {
-                transferFamily = i;
-            }
-            if (transferFamily.has_value() && graphicsFamily.has_value()) {
-                found = true;
                 break;
             }
             i++;
         }
 
-        if (!found) {
+        if (!graphicsFamily.has_value()) {
             ERR("required queues not found");
+            return;
         }
+        transferFamily = find_transfer_family(queueFamilies, graphicsFamily.value());
     }
     void find_queue_families(v::PhysicalDevice& device, v::Surface& surface) {
         //logic to fill indices struct up
@@ -81,9 +76,6 @@ private:
             if (queue.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
                 graphicsFamily = i;
             }
-            if (queue.queueFlags & VK_QUEUE_TRANSFER_BIT) {
-                transferFamily = i;
-            }
             if (is_complete()) {
                 break;
             }
@@ -94,6 +86,27 @@ private:
             printf("[ERROR] - findQueueData : could not find desired queues \n");
             throw std::runtime_error("");
         }
+        transferFamily = find_transfer_family(queueFamilies, graphicsFamily.value());
+    }
+
+    // uploads go to a family that can only transfer when there is one, that is
+    // usually a dma engine copying alongside the graphics queue. a family
+    // without graphics is the next best thing, the graphics family the last.
+    static uint32_t find_transfer_family(const std::vector<VkQueueFamilyProperties>& families, uint32_t graphics) {
+        std::optional<uint32_t> without_graphics;
+        for (uint32_t i = 0; i < families.size(); i++) {
+            VkQueueFlags flags = families[i].queueFlags;
+            if (!(flags & VK_QUEUE_TRANSFER_BIT) || families[i].queueCount == 0) {
+                continue;
+            }
+            if (!(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+                return i;
+            }
+            if (!(flags & VK_QUEUE_GRAPHICS_BIT) && !without_graphics.has_value()) {
+                without_graphics = i;
+            }
+        }
+        return without_graphics.value_or(graphics);
     }
 };
 }
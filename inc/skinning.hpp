@@ -0,0 +1,101 @@
+/* --------------------------- skinning.hpp ---------------------------
+ * linear blend skinning into MeshVertexLayout. the cpu path blends the
+ * joint matrices of four vertices' influences with sse and packs the
+ * result straight into the frame's skinned vertex region, the gpu path
+ * (skinning.comp) does the same per thread from GpuSkinVertex data.
+ * --------------------------------------------------------------------
+ */
+
+#pragma once
+
+#include "data_structures.hpp"
+#include "vertex_layout.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tuco {
+
+enum class SkinningMode {
+  Cpu, // vertices are skinned on the cpu and written before the frame is
+       // submitted
+  Gpu, // a compute pass skins the vertices at the start of the frame
+};
+
+// skinned vertices per swapchain image, every skinned object takes as many as
+// its model has.
+const uint32_t MAX_SKINNED_VERTICES = 1 << 20;
+// joint matrices per swapchain image.
+const uint32_t MAX_SKIN_JOINTS = 1 << 16;
+// upper bound on skinned objects.
+const uint32_t MAX_SKIN_JOBS = 1 << 14;
+// workgroup size of skinning.comp.
+const uint32_t SKINNING_GROUP_SIZE = 64;
+// below this many skinned vertices a frame the objects are posed and skinned
+// on the render thread alone.
+const size_t SKINNING_PARALLEL_VERTICES = 1 << 14;
+
+// bind pose vertex as read by skinning.comp, keep in sync with SkinVertex.
+struct GpuSkinVertex {
+  float position[3];
+  uint32_t normal;     // octahedral, snorm16 x 2
+  uint32_t tex_coord;  // half float x 2
+  uint32_t joints[2];  // uint16 x 4
+  uint32_t weights[2]; // unorm16 x 4
+};
+static_assert(sizeof(GpuSkinVertex) == 36, "must match skinning.comp");
+
+// one skinned object per frame, keep in sync with SkinJob in skinning.comp.
+struct GpuSkinJob {
+  glm::vec4 quantization; // xyz offset, w 1 / scale of the output positions
+  uint32_t source_start;  // in GpuSkinVertex
+  uint32_t vertex_count;
+  uint32_t output_start;  // in MeshVertexLayout vertices of the image's region
+  uint32_t joint_start;   // in joint matrices of the image's joint buffer
+};
+static_assert(sizeof(GpuSkinJob) == 32, "must match skinning.comp");
+
+struct SkinningStats {
+  size_t objects = 0;
+  size_t vertices = 0;
+  size_t morph_targets = 0; // with a non-zero weight
+  double animate_ms = 0.0; // sampling, world transforms and joint matrices
+  double skin_ms = 0.0;    // cpu morphing and skinning only
+};
+
+// REQUIRES: morph_extents is null or holds count entries.
+// MODIFIES: bounds
+// EFFECTS: for every joint, the bind pose sphere (xyz center, w radius) of the
+//          vertices it influences. with morph_extents (compute_morph_extents)
+//          each vertex counts as a ball of that radius, so the spheres also
+//          hold the vertices once blend shapes moved them. joints nothing
+//          depends on get w = -1.
+void compute_joint_bounds(const Vertex *vertices, size_t count,
+                          size_t joint_count, std::vector<glm::vec4> &bounds,
+                          const float *morph_extents = nullptr);
+
+// EFFECTS: quantization that covers every skinned vertex, from the joint
+//          bounds moved by their joint matrices. a blended vertex lies inside
+//          the hull of its influences' spheres, so this is conservative.
+VertexQuantization get_skinned_quantization(const glm::vec4 *bounds,
+                                            const glm::mat4 *joint_matrices,
+                                            size_t joint_count);
+
+// REQUIRES: out holds count elements.
+// EFFECTS: converts bind pose vertices into the layout skinning.comp reads.
+void pack_skin_vertices(const Vertex *vertices, size_t count,
+                        GpuSkinVertex *out);
+
+// REQUIRES: every influence of vertices indexes joint_matrices, dst holds
+//           count * MeshVertexLayout::stride bytes.
+// MODIFIES: dst
+// EFFECTS: blends each vertex by its weighted joint matrices and packs it
+//          with MeshVertexLayout against quantization.
+void skin_vertices(const Vertex *vertices, size_t count,
+                   const glm::mat4 *joint_matrices,
+                   const VertexQuantization &quantization, unsigned char *dst);
+
+} // namespace tuco
@@ -0,0 +1,66 @@
+/* ----------------------- texture_cache.hpp -----------------------
+ * every texture materials sample, keyed by where it came from (the
+ * normalized path of a file, or a hash of the pixels for images
+ * embedded in a model) and the format it is uploaded in. an image
+ * shared by many materials (or many models) is decoded and uploaded
+ * once per format.
+ * -----------------------------------------------------------------
+ */
+
+#pragma once
+
+#include "data_structures.hpp"
+
+#include <bedrock/image.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tuco
+{
+
+struct TextureCacheStats
+{
+	size_t textures = 0; // uploaded
+	size_t hits = 0;
+	size_t misses = 0;
+};
+
+// EFFECTS: the cache key of the file at path, paths naming the same file give the same key.
+uint64_t get_texture_key(const std::string& path);
+
+// EFFECTS: the cache key of width * height rgba8 pixels.
+uint64_t get_texture_key(const unsigned char* pixels, uint32_t width, uint32_t height);
+
+class TextureCache
+{
+private:
+	std::vector<std::unique_ptr<br::Image>> textures;
+	// key -> index in textures, -1 if the image could not be loaded (it isn't retried).
+	std::unordered_map<uint64_t, int32_t> lookup;
+	TextureCacheStats stats;
+
+public:
+	// EFFECTS: the texture of the image file at path, loaded on first use. nullptr if it
+	//          can't be decoded. colour maps are RGBA_COLOR, data maps RGBA_LINEAR.
+	br::Image* load_file(const std::string& path, br::ImageFormat format = br::ImageFormat::RGBA_COLOR);
+
+	// REQUIRES: image holds rgba8 pixels and its key.
+	// EFFECTS: the texture of image, uploaded the first time its key is seen in format.
+	br::Image* load_image(const ImageBuffer& image, br::ImageFormat format = br::ImageFormat::RGBA_COLOR);
+
+	const TextureCacheStats& get_stats() const { return stats; }
+
+	// destroys every texture, nothing may sample them afterwards.
+	void destroy();
+
+private:
+	// EFFECTS: true (and the texture in texture, possibly nullptr) if key was seen before.
+	bool find(uint64_t key, br::Image*& texture);
+	br::Image* insert(uint64_t key, std::unique_ptr<br::Image> texture);
+};
+
+}
@@ -0,0 +1,243 @@
+/* ----------------------- vertex_layout.hpp ------------------------
+ * compile-time description of how tuco::Vertex data is packed into
+ * the vertex buffer. a layout generates both the packing code and
+ * the vulkan attribute descriptions, so the two can't drift apart.
+ * ------------------------------------------------------------------
+ */
+
+#pragma once
+
+#include "data_structures.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace tuco {
+
+// the value of each semantic is the shader location it is read from.
+enum class VertexSemantic : uint32_t {
+  Position = 0,
+  Normal = 1,
+  TexCoord = 2,
+};
+
+// maps quantized positions (in [0, 1]) back into model space. the scale is kept
+// uniform so the transform can be folded into the model matrix without
+// skewing normals (shaders renormalize after the normal matrix).
+struct VertexQuantization {
+  glm::vec3 offset = glm::vec3(0.0f);
+  float scale = 1.0f;
+
+  glm::mat4 get_dequantization() const {
+    glm::mat4 matrix = glm::mat4(scale);
+    matrix[3] = glm::vec4(offset, 1.0f);
+    return matrix;
+  }
+
+  static VertexQuantization from_bounds(const Vertex *vertices, size_t count) {
+    VertexQuantization quantization{};
+    if (count == 0)
+      return quantization;
+
+    glm::vec3 min = glm::vec3(vertices[0].position);
+    glm::vec3 max = min;
+    for (size_t i = 1; i < count; i++) {
+      min = glm::min(min, glm::vec3(vertices[i].position));
+      max = glm::max(max, glm::vec3(vertices[i].position));
+    }
+
+    glm::vec3 extent = max - min;
+    quantization.offset = min;
+    quantization.scale =
+        std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+    return quantization;
+  }
+};
+
+namespace vertex_attribute {
+
+template <VertexSemantic S> inline glm::vec4 get_source(const Vertex &vertex) {
+  if constexpr (S == VertexSemantic::Position)
+    return vertex.position;
+  else if constexpr (S == VertexSemantic::Normal)
+    return vertex.normal;
+  else
+    return glm::vec4(vertex.tex_coord, 0.0f, 0.0f);
+}
+
+// full precision, 12 bytes.
+template <VertexSemantic S> struct Float3 {
+  static constexpr VertexSemantic semantic = S;
+  static constexpr VkFormat format = VK_FORMAT_R32G32B32_SFLOAT;
+  static constexpr uint32_t size = 3 * sizeof(float);
+  static constexpr bool quantized = false;
+
+  static void pack(const Vertex &vertex, const VertexQuantization &,
+                   unsigned char *dst) {
+    glm::vec3 value = glm::vec3(get_source<S>(vertex));
+    memcpy(dst, &value[0], size);
+  }
+};
+
+// full precision, 8 bytes.
+template <VertexSemantic S> struct Float2 {
+  static constexpr VertexSemantic semantic = S;
+  static constexpr VkFormat format = VK_FORMAT_R32G32_SFLOAT;
+  static constexpr uint32_t size = 2 * sizeof(float);
+  static constexpr bool quantized = false;
+
+  static void pack(const Vertex &vertex, const VertexQuantization &,
+                   unsigned char *dst) {
+    glm::vec2 value = glm::vec2(get_source<S>(vertex));
+    memcpy(dst, &value[0], size);
+  }
+};
+
+// half floats, 4 bytes. plenty for texture coordinates in [-2048, 2048].
+template <VertexSemantic S> struct Half2 {
+  static constexpr VertexSemantic semantic = S;
+  static constexpr VkFormat format = VK_FORMAT_R16G16_SFLOAT;
+  static constexpr uint32_t size = 2 * sizeof(uint16_t);
+  static constexpr bool quantized = false;
+
+  static void pack(const Vertex &vertex, const VertexQuantization &,
+                   unsigned char *dst) {
+    uint32_t value = glm::packHalf2x16(glm::vec2(get_source<S>(vertex)));
+    memcpy(dst, &value, size);
+  }
+};
+
+// positions quantized against the mesh bounds, 8 bytes (w is padding). the
+// shader reads [0, 1] and relies on VertexQuantization being part of the model
+// matrix.
+template <VertexSemantic S> struct Unorm16x4 {
+  static constexpr VertexSemantic semantic = S;
+  static constexpr VkFormat format = VK_FORMAT_R16G16B16A16_UNORM;
+  static constexpr uint32_t size = 4 * sizeof(uint16_t);
+  static constexpr bool quantized = true;
+
+  static void pack(const Vertex &vertex, const VertexQuantization &quantization,
+                   unsigned char *dst) {
+    glm::vec3 normalized = (glm::vec3(get_source<S>(vertex)) -
+                            quantization.offset) / quantization.scale;
+    normalized = glm::clamp(normalized, glm::vec3(0.0f), glm::vec3(1.0f));
+
+    uint16_t value[4] = {
+        static_cast<uint16_t>(std::lround(normalized.x * 65535.0f)),
+        static_cast<uint16_t>(std::lround(normalized.y * 65535.0f)),
+        static_cast<uint16_t>(std::lround(normalized.z * 65535.0f)),
+        0,
+    };
+    memcpy(dst, value, size);
+  }
+};
+
+// unit vectors in octahedral encoding, 4 bytes. needs decode_octahedral() in
+// the shader.
+template <VertexSemantic S> struct Octahedral16 {
+  static constexpr VertexSemantic semantic = S;
+  static constexpr VkFormat format = VK_FORMAT_R16G16_SNORM;
+  static constexpr uint32_t size = 2 * sizeof(int16_t);
+  static constexpr bool quantized = false;
+
+  static void pack(const Vertex &vertex, const VertexQuantization &,
+                   unsigned char *dst) {
+    glm::vec3 n = glm::vec3(get_source<S>(vertex));
+    float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    glm::vec2 p = l1 > 0.0f ? glm::vec2(n.x, n.y) / l1 : glm::vec2(0.0f);
+    if (n.z < 0.0f) {
+      glm::vec2 sign = glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f,
+                                 p.y >= 0.0f ? 1.0f : -1.0f);
+      p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * sign;
+    }
+    p = glm::clamp(p, glm::vec2(-1.0f), glm::vec2(1.0f));
+
+    int16_t value[2] = {
+        static_cast<int16_t>(std::lround(p.x * 32767.0f)),
+        static_cast<int16_t>(std::lround(p.y * 32767.0f)),
+    };
+    memcpy(dst, value, size);
+  }
+};
+
+} // namespace vertex_attribute
+
+// totals of the meshes packed and uploaded since the backend started.
+struct MeshUploadStats {
+  uint32_t meshes = 0;
+  uint32_t shared = 0; // objects drawn from another object's upload
+  uint64_t vertices = 0;
+  uint64_t vertex_bytes = 0;     // packed, in MeshVertexLayout
+  uint64_t cpu_vertex_bytes = 0; // the same vertices as tuco::Vertex
+  uint64_t index_bytes = 0;
+  uint32_t primitives = 0;
+  uint32_t narrow_primitives = 0; // drawn with 16 bit indices
+
+  double get_bytes_per_vertex() const {
+    return vertices > 0 ? static_cast<double>(vertex_bytes) / vertices : 0.0;
+  }
+};
+
+template <typename... Attributes> struct VertexLayout {
+  static constexpr uint32_t stride = (0 + ... + Attributes::size);
+  static constexpr bool quantized = (false || ... || Attributes::quantized);
+
+  static std::vector<vk::VertexInputBindingDescription>
+  binding_descriptions(uint32_t binding = 0) {
+    return {vk::VertexInputBindingDescription(binding, stride,
+                                              vk::VertexInputRate::eVertex)};
+  }
+
+  static std::vector<vk::VertexInputAttributeDescription>
+  attribute_descriptions(uint32_t binding = 0) {
+    std::vector<vk::VertexInputAttributeDescription> descriptions;
+    uint32_t offset = 0;
+    (add_description<Attributes>(descriptions, binding, offset), ...);
+    return descriptions;
+  }
+
+  // REQUIRES: dst holds at least count * stride bytes.
+  static void pack(const Vertex *vertices, size_t count,
+                   const VertexQuantization &quantization, unsigned char *dst) {
+    for (size_t i = 0; i < count; i++) {
+      unsigned char *out = dst + i * stride;
+      ((Attributes::pack(vertices[i], quantization, out),
+        out += Attributes::size),
+       ...);
+    }
+  }
+
+private:
+  template <typename Attribute>
+  static void
+  add_description(std::vector<vk::VertexInputAttributeDescription> &list,
+                  uint32_t binding, uint32_t &offset) {
+    list.push_back(vk::VertexInputAttributeDescription(
+        static_cast<uint32_t>(Attribute::semantic), binding,
+        static_cast<vk::Format>(Attribute::format), offset));
+    offset += Attribute::size;
+  }
+};
+
+// used by anything that treats positions as directions (skybox, cubemap and
+// environment map generation), 32 bytes.
+using StandardVertexLayout =
+    VertexLayout<vertex_attribute::Float3<VertexSemantic::Position>,
+                 vertex_attribute::Float3<VertexSemantic::Normal>,
+                 vertex_attribute::Float2<VertexSemantic::TexCoord>>;
+
+// used by the forward (and shadow) pass for scene meshes, 16 bytes. keep in
+// sync with the inputs of shader.vert.
+using MeshVertexLayout =
+    VertexLayout<vertex_attribute::Unorm16x4<VertexSemantic::Position>,
+                 vertex_attribute::Octahedral16<VertexSemantic::Normal>,
+                 vertex_attribute::Half2<VertexSemantic::TexCoord>>;
+
+} // namespace tuco
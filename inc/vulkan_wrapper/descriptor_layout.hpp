@@ -13,6 +13,8 @@ struct Binding
 {
 	std::string name;
 	VkDescriptorSetLayoutBinding info;
+	// VK_EXT_descriptor_indexing flags, set for bindless arrays.
+	VkDescriptorBindingFlagsEXT flags = 0;
 
 	uint32_t set_index;
 };
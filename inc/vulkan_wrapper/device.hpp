@@ -5,6 +5,7 @@
 #include "physical_device.hpp"
 #include "surface.hpp"
 #include "config.hpp"
+#include "device_allocator.hpp"
 
 namespace v {
 class Device {
@@ -18,6 +19,16 @@ private:
     vk::Queue present_queue;
     vk::Queue transfer_queue;
 
+    // drawCount > 1 in vkCmdDrawIndexedIndirect
+    bool multi_draw_indirect = false;
+    // runtime sized, partially bound descriptor arrays that can be written
+    // while bound (VK_EXT_descriptor_indexing).
+    bool descriptor_indexing = false;
+    uint32_t max_bindless_textures = 0;
+
+    // every buffer and image takes its memory from here.
+    mem::DeviceAllocator allocator;
+
     std::shared_ptr<v::PhysicalDevice> m_phys_device;
     std::shared_ptr<v::Surface> m_surface;
 
@@ -39,9 +50,19 @@ public:
     vk::Queue& get_graphics_queue() { return graphics_queue; }
     vk::Queue& get_present_queue() { return present_queue; }
     vk::Queue& get_transfer_queue() { return transfer_queue; }
+    // uploads run on a queue family of their own, what they write has to be
+    // handed over to the graphics family.
+    bool has_dedicated_transfer() const { return transfer_family != graphics_family; }
+
+    bool supports_multi_draw_indirect() const { return multi_draw_indirect; }
+    bool supports_descriptor_indexing() const { return descriptor_indexing; }
+    // sampled images an update after bind set can hold.
+    uint32_t get_max_bindless_textures() const { return max_bindless_textures; }
+    mem::DeviceAllocator& get_allocator() { return allocator; }
 
 private:
     void create_logical_device(PhysicalDevice* physical_device, Surface* surface, bool print_debug);
     bool check_device_extensions(PhysicalDevice* phys_device, std::vector<const char*> extensions, uint32_t extensions_count);
+    bool supports_extension(PhysicalDevice* phys_device, const char* extension);
 };
 }
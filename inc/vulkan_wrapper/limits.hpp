@@ -11,10 +11,14 @@ class Limits
 {
 public:
 	uint32_t uniformBufferOffsetAlignment = 0;
+	uint32_t storageBufferOffsetAlignment = 0;
 
-	VkDescriptorType descriptor_types[2] = {
+	VkDescriptorType descriptor_types[5] = {
 		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC
 	};
 
 public:
@@ -6,8 +6,11 @@
 
 #pragma once
 
+#include "asset_manager.hpp"
+#include "cluster_culling.hpp"
 #include "material.hpp"
 #include "model.hpp"
+#include "vertex_layout.hpp"
 // #include "graphics.hpp"
 
 #include <glm/glm.hpp>
@@ -82,6 +85,40 @@ private:
   glm::mat4 perspective_projection(float angle, float aspect, float n, float f);
 };
 
+struct DrawLod {
+  uint32_t first_index;
+  uint32_t index_count;
+  float error; // in model units, see PrimitiveLod
+};
+
+// where a primitive of a GameObject ended up in the backend's buffers.
+struct PrimitiveDraw {
+  uint32_t first_index;  // in units of index_type from the start of the buffer
+  uint32_t index_count;
+  int32_t vertex_offset; // in vertices of MeshVertexLayout
+  VkIndexType index_type;
+
+  // the levels of detail sit right after each other in the index buffer and
+  // share vertex_offset/index_type, first_index/index_count above are the
+  // range of the currently selected level.
+  uint32_t lod = 0;
+  uint32_t lod_count = 1;
+  DrawLod lods[MAX_LOD_COUNT];
+
+  // bounding sphere in the primitive's node space, used to project the lod
+  // error onto the screen.
+  glm::vec3 center = glm::vec3(0.0f);
+  float radius = 0.0f;
+
+  // the primitive's meshlets in GameObject::cluster_bounds. while level 0 is
+  // selected and command_slot is set, the primitive is drawn through the
+  // cluster_count indirect commands starting at command_slot instead.
+  uint32_t cluster_start = 0;
+  uint32_t cluster_count = 0;
+  uint32_t command_slot = UINT32_MAX;
+  uint32_t cull_job = UINT32_MAX;
+};
+
 // TODO: separate transform data from object container.
 // [TODO 08/24] - GameObject is actually a mesh component, but is named generically...
 class GameObject {
@@ -96,19 +133,73 @@ private:
   // reduce coupling.
   uint32_t material_index;
   uint32_t draw_index;
+  // the backend material each model primitive is drawn with, primitives
+  // without a material of their own use material_index.
+  std::vector<uint32_t> primitive_materials;
 
   size_t back_end_data = 0;
   uint32_t changed = 0;
 
+  // mesh data is imported on a worker thread, object_model must not be read
+  // by the backend until this handle reports Ready.
+  AssetHandle mesh_handle;
+
+  // first of the object's slots in the backend's transform table (one per
+  // node), assigned when the object is uploaded (objects finish loading out
+  // of order, so this can't be derived from the object's position in the
+  // scene). UINT32_MAX until then.
+  uint32_t transform_start = UINT32_MAX;
+  uint32_t transform_count = 0;
+  // transform changed since its slots were last written.
+  bool transform_dirty = true;
+
+  // filled in when the mesh is packed and uploaded, one per model primitive.
+  std::vector<PrimitiveDraw> primitive_draws;
+  // meshlet bounds of all primitives, see PrimitiveDraw::cluster_start.
+  ClusterBounds cluster_bounds;
+  // the upload in the backend's GeometryRegistry, shared with every other
+  // object built from the same source.
+  uint32_t geometry_id = UINT32_MAX;
+  // undoes the position quantization of the packed vertices, applied as part
+  // of the model matrix.
+  glm::mat4 dequantization = glm::mat4(1.0f);
+
+  // what object_model is playing, only advanced once the object is uploaded.
+  AnimationState animation;
+  // skinned models are drawn from the backend's skinned vertex buffers, each
+  // object gets its own range there (vertices in MeshVertexLayout), a range of
+  // joint matrices and a job for the compute pass.
+  uint32_t skinned_vertex_start = UINT32_MAX;
+  uint32_t joint_start = 0;
+  uint32_t skin_job = UINT32_MAX;
+  // bind pose bounds of every joint's vertices, see compute_joint_bounds.
+  std::vector<glm::vec4> joint_bounds;
+  // covers this frame's skinned vertices, used in place of dequantization.
+  VertexQuantization skin_quantization;
+  // object_model's vertices with its blend shapes applied, only kept for
+  // models with morph targets.
+  std::vector<Vertex> morphed_vertices;
+  MorphState morph_state;
+
 public:
   GameObject();
   ~GameObject();
-  void add_mesh(const std::string &fileName,
-                std::optional<std::string> name = std::nullopt);
+  // queues the mesh for import and returns immediately, the object is drawn
+  // once the returned handle is Ready.
+  AssetHandle add_mesh(const std::string &fileName,
+                       std::optional<std::string> name = std::nullopt);
+  const AssetHandle &get_mesh_handle() const { return mesh_handle; }
+  // true once the object has cpu-side data the backend can upload.
+  bool is_resident() const;
   void scale(glm::vec3 scale_vector);
   void translate(glm::vec3 t);
   void set_position(glm::vec3 t);
 
+  // EFFECTS: starts the animation called name from its beginning, returns
+  //          false if the model (once loaded) has no such animation.
+  bool play_animation(const std::string &name, bool loop = true);
+  void stop_animation();
+
   Material* get_material();
 
   uint32_t buffer_index_offset = 0;
@@ -0,0 +1,144 @@
+#include "animation.hpp"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace tuco;
+
+namespace {
+
+glm::quat to_quat(const glm::vec4 &value) {
+  glm::quat result;
+  result.x = value.x;
+  result.y = value.y;
+  result.z = value.z;
+  result.w = value.w;
+  return result;
+}
+
+glm::vec4 normalize_rotation(const glm::vec4 &value) {
+  float length = glm::length(value);
+  return length > 0.0f ? value / length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+} // namespace
+
+glm::vec4 tuco::sample_animation(const AnimationSampler &sampler, float time,
+                                 AnimationPath path, uint32_t element) {
+  const std::vector<float> &times = sampler.times;
+  bool cubic = sampler.interpolation == AnimationInterpolation::CubicSpline;
+  size_t stride = cubic ? 3 : 1;
+  size_t width = std::max(sampler.width, 1u);
+  size_t key_count =
+      std::min(times.size(), sampler.values.size() / (stride * width));
+  if (key_count == 0 || element >= width)
+    return glm::vec4(0.0f);
+
+  // part 0 is the in tangent, 1 the value and 2 the out tangent.
+  auto get = [&](size_t key, size_t part) {
+    return sampler.values[(key * stride + part) * width + element];
+  };
+  auto value_at = [&](size_t key) { return get(key, cubic ? 1 : 0); };
+
+  if (key_count == 1 || time <= times[0])
+    return value_at(0);
+  if (time >= times[key_count - 1])
+    return value_at(key_count - 1);
+
+  size_t next = std::upper_bound(times.begin(), times.begin() + key_count,
+                                 time) -
+                times.begin();
+  size_t prev = next - 1;
+  float dt = times[next] - times[prev];
+  float t = dt > 0.0f ? (time - times[prev]) / dt : 0.0f;
+
+  bool rotation = path == AnimationPath::Rotation;
+  switch (sampler.interpolation) {
+  case AnimationInterpolation::Step:
+    return value_at(prev);
+  case AnimationInterpolation::Linear: {
+    if (!rotation)
+      return glm::mix(value_at(prev), value_at(next), t);
+
+    glm::quat q =
+        glm::slerp(to_quat(value_at(prev)), to_quat(value_at(next)), t);
+    return normalize_rotation(glm::vec4(q.x, q.y, q.z, q.w));
+  }
+  case AnimationInterpolation::CubicSpline: {
+    // hermite spline, the tangents are stored per second.
+    glm::vec4 p0 = get(prev, 1);
+    glm::vec4 m0 = get(prev, 2) * dt;
+    glm::vec4 p1 = get(next, 1);
+    glm::vec4 m1 = get(next, 0) * dt;
+
+    float t2 = t * t;
+    float t3 = t2 * t;
+    glm::vec4 value = (2.0f * t3 - 3.0f * t2 + 1.0f) * p0 +
+                      (t3 - 2.0f * t2 + t) * m0 +
+                      (-2.0f * t3 + 3.0f * t2) * p1 + (t3 - t2) * m1;
+    return rotation ? normalize_rotation(value) : value;
+  }
+  }
+  return value_at(prev);
+}
+
+void tuco::apply_animation(const Animation &animation, float time,
+                           model::NodeHierarchy &nodes,
+                           std::vector<float> &morph_weights) {
+  for (const AnimationChannel &channel : animation.channels) {
+    if (channel.sampler >= animation.samplers.size())
+      continue;
+    const AnimationSampler &sampler = animation.samplers[channel.sampler];
+
+    if (channel.path == AnimationPath::Weights) {
+      uint32_t count = std::min(channel.weight_count, sampler.width);
+      if (channel.weight_start + count > morph_weights.size())
+        continue;
+      for (uint32_t t = 0; t < count; t++) {
+        morph_weights[channel.weight_start + t] =
+            sample_animation(sampler, time, channel.path, t).x;
+      }
+      continue;
+    }
+
+    if (channel.node >= nodes.size() || !nodes.has_trs(channel.node))
+      continue;
+
+    glm::vec4 value = sample_animation(sampler, time, channel.path);
+    switch (channel.path) {
+    case AnimationPath::Translation:
+      nodes.set_translation(channel.node, glm::vec3(value));
+      break;
+    case AnimationPath::Rotation:
+      nodes.set_rotation(channel.node, to_quat(value));
+      break;
+    case AnimationPath::Scale:
+      nodes.set_scale(channel.node, glm::vec3(value));
+      break;
+    case AnimationPath::Weights:
+      break;
+    }
+  }
+}
+
+bool tuco::advance_animation(const Animation &animation, float seconds,
+                             AnimationState &state) {
+  state.time += seconds * state.speed;
+  if (animation.duration <= 0.0f) {
+    state.time = 0.0f;
+    return state.loop;
+  }
+
+  if (state.loop) {
+    state.time = std::fmod(state.time, animation.duration);
+    if (state.time < 0.0f)
+      state.time += animation.duration;
+    return true;
+  }
+
+  state.time = std::clamp(state.time, 0.0f, animation.duration);
+  return state.speed >= 0.0f ? state.time < animation.duration
+                             : state.time > 0.0f;
+}
@@ -3,6 +3,7 @@
 #include "logger/interface.hpp"
 #include "api_graphics.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 #include <bedrock/mesh_draw.hpp>
@@ -91,6 +92,20 @@ GameObject* Antuco::create_object() {
 	return objects[objects.size() - 1].get();
 }
 
+void Antuco::destroy_object(GameObject* object) {
+	auto it = std::find_if(objects.begin(), objects.end(),
+		[object](const std::unique_ptr<GameObject>& owned) { return owned.get() == object; });
+	if (it == objects.end())
+		return;
+
+	// the import job writes into the object's model.
+	if (object->get_mesh_handle().is_pending())
+		asset_manager.wait_idle();
+
+	p_graphics->p_graphics->release_object(*object);
+	objects.erase(it);
+}
+
 SceneData* Antuco::create_scene()
 {
 	scene = std::make_unique<SceneData>();
@@ -10,6 +10,8 @@
 
 #include <stb_image.h>
 
+#include <fstream>
+
 using namespace tuco;
 
 GraphicsImpl::GraphicsImpl(Window* pWindow)
@@ -41,7 +43,6 @@ GraphicsImpl::GraphicsImpl(Window* pWindow)
 	create_pass();
 	// create_geometry_pass();
 	//create_shadowpass();
-	create_ubo_layout();
 	create_light_layout();
 	create_scene_layout();
 	createMaterialLayout();
@@ -63,9 +64,15 @@ GraphicsImpl::GraphicsImpl(Window* pWindow)
 	create_fences();
 
 	// create some buffers now
+	create_staging_ring();
+	create_frame_arena();
 	create_vertex_buffer();
 	create_index_buffer();
 	create_uniform_buffer();
+	create_uniform_ring();
+	create_transform_table();
+	create_cluster_culling();
+	create_skinning();
 
 	create_screen_pass();
 	create_screen_buffer();
@@ -77,6 +84,7 @@ GraphicsImpl::GraphicsImpl(Window* pWindow)
 	// globalMaterialOffsets = setupMaterialBuffers();
 
 	create_default_images();
+	create_material_table();
 }
 
 void GraphicsImpl::create_pools()
@@ -103,9 +111,10 @@ void GraphicsImpl::update_camera(glm::mat4 world_to_camera,
 	camera_pos = eye;
 }
 
-void GraphicsImpl::update_light(std::vector<DirectionalLight> lights,
-								std::vector<int> shadow_casters)
+void GraphicsImpl::update_light(const std::vector<DirectionalLight>& lights,
+								const std::vector<int>& shadow_casters)
 {
+	// assigned into the vectors from last frame, which already have the room.
 	light_data = lights;
 	shadow_caster_indices = shadow_casters;
 }
@@ -124,6 +133,18 @@ void GraphicsImpl::update_draw(
 // we need to create some command buffers
 // update vertex and index buffers
 
+	// the slot coming around was last used MAX_FRAMES_IN_FLIGHT frames ago, its fence has been waited on.
+	frame_arena.begin_frame();
+	staging_ring.begin_frame();
+	vertex_buffer.begin_frame();
+	index_buffer.begin_frame();
+	// sets freed a few frames ago become reusable.
+	set_pool->begin_frame();
+	ubo_pool->begin_frame();
+	matPool->begin_frame();
+	texture_pool->begin_frame();
+	relocate_geometry(game_objects);
+
 	SceneData* scene = Antuco::get_engine().get_scene();
 	if (scene->update_gpu)
 	{
@@ -136,9 +157,15 @@ void GraphicsImpl::update_draw(
 	ubo.projection = camera_projection;
 	ubo.modelToWorld = scene->get_skybox_model().transform;
 
-	updateUniformBuffer(scene->ubo_offset, sizeof(UniformBufferObject), &ubo);
+	update_uniform_buffer(scene->ubo_offset, ubo);
+
+	// poses the nodes the transforms below are built from.
+	update_skinning(game_objects);
 
-	auto offset = 0;
+	uint32_t shared_before = upload_stats.shared;
+	// textures of the objects uploaded below are reported once, after the loop.
+	const TextureCacheStats& texture_stats = texture_cache.get_stats();
+	size_t texture_lookups = texture_stats.hits + texture_stats.misses;
 	for (size_t i = 0; i < game_objects.size(); i++)
 	{
 		const auto& model = game_objects[i]->object_model;
@@ -146,52 +173,52 @@ void GraphicsImpl::update_draw(
 		// TODO: move this outside of per-frame loop, call only when user wants to update scene.
 		if (game_objects[i]->update)
 		{
+			// mesh is still being imported, pick it up on a later frame rather than stalling here.
+			if (!game_objects[i]->is_resident())
+				continue;
+
+			// the frame's upload budget is spent, the object waits for a later frame.
+			VkDeviceSize upload_bytes = model.model_vertices.size() * MeshVertexLayout::stride +
+				model.model_indices.size() * sizeof(uint32_t);
+			if (!staging_ring.has_budget(upload_bytes))
+				continue;
+
 // update the buffer data of game objects
-			game_objects[i]->buffer_index_offset = update_index_buffer(model.model_indices) / sizeof(uint32_t);
-			game_objects[i]->buffer_vertex_offset = update_vertex_buffer(model.model_vertices) / sizeof(Vertex);
+			upload_mesh(*game_objects[i]);
 
 			update_command_buffers = true;
 			game_objects[i]->update = false;
-			createUboSets(static_cast<uint32_t>(model.transforms.size()));
-			write_to_ubo();
-			//create_light_set(static_cast<uint32_t>(model.transforms.size()));
-
-			auto primitives = model.primitives;
-			// WARNING: texture sets only created for objects with textures. this
-			// means that the object index in the objects array does not always refer
-			// corresponding texture set.
-			if (model.model_images.size() > 0)
-			{
-//create_texture_set(model.model_images.size());
-			}
+			assign_transforms(*game_objects[i], static_cast<uint32_t>(model.nodes.size()));
+			//create_light_set(static_cast<uint32_t>(model.nodes.size()));
 
-			// load textures.
+			// the object's own material, then the ones its model brings along (textures
+			// shared with materials already loaded are reused).
 			Material* mat = game_objects[i]->get_material();
-
-			// writeMaterial(game_objects[i]->material);
 			writeMaterial(mat);
-
+			register_materials(*game_objects[i]);
 		}
 
-		// update buffer data (for representing object information in shader)
-		auto ubo = UniformBufferObject{};
-		ubo.worldToCamera = camera_view;
-		ubo.projection = camera_projection;
+		// the selected index ranges are baked into the recorded command buffers.
+		if (select_lods(*game_objects[i]))
+			update_command_buffers = true;
+	}
 
-		//auto lbo = UniformBufferObject{};
-		//lbo.worldToCamera = light_data[0].world_to_light;
-		//lbo.projection = light_data[0].perspective;
-		for (size_t j = 0; j < model.transforms.size(); j++)
-		{
-			ubo.modelToWorld = game_objects[i]->transform * model.transforms[j];
-			//lbo.modelToWorld = game_objects[i]->transform * model.transforms[j];
-			update_uniform_buffer(ubo_offsets[offset + j], ubo);
-			// update light data (used for generating shadow map)
-			//update_uniform_buffer(light_offsets[offset + j], lbo);
-		}
-		offset += model.transforms.size();
+	if (upload_stats.shared != shared_before)
+	{
+		INFO("{} objects reused uploaded geometry this frame, {} bytes not uploaded in total",
+			 upload_stats.shared - shared_before, geometry_registry.get_saved_bytes());
+	}
+
+	if (texture_stats.hits + texture_stats.misses != texture_lookups)
+	{
+		INFO("textures: {} uploaded, {} hits, {} misses", texture_stats.textures,
+			texture_stats.hits, texture_stats.misses);
 	}
 
+	// the camera is in the scene ubo, only nodes that moved are written.
+	update_transforms(game_objects);
+	update_cluster_culling(game_objects);
+
 	if (!update_command_buffers)
 	{
 		for (size_t i = 0; i < MAX_SHADOW_CASTERS; i++)
@@ -214,5 +241,82 @@ void GraphicsImpl::update_draw(
 
 	update_command_buffers = false;
 
+	// this frame's uploads are submitted ahead of it.
+	if (staging_ring.get_frame_bytes() > 0)
+	{
+		staging_ring.flush();
+	}
+
+	// totals since init, mb/s is over the time batches were on the queue.
+	const mem::StagingStats& staging_stats = staging_ring.get_stats();
+	if (++staging_frame % STAGING_STATS_INTERVAL == 0 && staging_stats.frames != staging_logged_frames)
+	{
+		double seconds = staging_stats.busy_ms / 1000.0;
+		INFO("staged {:.2f} mb in {} batches over {} frames ({:.2f} mb largest frame, {:.1f} mb/s, {} stalls)",
+			staging_stats.bytes / 1e6, staging_stats.batches, staging_stats.frames,
+			staging_stats.peak_frame_bytes / 1e6,
+			seconds > 0.0 ? staging_stats.completed_bytes / 1e6 / seconds : 0.0, staging_stats.stalls);
+		staging_logged_frames = staging_stats.frames;
+	}
+
+	// moves go after the uploads, which may still be writing what is moved.
+	bool vertices_moving = vertex_buffer.compact(GEOMETRY_COMPACTION_BUDGET);
+	bool indices_moving = index_buffer.compact(GEOMETRY_COMPACTION_BUDGET);
+	if (!vertices_moving && !indices_moving && compaction_vertex_moves + compaction_index_moves > 0)
+	{
+		mem::GeometryHeapStats vertex_stats = vertex_buffer.get_stats();
+		mem::GeometryHeapStats index_stats = index_buffer.get_stats();
+		INFO("compaction moved {} vertex and {} index ranges, {:.2f}/{:.2f} mb used, {} and {} free ranges",
+			 compaction_vertex_moves, compaction_index_moves, vertex_stats.used_bytes / 1e6,
+			 index_stats.used_bytes / 1e6, vertex_stats.free_ranges, index_stats.free_ranges);
+		compaction_vertex_moves = 0;
+		compaction_index_moves = 0;
+	}
+
+	if (++memory_frame % MEMORY_BUDGET_INTERVAL == 0)
+	{
+		p_device->get_allocator().check_budget(MEMORY_BUDGET_WARNING);
+
+		// the allocations only change much while meshes are streamed in.
+		if (staging_stats.bytes != memory_logged_bytes)
+		{
+			p_device->get_allocator().log_stats();
+			memory_logged_bytes = staging_stats.bytes;
+		}
+	}
+
 	draw_frame();
+
+	// the scratch vectors of a steady frame fit in what the arena already holds.
+	if (uint32_t grows = frame_arena.take_grows())
+	{
+		const mem::FrameArenaStats& arena_stats = frame_arena.get_stats();
+		INFO("frame arena grew by {} blocks ({:.2f} mb in {} blocks, {:.2f} mb peak frame)", grows,
+			arena_stats.block_bytes / 1e6, arena_stats.blocks, arena_stats.peak_bytes / 1e6);
+	}
+}
+
+mem::AllocatorStats GraphicsImpl::get_memory_stats()
+{
+	mem::DeviceAllocator& allocator = p_device->get_allocator();
+	allocator.update_budget();
+	return allocator.get_stats();
+}
+
+bool GraphicsImpl::write_memory_report(const std::string& path)
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file)
+	{
+		WARN("could not open {} for the memory report", path);
+		return false;
+	}
+
+	file << p_device->get_allocator().get_report(MEMORY_REPORT_LARGEST);
+	if (!file)
+	{
+		WARN("could not write the memory report to {}", path);
+		return false;
+	}
+	return true;
 }
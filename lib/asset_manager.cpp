@@ -0,0 +1,82 @@
+#include "asset_manager.hpp"
+
+#include "config.hpp"
+#include "logger/interface.hpp"
+#include "model.hpp"
+
+#include <chrono>
+
+using namespace tuco;
+
+AssetState AssetHandle::get_state() const {
+  if (!record)
+    return AssetState::Failed;
+  return record->state.load(std::memory_order_acquire);
+}
+
+bool AssetHandle::is_pending() const {
+  AssetState state = get_state();
+  return state == AssetState::Pending || state == AssetState::Loading;
+}
+
+AssetManager::~AssetManager() {
+  // waiting for the workers here guarantees no job can write into a model
+  // after the objects owning them have been destroyed.
+  wait_idle();
+}
+
+br::JobSystem &AssetManager::get_jobs() {
+  std::lock_guard<std::mutex> lock(jobs_lock);
+  if (!jobs)
+    jobs = &br::JobSystem::get_shared();
+  return *jobs;
+}
+
+AssetHandle AssetManager::load_model(Model *target,
+                                     const std::string &file_path,
+                                     std::optional<std::string> name) {
+  auto record = std::make_shared<AssetRecord>();
+  record->id = next_id.fetch_add(1, std::memory_order_relaxed);
+  record->path = file_path;
+
+  ModelImportOptions options;
+  {
+    std::lock_guard<std::mutex> lock(options_lock);
+    options = import_options;
+  }
+
+  get_jobs().submit([record, target, file_path, name, options]() {
+    record->state.store(AssetState::Loading, std::memory_order_relaxed);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    bool loaded = false;
+    try {
+      loaded = target->add_mesh(file_path, name, options);
+    } catch (const std::exception &e) {
+      ERR("failed to import {} : {}", file_path, e.what());
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    record->import_ms =
+        std::chrono::duration<double, std::milli>(end - start).count();
+
+    INFO("imported {} in {:.2f} ms (peak rss {:.1f} mb)", file_path,
+         record->import_ms, get_peak_memory_usage() / (1024.0 * 1024.0));
+
+    // publish the model data written above to the render thread.
+    record->state.store(loaded ? AssetState::Ready : AssetState::Failed,
+                        std::memory_order_release);
+  });
+
+  return AssetHandle(record);
+}
+
+void AssetManager::set_import_options(const ModelImportOptions &options) {
+  std::lock_guard<std::mutex> lock(options_lock);
+  import_options = options;
+}
+
+void AssetManager::wait_idle() {
+  std::lock_guard<std::mutex> lock(jobs_lock);
+  if (jobs)
+    jobs->wait_idle();
+}
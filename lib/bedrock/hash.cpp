@@ -0,0 +1,29 @@
+#include <bedrock/hash.hpp>
+
+#include <cstring>
+
+uint64_t br::hash_bytes(const void* bytes, size_t size)
+{
+	const unsigned char* data = static_cast<const unsigned char*>(bytes);
+
+	// fnv-1a style mixing over 8 byte words, this only needs to detect changes
+	// and tell contents apart, not resist collisions on purpose.
+	const uint64_t prime = 0x100000001B3ull;
+	uint64_t hash = 0xCBF29CE484222325ull ^ static_cast<uint64_t>(size);
+
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, data + i, sizeof(word));
+		hash = (hash ^ word) * prime;
+		hash ^= hash >> 29;
+	}
+	for (; i < size; i++)
+	{
+		hash = (hash ^ data[i]) * prime;
+	}
+
+	// 0 is reserved for "could not hash".
+	return hash == 0 ? 1 : hash;
+}
@@ -7,12 +7,25 @@
 #include <data_structures.hpp>
 #include <memory_allocator.hpp>
 
-#include <stb_image.h>
+#include <bedrock/texture_ingest.hpp>
 
 using namespace br;
 
 #define CUBEMAP_IMAGE_COUNT 6
 
+namespace
+{
+
+// files are decoded as floats for any format wider than a byte a component.
+TexelFormat get_texel_format(uint32_t size)
+{
+	if (size == 1) return TexelFormat::Unorm8;
+	if (size == 2) return TexelFormat::Float16;
+	return TexelFormat::Float32;
+}
+
+}
+
 
 void Image::destroy()
 {
@@ -22,9 +35,9 @@ void Image::destroy()
 	{
 		device->get().destroyImage(image, nullptr);
 	}
-	if (memory != VK_NULL_HANDLE)
+	if (memory.valid())
 	{
-		device->get().freeMemory(memory, nullptr);
+		device->get_allocator().free(memory);
 	}
 
 	if (sampler != VK_NULL_HANDLE)
@@ -34,7 +47,6 @@ void Image::destroy()
 
 	// invalidate handles
 	image = VK_NULL_HANDLE;
-	memory = VK_NULL_HANDLE;
 }
 
 void Image::destroy_image_view()
@@ -73,7 +85,8 @@ void Image::init(std::string name, bool handle_destruction)
 	Image::device = backend->p_device;
 	Image::p_physical_device = backend->p_physical_device;
 
-	auto pool_info = vk::CommandPoolCreateInfo({}, device->get_transfer_family());
+	// layout changes are submitted to the graphics queue, upload() brings a pool of the transfer family.
+	auto pool_info = vk::CommandPoolCreateInfo({}, device->get_graphics_family());
 	command_pool = device->get().createCommandPool(pool_info);
 
 	initialized = true;
@@ -86,6 +99,7 @@ void Image::load_blank(ImageDetails info, uint32_t width, uint32_t height, uint3
 	vk::Format v_format = get_vk_format(info.format, &channels, &size);
 
 	ImageCreateInfo image_info;
+	image_info.category = data.image_info.category;
 	image_info.format = v_format;
 	image_info.extent = vk::Extent3D(width, height, 1);
 	image_info.usage = get_vk_usage(info.format, info.usage);
@@ -181,10 +195,18 @@ vk::Format Image::get_vk_format(ImageFormat image_format, uint32_t* channels, ui
 		if (channels) *channels = 4;
 		if (size) *size = 1;
 		return vk::Format::eR8G8B8A8Srgb;
+	case ImageFormat::RGBA_LINEAR:
+		if (channels) *channels = 4;
+		if (size) *size = 1;
+		return vk::Format::eR8G8B8A8Unorm;
 	case ImageFormat::HDR_COLOR:
 		if (channels) *channels = 4;
 		if (size) *size = 4;
 		return vk::Format::eR32G32B32A32Sfloat;
+	case ImageFormat::HDR_HALF:
+		if (channels) *channels = 4;
+		if (size) *size = 2;
+		return vk::Format::eR16G16B16A16Sfloat;
 	case ImageFormat::DEPTH:
 		if (channels) *channels = 1;
 		if (size) *size = 4;
@@ -217,28 +239,31 @@ void Image::load_cubemap(std::vector<std::string>& cube_images, ImageFormat imag
 	uint32_t size;
 	vk::Format format = get_vk_format(image_format, &channels, &size);
 
-	// load images
-	raw_image.image_count = CUBEMAP_IMAGE_COUNT;
-	raw_image.images.resize(CUBEMAP_IMAGE_COUNT);
-	for (int i = 0; i < CUBEMAP_IMAGE_COUNT; i++)
+	// load images, the faces are decoded concurrently.
+	DecodedImage faces[CUBEMAP_IMAGE_COUNT];
+	uint32_t decode_channels = channels == 4 ? 0 : channels;
+	if (!decode_image_files(cube_images.data(), CUBEMAP_IMAGE_COUNT, decode_channels, size > 1, faces))
 	{
-		raw_image.images[i] = stbi_load(cube_images[i].c_str(), &raw_image.width, &raw_image.height, nullptr, channels);
-		raw_image.channels = channels;
+		return;
 	}
-
-	raw_image.image_size = raw_image.width * raw_image.height * raw_image.channels;
-	raw_image.buffer_size = raw_image.image_size * raw_image.image_count;
-
-
-	mem::CPUBuffer buffer;
-	init_buffer(raw_image.buffer_size, &buffer);
-	uint32_t offset = 0;
-	for (int i = 0; i < CUBEMAP_IMAGE_COUNT; i++)
+	for (int i = 1; i < CUBEMAP_IMAGE_COUNT; i++)
 	{
-		offset = add_to_buffer(raw_image, i, offset, &buffer);
+		if (faces[i].width != faces[0].width || faces[i].height != faces[0].height)
+		{
+			ERR("cubemap faces of {} differ in size", data.name);
+			for (DecodedImage& face : faces)
+			{
+				free_decoded_image(face);
+			}
+			return;
+		}
 	}
 
+	mem::CPUBuffer buffer;
+	stage_images(faces, CUBEMAP_IMAGE_COUNT, channels, size, &buffer);
+
 	ImageCreateInfo image_info;
+	image_info.category = data.image_info.category;
 	image_info.format = format;
 	image_info.extent = vk::Extent3D(raw_image.width, raw_image.height, 1);
 	image_info.usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
@@ -261,13 +286,7 @@ void Image::load_cubemap(std::vector<std::string>& cube_images, ImageFormat imag
 	create_image();
 	create_image_view();
 
-	change_layout(vk::ImageLayout::eTransferDstOptimal, device->get_transfer_queue());
-
-	copy_from_buffer(buffer.get(), vk::Offset3D(), CUBEMAP_IMAGE_COUNT, raw_image.image_size, vk::Extent3D(raw_image.width, raw_image.height, 1), device->get_transfer_queue());
-
-	change_layout(vk::ImageLayout::eShaderReadOnlyOptimal, device->get_transfer_queue());
-
-	current_layout = vk::ImageLayout::eShaderReadOnlyOptimal;
+	upload(buffer.get(), CUBEMAP_IMAGE_COUNT, raw_image.image_size, vk::Extent3D(raw_image.width, raw_image.height, 1));
 
 	buffer.destroy();
 }
@@ -278,46 +297,82 @@ void Image::load_image(std::string& file_path, ImageFormat image_format, ImageTy
 	uint32_t size;
 	vk::Format format = get_vk_format(image_format, &channels, &size);
 
-	raw_image.image_count = 1;
-	raw_image.images.resize(raw_image.image_count);
-	raw_image.images[0] = stbi_load(file_path.c_str(), &raw_image.width, &raw_image.height, nullptr, channels);
-	raw_image.channels = channels;
-	raw_image.size = size;
-	raw_image.buffer_size = raw_image.width * raw_image.height * raw_image.channels * raw_image.size;
-	raw_image.image_size = raw_image.width * raw_image.height * raw_image.channels * raw_image.size;
+	// rgba images keep the file's channels until staging, where they are expanded.
+	DecodedImage decoded;
+	uint32_t decode_channels = channels == 4 ? 0 : channels;
+	if (!decode_image_files(&file_path, 1, decode_channels, size > 1, &decoded))
+	{
+		return;
+	}
 
-	load_to_gpu(format, type);
+	mem::CPUBuffer buffer;
+	stage_images(&decoded, 1, channels, size, &buffer);
+	load_to_gpu(format, type, buffer);
 }
 
+// HDR_HALF images are converted from the decoded floats to half floats while staging.
 void Image::load_float_image(std::string& file_path, ImageFormat image_format, ImageType type)
+{
+	uint32_t size;
+	get_vk_format(image_format, nullptr, &size);
+	if (size == 1)
+	{
+		ERR("{} is not a float format", static_cast<uint32_t>(image_format));
+		return;
+	}
+
+	load_image(file_path, image_format, type);
+}
+
+void Image::load_pixels(const unsigned char* pixels, uint32_t width, uint32_t height, ImageFormat image_format)
 {
 	uint32_t channels;
 	uint32_t size;
 	vk::Format format = get_vk_format(image_format, &channels, &size);
 
 	raw_image.image_count = 1;
-	raw_image.images.resize(raw_image.image_count);
-	raw_image.images[0] = reinterpret_cast<unsigned char*>(stbi_loadf(file_path.c_str(), &raw_image.width, &raw_image.height, nullptr, channels));
-	raw_image.channels = channels;
-	raw_image.size = size;
-	raw_image.buffer_size = raw_image.width * raw_image.height * raw_image.channels * raw_image.size;
+	raw_image.width = static_cast<int>(width);
+	raw_image.height = static_cast<int>(height);
+	raw_image.channels = static_cast<int>(channels);
+	raw_image.size = static_cast<int>(size);
 	raw_image.image_size = raw_image.width * raw_image.height * raw_image.channels * raw_image.size;
+	raw_image.buffer_size = raw_image.image_size;
 
-	load_to_gpu(format, type);
+	mem::CPUBuffer buffer;
+	init_buffer(raw_image.buffer_size, &buffer);
+	buffer.map(raw_image.buffer_size, 0, pixels);
+	load_to_gpu(format, ImageType::Image_2D, buffer);
 }
 
-// REQUIRES: Raw image should have already been loaded in.
-void Image::load_to_gpu(vk::Format format, ImageType type)
+void Image::stage_images(DecodedImage* images, uint32_t image_count, uint32_t channels, uint32_t size,
+	mem::CPUBuffer* buffer)
 {
+	raw_image.image_count = image_count;
+	raw_image.width = static_cast<int>(images[0].width);
+	raw_image.height = static_cast<int>(images[0].height);
+	raw_image.channels = static_cast<int>(channels);
+	raw_image.size = static_cast<int>(size);
+	raw_image.image_size = raw_image.width * raw_image.height * raw_image.channels * raw_image.size;
+	raw_image.buffer_size = raw_image.image_size * raw_image.image_count;
 
-	// Load image to CPU buffer.
-	mem::CPUBuffer buffer;
-	init_buffer(raw_image.buffer_size, &buffer);
-	add_to_buffer(raw_image, 0, 0, &buffer);
+	// the texels are written straight into the mapped staging buffer.
+	init_buffer(raw_image.buffer_size, buffer);
+	unsigned char* staging = static_cast<unsigned char*>(buffer->map_range(raw_image.buffer_size, 0));
+	for (uint32_t i = 0; i < image_count; i++)
+	{
+		write_texels(images[i], channels, get_texel_format(size), staging + i * raw_image.image_size);
+		free_decoded_image(images[i]);
+	}
+	buffer->unmap();
+}
 
+// REQUIRES: buffer holds the image staged by stage_images.
+void Image::load_to_gpu(vk::Format format, ImageType type, mem::CPUBuffer& buffer)
+{
 	// TODO - embed image info into the image itself (should be some library to extract info). simplify image creation and make it more universal.
 	// Initialize device image.
 	ImageCreateInfo image_info;
+	image_info.category = data.image_info.category;
 
 	// [TODO - 08/2024] - Image Array Support.
 	image_info.format = format;
@@ -340,76 +395,14 @@ void Image::load_to_gpu(vk::Format format, ImageType type)
 	create_image();
 	create_image_view();
 
-	change_layout(vk::ImageLayout::eTransferDstOptimal, device->get_transfer_queue());
-
-	copy_from_buffer(buffer.get(), vk::Offset3D(), 1, raw_image.image_size, vk::Extent3D(raw_image.width, raw_image.height, 1), device->get_transfer_queue());
-
-	change_layout(vk::ImageLayout::eShaderReadOnlyOptimal, device->get_transfer_queue());
-
-	current_layout = vk::ImageLayout::eShaderReadOnlyOptimal;
+	upload(buffer.get(), 1, raw_image.image_size, vk::Extent3D(raw_image.width, raw_image.height, 1));
 
 	buffer.destroy();
 }
 
 void Image::load_color_image(std::string file_path)
 {
-	// Load raw image
-	raw_image.image_count = 1;
-	raw_image.images.resize(raw_image.image_count);
-	raw_image.images[0] = stbi_load(file_path.c_str(), &raw_image.width, &raw_image.height, nullptr, 4);
-	raw_image.channels = 4;
-	raw_image.buffer_size = raw_image.width * raw_image.height * raw_image.channels;
-	raw_image.image_size = raw_image.width * raw_image.height * raw_image.channels;
-
-	// Load image to CPU buffer.
-	mem::CPUBuffer buffer;
-	init_buffer(raw_image.buffer_size, &buffer);
-	add_to_buffer(raw_image, 0, 0, &buffer);
-	//copy_to_buffer(raw_image, 0, &buffer);
-
-	// TODO - embed image info into the image itself (should be some library to extract info). simplify image creation and make it more universal.
-	// Initialize device image.
-	ImageCreateInfo image_info;
-
-	// TODO : take format info from user.
-	if (raw_image.channels == 4)
-	{
-		image_info.format = vk::Format::eR8G8B8A8Srgb;
-	}
-	else if (raw_image.channels == 3)
-	{
-		image_info.format = vk::Format::eR8G8B8Srgb;
-	}
-	else
-	{
-		ERR("Engine only supports images with channel count of 3 or 4, this image has channel count of [%d]", raw_image.channels);
-	}
-	image_info.extent = vk::Extent3D(raw_image.width, raw_image.height, 1);
-	image_info.usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
-	//image_info.initial_layout = vk::ImageLayout::eTransferDstOptimal;
-	image_info.queueFamilyIndexCount = 1;
-	image_info.pQueueFamilyIndices = &device->get_graphics_family();
-	image_info.size = raw_image.image_size;
-
-	// Generalize to support other non-color type images.
-	ImageViewCreateInfo view_info;
-	view_info.aspect_mask = vk::ImageAspectFlagBits::eColor;
-
-	// TODO - add support to cleaning up image if user wants to change material texture.
-	data.image_info = image_info;
-	data.image_view_info = view_info;
-	create_image();
-	create_image_view();
-
-	change_layout(vk::ImageLayout::eTransferDstOptimal, device->get_transfer_queue());
-
-	copy_from_buffer(buffer.get(), vk::Offset3D(), 1, raw_image.image_size, vk::Extent3D(raw_image.width, raw_image.height, 1), device->get_transfer_queue());
-
-	change_layout(vk::ImageLayout::eShaderReadOnlyOptimal, device->get_transfer_queue());
-
-	current_layout = vk::ImageLayout::eShaderReadOnlyOptimal;
-
-	buffer.destroy();
+	load_image(file_path, ImageFormat::RGBA_COLOR, ImageType::Image_2D);
 }
 
 void Image::init_buffer(uint32_t buffer_size, mem::CPUBuffer* buffer)
@@ -421,17 +414,13 @@ void Image::init_buffer(uint32_t buffer_size, mem::CPUBuffer* buffer)
 	texture_buffer_info.sharing_mode = vk::SharingMode::eExclusive;
 	texture_buffer_info.queue_family_index_count = 1;
 	texture_buffer_info.p_queue_family_indices = &device->get_transfer_family();
+	texture_buffer_info.category = mem::MemoryCategory::Staging;
+	texture_buffer_info.name = "image upload";
 
 	// TODO: make buffer at runtime specifically for transfer commands
 	buffer->init(*p_physical_device, *device, texture_buffer_info);
 }
 
-uint32_t Image::add_to_buffer(RawImageData& data, uint32_t image_index, uint32_t offset, mem::CPUBuffer* buffer)
-{
-	buffer->map(data.image_size, offset, data.images[image_index]);
-	return offset + data.image_size;
-}
-
 void Image::init(std::shared_ptr<v::PhysicalDevice> p_physical_device, std::shared_ptr<v::Device> device,
 				 VkImage image, ImageData info, bool handle_destruction)
 {
@@ -450,7 +439,7 @@ void Image::init(std::shared_ptr<v::PhysicalDevice> p_physical_device, std::shar
 	current_layout = data.image_info.initial_layout;
 
 	// create command pool
-	auto pool_info = vk::CommandPoolCreateInfo({}, device->get_transfer_family());
+	auto pool_info = vk::CommandPoolCreateInfo({}, device->get_graphics_family());
 
 	command_pool = device->get().createCommandPool(pool_info);
 	initialized = true;
@@ -475,7 +464,7 @@ void Image::init(std::shared_ptr<v::PhysicalDevice> p_physical_device, std::shar
 
 	current_layout = data.image_info.initial_layout;
 
-	auto pool_info = vk::CommandPoolCreateInfo({}, device->get_transfer_family());
+	auto pool_info = vk::CommandPoolCreateInfo({}, device->get_graphics_family());
 
 	command_pool = device->get().createCommandPool(pool_info);
 
@@ -503,32 +492,23 @@ void Image::create_image()
 
 	image = device->get().createImage(image_info);
 
-	// allocate memory
-	auto memory_req = device->get().getImageMemoryRequirements(image);
-	auto memory_prop = p_physical_device->get().getMemoryProperties();
-
-	auto memory_index = uint32_t(0);
-	auto properties = info.memory_properties;
-	// uint32_t suitableMemoryForBuffer = 0;
-	for (uint32_t i = 0; i < memory_prop.memoryTypeCount; i++)
-	{
-		if (memory_req.memoryTypeBits & (1 << i) &&
-			((memory_prop.memoryTypes[i].propertyFlags & properties) ==
-			 properties))
-		{
-			memory_index = i;
-			break;
-		}
-	}
+	// allocate memory, render targets and the like are often better off on their own (the driver says so).
+	auto dedicated_req = vk::MemoryDedicatedRequirements();
+	auto memory_req = vk::MemoryRequirements2();
+	memory_req.pNext = &dedicated_req;
+	device->get().getImageMemoryRequirements2(vk::ImageMemoryRequirementsInfo2(image), &memory_req);
 
-	auto alloc = vk::MemoryAllocateInfo(memory_req.size, memory_index);
+	mem::AllocationInfo allocation_info{};
+	allocation_info.required = info.memory_properties;
+	allocation_info.optimal_image = info.tiling == vk::ImageTiling::eOptimal;
+	allocation_info.dedicated = dedicated_req.prefersDedicatedAllocation || dedicated_req.requiresDedicatedAllocation;
+	allocation_info.dedicated_image = image;
+	allocation_info.category = info.category;
+	allocation_info.name = data.name.c_str();
 
-	alloc.memoryTypeIndex = mem::findMemoryType(
-		*p_physical_device, memory_req.memoryTypeBits, info.memory_properties);
+	memory = device->get_allocator().allocate(memory_req.memoryRequirements, allocation_info);
 
-	memory = device->get().allocateMemory(alloc);
-
-	device->get().bindImageMemory(image, memory, 0);
+	device->get().bindImageMemory(image, memory.memory, memory.offset);
 }
 
 ///
@@ -582,6 +562,93 @@ void Image::copy_from_buffer(vk::Buffer buffer, vk::Offset3D image_offset, uint3
 	}
 }
 
+void Image::upload(vk::Buffer buffer, uint32_t image_count, uint32_t image_size,
+				   std::optional<vk::Extent3D> map_size)
+{
+	bool dedicated = device->has_dedicated_transfer();
+	vk::Device api_device = device->get();
+
+	vk::CommandPool transfer_pool = command_pool;
+	if (dedicated)
+	{
+		transfer_pool = api_device.createCommandPool(vk::CommandPoolCreateInfo({}, device->get_transfer_family()));
+	}
+
+	auto alloc = vk::CommandBufferAllocateInfo(transfer_pool, vk::CommandBufferLevel::ePrimary, 1);
+	vk::CommandBuffer copy_buffer = api_device.allocateCommandBuffers(alloc)[0];
+	copy_buffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+	auto subresource = vk::ImageSubresourceRange(
+		data.image_view_info.aspect_mask, 0, data.image_info.mipLevels, 0, data.image_info.arrayLayers);
+
+	auto barrier = vk::ImageMemoryBarrier(
+		{}, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, subresource);
+	copy_buffer.pipelineBarrier(
+		vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	copy_from_buffer(buffer, vk::Offset3D(), image_count, image_size, map_size, device->get_transfer_queue(), copy_buffer);
+
+	// one transition to shader reads. with a dedicated transfer family it is split into the release here and
+	// the acquire on the graphics queue, both describe the same layouts and families.
+	const vk::PipelineStageFlags read_stages =
+		vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader;
+	barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+	barrier.dstAccessMask = dedicated ? vk::AccessFlags() : vk::AccessFlags(vk::AccessFlagBits::eShaderRead);
+	barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+	barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+	if (dedicated)
+	{
+		barrier.srcQueueFamilyIndex = device->get_transfer_family();
+		barrier.dstQueueFamilyIndex = device->get_graphics_family();
+	}
+	copy_buffer.pipelineBarrier(
+		vk::PipelineStageFlagBits::eTransfer,
+		dedicated ? vk::PipelineStageFlags(vk::PipelineStageFlagBits::eBottomOfPipe) : read_stages,
+		{}, 0, nullptr, 0, nullptr, 1, &barrier);
+	copy_buffer.end();
+
+	vk::Fence fence = api_device.createFence(vk::FenceCreateInfo());
+	vk::Semaphore semaphore;
+	vk::CommandBuffer acquire_buffer;
+	if (!dedicated)
+	{
+		device->get_graphics_queue().submit(vk::SubmitInfo(0, nullptr, nullptr, 1, &copy_buffer), fence);
+	}
+	else
+	{
+		semaphore = api_device.createSemaphore(vk::SemaphoreCreateInfo());
+		device->get_transfer_queue().submit(vk::SubmitInfo(0, nullptr, nullptr, 1, &copy_buffer, 1, &semaphore));
+
+		alloc.commandPool = command_pool;
+		acquire_buffer = api_device.allocateCommandBuffers(alloc)[0];
+		acquire_buffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+		barrier.srcAccessMask = {};
+		barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+		acquire_buffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer, read_stages, {}, 0, nullptr, 0, nullptr, 1, &barrier);
+		acquire_buffer.end();
+
+		vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eTransfer;
+		device->get_graphics_queue().submit(
+			vk::SubmitInfo(1, &semaphore, &wait_stage, 1, &acquire_buffer), fence);
+	}
+
+	// the staging buffer is the caller's and goes away on return, the graphics queue itself is not waited on.
+	(void)api_device.waitForFences(fence, VK_TRUE, UINT64_MAX);
+	api_device.destroyFence(fence);
+	api_device.freeCommandBuffers(transfer_pool, copy_buffer);
+	if (dedicated)
+	{
+		api_device.freeCommandBuffers(command_pool, acquire_buffer);
+		api_device.destroySemaphore(semaphore);
+		api_device.destroyCommandPool(transfer_pool);
+	}
+
+	current_layout = vk::ImageLayout::eShaderReadOnlyOptimal;
+	data.image_info.initial_layout = current_layout;
+}
+
 void Image::change_layout(vk::ImageLayout new_layout, vk::Queue queue, std::optional<vk::CommandBuffer> command_buffer)
 {
 	if (current_layout == new_layout)
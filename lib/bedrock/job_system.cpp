@@ -0,0 +1,161 @@
+#include <bedrock/job_system.hpp>
+
+#include "logger/interface.hpp"
+
+#include <algorithm>
+#include <exception>
+
+using namespace br;
+
+JobSystem::JobSystem(uint32_t thread_count)
+{
+	if (thread_count == 0)
+	{
+		uint32_t hardware_threads = std::thread::hardware_concurrency();
+		thread_count = std::max(1u, hardware_threads > 1 ? hardware_threads - 1 : 1u);
+	}
+
+	workers.reserve(thread_count);
+	for (uint32_t i = 0; i < thread_count; i++)
+	{
+		workers.emplace_back(&JobSystem::worker_loop, this);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(queue_lock);
+		stopping = true;
+	}
+	queue_signal.notify_all();
+
+	// workers drain whatever is left in the queue before exiting, so anything
+	// a job writes into is still guaranteed to be alive while it runs.
+	for (auto& worker : workers)
+	{
+		if (worker.joinable())
+			worker.join();
+	}
+}
+
+void JobSystem::submit(Job job)
+{
+	{
+		std::lock_guard<std::mutex> lock(queue_lock);
+		jobs.push_back(std::move(job));
+	}
+	queue_signal.notify_one();
+}
+
+void JobSystem::wait_idle()
+{
+	std::unique_lock<std::mutex> lock(queue_lock);
+	idle_signal.wait(lock, [this] { return jobs.empty() && active_jobs == 0; });
+}
+
+void JobSystem::worker_loop()
+{
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(queue_lock);
+			queue_signal.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+			if (jobs.empty())
+				return; // stopping and nothing left to do.
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
+			active_jobs++;
+		}
+
+		try
+		{
+			job();
+		}
+		catch (const std::exception& e)
+		{
+			ERR("job failed with : {}", e.what());
+		}
+		catch (...)
+		{
+			ERR("job failed with unknown exception");
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(queue_lock);
+			active_jobs--;
+			if (jobs.empty() && active_jobs == 0)
+				idle_signal.notify_all();
+		}
+	}
+}
+
+void JobSystem::run_range(const std::shared_ptr<ParallelRange>& range, size_t helpers)
+{
+	// never throws, the first exception is kept for the caller and the rest of
+	// the range is given up.
+	auto work = [](ParallelRange& range)
+	{
+		try
+		{
+			for (size_t i = range.next.fetch_add(1); i < range.count; i = range.next.fetch_add(1))
+			{
+				range.call(range.function, i);
+			}
+		}
+		catch (...)
+		{
+			range.next.store(range.count);
+			std::lock_guard<std::mutex> lock(range.lock);
+			if (!range.error)
+				range.error = std::current_exception();
+		}
+	};
+
+	// the caller's stack (function and whatever it captured) has to outlive
+	// every helper inside the range, however the helper leaves it.
+	struct Leave
+	{
+		ParallelRange& range;
+		~Leave()
+		{
+			if (range.running.fetch_sub(1) == 1)
+			{
+				std::lock_guard<std::mutex> lock(range.lock);
+				range.finished.notify_all();
+			}
+		}
+	};
+
+	{
+		std::lock_guard<std::mutex> lock(queue_lock);
+		for (size_t h = 0; h < helpers; h++)
+		{
+			jobs.push_front([range, work]()
+			{
+				// counted before claiming anything, the caller can't miss a
+				// helper that still runs part of the range.
+				range->running.fetch_add(1);
+				Leave leave{ *range };
+				work(*range);
+			});
+		}
+	}
+	queue_signal.notify_all();
+
+	work(*range);
+
+	std::unique_lock<std::mutex> lock(range->lock);
+	range->finished.wait(lock, [&] { return range->running.load() == 0; });
+	if (range->error)
+		std::rethrow_exception(range->error);
+}
+
+JobSystem& JobSystem::get_shared()
+{
+	static JobSystem* shared = new JobSystem();
+	return *shared;
+}
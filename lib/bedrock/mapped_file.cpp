@@ -0,0 +1,125 @@
+#include <bedrock/mapped_file.hpp>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace br;
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER file_size{};
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	file_handle = file;
+	mapping_handle = mapping;
+	mapped_data = static_cast<const unsigned char*>(view);
+	mapped_size = static_cast<size_t>(file_size.QuadPart);
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mapped_data)
+		UnmapViewOfFile(mapped_data);
+	if (mapping_handle)
+		CloseHandle(mapping_handle);
+	if (file_handle)
+		CloseHandle(file_handle);
+
+	mapped_data = nullptr;
+	mapped_size = 0;
+	mapping_handle = nullptr;
+	file_handle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat file_info{};
+	if (fstat(fd, &file_info) != 0 || file_info.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	size_t size = static_cast<size_t>(file_info.st_size);
+	void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (view == MAP_FAILED)
+	{
+		::close(fd);
+		return false;
+	}
+
+	// loaders walk the file front to back, let the kernel read ahead.
+	madvise(view, size, MADV_SEQUENTIAL);
+
+	file_descriptor = fd;
+	mapped_data = static_cast<const unsigned char*>(view);
+	mapped_size = size;
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mapped_data)
+		munmap(const_cast<unsigned char*>(mapped_data), mapped_size);
+	if (file_descriptor >= 0)
+		::close(file_descriptor);
+
+	mapped_data = nullptr;
+	mapped_size = 0;
+	file_descriptor = -1;
+}
+
+#endif
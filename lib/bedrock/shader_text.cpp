@@ -6,6 +6,7 @@
 #include "config.hpp"
 #include "shaderc/shaderc.h"
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 
@@ -94,7 +95,9 @@ std::vector<uint32_t> ShaderText::compile_file_to_spirv(const std::string& sourc
 // [TODO 8/2024] - Instead of using 0,1,2,3 for set numbers, we should use terms like draw,material,pass,scene etc and then use a define to convert these to set values
 //                 This could eliminate accidental errors and create stronger correllation between set number and type of data.
 
-void ShaderText::create_layouts(std::shared_ptr<v::Device> device) {
+void ShaderText::create_layouts(std::shared_ptr<v::Device> device,
+                                const std::vector<std::pair<uint32_t, uint32_t>>& dynamic_uniforms,
+                                const std::vector<DescriptorArray>& descriptor_arrays) {
     // vertex shader
     std::vector<v::Binding> shader_bindings;
     if (auto search = compiled_code.find(ShaderKind::VertexShader); search != compiled_code.end())
@@ -120,6 +123,28 @@ void ShaderText::create_layouts(std::shared_ptr<v::Device> device) {
     layouts.resize(4);
     for (auto& binding : shader_bindings)
     {
+        auto key = std::make_pair(binding.set_index, binding.info.binding);
+        if (std::find(dynamic_uniforms.begin(), dynamic_uniforms.end(), key) != dynamic_uniforms.end())
+        {
+            if (binding.info.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+            {
+                binding.info.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            }
+            else if (binding.info.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+            {
+                binding.info.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            }
+        }
+        for (const auto& array : descriptor_arrays)
+        {
+            if (array.set == binding.set_index && array.binding == binding.info.binding)
+            {
+                binding.info.descriptorCount = array.count;
+                binding.flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+                                VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+                                VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+            }
+        }
         layouts[binding.set_index].add_binding(binding);
         layouts[binding.set_index].set_index(binding.set_index);
     }
@@ -0,0 +1,388 @@
+#include <bedrock/texture_ingest.hpp>
+#include <bedrock/parallel_for.hpp>
+#include <logger/interface.hpp>
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BR_TEXEL_SSE 1
+#endif
+
+#if defined(__F16C__) || defined(__AVX2__)
+#include <immintrin.h>
+#define BR_TEXEL_F16C 1
+#endif
+
+using namespace br;
+
+namespace
+{
+
+// REQUIRES: src and dst hold count floats/halves.
+void convert_to_halves(const float* src, size_t count, uint16_t* dst)
+{
+	size_t i = 0;
+#ifdef BR_TEXEL_F16C
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i halves = _mm_cvtps_ph(_mm_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), halves);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		dst[i] = float_to_half(src[i]);
+	}
+}
+
+// EFFECTS: pixel of src_channels floats as rgba.
+inline void expand_pixel(const float* src, uint32_t src_channels, float* rgba)
+{
+	switch (src_channels)
+	{
+	case 1:
+		rgba[0] = rgba[1] = rgba[2] = src[0];
+		rgba[3] = 1.0f;
+		break;
+	case 2:
+		rgba[0] = rgba[1] = rgba[2] = src[0];
+		rgba[3] = src[1];
+		break;
+	case 3:
+		rgba[0] = src[0];
+		rgba[1] = src[1];
+		rgba[2] = src[2];
+		rgba[3] = 1.0f;
+		break;
+	default:
+		memcpy(rgba, src, 4 * sizeof(float));
+		break;
+	}
+}
+
+}
+
+size_t br::get_texel_size(TexelFormat format)
+{
+	switch (format)
+	{
+	case TexelFormat::Unorm8:
+		return 1;
+	case TexelFormat::Float16:
+		return 2;
+	case TexelFormat::Float32:
+		return 4;
+	}
+	return 0;
+}
+
+bool br::decode_image(const unsigned char* bytes, size_t size, uint32_t channels, bool is_float,
+	DecodedImage& image)
+{
+	int width = 0;
+	int height = 0;
+	int file_channels = 0;
+	int length = static_cast<int>(size);
+	int requested = static_cast<int>(channels);
+
+	image.is_float = is_float;
+	if (is_float)
+	{
+		image.pixels = stbi_loadf_from_memory(bytes, length, &width, &height, &file_channels, requested);
+	}
+	else
+	{
+		image.pixels = stbi_load_from_memory(bytes, length, &width, &height, &file_channels, requested);
+	}
+
+	if (!image.pixels)
+	{
+		return false;
+	}
+
+	image.width = static_cast<uint32_t>(width);
+	image.height = static_cast<uint32_t>(height);
+	image.channels = channels != 0 ? channels : static_cast<uint32_t>(file_channels);
+	return true;
+}
+
+bool br::decode_image_files(const std::string* paths, size_t count, uint32_t channels, bool is_float,
+	DecodedImage* images)
+{
+	std::atomic<bool> failed{ false };
+	br::parallel_for(count, [&](size_t i)
+	{
+		int width = 0;
+		int height = 0;
+		int file_channels = 0;
+		int requested = static_cast<int>(channels);
+
+		images[i].is_float = is_float;
+		if (is_float)
+		{
+			images[i].pixels = stbi_loadf(paths[i].c_str(), &width, &height, &file_channels, requested);
+		}
+		else
+		{
+			images[i].pixels = stbi_load(paths[i].c_str(), &width, &height, &file_channels, requested);
+		}
+
+		if (!images[i].pixels)
+		{
+			ERR("could not decode image {}: {}", paths[i], stbi_failure_reason());
+			failed = true;
+			return;
+		}
+
+		images[i].width = static_cast<uint32_t>(width);
+		images[i].height = static_cast<uint32_t>(height);
+		images[i].channels = channels != 0 ? channels : static_cast<uint32_t>(file_channels);
+	});
+
+	if (failed)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			free_decoded_image(images[i]);
+		}
+		return false;
+	}
+	return true;
+}
+
+void br::free_decoded_image(DecodedImage& image)
+{
+	if (image.pixels)
+	{
+		stbi_image_free(image.pixels);
+	}
+	image.pixels = nullptr;
+}
+
+void br::expand_to_rgba8(const unsigned char* src, uint32_t src_channels, size_t pixel_count,
+	unsigned char* dst)
+{
+	if (src_channels == 4)
+	{
+		memcpy(dst, src, pixel_count * 4);
+		return;
+	}
+
+	size_t i = 0;
+#ifdef BR_TEXEL_SSE
+	const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+	if (src_channels == 3)
+	{
+		// four pixels a load, each shifted down into its own dword. the load reads
+		// 16 bytes for 12, so stop while two more pixels are left.
+		for (; i + 6 <= pixel_count; i += 4)
+		{
+			__m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+			__m128i p01 = _mm_unpacklo_epi32(rgb, _mm_srli_si128(rgb, 3));
+			__m128i p23 = _mm_unpacklo_epi32(_mm_srli_si128(rgb, 6), _mm_srli_si128(rgb, 9));
+			__m128i rgba = _mm_or_si128(_mm_unpacklo_epi64(p01, p23), opaque);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), rgba);
+		}
+	}
+	else if (src_channels == 2)
+	{
+		// a grey/alpha pair is already the high half (g | a << 8) of the output
+		// pixel, the low half is g | g << 8.
+		const __m128i low_byte = _mm_set1_epi16(0x00FF);
+		for (; i + 8 <= pixel_count; i += 8)
+		{
+			__m128i ga = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+			__m128i g = _mm_and_si128(ga, low_byte);
+			__m128i gg = _mm_or_si128(g, _mm_slli_epi16(g, 8));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_unpacklo_epi16(gg, ga));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4 + 16), _mm_unpackhi_epi16(gg, ga));
+		}
+	}
+	else if (src_channels == 1)
+	{
+		const __m128i ones = _mm_set1_epi8(static_cast<char>(0xFF));
+		for (; i + 16 <= pixel_count; i += 16)
+		{
+			__m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			__m128i gg_lo = _mm_unpacklo_epi8(g, g);
+			__m128i gg_hi = _mm_unpackhi_epi8(g, g);
+			__m128i ga_lo = _mm_unpacklo_epi8(g, ones);
+			__m128i ga_hi = _mm_unpackhi_epi8(g, ones);
+			__m128i* out = reinterpret_cast<__m128i*>(dst + i * 4);
+			_mm_storeu_si128(out + 0, _mm_unpacklo_epi16(gg_lo, ga_lo));
+			_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(gg_lo, ga_lo));
+			_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(gg_hi, ga_hi));
+			_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(gg_hi, ga_hi));
+		}
+	}
+#endif
+
+	for (; i < pixel_count; i++)
+	{
+		const unsigned char* pixel = src + i * src_channels;
+		unsigned char* rgba = dst + i * 4;
+		if (src_channels >= 3)
+		{
+			rgba[0] = pixel[0];
+			rgba[1] = pixel[1];
+			rgba[2] = pixel[2];
+		}
+		else
+		{
+			rgba[0] = rgba[1] = rgba[2] = pixel[0];
+		}
+		rgba[3] = src_channels == 2 ? pixel[1] : 0xFF;
+	}
+}
+
+void br::expand_to_rgba32f(const float* src, uint32_t src_channels, size_t pixel_count, float* dst)
+{
+	if (src_channels == 4)
+	{
+		memcpy(dst, src, pixel_count * 4 * sizeof(float));
+		return;
+	}
+
+	size_t i = 0;
+#ifdef BR_TEXEL_SSE
+	if (src_channels == 3)
+	{
+		// the load takes the next pixel's red as alpha, which is then replaced. the
+		// last pixel has no next one.
+		const __m128 rgb_mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		const __m128 opaque = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+		for (; i + 1 < pixel_count; i++)
+		{
+			__m128 rgb = _mm_and_ps(_mm_loadu_ps(src + i * 3), rgb_mask);
+			_mm_storeu_ps(dst + i * 4, _mm_or_ps(rgb, opaque));
+		}
+	}
+#endif
+
+	for (; i < pixel_count; i++)
+	{
+		expand_pixel(src + i * src_channels, src_channels, dst + i * 4);
+	}
+}
+
+void br::expand_to_rgba16f(const float* src, uint32_t src_channels, size_t pixel_count, uint16_t* dst)
+{
+	if (src_channels == 4)
+	{
+		convert_to_halves(src, pixel_count * 4, dst);
+		return;
+	}
+
+	// expand a block at a time on the stack, then convert it in one pass.
+	const size_t block_pixels = 256;
+	float rgba[block_pixels * 4];
+	for (size_t i = 0; i < pixel_count; i += block_pixels)
+	{
+		size_t count = std::min(block_pixels, pixel_count - i);
+		expand_to_rgba32f(src + i * src_channels, src_channels, count, rgba);
+		convert_to_halves(rgba, count * 4, dst + i * 4);
+	}
+}
+
+uint16_t br::float_to_half(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint32_t sign = (bits >> 16) & 0x8000u;
+	bits &= 0x7FFFFFFFu;
+
+	uint32_t half;
+	if (bits >= (127u + 16u) << 23)
+	{
+		// too large for a half (or inf/nan already).
+		half = bits > 0x7F800000u ? 0x7E00u : 0x7C00u;
+	}
+	else if (bits < 113u << 23)
+	{
+		// subnormal half, let the fpu round by adding a magic number whose
+		// mantissa lines up with the half's.
+		const uint32_t magic_bits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+		float magic;
+		float f;
+		memcpy(&magic, &magic_bits, sizeof(magic));
+		memcpy(&f, &bits, sizeof(f));
+		f += magic;
+		memcpy(&bits, &f, sizeof(bits));
+		half = bits - magic_bits;
+	}
+	else
+	{
+		// rebias the exponent and round the mantissa to nearest even.
+		uint32_t odd = (bits >> 13) & 1u;
+		bits += ((15u - 127u) << 23) + 0xFFFu + odd;
+		half = bits >> 13;
+	}
+	return static_cast<uint16_t>(half | sign);
+}
+
+void br::write_texels(const DecodedImage& image, uint32_t channels, TexelFormat format, void* dst)
+{
+	size_t pixel_count = static_cast<size_t>(image.width) * image.height;
+	size_t pixel_size = channels * get_texel_size(format);
+
+	// every chunk converts a run of whole pixels, so the kernels never see a
+	// split pixel.
+	auto convert = [&](size_t first, size_t count)
+	{
+		unsigned char* out = static_cast<unsigned char*>(dst) + first * pixel_size;
+		if (!image.is_float)
+		{
+			const unsigned char* src = static_cast<const unsigned char*>(image.pixels) + first * image.channels;
+			if (channels == image.channels)
+			{
+				memcpy(out, src, count * pixel_size);
+			}
+			else
+			{
+				expand_to_rgba8(src, image.channels, count, out);
+			}
+			return;
+		}
+
+		const float* src = static_cast<const float*>(image.pixels) + first * image.channels;
+		if (format == TexelFormat::Float16)
+		{
+			if (channels == image.channels)
+			{
+				convert_to_halves(src, count * channels, reinterpret_cast<uint16_t*>(out));
+			}
+			else
+			{
+				expand_to_rgba16f(src, image.channels, count, reinterpret_cast<uint16_t*>(out));
+			}
+		}
+		else if (channels == image.channels)
+		{
+			memcpy(out, src, count * pixel_size);
+		}
+		else
+		{
+			expand_to_rgba32f(src, image.channels, count, reinterpret_cast<float*>(out));
+		}
+	};
+
+	if (pixel_count < TEXEL_PARALLEL_PIXELS)
+	{
+		convert(0, pixel_count);
+		return;
+	}
+
+	const size_t chunk_pixels = TEXEL_PARALLEL_PIXELS / 4;
+	size_t chunk_count = (pixel_count + chunk_pixels - 1) / chunk_pixels;
+	br::parallel_for(chunk_count, [&](size_t c)
+	{
+		size_t first = c * chunk_pixels;
+		convert(first, std::min(chunk_pixels, pixel_count - first));
+	});
+}
@@ -0,0 +1,190 @@
+#include "cluster_culling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TUCO_CLUSTER_SSE 1
+#endif
+
+using namespace tuco;
+
+void ClusterBounds::clear() {
+  center_x.clear();
+  center_y.clear();
+  center_z.clear();
+  radius.clear();
+  axis_x.clear();
+  axis_y.clear();
+  axis_z.clear();
+  cutoff.clear();
+  first_index.clear();
+  index_count.clear();
+}
+
+void ClusterBounds::push_back(const Meshlet &meshlet, uint32_t first,
+                              uint32_t count) {
+  center_x.push_back(meshlet.center.x);
+  center_y.push_back(meshlet.center.y);
+  center_z.push_back(meshlet.center.z);
+  radius.push_back(meshlet.radius);
+  axis_x.push_back(meshlet.cone_axis.x);
+  axis_y.push_back(meshlet.cone_axis.y);
+  axis_z.push_back(meshlet.cone_axis.z);
+  cutoff.push_back(meshlet.cone_cutoff);
+  first_index.push_back(first);
+  index_count.push_back(count);
+}
+
+void tuco::extract_frustum_planes(const glm::mat4 &clip, glm::vec4 planes[6]) {
+  // glm is column major, clip[c][r].
+  glm::vec4 row[4];
+  for (int r = 0; r < 4; r++) {
+    row[r] = glm::vec4(clip[0][r], clip[1][r], clip[2][r], clip[3][r]);
+  }
+
+  planes[0] = row[3] + row[0]; // left
+  planes[1] = row[3] - row[0]; // right
+  planes[2] = row[3] + row[1]; // bottom
+  planes[3] = row[3] - row[1]; // top
+  // -w <= z is the gl near plane, it lies in front of vulkan's 0 <= z so it
+  // never culls anything that is drawn.
+  planes[4] = row[3] + row[2]; // near
+  planes[5] = row[3] - row[2]; // far
+
+  for (int p = 0; p < 6; p++) {
+    float length = glm::length(glm::vec3(planes[p]));
+    if (length > 0.0f)
+      planes[p] /= length;
+  }
+}
+
+namespace {
+
+// EFFECTS: returns 0 if the cluster is visible, 1 if it is outside the
+//          frustum and 2 if it faces away from eye.
+int test_cluster(const ClusterBounds &bounds, size_t c,
+                 const glm::vec4 planes[6], const glm::vec3 &eye,
+                 bool test_cones) {
+  glm::vec3 center(bounds.center_x[c], bounds.center_y[c], bounds.center_z[c]);
+  float radius = bounds.radius[c];
+
+  for (int p = 0; p < 6; p++) {
+    if (glm::dot(glm::vec3(planes[p]), center) + planes[p].w < -radius)
+      return 1;
+  }
+
+  if (!test_cones)
+    return 0;
+
+  glm::vec3 view = center - eye;
+  glm::vec3 axis(bounds.axis_x[c], bounds.axis_y[c], bounds.axis_z[c]);
+  if (glm::dot(view, axis) >= bounds.cutoff[c] * glm::length(view) + radius)
+    return 2;
+
+  return 0;
+}
+
+} // namespace
+
+void tuco::cull_clusters(const ClusterBounds &bounds, size_t first,
+                         size_t count, const glm::vec4 planes[6],
+                         const glm::vec3 &eye, bool test_cones,
+                         uint8_t *visible, ClusterCullStats &stats) {
+  size_t i = 0;
+  stats.tested += static_cast<uint32_t>(count);
+
+#ifdef TUCO_CLUSTER_SSE
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 eye_x = _mm_set1_ps(eye.x);
+  const __m128 eye_y = _mm_set1_ps(eye.y);
+  const __m128 eye_z = _mm_set1_ps(eye.z);
+
+  for (; i + 4 <= count; i += 4) {
+    size_t c = first + i;
+    __m128 cx = _mm_loadu_ps(&bounds.center_x[c]);
+    __m128 cy = _mm_loadu_ps(&bounds.center_y[c]);
+    __m128 cz = _mm_loadu_ps(&bounds.center_z[c]);
+    __m128 radius = _mm_loadu_ps(&bounds.radius[c]);
+    __m128 neg_radius = _mm_sub_ps(zero, radius);
+
+    __m128 outside = _mm_setzero_ps();
+    for (int p = 0; p < 6; p++) {
+      __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].x), cx),
+                     _mm_mul_ps(_mm_set1_ps(planes[p].y), cy)),
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].z), cz),
+                     _mm_set1_ps(planes[p].w)));
+      outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, neg_radius));
+    }
+
+    __m128 vx = _mm_sub_ps(cx, eye_x);
+    __m128 vy = _mm_sub_ps(cy, eye_y);
+    __m128 vz = _mm_sub_ps(cz, eye_z);
+    __m128 view_length = _mm_sqrt_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)),
+                   _mm_mul_ps(vz, vz)));
+    __m128 along = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(vx, _mm_loadu_ps(&bounds.axis_x[c])),
+                   _mm_mul_ps(vy, _mm_loadu_ps(&bounds.axis_y[c]))),
+        _mm_mul_ps(vz, _mm_loadu_ps(&bounds.axis_z[c])));
+    __m128 limit = _mm_add_ps(
+        _mm_mul_ps(_mm_loadu_ps(&bounds.cutoff[c]), view_length), radius);
+    __m128 back_facing = _mm_andnot_ps(outside, _mm_cmpge_ps(along, limit));
+
+    int outside_mask = _mm_movemask_ps(outside);
+    int back_facing_mask = test_cones ? _mm_movemask_ps(back_facing) : 0;
+    for (int lane = 0; lane < 4; lane++) {
+      bool frustum_culled = (outside_mask >> lane) & 1;
+      bool cone_culled = (back_facing_mask >> lane) & 1;
+      stats.frustum_culled += frustum_culled;
+      stats.cone_culled += cone_culled;
+      visible[i + lane] = !(frustum_culled || cone_culled);
+    }
+  }
+#endif
+
+  for (; i < count; i++) {
+    int result = test_cluster(bounds, first + i, planes, eye, test_cones);
+    stats.frustum_culled += result == 1;
+    stats.cone_culled += result == 2;
+    visible[i] = result == 0;
+  }
+}
+
+uint32_t tuco::write_cluster_commands(const ClusterBounds &bounds,
+                                      size_t first, size_t count,
+                                      const uint8_t *visible,
+                                      int32_t vertex_offset,
+                                      VkDrawIndexedIndirectCommand *commands,
+                                      ClusterCullStats &stats) {
+  uint32_t written = 0;
+  for (size_t i = 0; i < count;) {
+    if (!visible[i]) {
+      i++;
+      continue;
+    }
+
+    // meshlets are contiguous ranges of the primitive's indices, so a run of
+    // visible neighbours is a single draw.
+    VkDrawIndexedIndirectCommand &command = commands[written++];
+    command.firstIndex = bounds.first_index[first + i];
+    command.indexCount = 0;
+    command.instanceCount = 1;
+    command.vertexOffset = vertex_offset;
+    command.firstInstance = 0;
+    while (i < count && visible[i] &&
+           bounds.first_index[first + i] ==
+               command.firstIndex + command.indexCount) {
+      command.indexCount += bounds.index_count[first + i];
+      i++;
+    }
+  }
+
+  std::memset(commands + written, 0,
+              (count - written) * sizeof(VkDrawIndexedIndirectCommand));
+  stats.commands += written;
+  return written;
+}
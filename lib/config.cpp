@@ -8,6 +8,16 @@
 
 #include <vector>
 
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
 std::string goto_previous_directory(std::string file_path) {
 #ifdef _WIN32
     size_t index = file_path.rfind("\\");
@@ -92,3 +102,24 @@ std::string get_file_name(const std::string& path) {
     return name;
 }
 
+
+
+size_t get_peak_memory_usage() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<size_t>(counters.PeakWorkingSetSize);
+    }
+    return 0;
+#else
+    struct rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(__APPLE__)
+    return static_cast<size_t>(usage.ru_maxrss); // already in bytes
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024; // reported in kilobytes
+#endif
+#endif
+}
@@ -240,6 +240,7 @@ void Cubemap::create_cubemap_faces()
 	info.usage = br::ImageUsage::RENDER_OUTPUT;
 
 	cubemap.init(name);
+	cubemap.set_memory_category(mem::MemoryCategory::Environment);
 
 	cubemap.load_blank(info, map_size, map_size, 6, mip_count);
 	cubemap.set_image_sampler(VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
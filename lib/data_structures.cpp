@@ -8,10 +8,10 @@ Vertex::Vertex(glm::vec4 pos, glm::vec4 norm, glm::vec2 tex) {
   position = pos;
   normal = norm;
   tex_coord = tex;
+  joints = glm::u16vec4(0);
+  weights = glm::vec4(0.0f);
 }
 
-Vertex::~Vertex() {}
-
 std::string Vertex::to_string() {
   std::string s_pos = std::to_string(position.x) + std::to_string(position.y) +
                       std::to_string(position.z) + std::to_string(position.w);
@@ -1,9 +1,69 @@
 #include "descriptor_set.hpp"
+#include <bedrock/hash.hpp>
 #include "vulkan/vulkan_core.h"
 #include <stdexcept>
 
 using namespace tuco;
 
+namespace {
+
+bool is_image_type(VkDescriptorType type) {
+  return type == VK_DESCRIPTOR_TYPE_SAMPLER ||
+         type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+         type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+         type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+         type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+}
+
+template <typename T>
+void append_bytes(std::vector<unsigned char> &bytes, const T &value) {
+  const unsigned char *data = reinterpret_cast<const unsigned char *>(&value);
+  bytes.insert(bytes.end(), data, data + sizeof(T));
+}
+
+// only the fields the binding's type reads, padding and the unused half are
+// left out.
+uint64_t hash_bindings(const std::vector<ResourceBinding> &bindings) {
+  std::vector<unsigned char> bytes;
+  for (const ResourceBinding &binding : bindings) {
+    append_bytes(bytes, binding.binding);
+    append_bytes(bytes, binding.type);
+    if (is_image_type(binding.type)) {
+      append_bytes(bytes, binding.image.sampler);
+      append_bytes(bytes, binding.image.imageView);
+      append_bytes(bytes, binding.image.imageLayout);
+    } else {
+      append_bytes(bytes, binding.buffer.buffer);
+      append_bytes(bytes, binding.buffer.offset);
+      append_bytes(bytes, binding.buffer.range);
+    }
+  }
+  return br::hash_bytes(bytes.data(), bytes.size());
+}
+
+bool same_bindings(const std::vector<ResourceBinding> &a,
+                   const std::vector<ResourceBinding> &b) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i].binding != b[i].binding || a[i].type != b[i].type)
+      return false;
+    if (is_image_type(a[i].type)) {
+      if (a[i].image.sampler != b[i].image.sampler ||
+          a[i].image.imageView != b[i].image.imageView ||
+          a[i].image.imageLayout != b[i].image.imageLayout)
+        return false;
+    } else if (a[i].buffer.buffer != b[i].buffer.buffer ||
+               a[i].buffer.offset != b[i].buffer.offset ||
+               a[i].buffer.range != b[i].buffer.range) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
 void ResourceCollection::init(const v::Device &device,
                               VkDescriptorSetLayout layout) {
   ResourceCollection::device = const_cast<v::Device *>(&device);
@@ -20,6 +80,109 @@ uint32_t ResourceCollection::addSets(uint32_t setCount, mem::Pool &pool) {
   return firstSetIndex;
 }
 
+uint32_t
+ResourceCollection::acquire_set(const std::vector<ResourceBinding> &bindings,
+                                mem::Pool &pool) {
+  uint64_t key = hash_bindings(bindings);
+  auto range = set_cache.equal_range(key);
+  for (auto it = range.first; it != range.second; it++) {
+    SharedSet &shared = shared_sets[it->second];
+    if (same_bindings(shared.bindings, bindings)) {
+      shared.references++;
+      cache_stats.hits++;
+      return it->second;
+    }
+  }
+
+  uint32_t index;
+  if (!free_indices.empty()) {
+    index = free_indices.back();
+    free_indices.pop_back();
+  } else {
+    index = static_cast<uint32_t>(sets.size());
+    sets.push_back(VK_NULL_HANDLE);
+    setsUpdateInfo.emplace_back();
+  }
+  if (shared_sets.size() < sets.size())
+    shared_sets.resize(sets.size());
+
+  // the pool hands out a set given back earlier when it has one, it is
+  // written from scratch either way.
+  pool.allocateDescriptorSets(*device, 1, m_layout, &sets[index]);
+
+  std::vector<VkWriteDescriptorSet> writes(bindings.size());
+  for (size_t i = 0; i < bindings.size(); i++) {
+    VkWriteDescriptorSet &write = writes[i];
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = sets[index];
+    write.dstBinding = bindings[i].binding;
+    write.dstArrayElement = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = bindings[i].type;
+    if (is_image_type(bindings[i].type))
+      write.pImageInfo = &bindings[i].image;
+    else
+      write.pBufferInfo = &bindings[i].buffer;
+  }
+  vkUpdateDescriptorSets(device->get(), static_cast<uint32_t>(writes.size()),
+                         writes.data(), 0, nullptr);
+
+  SharedSet &shared = shared_sets[index];
+  shared.key = key;
+  shared.references = 1;
+  shared.bindings = bindings;
+  set_cache.emplace(key, index);
+  cache_stats.writes++;
+  return index;
+}
+
+void ResourceCollection::write_element(uint32_t set_index, uint32_t element,
+                                       const ResourceBinding &binding) {
+  if (!check_size(set_index)) {
+    return;
+  }
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = sets[set_index];
+  write.dstBinding = binding.binding;
+  write.dstArrayElement = element;
+  write.descriptorCount = 1;
+  write.descriptorType = binding.type;
+  if (is_image_type(binding.type))
+    write.pImageInfo = &binding.image;
+  else
+    write.pBufferInfo = &binding.buffer;
+  vkUpdateDescriptorSets(device->get(), 1, &write, 0, nullptr);
+}
+
+void ResourceCollection::release_set(uint32_t index, mem::Pool &pool) {
+  if (index >= shared_sets.size() || shared_sets[index].references == 0) {
+    WARN("releasing set {}, it was not acquired", index);
+    return;
+  }
+
+  SharedSet &shared = shared_sets[index];
+  if (--shared.references > 0)
+    return;
+
+  auto range = set_cache.equal_range(shared.key);
+  for (auto it = range.first; it != range.second; it++) {
+    if (it->second == index) {
+      set_cache.erase(it);
+      break;
+    }
+  }
+  shared.bindings.clear();
+
+  // recorded command buffers may still bind it, the pool holds it back for
+  // the frames in flight.
+  pool.free_sets(m_layout, 1, &sets[index]);
+  sets[index] = VK_NULL_HANDLE;
+  free_indices.push_back(index);
+  cache_stats.releases++;
+}
+
 bool ResourceCollection::check_size(size_t i) {
   if (i >= sets.size()) {
     ERR("invalid allocation");
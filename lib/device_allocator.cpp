@@ -0,0 +1,835 @@
+#include "device_allocator.hpp"
+
+#include "logger/interface.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using namespace mem;
+
+namespace {
+
+// REQUIRES: value != 0
+uint32_t find_lowest_bit(uint64_t value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return static_cast<uint32_t>(index);
+#else
+  return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+}
+
+// REQUIRES: value != 0
+uint32_t find_highest_bit(uint64_t value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return static_cast<uint32_t>(index);
+#else
+  return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+}
+
+VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// EFFECTS: the bins a free range of size bytes is kept in.
+void get_bin(VkDeviceSize size, uint32_t &fl, uint32_t &sl) {
+  if (size < TlsfBlock::SL_COUNT) {
+    fl = 0;
+    sl = static_cast<uint32_t>(size);
+    return;
+  }
+  uint32_t high = find_highest_bit(size);
+  sl = static_cast<uint32_t>(size >> (high - TlsfBlock::SL_BITS)) ^
+       TlsfBlock::SL_COUNT;
+  fl = high - TlsfBlock::SL_BITS + 1;
+}
+
+std::string escape_json(const std::string &text) {
+  std::string escaped;
+  for (char c : text) {
+    switch (c) {
+    case '"':
+      escaped += "\\\"";
+      break;
+    case '\\':
+      escaped += "\\\\";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20)
+        escaped += fmt::format("\\u{:04x}", static_cast<int>(c));
+      else
+        escaped += c;
+    }
+  }
+  return escaped;
+}
+
+double get_fragmentation(VkDeviceSize free_bytes, VkDeviceSize largest_free) {
+  return free_bytes > 0 ? 1.0 - static_cast<double>(largest_free) / free_bytes
+                        : 0.0;
+}
+
+} // namespace
+
+const char *mem::get_category_name(MemoryCategory category) {
+  switch (category) {
+  case MemoryCategory::Geometry:
+    return "geometry";
+  case MemoryCategory::Texture:
+    return "texture";
+  case MemoryCategory::RenderTarget:
+    return "render_target";
+  case MemoryCategory::Uniform:
+    return "uniform";
+  case MemoryCategory::Staging:
+    return "staging";
+  case MemoryCategory::Environment:
+    return "environment";
+  default:
+    return "other";
+  }
+}
+
+void TlsfBlock::init(VkDeviceSize size) {
+  TlsfBlock::size = size;
+  free_bytes = 0;
+  nodes.clear();
+  unused_nodes.clear();
+  fl_bitmap = 0;
+  for (uint32_t f = 0; f < FL_COUNT; f++) {
+    sl_bitmap[f] = 0;
+    for (uint32_t s = 0; s < SL_COUNT; s++) {
+      heads[f][s] = NONE;
+    }
+  }
+
+  uint32_t node = create_node(0, size);
+  insert_free(node);
+}
+
+uint32_t TlsfBlock::create_node(VkDeviceSize offset, VkDeviceSize size) {
+  uint32_t index;
+  if (!unused_nodes.empty()) {
+    index = unused_nodes.back();
+    unused_nodes.pop_back();
+  } else {
+    index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+  }
+  nodes[index] = {offset, size, NONE, NONE, NONE, NONE, false};
+  return index;
+}
+
+void TlsfBlock::release_node(uint32_t node) { unused_nodes.push_back(node); }
+
+void TlsfBlock::insert_free(uint32_t node) {
+  uint32_t fl, sl;
+  get_bin(nodes[node].size, fl, sl);
+
+  nodes[node].free = true;
+  nodes[node].prev_free = NONE;
+  nodes[node].next_free = heads[fl][sl];
+  if (heads[fl][sl] != NONE)
+    nodes[heads[fl][sl]].prev_free = node;
+  heads[fl][sl] = node;
+
+  fl_bitmap |= 1ull << fl;
+  sl_bitmap[fl] |= 1u << sl;
+  free_bytes += nodes[node].size;
+}
+
+void TlsfBlock::remove_free(uint32_t node) {
+  uint32_t fl, sl;
+  get_bin(nodes[node].size, fl, sl);
+
+  Node &n = nodes[node];
+  if (n.prev_free != NONE)
+    nodes[n.prev_free].next_free = n.next_free;
+  else
+    heads[fl][sl] = n.next_free;
+  if (n.next_free != NONE)
+    nodes[n.next_free].prev_free = n.prev_free;
+
+  if (heads[fl][sl] == NONE) {
+    sl_bitmap[fl] &= ~(1u << sl);
+    if (sl_bitmap[fl] == 0)
+      fl_bitmap &= ~(1ull << fl);
+  }
+
+  n.free = false;
+  free_bytes -= n.size;
+}
+
+VkDeviceSize TlsfBlock::get_largest_free() const {
+  if (fl_bitmap == 0)
+    return 0;
+
+  // the last non empty bin holds the largest ranges.
+  uint32_t fl = find_highest_bit(fl_bitmap);
+  uint32_t sl = find_highest_bit(sl_bitmap[fl]);
+  VkDeviceSize largest = 0;
+  for (uint32_t node = heads[fl][sl]; node != NONE;
+       node = nodes[node].next_free) {
+    largest = std::max(largest, nodes[node].size);
+  }
+  return largest;
+}
+
+uint32_t TlsfBlock::find_free(VkDeviceSize size) {
+  uint32_t fl, sl;
+  get_bin(size, fl, sl);
+  const uint32_t exact_fl = fl;
+  const uint32_t exact_sl = sl;
+
+  // round up to the next bin, every range in it (or any later one) fits.
+  if (size >= SL_COUNT) {
+    VkDeviceSize step = 1ull << (find_highest_bit(size) - SL_BITS);
+    if (size <= ~0ull - step)
+      get_bin(size + step - 1, fl, sl);
+    else
+      fl = FL_COUNT;
+  }
+
+  if (fl < FL_COUNT) {
+    uint32_t sl_map = sl_bitmap[fl] & (~0u << sl);
+    if (sl_map == 0) {
+      uint64_t fl_map =
+          fl + 1 < FL_COUNT ? fl_bitmap & (~0ull << (fl + 1)) : 0;
+      if (fl_map != 0) {
+        fl = find_lowest_bit(fl_map);
+        sl_map = sl_bitmap[fl];
+      }
+    }
+    if (sl_map != 0)
+      return heads[fl][find_lowest_bit(sl_map)];
+  }
+
+  // the ranges sharing size's own bin may still be large enough, which
+  // matters once the block is nearly full.
+  for (uint32_t node = heads[exact_fl][exact_sl]; node != NONE;
+       node = nodes[node].next_free) {
+    if (nodes[node].size >= size)
+      return node;
+  }
+  return NONE;
+}
+
+bool TlsfBlock::allocate(VkDeviceSize request, VkDeviceSize alignment,
+                         VkDeviceSize &offset, uint32_t &node) {
+  if (request == 0 || request + alignment - 1 > free_bytes)
+    return false;
+
+  // any range this large holds request at any alignment.
+  node = find_free(request + alignment - 1);
+  if (node == NONE)
+    return false;
+  remove_free(node);
+
+  // the bytes skipped to align the start stay free on their own.
+  VkDeviceSize aligned = align_up(nodes[node].offset, alignment);
+  VkDeviceSize padding = aligned - nodes[node].offset;
+  if (padding > 0) {
+    uint32_t front = create_node(nodes[node].offset, padding);
+    nodes[front].prev_physical = nodes[node].prev_physical;
+    nodes[front].next_physical = node;
+    if (nodes[node].prev_physical != NONE)
+      nodes[nodes[node].prev_physical].next_physical = front;
+    nodes[node].prev_physical = front;
+    nodes[node].offset = aligned;
+    nodes[node].size -= padding;
+    insert_free(front);
+  }
+
+  // and so does whatever is left behind the allocation.
+  if (nodes[node].size > request) {
+    uint32_t back =
+        create_node(nodes[node].offset + request, nodes[node].size - request);
+    nodes[back].prev_physical = node;
+    nodes[back].next_physical = nodes[node].next_physical;
+    if (nodes[node].next_physical != NONE)
+      nodes[nodes[node].next_physical].prev_physical = back;
+    nodes[node].next_physical = back;
+    nodes[node].size = request;
+    insert_free(back);
+  }
+
+  offset = nodes[node].offset;
+  return true;
+}
+
+void TlsfBlock::free(uint32_t node) {
+  // merge with free neighbours, so free ranges never sit next to each other.
+  uint32_t prev = nodes[node].prev_physical;
+  if (prev != NONE && nodes[prev].free) {
+    remove_free(prev);
+    nodes[prev].size += nodes[node].size;
+    nodes[prev].next_physical = nodes[node].next_physical;
+    if (nodes[node].next_physical != NONE)
+      nodes[nodes[node].next_physical].prev_physical = prev;
+    release_node(node);
+    node = prev;
+  }
+
+  uint32_t next = nodes[node].next_physical;
+  if (next != NONE && nodes[next].free) {
+    remove_free(next);
+    nodes[node].size += nodes[next].size;
+    nodes[node].next_physical = nodes[next].next_physical;
+    if (nodes[next].next_physical != NONE)
+      nodes[nodes[next].next_physical].prev_physical = node;
+    release_node(next);
+  }
+
+  insert_free(node);
+}
+
+void DeviceAllocator::init(vk::PhysicalDevice physical_device,
+                           vk::Device device, bool memory_budget) {
+  DeviceAllocator::device = device;
+  DeviceAllocator::physical_device = physical_device;
+  properties = physical_device.getMemoryProperties();
+
+  vk::PhysicalDeviceLimits limits = physical_device.getProperties().limits;
+  image_granularity = std::max<VkDeviceSize>(limits.bufferImageGranularity, 1);
+
+  stats = AllocatorStats{};
+  stats.types.resize(properties.memoryTypeCount);
+  stats.heaps.resize(properties.memoryHeapCount);
+  for (uint32_t h = 0; h < properties.memoryHeapCount; h++) {
+    stats.heaps[h].size = properties.memoryHeaps[h].size;
+    stats.heaps[h].device_local =
+        static_cast<bool>(properties.memoryHeaps[h].flags &
+                          vk::MemoryHeapFlagBits::eDeviceLocal);
+  }
+  stats.max_device_allocations = limits.maxMemoryAllocationCount;
+  stats.memory_budget = memory_budget;
+  over_budget.assign(properties.memoryHeapCount, false);
+  live.clear();
+  refresh_budget();
+}
+
+void DeviceAllocator::destroy() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!device)
+    return;
+
+  for (Heap &heap : heaps) {
+    for (std::unique_ptr<Block> &block : heap.blocks) {
+      if (!block)
+        continue;
+      if (!block->space.empty()) {
+        WARN("memory type {} is destroyed with allocations left in it",
+             heap.memory_type);
+      }
+      release_memory(block->memory);
+    }
+  }
+  heaps.clear();
+  device = vk::Device();
+}
+
+std::vector<uint32_t>
+DeviceAllocator::get_memory_types(uint32_t type_bits,
+                                  vk::MemoryPropertyFlags required,
+                                  vk::MemoryPropertyFlags preferred) const {
+  struct Candidate {
+    uint32_t type;
+    int score;
+  };
+  std::vector<Candidate> candidates;
+  for (uint32_t i = 0; i < properties.memoryTypeCount; i++) {
+    vk::MemoryPropertyFlags flags = properties.memoryTypes[i].propertyFlags;
+    if (!(type_bits & (1u << i)) || (flags & required) != required)
+      continue;
+
+    // every preferred flag outweighs any number of unasked for ones (which
+    // usually mean scarcer memory, like device local host visible).
+    int score = 0;
+    for (uint32_t bit = 0; bit < 32; bit++) {
+      vk::MemoryPropertyFlags flag(static_cast<VkMemoryPropertyFlags>(1u << bit));
+      if (!(flags & flag))
+        continue;
+      if (preferred & flag)
+        score += 64;
+      else if (!(required & flag))
+        score -= 1;
+    }
+    candidates.push_back({i, score});
+  }
+
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](const Candidate &a, const Candidate &b) {
+                     return a.score > b.score;
+                   });
+
+  std::vector<uint32_t> types;
+  types.reserve(candidates.size());
+  for (const Candidate &candidate : candidates) {
+    types.push_back(candidate.type);
+  }
+  return types;
+}
+
+Allocation DeviceAllocator::allocate(const vk::MemoryRequirements &requirements,
+                                     const AllocationInfo &info) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  std::vector<uint32_t> types = get_memory_types(
+      requirements.memoryTypeBits, info.required, info.preferred);
+  if (types.empty()) {
+    throw std::runtime_error("could not find appropriate memory type");
+  }
+
+  Allocation allocation{};
+  for (uint32_t type : types) {
+    uint32_t heap = get_heap(type, info.optimal_image);
+    bool dedicated =
+        info.dedicated || requirements.size > heaps[heap].block_size / 2;
+
+    // a full memory heap moves on to the next best type.
+    try {
+      if (dedicated
+              ? allocate_dedicated(type, requirements.size, info, allocation)
+              : allocate_from_heap(heap, requirements.size,
+                                   std::max<VkDeviceSize>(
+                                       requirements.alignment, 1),
+                                   allocation)) {
+        track(allocation, info);
+        return allocation;
+      }
+    } catch (const vk::OutOfDeviceMemoryError &) {
+      WARN("memory type {} is out of memory, trying another", type);
+    }
+  }
+
+  throw std::runtime_error("out of device memory");
+}
+
+bool DeviceAllocator::allocate_from_heap(uint32_t heap_index,
+                                         VkDeviceSize size,
+                                         VkDeviceSize alignment,
+                                         Allocation &allocation) {
+  Heap &heap = heaps[heap_index];
+
+  VkDeviceSize offset = 0;
+  uint32_t node = TlsfBlock::NONE;
+  uint32_t block_index = TlsfBlock::NONE;
+  for (uint32_t b = 0; b < heap.blocks.size(); b++) {
+    if (heap.blocks[b] && heap.blocks[b]->space.allocate(size, alignment,
+                                                         offset, node)) {
+      block_index = b;
+      break;
+    }
+  }
+
+  if (block_index == TlsfBlock::NONE) {
+    auto block = std::make_unique<Block>();
+    block->memory = allocate_memory(heap.memory_type, heap.block_size, nullptr);
+    if (is_host_visible(heap.memory_type)) {
+      block->mapped = static_cast<unsigned char *>(
+          device.mapMemory(block->memory, 0, VK_WHOLE_SIZE));
+    }
+    block->space.init(heap.block_size);
+    if (!block->space.allocate(size, alignment, offset, node)) {
+      release_memory(block->memory);
+      return false;
+    }
+
+    // freed blocks leave their slot for the next one.
+    auto slot = std::find(heap.blocks.begin(), heap.blocks.end(), nullptr);
+    block_index = static_cast<uint32_t>(slot - heap.blocks.begin());
+    if (slot == heap.blocks.end())
+      heap.blocks.push_back(std::move(block));
+    else
+      *slot = std::move(block);
+
+    MemoryTypeStats &type_stats = stats.types[heap.memory_type];
+    type_stats.blocks++;
+    type_stats.block_bytes += heap.block_size;
+  }
+
+  Block &block = *heap.blocks[block_index];
+  allocation.memory = block.memory;
+  allocation.offset = offset;
+  allocation.size = size;
+  allocation.mapped = block.mapped ? block.mapped + offset : nullptr;
+  allocation.memory_type = heap.memory_type;
+  allocation.heap = heap_index;
+  allocation.block = block_index;
+  allocation.node = node;
+
+  MemoryTypeStats &type_stats = stats.types[heap.memory_type];
+  type_stats.allocations++;
+  type_stats.allocated_bytes += size;
+  return true;
+}
+
+bool DeviceAllocator::allocate_dedicated(uint32_t memory_type,
+                                         VkDeviceSize size,
+                                         const AllocationInfo &info,
+                                         Allocation &allocation) {
+  vk::MemoryDedicatedAllocateInfo dedicated_info(info.dedicated_image,
+                                                 info.dedicated_buffer);
+  bool has_resource = info.dedicated_image || info.dedicated_buffer;
+
+  allocation.memory = allocate_memory(memory_type, size,
+                                      has_resource ? &dedicated_info : nullptr);
+  allocation.offset = 0;
+  allocation.size = size;
+  allocation.mapped = nullptr;
+  if (is_host_visible(memory_type)) {
+    allocation.mapped = static_cast<unsigned char *>(
+        device.mapMemory(allocation.memory, 0, VK_WHOLE_SIZE));
+  }
+  allocation.memory_type = memory_type;
+  allocation.heap = UINT32_MAX;
+
+  MemoryTypeStats &type_stats = stats.types[memory_type];
+  type_stats.dedicated++;
+  type_stats.dedicated_bytes += size;
+  return true;
+}
+
+void DeviceAllocator::free(Allocation &allocation) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!allocation.valid() || !device) {
+    allocation = Allocation{};
+    return;
+  }
+  untrack(allocation);
+
+  MemoryTypeStats &type_stats = stats.types[allocation.memory_type];
+  if (allocation.heap == UINT32_MAX) {
+    type_stats.dedicated--;
+    type_stats.dedicated_bytes -= allocation.size;
+    release_memory(allocation.memory);
+    allocation = Allocation{};
+    return;
+  }
+
+  type_stats.allocations--;
+  type_stats.allocated_bytes -= allocation.size;
+
+  Heap &heap = heaps[allocation.heap];
+  std::unique_ptr<Block> &block = heap.blocks[allocation.block];
+  block->space.free(allocation.node);
+
+  // one empty block is kept around, so a heap that keeps emptying and
+  // refilling doesn't hit the driver every time.
+  if (block->space.empty()) {
+    bool spare = false;
+    for (const std::unique_ptr<Block> &other : heap.blocks) {
+      spare = spare || (other && other != block && other->space.empty());
+    }
+    if (spare) {
+      release_memory(block->memory);
+      block.reset();
+      type_stats.blocks--;
+      type_stats.block_bytes -= heap.block_size;
+    }
+  }
+
+  allocation = Allocation{};
+}
+
+uint32_t DeviceAllocator::get_heap(uint32_t memory_type, bool optimal_image) {
+  // without a granularity to respect, images and buffers can share blocks.
+  optimal_image = optimal_image && image_granularity > 1;
+
+  for (uint32_t h = 0; h < heaps.size(); h++) {
+    if (heaps[h].memory_type == memory_type &&
+        heaps[h].optimal_image == optimal_image)
+      return h;
+  }
+
+  VkDeviceSize heap_size =
+      properties.memoryHeaps[properties.memoryTypes[memory_type].heapIndex]
+          .size;
+
+  Heap heap{};
+  heap.memory_type = memory_type;
+  heap.optimal_image = optimal_image;
+  heap.block_size = heap_size < ALLOCATOR_SMALL_HEAP
+                        ? align_up(heap_size / 8, 1 << 20)
+                        : ALLOCATOR_BLOCK_SIZE;
+  heaps.push_back(std::move(heap));
+  return static_cast<uint32_t>(heaps.size() - 1);
+}
+
+vk::DeviceMemory DeviceAllocator::allocate_memory(uint32_t memory_type,
+                                                  VkDeviceSize size,
+                                                  const void *p_next) {
+  auto info = vk::MemoryAllocateInfo(size, memory_type);
+  info.pNext = p_next;
+  vk::DeviceMemory memory = device.allocateMemory(info);
+  stats.device_allocations++;
+  return memory;
+}
+
+void DeviceAllocator::release_memory(vk::DeviceMemory memory) {
+  // mapped memory is unmapped implicitly when it's freed.
+  device.freeMemory(memory);
+  stats.device_allocations--;
+}
+
+bool DeviceAllocator::is_host_visible(uint32_t memory_type) const {
+  return static_cast<bool>(properties.memoryTypes[memory_type].propertyFlags &
+                           vk::MemoryPropertyFlagBits::eHostVisible);
+}
+
+void DeviceAllocator::track(Allocation &allocation,
+                            const AllocationInfo &info) {
+  allocation.category = info.category;
+  allocation.id = next_id++;
+
+  LiveAllocation entry{};
+  entry.name = info.name ? info.name : "";
+  entry.category = info.category;
+  entry.size = allocation.size;
+  entry.memory_type = allocation.memory_type;
+  entry.dedicated = allocation.heap == UINT32_MAX;
+  live.emplace(allocation.id, std::move(entry));
+
+  CategoryStats &category =
+      stats.categories[static_cast<uint32_t>(info.category)];
+  category.allocations++;
+  category.bytes += allocation.size;
+}
+
+void DeviceAllocator::untrack(const Allocation &allocation) {
+  live.erase(allocation.id);
+
+  CategoryStats &category =
+      stats.categories[static_cast<uint32_t>(allocation.category)];
+  category.allocations--;
+  category.bytes -= allocation.size;
+}
+
+void DeviceAllocator::refresh_budget() {
+  for (HeapBudget &heap : stats.heaps) {
+    heap.allocated = 0;
+  }
+  for (uint32_t t = 0; t < properties.memoryTypeCount; t++) {
+    const MemoryTypeStats &type = stats.types[t];
+    stats.heaps[properties.memoryTypes[t].heapIndex].allocated +=
+        type.block_bytes + type.dedicated_bytes;
+  }
+
+  if (stats.memory_budget) {
+    auto chain = physical_device.getMemoryProperties2<
+        vk::PhysicalDeviceMemoryProperties2,
+        vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+    const auto &budget =
+        chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+    for (uint32_t h = 0; h < stats.heaps.size(); h++) {
+      stats.heaps[h].budget = budget.heapBudget[h];
+      stats.heaps[h].usage = budget.heapUsage[h];
+    }
+    return;
+  }
+
+  // without the extension only this allocator's memory is known, other
+  // processes (and the driver) are accounted for by the smaller budget.
+  for (HeapBudget &heap : stats.heaps) {
+    heap.budget =
+        static_cast<VkDeviceSize>(heap.size * ALLOCATOR_ESTIMATED_BUDGET);
+    heap.usage = heap.allocated;
+  }
+}
+
+void DeviceAllocator::update_budget() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (device)
+    refresh_budget();
+}
+
+bool DeviceAllocator::check_budget(float warning) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!device)
+    return false;
+
+  refresh_budget();
+  bool any_over = false;
+  for (uint32_t h = 0; h < stats.heaps.size(); h++) {
+    const HeapBudget &heap = stats.heaps[h];
+    bool over = heap.budget > 0 && heap.usage > heap.budget * warning;
+    if (over) {
+      VkDeviceSize released = release_spare_blocks(h);
+      if (!over_budget[h]) {
+        WARN("memory heap {} uses {:.1f} of its {:.1f} mb budget, released "
+             "{:.1f} mb of spare blocks",
+             h, heap.usage / 1e6, heap.budget / 1e6, released / 1e6);
+      }
+    } else if (over_budget[h]) {
+      INFO("memory heap {} is back under {:.0f}% of its budget", h,
+           warning * 100.0f);
+    }
+    over_budget[h] = over;
+    any_over = any_over || over;
+  }
+  return any_over;
+}
+
+VkDeviceSize DeviceAllocator::trim(uint32_t memory_heap) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!device)
+    return 0;
+  return release_spare_blocks(memory_heap);
+}
+
+VkDeviceSize DeviceAllocator::release_spare_blocks(uint32_t memory_heap) {
+  VkDeviceSize released = 0;
+  for (Heap &heap : heaps) {
+    if (memory_heap != UINT32_MAX &&
+        properties.memoryTypes[heap.memory_type].heapIndex != memory_heap)
+      continue;
+
+    for (std::unique_ptr<Block> &block : heap.blocks) {
+      if (!block || !block->space.empty())
+        continue;
+      release_memory(block->memory);
+      block.reset();
+
+      MemoryTypeStats &type_stats = stats.types[heap.memory_type];
+      type_stats.blocks--;
+      type_stats.block_bytes -= heap.block_size;
+      released += heap.block_size;
+    }
+  }
+  return released;
+}
+
+AllocatorStats DeviceAllocator::get_stats() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return stats;
+}
+
+void DeviceAllocator::log_stats() {
+  AllocatorStats current = get_stats();
+  for (uint32_t t = 0; t < current.types.size(); t++) {
+    const MemoryTypeStats &type = current.types[t];
+    if (type.blocks == 0 && type.dedicated == 0)
+      continue;
+    INFO("memory type {}: {} blocks ({:.1f} mb), {} allocations ({:.1f} mb), "
+         "{} dedicated ({:.1f} mb)",
+         t, type.blocks, type.block_bytes / 1e6, type.allocations,
+         type.allocated_bytes / 1e6, type.dedicated,
+         type.dedicated_bytes / 1e6);
+  }
+  for (uint32_t c = 0; c < MEMORY_CATEGORY_COUNT; c++) {
+    const CategoryStats &category = current.categories[c];
+    if (category.allocations == 0)
+      continue;
+    INFO("{}: {} allocations ({:.1f} mb)",
+         get_category_name(static_cast<MemoryCategory>(c)),
+         category.allocations, category.bytes / 1e6);
+  }
+  INFO("{} of {} device memory allocations in use", current.device_allocations,
+       current.max_device_allocations);
+}
+
+std::string DeviceAllocator::get_report(size_t largest_count) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (device)
+    refresh_budget();
+
+  // free space of the blocks, per memory heap.
+  std::vector<VkDeviceSize> heap_free(stats.heaps.size(), 0);
+  std::vector<VkDeviceSize> heap_largest(stats.heaps.size(), 0);
+
+  std::string pools;
+  for (const Heap &heap : heaps) {
+    uint32_t blocks = 0;
+    VkDeviceSize free_bytes = 0;
+    VkDeviceSize largest_free = 0;
+    for (const std::unique_ptr<Block> &block : heap.blocks) {
+      if (!block)
+        continue;
+      blocks++;
+      free_bytes += block->space.get_free_bytes();
+      largest_free = std::max(largest_free, block->space.get_largest_free());
+    }
+
+    uint32_t memory_heap = properties.memoryTypes[heap.memory_type].heapIndex;
+    heap_free[memory_heap] += free_bytes;
+    heap_largest[memory_heap] =
+        std::max(heap_largest[memory_heap], largest_free);
+
+    if (!pools.empty())
+      pools += ",";
+    pools += fmt::format(
+        "\n    {{\"memory_type\": {}, \"memory_heap\": {}, "
+        "\"optimal_image\": {}, \"block_size\": {}, \"blocks\": {}, "
+        "\"used_bytes\": {}, \"free_bytes\": {}, \"largest_free\": {}, "
+        "\"fragmentation\": {:.4f}}}",
+        heap.memory_type, memory_heap, heap.optimal_image, heap.block_size,
+        blocks, blocks * heap.block_size - free_bytes, free_bytes,
+        largest_free, get_fragmentation(free_bytes, largest_free));
+  }
+
+  std::string json = "{\n";
+  json += fmt::format("  \"memory_budget\": {},\n", stats.memory_budget);
+  json += fmt::format("  \"device_allocations\": {},\n",
+                      stats.device_allocations);
+  json += fmt::format("  \"max_device_allocations\": {},\n",
+                      stats.max_device_allocations);
+
+  json += "  \"heaps\": [";
+  for (uint32_t h = 0; h < stats.heaps.size(); h++) {
+    const HeapBudget &heap = stats.heaps[h];
+    json += fmt::format(
+        "{}\n    {{\"index\": {}, \"device_local\": {}, \"size\": {}, "
+        "\"budget\": {}, \"usage\": {}, \"allocated\": {}, "
+        "\"block_free_bytes\": {}, \"fragmentation\": {:.4f}}}",
+        h == 0 ? "" : ",", h, heap.device_local, heap.size, heap.budget,
+        heap.usage, heap.allocated, heap_free[h],
+        get_fragmentation(heap_free[h], heap_largest[h]));
+  }
+  json += "\n  ],\n";
+
+  json += "  \"pools\": [" + pools + "\n  ],\n";
+
+  json += "  \"categories\": {";
+  for (uint32_t c = 0; c < MEMORY_CATEGORY_COUNT; c++) {
+    const CategoryStats &category = stats.categories[c];
+    json += fmt::format(
+        "{}\n    \"{}\": {{\"allocations\": {}, \"bytes\": {}}}",
+        c == 0 ? "" : ",", get_category_name(static_cast<MemoryCategory>(c)),
+        category.allocations, category.bytes);
+  }
+  json += "\n  },\n";
+
+  std::vector<const LiveAllocation *> largest;
+  largest.reserve(live.size());
+  for (const auto &entry : live) {
+    largest.push_back(&entry.second);
+  }
+  largest_count = std::min(largest_count, largest.size());
+  std::partial_sort(largest.begin(), largest.begin() + largest_count,
+                    largest.end(),
+                    [](const LiveAllocation *a, const LiveAllocation *b) {
+                      return a->size > b->size;
+                    });
+
+  json += "  \"largest_allocations\": [";
+  for (size_t i = 0; i < largest_count; i++) {
+    const LiveAllocation &allocation = *largest[i];
+    json += fmt::format(
+        "{}\n    {{\"name\": \"{}\", \"category\": \"{}\", "
+        "\"size\": {}, \"memory_type\": {}, \"dedicated\": {}}}",
+        i == 0 ? "" : ",", escape_json(allocation.name),
+        get_category_name(allocation.category), allocation.size,
+        allocation.memory_type, allocation.dedicated);
+  }
+  json += "\n  ]\n}\n";
+  return json;
+}
@@ -22,7 +22,8 @@ void Environment::init(std::string file_path, GameObject* model)
 	p_device = Antuco::get_engine().get_backend()->p_device;
 
 	input_image.init("environment map");
-	input_image.load_float_image(file_path, br::ImageFormat::HDR_COLOR, br::ImageType::Image_2D);
+	input_image.set_memory_category(mem::MemoryCategory::Environment);
+	input_image.load_float_image(file_path, br::ImageFormat::HDR_HALF, br::ImageType::Image_2D);
 	input_image.set_image_sampler(VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
 
 	skybox.init("skybox", SHADER("skybox/create_skybox.vert"), SHADER("skybox/create_skybox.frag"), model, 1024);
@@ -61,6 +62,9 @@ void Environment::render_to_image()
 
 	//vkResetFences(p_device->get(), MAX_FRAMES_IN_FLIGHT, cpu_sync.data());
 
+	// the skybox mesh may still be sitting in the staging ring.
+	Antuco::get_engine().get_backend()->get_staging_ring().flush();
+
 	int32_t prev_image = -1;
 	int32_t curr_image = (prev_image + 1) % MAX_FRAMES_IN_FLIGHT;
 	for (int i = 0; i < CUBEMAP_FACES + 1; i++)
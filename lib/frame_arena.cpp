@@ -0,0 +1,70 @@
+#include "frame_arena.hpp"
+
+#include <algorithm>
+
+using namespace mem;
+
+void FrameArena::init(size_t block_size, uint32_t slot_count) {
+  this->block_size = block_size;
+  slots.resize(slot_count);
+  for (Slot &slot : slots)
+    add_block(slot, block_size);
+  current = 0;
+  // the first blocks are part of setting up, not growth.
+  stats.grows = 0;
+}
+
+void FrameArena::destroy() {
+  slots.clear();
+  stats = FrameArenaStats{};
+}
+
+void FrameArena::begin_frame() {
+  current = (current + 1) % static_cast<uint32_t>(slots.size());
+  Slot &slot = slots[current];
+  slot.block = 0;
+  slot.head = 0;
+
+  stats.frame_bytes = 0;
+  stats.frame++;
+}
+
+void *FrameArena::allocate(size_t size, size_t alignment) {
+  Slot &slot = slots[current];
+  // blocks the slot took on earlier frames are tried before a new one.
+  while (slot.block < slot.blocks.size()) {
+    Block &block = slot.blocks[slot.block];
+    uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+    uintptr_t start = (base + slot.head + alignment - 1) & ~(alignment - 1);
+    size_t end = static_cast<size_t>(start - base) + size;
+    if (end <= block.size) {
+      slot.head = end;
+      stats.frame_bytes += size;
+      stats.peak_bytes = std::max(stats.peak_bytes, stats.frame_bytes);
+      return reinterpret_cast<void *>(start);
+    }
+
+    slot.block++;
+    slot.head = 0;
+  }
+
+  add_block(slot, std::max(block_size, size + alignment));
+  stats.grows++;
+  return allocate(size, alignment);
+}
+
+uint32_t FrameArena::take_grows() {
+  uint32_t grows = stats.grows;
+  stats.grows = 0;
+  return grows;
+}
+
+void FrameArena::add_block(Slot &slot, size_t size) {
+  Block block;
+  block.data = std::make_unique<unsigned char[]>(size);
+  block.size = size;
+  slot.blocks.push_back(std::move(block));
+
+  stats.block_bytes += size;
+  stats.blocks++;
+}
@@ -5,6 +5,7 @@
 
 #include <antuco.hpp>
 #include <api_graphics.hpp>
+#include "logger/interface.hpp"
 
 using namespace tuco;
 
@@ -19,9 +20,21 @@ GameObject::GameObject() : object_model() {
 
 GameObject::~GameObject() {}
 
-void GameObject::add_mesh(const std::string& file_name, std::optional<std::string> name) {
+AssetHandle GameObject::add_mesh(const std::string& file_name, std::optional<std::string> name) {
+	if (mesh_handle.is_pending()) {
+		WARN("mesh is still loading, ignoring request to load {}", file_name);
+		return mesh_handle;
+	}
+
 	changed = 1;
-	object_model.add_mesh(file_name, name);
+	update = true;
+	mesh_handle = Antuco::get_engine().get_asset_manager().load_model(&object_model, file_name, name);
+
+	return mesh_handle;
+}
+
+bool GameObject::is_resident() const {
+	return !mesh_handle.valid() || mesh_handle.is_ready();
 }
 
 void GameObject::translate(glm::vec3 t) {
@@ -33,6 +46,7 @@ void GameObject::translate(glm::vec3 t) {
 	};
 
 	transform = glm::translate(transform, t);
+	transform_dirty = true;
 }
 
 void GameObject::set_position(glm::vec3 t) {
@@ -44,6 +58,28 @@ void GameObject::set_position(glm::vec3 t) {
 	};
 }
 
+bool GameObject::play_animation(const std::string& name, bool loop) {
+	if (!is_resident()) {
+		WARN("mesh is not loaded yet, can't play animation {}", name);
+		return false;
+	}
+
+	int32_t index = object_model.find_animation(name);
+	if (index < 0) {
+		WARN("model has no animation called {}", name);
+		return false;
+	}
+
+	animation = AnimationState{};
+	animation.animation = index;
+	animation.loop = loop;
+	return true;
+}
+
+void GameObject::stop_animation() {
+	animation.animation = -1;
+}
+
 Material* GameObject::get_material()
 {
 	GraphicsImpl* backend = Antuco::get_engine().get_backend();
@@ -59,4 +95,5 @@ void GameObject::scale(glm::vec3 scale_vector) {
 	};
 
 	transform = transform * glm::transpose(scale_mat);
+	transform_dirty = true;
 }
@@ -0,0 +1,72 @@
+#include "geometry_registry.hpp"
+
+using namespace tuco;
+
+std::optional<uint32_t> GeometryRegistry::acquire(const GeometryKey &key) {
+  if (key.hash == 0)
+    return std::nullopt;
+
+  auto search = lookup.find(key);
+  if (search == lookup.end())
+    return std::nullopt;
+
+  entries.at(search->second).ref_count++;
+  return search->second;
+}
+
+uint32_t GeometryRegistry::add(const GeometryKey &key,
+                               SharedGeometry geometry) {
+  uint32_t id = next_id++;
+  geometry.key = key;
+  geometry.ref_count = 1;
+  entries.emplace(id, std::move(geometry));
+
+  // unshareable uploads are still tracked so they are freed the same way.
+  if (key.hash != 0)
+    lookup[key] = id;
+
+  return id;
+}
+
+bool GeometryRegistry::release(uint32_t id, SharedGeometry &released) {
+  auto search = entries.find(id);
+  if (search == entries.end() || search->second.ref_count == 0)
+    return false;
+
+  if (--search->second.ref_count > 0)
+    return false;
+
+  if (search->second.key.hash != 0)
+    lookup.erase(search->second.key);
+
+  released = std::move(search->second);
+  entries.erase(search);
+  return true;
+}
+
+std::optional<uint32_t>
+GeometryRegistry::find_vertices(VkDeviceSize location) const {
+  for (const auto &[id, geometry] : entries) {
+    if (geometry.vertex_location == location)
+      return id;
+  }
+  return std::nullopt;
+}
+
+std::optional<uint32_t>
+GeometryRegistry::find_indices(VkDeviceSize location) const {
+  for (const auto &[id, geometry] : entries) {
+    if (geometry.index_location == location)
+      return id;
+  }
+  return std::nullopt;
+}
+
+size_t GeometryRegistry::get_saved_bytes() const {
+  size_t saved = 0;
+  for (const auto &[id, geometry] : entries) {
+    saved += (geometry.vertex_bytes + geometry.index_bytes) *
+             (geometry.ref_count - 1);
+  }
+  return saved;
+}
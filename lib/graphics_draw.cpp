@@ -7,6 +7,8 @@
 #include "descriptor_set.hpp"
 #include "material.hpp"
 #include "memory_allocator.hpp"
+#include "skinning.hpp"
+#include "vertex_layout.hpp"
 
 #include <vulkan_wrapper/limits.hpp>
 #include "antuco.hpp"
@@ -16,13 +18,19 @@
 #include "logger/interface.hpp"
 #include "vulkan/vulkan_core.h"
 
+#include <bedrock/hash.hpp>
+#include <bedrock/parallel_for.hpp>
 #include <bedrock/shader_text.hpp>
 
 #include <stb_image.h>
 
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cmath>
 #include <optional>
+#include <unordered_map>
 #include <vector>
 #include <vulkan/vulkan.h>
 
@@ -36,6 +44,53 @@
 
 using namespace tuco;
 
+// MODIFIES: ranges
+// PURPOSE: gives [start, start + count) back to ranges (start, count, sorted by
+// start), merged with the ranges right before and after it.
+static void release_range(std::vector<std::pair<uint32_t, uint32_t>>& ranges, uint32_t start, uint32_t count)
+{
+	auto next = std::lower_bound(ranges.begin(), ranges.end(), std::make_pair(start, 0u));
+	auto range = ranges.insert(next, { start, count });
+	if (range + 1 != ranges.end() && range->first + range->second == (range + 1)->first)
+	{
+		range->second += (range + 1)->second;
+		ranges.erase(range + 1);
+	}
+	if (range != ranges.begin() && (range - 1)->first + (range - 1)->second == range->first)
+	{
+		(range - 1)->second += range->second;
+		ranges.erase(range);
+	}
+}
+
+// MODIFIES: ranges, used
+// PURPOSE: finds count consecutive entries, in the first released range large
+// enough or after the used ones handed out so far. false if neither has room
+// below limit.
+static bool allocate_range(std::vector<std::pair<uint32_t, uint32_t>>& ranges, uint32_t count,
+						   uint32_t limit, uint32_t& used, uint32_t& start)
+{
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		std::pair<uint32_t, uint32_t>& range = ranges[i];
+		if (range.second < count)
+			continue;
+
+		start = range.first;
+		range.first += count;
+		range.second -= count;
+		if (range.second == 0)
+			ranges.erase(ranges.begin() + i);
+		return true;
+	}
+
+	if (used + count > limit)
+		return false;
+	start = used;
+	used += count;
+	return true;
+}
+
 void GraphicsImpl::create_depth_pipeline()
 {
 	PipelineConfig config{};
@@ -246,6 +301,8 @@ void GraphicsImpl::create_pipeline()
 	config.blend_colours = true;
 	config.cull_mode = VK_CULL_MODE_FRONT_BIT;
 	config.front_face = VK_FRONT_FACE_CLOCKWISE;
+	// the scene ubo lives in the uniform ring.
+	config.dynamic_uniforms = { { 0, 1 } };
 
 	pipeline.init(p_device, set_pool, config);
 
@@ -267,10 +324,11 @@ void GraphicsImpl::create_graphics_pipeline()
 
 	std::vector<VkPushConstantRange> push_ranges;
 
+	// light, camera position and the transform table slot of the node drawn.
 	VkPushConstantRange pushRange{};
 	pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	pushRange.offset = 0;
-	pushRange.size = sizeof(LightObject) + sizeof(glm::vec4);
+	pushRange.size = sizeof(LightObject) + sizeof(glm::vec4) + sizeof(uint32_t);
 
 	push_ranges.push_back(pushRange);
 
@@ -284,6 +342,10 @@ void GraphicsImpl::create_graphics_pipeline()
 	config.subpass_index = 0;
 	config.screen_extent = swapchain.get_extent();
 	config.blend_colours = true;
+	config.binding_descriptions = MeshVertexLayout::binding_descriptions();
+	config.attribute_descriptions = MeshVertexLayout::attribute_descriptions();
+	// the transform table and the scene ubo live in the uniform ring.
+	config.dynamic_uniforms = { { 0, 0 }, { 2, 3 } };
 
 	graphics_pipelines[0].init(p_device, set_pool, config);
 
@@ -291,6 +353,23 @@ void GraphicsImpl::create_graphics_pipeline()
 	//config.descriptor_layouts.erase(it);
 	config.frag_shader_path = SHADER_PATH + "no_texture.frag";
 
+	// with descriptor indexing the forward pipeline takes its materials and textures from the tables
+	// (see create_material_table), the material is picked by a push constant after the vertex stage's.
+	bindless_materials = p_device->supports_descriptor_indexing();
+	if (bindless_materials)
+	{
+		bindless_texture_count = std::min(BINDLESS_TEXTURE_COUNT, p_device->get_max_bindless_textures());
+
+		VkPushConstantRange materialRange{};
+		materialRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		materialRange.offset = pushRange.size;
+		materialRange.size = sizeof(uint32_t);
+
+		config.frag_shader_path = SHADER_PATH + "bindless.frag";
+		config.push_ranges.push_back(materialRange);
+		config.descriptor_arrays = { { 1, 1, bindless_texture_count } };
+	}
+
 	graphics_pipelines[1].init(p_device, set_pool, config);
 }
 
@@ -315,6 +394,7 @@ void GraphicsImpl::create_depth_resources()
 	depth_image_info.usage = vk::ImageUsageFlagBits::eDepthStencilAttachment;
 	depth_image_info.queueFamilyIndexCount = 1;
 	depth_image_info.pQueueFamilyIndices = &p_device->get_graphics_family();
+	depth_image_info.category = mem::MemoryCategory::RenderTarget;
 
 	// create image view
 	VkImageViewUsageCreateInfo usageInfo{};
@@ -379,6 +459,7 @@ void GraphicsImpl::create_output_images()
 	data.image_info.extent.depth = 1.0;
 
 	data.image_info.format = vk::Format::eR32G32B32A32Sfloat;
+	data.image_info.category = mem::MemoryCategory::RenderTarget;
 
 	data.image_info.usage = vk::ImageUsageFlagBits::eColorAttachment |
 		vk::ImageUsageFlagBits::eTransferSrc |
@@ -626,49 +707,124 @@ void GraphicsImpl::create_screen_buffer()
 	}
 }
 
-void GraphicsImpl::create_ubo_layout()
+void GraphicsImpl::create_ubo_pool()
 {
-/* UNIFORM BUFFER DESCRIPTOR SET */
-	VkDescriptorSetLayoutBinding ubo_layout_binding{};
-	ubo_layout_binding.binding = 0;
-	ubo_layout_binding.descriptorCount = 1;
-	ubo_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	ubo_layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-	ubo_layout_binding.pImmutableSamplers = nullptr;
+	std::vector<mem::PoolCreateInfo> poolInfo(1);
+	// light ubos
+	poolInfo[0].pool_size = swapchain.getSwapchainSize() * 50;
+	poolInfo[0].set_type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 
-	VkDescriptorSetLayoutCreateInfo layout_info{};
-	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	ubo_pool = std::make_unique<mem::Pool>(p_device, poolInfo);
+}
 
-	layout_info.bindingCount = 1;
-	layout_info.pBindings = &ubo_layout_binding;
+// PURPOSE: reserves the transform table in the uniform ring and the set the forward pass reads it
+// through, bound with the ring's dynamic offset like the ubos.
+void GraphicsImpl::create_transform_table()
+{
+	transform_table_offset = uniform_ring.allocate(MAX_TRANSFORMS * sizeof(TransformObject));
+	transform_objects.resize(MAX_TRANSFORMS);
 
-	auto result = vkCreateDescriptorSetLayout(p_device->get(), &layout_info, nullptr,
-											  &ubo_layout);
+	ResourceCollection* collection = graphics_pipelines[1].get_resource_collection(0);
+	transform_set = collection->addSets(1, *set_pool);
 
-	if (result != VK_SUCCESS)
+	ResourceBinding table{};
+	table.binding = 0;
+	table.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	table.buffer.buffer = uniform_ring.get_buffer();
+	table.buffer.offset = transform_table_offset;
+	table.buffer.range = MAX_TRANSFORMS * sizeof(TransformObject);
+	collection->write_element(transform_set, 0, table);
+}
+
+// MODIFIES: this, object
+// PURPOSE: gives the object a slot of the transform table per node, reusing the ranges released
+// objects gave back first. an object that doesn't fit what is left of MAX_TRANSFORMS keeps
+// transform_start at UINT32_MAX and isn't drawn.
+void GraphicsImpl::assign_transforms(GameObject& object, uint32_t node_count)
+{
+	object.transform_dirty = true;
+	if (object.transform_start != UINT32_MAX && object.transform_count == node_count)
+		return;
+	release_transforms(object);
+
+	uint32_t start = 0;
+	if (!allocate_range(free_transforms, node_count, MAX_TRANSFORMS, transform_count, start))
 	{
-		throw std::runtime_error("could not create ubo layout");
+		WARN("{} nodes don't fit the transform table ({} slots), the object isn't drawn", node_count, MAX_TRANSFORMS);
+		return;
 	}
+	object.transform_start = start;
+	object.transform_count = node_count;
 }
 
-void GraphicsImpl::create_ubo_pool()
+// MODIFIES: this, object
+// PURPOSE: gives the transform slots of object back to free_transforms.
+void GraphicsImpl::release_transforms(GameObject& object)
 {
-	std::vector<mem::PoolCreateInfo> poolInfo(1);
-	poolInfo[0].pool_size = swapchain.getSwapchainSize() * 50;
-	poolInfo[0].set_type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	if (object.transform_start == UINT32_MAX)
+		return;
 
-	ubo_pool = std::make_unique<mem::Pool>(p_device, poolInfo);
+	release_range(free_transforms, object.transform_start, object.transform_count);
+	object.transform_start = UINT32_MAX;
+	object.transform_count = 0;
 }
 
-// create swapchain image * set_count amount of descriptor sets.
-void GraphicsImpl::createUboSets(uint32_t setCount)
+// MODIFIES: this, game_objects
+// PURPOSE: writes the model and normal matrices of the objects that moved (or are animated) to the
+// transform table, the others keep what they have in the ring. the matrices are computed across
+// threads when enough nodes moved, the ring is written after.
+void GraphicsImpl::update_transforms(std::vector<std::unique_ptr<GameObject>>& game_objects)
 {
-	size_t current_size = uboSets.size();
-	uboSets.resize(current_size + 1);
-	uboSets[current_size].resize(setCount);
+	moved_objects.clear();
+	size_t node_count = 0;
+	for (auto& object : game_objects)
+	{
+		if (object->update || object->transform_start == UINT32_MAX)
+			continue;
+		// skinned vertices and animated nodes change every frame.
+		bool animated = object->animation.animation >= 0 || object->skinned_vertex_start != UINT32_MAX;
+		if (!object->transform_dirty && !animated)
+			continue;
+
+		moved_objects.push_back(object.get());
+		node_count += object->transform_count;
+	}
+	if (moved_objects.empty())
+		return;
+
+	auto compute = [&](size_t i)
+	{
+		GameObject& object = *moved_objects[i];
+		const Model& model = object.object_model;
+		bool skinned = object.skinned_vertex_start != UINT32_MAX;
+		for (uint32_t j = 0; j < object.transform_count; j++)
+		{
+			TransformObject& transform = transform_objects[object.transform_start + j];
+			// skinned vertices already carry their node transforms.
+			glm::mat4 node_to_world = skinned ? object.transform : object.transform * model.nodes.get_world(j);
+			transform.model_to_world = node_to_world *
+				(skinned ? object.skin_quantization.get_dequantization() : object.dequantization);
+			transform.normal_matrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(node_to_world))));
+		}
+	};
+	if (node_count >= TRANSFORM_PARALLEL_NODES)
+	{
+		br::parallel_for(moved_objects.size(), compute);
+	}
+	else
+	{
+		for (size_t i = 0; i < moved_objects.size(); i++)
+		{
+			compute(i);
+		}
+	}
 
-	ubo_pool->allocateDescriptorSets(*p_device, setCount, ubo_layout,
-									 uboSets[current_size].data());
+	for (GameObject* object : moved_objects)
+	{
+		uniform_ring.write(transform_table_offset + object->transform_start * sizeof(TransformObject),
+			object->transform_count * sizeof(TransformObject), &transform_objects[object->transform_start]);
+		object->transform_dirty = false;
+	}
 }
 
 //void GraphicsImpl::create_shadowmap_pool() {
@@ -838,17 +994,22 @@ void GraphicsImpl::create_shadowpass_pipeline()
 	config.subpass_index = 0;
 	config.depth_bias_enable = VK_TRUE;
 	config.push_ranges = push_ranges;
+	config.binding_descriptions = MeshVertexLayout::binding_descriptions();
+	config.attribute_descriptions = MeshVertexLayout::attribute_descriptions();
 
 	shadowmap_pipeline.init(p_device, set_pool, config);
 }
 
-VkDescriptorBufferInfo GraphicsImpl::allocateDescriptorBuffer(uint32_t size)
+// MODIFIES: this, offset
+// PURPOSE: allocates size bytes of the uniform buffer, offset is where they went
+// (what writes to them take), the returned info is their block and range in it.
+VkDescriptorBufferInfo GraphicsImpl::allocateDescriptorBuffer(uint32_t size, VkDeviceSize& offset)
 {
-	VkDeviceSize offset = uniform_buffer.allocate(size, v::Limits::get().uniformBufferOffsetAlignment);
+	offset = uniform_buffer.allocate(size, v::Limits::get().uniformBufferOffsetAlignment);
 
 	VkDescriptorBufferInfo buffer_info{};
-	buffer_info.buffer = uniform_buffer.buffer;
-	buffer_info.offset = offset;
+	buffer_info.buffer = uniform_buffer.get_buffer(offset);
+	buffer_info.offset = uniform_buffer.get_offset(offset);
 	buffer_info.range = (VkDeviceSize)size;
 
 	return buffer_info;
@@ -856,31 +1017,21 @@ VkDescriptorBufferInfo GraphicsImpl::allocateDescriptorBuffer(uint32_t size)
 
 void GraphicsImpl::update_descriptor_set(VkDescriptorBufferInfo buffer_info,
 										 uint32_t dst_binding,
-										 VkDescriptorSet set)
+										 VkDescriptorSet set,
+										 VkDescriptorType type)
 {
 	VkWriteDescriptorSet writeInfo{};
 	writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 	writeInfo.dstBinding = dst_binding;
 	writeInfo.dstSet = set;
 	writeInfo.descriptorCount = 1;
-	writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	writeInfo.descriptorType = type;
 	writeInfo.pBufferInfo = &buffer_info;
 	writeInfo.dstArrayElement = 0;
 
 	vkUpdateDescriptorSets(p_device->get(), 1, &writeInfo, 0, nullptr);
 }
 
-void GraphicsImpl::write_to_ubo()
-{
-	for (size_t i = 0; i < uboSets[uboSets.size() - 1].size(); i++)
-	{
-		VkDescriptorBufferInfo buffer_info =
-			allocateDescriptorBuffer(sizeof(UniformBufferObject));
-		ubo_offsets.push_back(buffer_info.offset);
-		update_descriptor_set(buffer_info, 0, uboSets[uboSets.size() - 1][i]);
-	}
-}
-
 void GraphicsImpl::destroy_draw()
 {
 	vkDeviceWaitIdle(p_device->get());
@@ -894,13 +1045,20 @@ void GraphicsImpl::destroy_draw()
 		vkDestroySemaphore(p_device->get(), image_available_semaphores[i], nullptr);
 	}
 
+	staging_ring.destroy();
+	frame_arena.destroy();
 	uniform_buffer.destroy();
+	uniform_ring.destroy();
 	vertex_buffer.destroy();
 	index_buffer.destroy();
+	// the textures go before the device does, materials only point at them.
+	texture_cache.destroy();
+	material_lookup.clear();
+	destroy_cluster_culling();
+	destroy_skinning();
 
 	vkDestroyCommandPool(p_device->get(), command_pool, nullptr);
 
-	vkDestroyDescriptorSetLayout(p_device->get(), ubo_layout, nullptr);
 	vkDestroyDescriptorSetLayout(p_device->get(), light_layout, nullptr);
 	//vkDestroyDescriptorSetLayout(p_device->get(), shadowmap_layout, nullptr);
 	vkDestroyDescriptorSetLayout(p_device->get(), texture_layout, nullptr);
@@ -932,6 +1090,11 @@ void GraphicsImpl::destroy_draw()
 	texture_pool.get()->destroyPool();
 	ubo_pool.get()->destroyPool();
 	matPool.get()->destroyPool();
+	if (bindless_materials)
+	{
+		bindless_pool->destroyPool();
+		material_table.destroy();
+	}
 	//shadowmap_pool.get()->destroyPool();
 
 	//for (br::Image &image : output_images) {
@@ -986,12 +1149,13 @@ void GraphicsImpl::create_light_set(uint32_t set_count)
 	light_ubo[current_size].addSets(set_count, *ubo_pool);
 
 	// write to set
-	VkDeviceSize offset = uniform_buffer.allocate(sizeof(UniformBufferObject));
+	VkDeviceSize offset = uniform_buffer.allocate(sizeof(UniformBufferObject),
+		v::Limits::get().uniformBufferOffsetAlignment);
 
 	VkDeviceSize buffer_range = (VkDeviceSize)sizeof(UniformBufferObject);
 	light_ubo[current_size].addBuffer(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-									  uniform_buffer.buffer, offset,
-									  buffer_range);
+									  uniform_buffer.get_buffer(offset),
+									  uniform_buffer.get_offset(offset), buffer_range);
 
 	light_ubo[current_size].updateSets();
 	for (uint32_t i = 0; i < set_count; i++)
@@ -1064,14 +1228,14 @@ void GraphicsImpl::create_shadow_map(
 					  shadowmap_pipeline.get_api_pipeline());
 
 	// time for the draw calls
-	const VkDeviceSize offsets[] = { 0, offsetof(Vertex, normal),
-									offsetof(Vertex, tex_coord) };
+	const VkDeviceSize offsets[] = { 0 };
 
 	command_buffers[command_index].bindVertexBuffers(0, 1, &vertex_buffer.buffer,
 													 offsets);
 
 	vkCmdBindIndexBuffer(command_buffers[command_index], index_buffer.buffer, 0,
 						 VK_INDEX_TYPE_UINT32);
+	VkIndexType bound_index_type = VK_INDEX_TYPE_UINT32;
 
 	vkCmdPushConstants(command_buffers[command_index],
 					   shadowmap_pipeline.get_api_layout(),
@@ -1081,10 +1245,10 @@ void GraphicsImpl::create_shadow_map(
 	{
 		if (!game_objects[j]->update)
 		{
-			for (size_t k = 0; k < game_objects[j]->object_model.primitives.size();
+			for (size_t k = 0; k < game_objects[j]->primitive_draws.size();
 				 k++)
 			{
-				Primitive prim = game_objects[j]->object_model.primitives[k];
+				const Primitive& prim = game_objects[j]->object_model.primitives[k];
 
 				VkDescriptorSet descriptors[1] = {
 					light_ubo[j].get_api_set(prim.transform_index) };
@@ -1093,8 +1257,15 @@ void GraphicsImpl::create_shadow_map(
 					command_buffers[command_index], VK_PIPELINE_BIND_POINT_GRAPHICS,
 					shadowmap_pipeline.get_api_layout(), 0, 1, descriptors, 0, nullptr);
 
-				vkCmdDrawIndexed(command_buffers[command_index], prim.index_count, 1,
-								 prim.index_start, 0, static_cast<uint32_t>(0));
+				const PrimitiveDraw& draw = game_objects[j]->primitive_draws[k];
+				if (draw.index_type != bound_index_type)
+				{
+					vkCmdBindIndexBuffer(command_buffers[command_index], index_buffer.buffer, 0, draw.index_type);
+					bound_index_type = draw.index_type;
+				}
+
+				vkCmdDrawIndexed(command_buffers[command_index], draw.index_count, 1,
+								 draw.first_index, draw.vertex_offset, static_cast<uint32_t>(0));
 			}
 		}
 	}
@@ -1125,12 +1296,12 @@ void GraphicsImpl::write_scene(SceneData* scene)
 {
 	GameObject& skybox_model = scene->get_skybox_model();
 	
-	scene->ubo_offset = uniform_buffer.allocate(sizeof(UniformBufferObject), v::Limits::get().uniformBufferOffsetAlignment);
+	scene->ubo_offset = uniform_ring.allocate(sizeof(UniformBufferObject));
 
 	BufferDescription info{};
 	info.binding = 1;
-	info.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	info.buffer = uniform_buffer.buffer;
+	info.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	info.buffer = uniform_ring.get_buffer();
 	info.bufferRange = sizeof(UniformBufferObject);
 	info.bufferOffset = scene->ubo_offset;
 
@@ -1152,7 +1323,7 @@ void GraphicsImpl::write_scene(SceneData* scene)
 	}
 	else
 	{
-		uninitalized_image.change_layout(vk::ImageLayout::eShaderReadOnlyOptimal, p_device->get_transfer_queue());
+		uninitalized_image.change_layout(vk::ImageLayout::eShaderReadOnlyOptimal, p_device->get_graphics_queue());
 		image_info.image = uninitalized_image.get_api_image();
 		image_info.image_view = uninitalized_image.get_api_image_view();
 		image_info.sampler = uninitalized_image.get_sampler();
@@ -1198,100 +1369,277 @@ void GraphicsImpl::write_scene(SceneData* scene)
 	}
 	forward_collection->addImage(brdf_info, scene->get_index(forward_collection));
 
+	// the camera matrices the forward pass projects with.
+	BufferDescription camera_info = info;
+	camera_info.binding = 3;
+	forward_collection->addBuffer(camera_info, scene->get_index(forward_collection));
+
 	forward_collection->updateSet(scene->get_index(forward_collection));
 	skybox_collection->updateSet(scene->get_index(skybox_collection));
 }
 
-void GraphicsImpl::writeMaterial(Material* material)
+void GraphicsImpl::create_material_table()
 {
-	// material.offsets.descriptorOffset = globalMaterialOffsets.descriptorOffset;
-	// update_materials(material.offsets.bufferOffset, material);
-	MaterialBufferObject matObj = material->convert();
-	updateUniformBuffer(material->gpuInfo.bufferOffset,
-						sizeof(MaterialBufferObject), &matObj);
+	if (!bindless_materials)
+	{
+		return;
+	}
 
+	std::vector<mem::PoolCreateInfo> pool_info(2);
+	pool_info[0].pool_size = 1;
+	pool_info[0].set_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	pool_info[1].pool_size = bindless_texture_count;
+	pool_info[1].set_type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	// texture slots are written while recorded command buffers use the set.
+	bindless_pool = std::make_unique<mem::Pool>(p_device, pool_info,
+		VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT);
 
-	// [TODO 08/2024] - by having addSets here, we basically create a new descriptor set every frame per every object... this is memory leak.
-	//material.gpuInfo.setIndex = materialCollection.addSets(1, *matPool);
 	ResourceCollection* collection = graphics_pipelines[1].get_resource_collection(1);
-	material->gpuInfo.setIndex = collection->addSets(1, *matPool);
+	bindless_set = collection->addSets(1, *bindless_pool);
 
-	BufferDescription info{};
-	info.binding = 0;
-	info.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	info.buffer = uniform_buffer.buffer;
-	info.bufferRange = sizeof(MaterialBufferObject);
-	info.bufferOffset = material->gpuInfo.bufferOffset;
+	material_table_writes.resize(swapchain.getSwapchainSize());
+	resize_material_table(BINDLESS_MATERIAL_COUNT);
 
-	collection->addBuffer(info, material->gpuInfo.setIndex);
+	// slot 0, what materials without a texture point at. slots past the last written are never read.
+	uninitalized_image.change_layout(vk::ImageLayout::eShaderReadOnlyOptimal, p_device->get_graphics_queue());
+	get_texture_slot(nullptr);
 
-	// TODO : will cause pipeline warning (errors?) if we do not bind an image even for materials that do not access it.
-	//        use specialization constants to prevent compilation of shaders with unbound textures?
-	ImageDescription image_info{};
-	image_info.binding = 1;
-	image_info.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	image_info.image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	if (material->hasBaseTexture)
+	INFO("bindless materials: {} materials, {} texture slots", BINDLESS_MATERIAL_COUNT, bindless_texture_count);
+}
+
+uint32_t GraphicsImpl::get_texture_slot(br::Image* image)
+{
+	if (image == nullptr)
 	{
-		image_info.image = material->getBaseColorImage().get_api_image();
-		image_info.image_view = material->getBaseColorImage().get_api_image_view();
-		image_info.sampler = material->getBaseColorImage().get_sampler();
+		image = &uninitalized_image;
 	}
-	else
+
+	if (auto found = texture_slots.find(image); found != texture_slots.end())
 	{
-		uninitalized_image.change_layout(vk::ImageLayout::eShaderReadOnlyOptimal, p_device->get_transfer_queue());
-		image_info.image = uninitalized_image.get_api_image();
-		image_info.image_view = uninitalized_image.get_api_image_view();
-		image_info.sampler = uninitalized_image.get_sampler();
+		return found->second;
 	}
-	collection->addImage(image_info, material->gpuInfo.setIndex);
 
-	image_info.binding = 2;
-	image_info.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	image_info.image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	uint32_t slot = static_cast<uint32_t>(texture_slots.size());
+	if (slot >= bindless_texture_count)
+	{
+		WARN("texture table is full ({} slots), the texture is left out", bindless_texture_count);
+		return 0;
+	}
+
+	ResourceBinding binding{};
+	binding.binding = 1;
+	binding.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	binding.image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	binding.image.imageView = image->get_api_image_view();
+	binding.image.sampler = image->get_sampler();
+	graphics_pipelines[1].get_resource_collection(1)->write_element(bindless_set, slot, binding);
+
+	texture_slots.emplace(image, slot);
+	return slot;
+}
 
-	if (material->hasRoughnessTexture || material->hasMetallicTexture)
+void GraphicsImpl::write_material_table(Material* material)
+{
+	MaterialBufferObject matObj = material->convert();
+	matObj.textures.x = get_texture_slot(material->hasBaseTexture ? &material->getBaseColorImage() : nullptr);
+	bool has_roughness_metallic = material->hasRoughnessTexture || material->hasMetallicTexture;
+	matObj.textures.y = get_texture_slot(has_roughness_metallic ? &material->getRoughnessMetallicImage() : nullptr);
+	matObj.textures.z = get_texture_slot(material->hasSeparateMetallic ? &material->getMetallicTexture() : nullptr);
+
+	uint32_t index = material->gpuInfo.tableIndex;
+	material_data[index] = matObj;
+	for (std::vector<uint32_t>& writes : material_table_writes)
 	{
-		image_info.image = material->getRoughnessMetallicImage().get_api_image();
-		image_info.image_view = material->getRoughnessMetallicImage().get_api_image_view();
-		image_info.sampler = material->getRoughnessMetallicImage().get_sampler();
+		writes.push_back(index);
 	}
-	else
+}
+
+// MODIFIES: this
+// PURPOSE: moves the materials into a table of capacity materials per region. the old table may be
+// read by the frames in flight and the recorded command buffers push indices into its regions, so
+// the device is waited for and the command buffers are recorded again. only happens when the table
+// is full, doubling each time.
+void GraphicsImpl::resize_material_table(uint32_t capacity)
+{
+	if (material_table_capacity > 0)
 	{
-		uninitalized_image.change_layout(vk::ImageLayout::eShaderReadOnlyOptimal, p_device->get_transfer_queue());
-		image_info.image = uninitalized_image.get_api_image();
-		image_info.image_view = uninitalized_image.get_api_image_view();
-		image_info.sampler = uninitalized_image.get_sampler();
+		vkDeviceWaitIdle(p_device->get());
+		material_table.destroy();
 	}
-	collection->addImage(image_info, material->gpuInfo.setIndex);
+	material_table_capacity = capacity;
+	material_data.resize(capacity);
 
-	image_info.binding = 3;
-	image_info.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	image_info.image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	uint32_t region_count = static_cast<uint32_t>(material_table_writes.size());
+	VkDeviceSize region_size = capacity * sizeof(MaterialBufferObject);
+	mem::BufferCreateInfo buffer_info{};
+	buffer_info.size = region_size * region_count;
+	buffer_info.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+	buffer_info.sharing_mode = vk::SharingMode::eExclusive;
+	buffer_info.queue_family_index_count = 1;
+	buffer_info.p_queue_family_indices = &p_device->get_graphics_family();
+	buffer_info.memory_properties = vk::MemoryPropertyFlagBits::eHostVisible |
+		vk::MemoryPropertyFlagBits::eHostCoherent;
+	buffer_info.category = mem::MemoryCategory::Uniform;
+	buffer_info.name = "material table";
+	material_table.init(*p_physical_device, *p_device, buffer_info);
 
-	if (material->hasSeparateMetallic)
+	// nothing reads the new table yet, every region gets every material right away.
+	for (uint32_t r = 0; r < region_count; r++)
 	{
-		image_info.image = material->getMetallicTexture().get_api_image();
-		image_info.image_view = material->getMetallicTexture().get_api_image_view();
-		image_info.sampler = material->getMetallicTexture().get_sampler();
+		material_table.map(region_size, r * region_size, material_data.data());
+		material_table_writes[r].clear();
 	}
-	else
+
+	ResourceBinding table{};
+	table.binding = 0;
+	table.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	table.buffer.buffer = material_table.get();
+	table.buffer.offset = 0;
+	table.buffer.range = VK_WHOLE_SIZE;
+	graphics_pipelines[1].get_resource_collection(1)->write_element(bindless_set, 0, table);
+	update_command_buffers = true;
+}
+
+// REQUIRES: the last submission reading image_index's region has finished.
+// MODIFIES: this
+// PURPOSE: copies the materials written since image_index was last drawn into its region.
+void GraphicsImpl::flush_material_table(uint32_t image_index)
+{
+	if (!bindless_materials)
+		return;
+
+	VkDeviceSize region_offset = image_index * material_table_capacity * sizeof(MaterialBufferObject);
+	for (uint32_t index : material_table_writes[image_index])
 	{
-		uninitalized_image.change_layout(vk::ImageLayout::eShaderReadOnlyOptimal, p_device->get_transfer_queue());
-		image_info.image = uninitalized_image.get_api_image();
-		image_info.image_view = uninitalized_image.get_api_image_view();
-		image_info.sampler = uninitalized_image.get_sampler();
+		material_table.map(sizeof(MaterialBufferObject), region_offset + index * sizeof(MaterialBufferObject),
+			&material_data[index]);
+	}
+	material_table_writes[image_index].clear();
+}
+
+void GraphicsImpl::writeMaterial(Material* material)
+{
+	if (bindless_materials)
+	{
+		write_material_table(material);
+		return;
 	}
-	collection->addImage(image_info, material->gpuInfo.setIndex);
 
-	collection->updateSet(material->gpuInfo.setIndex);
+	// material.offsets.descriptorOffset = globalMaterialOffsets.descriptorOffset;
+	// update_materials(material.offsets.bufferOffset, material);
+	MaterialBufferObject matObj = material->convert();
+	updateUniformBuffer(material->gpuInfo.bufferOffset,
+						sizeof(MaterialBufferObject), &matObj);
+
+	ResourceCollection* collection = graphics_pipelines[1].get_resource_collection(1);
+
+	std::vector<ResourceBinding> bindings(4);
+	bindings[0].binding = 0;
+	bindings[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	bindings[0].buffer.buffer = uniform_buffer.get_buffer(material->gpuInfo.bufferOffset);
+	bindings[0].buffer.offset = uniform_buffer.get_offset(material->gpuInfo.bufferOffset);
+	bindings[0].buffer.range = sizeof(MaterialBufferObject);
 
+	// TODO : will cause pipeline warning (errors?) if we do not bind an image even for materials that do not access it.
+	//        use specialization constants to prevent compilation of shaders with unbound textures?
+	auto bind_image = [&](ResourceBinding& binding, uint32_t index, bool has_image, br::Image* image)
+	{
+		if (!has_image)
+		{
+			uninitalized_image.change_layout(vk::ImageLayout::eShaderReadOnlyOptimal, p_device->get_graphics_queue());
+			image = &uninitalized_image;
+		}
+		binding.binding = index;
+		binding.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		binding.image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		binding.image.imageView = image->get_api_image_view();
+		binding.image.sampler = image->get_sampler();
+	};
+	bind_image(bindings[1], 1, material->hasBaseTexture,
+		material->hasBaseTexture ? &material->getBaseColorImage() : nullptr);
+	bool has_roughness_metallic = material->hasRoughnessTexture || material->hasMetallicTexture;
+	bind_image(bindings[2], 2, has_roughness_metallic,
+		has_roughness_metallic ? &material->getRoughnessMetallicImage() : nullptr);
+	bind_image(bindings[3], 3, material->hasSeparateMetallic,
+		material->hasSeparateMetallic ? &material->getMetallicTexture() : nullptr);
+
+	// writing a material again hands back the set it already has (its bindings are the same unless a
+	// texture changed), the old set is only given up after the new one is taken.
+	uint32_t previous = material->gpuInfo.setIndex;
+	material->gpuInfo.setIndex = collection->acquire_set(bindings, *matPool);
+	if (previous != UINT32_MAX)
+	{
+		collection->release_set(previous, *matPool);
+	}
 }
 
 uint32_t GraphicsImpl::add_material()
 {
 	materials.push_back(std::make_unique<Material>());
-	return materials.size() - 1;
+	uint32_t index = static_cast<uint32_t>(materials.size() - 1);
+	if (bindless_materials)
+	{
+		if (index >= material_table_capacity)
+		{
+			INFO("material table is full ({} materials), doubling it", material_table_capacity);
+			resize_material_table(material_table_capacity * 2);
+		}
+		materials.back()->gpuInfo.tableIndex = index;
+		return index;
+	}
+
+	materials.back()->gpuInfo.bufferOffset = uniform_buffer.allocate(sizeof(MaterialBufferObject),
+		v::Limits::get().uniformBufferOffsetAlignment);
+	return index;
+}
+
+uint32_t GraphicsImpl::find_material(const Model& model, const MaterialDescription& description)
+{
+	// materials are the same if their factors and the textures they sample are.
+	uint64_t texture_keys[2] = {};
+	if (description.base_color_image >= 0)
+		texture_keys[0] = model.model_images[description.base_color_image].key;
+	if (description.metallic_roughness_image >= 0)
+		texture_keys[1] = model.model_images[description.metallic_roughness_image].key;
+
+	uint64_t key = br::hash_bytes(&description.base_color, sizeof(glm::vec4) + 2 * sizeof(float));
+	key ^= br::hash_bytes(texture_keys, sizeof(texture_keys)) * 0x100000001B3ull;
+
+	auto found = material_lookup.find(key);
+	if (found != material_lookup.end())
+		return found->second;
+
+	uint32_t index = add_material();
+	Material* material = materials[index].get();
+	material->albedo = glm::vec3(description.base_color);
+	material->roughness = description.roughness;
+	material->metallic = description.metallic;
+	if (description.base_color_image >= 0)
+		material->setBaseColorImage(texture_cache.load_image(model.model_images[description.base_color_image]));
+	if (description.metallic_roughness_image >= 0)
+	{
+		// metallic and roughness are linear values, not colour.
+		material->setRoughnessMetallicImage(texture_cache.load_image(
+			model.model_images[description.metallic_roughness_image], br::ImageFormat::RGBA_LINEAR));
+	}
+
+	writeMaterial(material);
+	material_lookup.emplace(key, index);
+	return index;
+}
+
+void GraphicsImpl::register_materials(GameObject& object)
+{
+	const Model& model = object.object_model;
+
+	object.primitive_materials.resize(model.primitives.size());
+	for (size_t p = 0; p < model.primitives.size(); p++)
+	{
+		int mat_index = model.primitives[p].mat_index;
+		object.primitive_materials[p] = mat_index < 0
+			? object.material_index
+			: find_material(model, model.model_materials[mat_index]);
+	}
 }
 
 uint32_t GraphicsImpl::add_draw_data(br::GPUResource* resource)
@@ -1355,6 +1703,9 @@ void GraphicsImpl::create_command_buffers(
 		auto begin_info = vk::CommandBufferBeginInfo(beginInfo);
 		command_buffers[i].begin(begin_info);
 
+		record_cluster_cull(i);
+		record_skinning(i);
+
 		LightObject light{};
 		light.position = light_data[0].position;
 		light.direction = light_data[0].target;
@@ -1366,7 +1717,8 @@ void GraphicsImpl::create_command_buffers(
 
 		auto render_area = vk::Rect2D(vk::Offset2D(0, 0), swapchain.get_extent());
 
-		std::vector<VkClearValue> clear_values;
+		mem::FrameVector<VkClearValue> clear_values(frame_arena);
+		clear_values.reserve(2);
 
 		VkClearValue color_clear{};
 		color_clear.color.float32[0] = 0.f;
@@ -1404,6 +1756,9 @@ void GraphicsImpl::create_command_buffers(
 
 		command_buffers[i].setScissor(0, 1, &scissor);
 
+		// this image's region of the uniform ring, for every set using it.
+		uint32_t ring_offset = uniform_ring.get_dynamic_offset(static_cast<uint32_t>(i));
+
 		const VkDeviceSize offset[] = { 0, offsetof(Vertex, normal),
 									   offsetof(Vertex, tex_coord) };
 
@@ -1426,9 +1781,9 @@ void GraphicsImpl::create_command_buffers(
 		for (size_t k = 0; k < skybox.object_model.primitives.size(); k++)
 		{
 
-			Primitive prim = skybox.object_model.primitives[k];
+			const Primitive& prim = skybox.object_model.primitives[k];
 
-			vkCmdBindDescriptorSets(command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.get_api_layout(), 0, 1, &skybox_scene_set, 0, nullptr);
+			vkCmdBindDescriptorSets(command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.get_api_layout(), 0, 1, &skybox_scene_set, 1, &ring_offset);
 
 			vkCmdDrawIndexed(
 				command_buffers[i], prim.index_count, 1,
@@ -1461,6 +1816,7 @@ void GraphicsImpl::create_command_buffers(
 
 		vkCmdBindIndexBuffer(command_buffers[i], index_buffer.buffer, 0,
 							 VK_INDEX_TYPE_UINT32);
+		VkIndexType bound_index_type = VK_INDEX_TYPE_UINT32;
 
 		auto index = 1;
 		vkCmdBindPipeline(command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -1475,78 +1831,159 @@ void GraphicsImpl::create_command_buffers(
 						   VK_SHADER_STAGE_VERTEX_BIT, sizeof(light),
 						   sizeof(glm::vec4), &camera_pos);
 
-		// draw first object (cube)
-		auto index_offset = uint32_t(0);
-		auto vertex_offset = uint32_t(0);
-
-		std::vector<TransparentMesh> transparent_meshes;
-
+		// every primitive of the uploaded objects, grouped by material so each
+		// material's set is bound once and the objects sharing it draw back to back.
+		struct ForwardDraw
+		{
+			uint32_t material;
+			uint32_t object;
+			uint32_t primitive;
+		};
+		size_t draw_count = 0;
+		for (const auto& object : game_objects)
+			draw_count += object->update ? 0 : object->primitive_draws.size();
+		mem::FrameVector<ForwardDraw> forward_draws(frame_arena);
+		forward_draws.reserve(draw_count);
 		for (size_t j = 0; j < game_objects.size(); j++)
 		{
-// auto total_vertices = uint32_t(0);
-// i actually think this update this is ill-thought out...
-			if (!game_objects[j]->update)
+			// i actually think this update this is ill-thought out...
+			if (game_objects[j]->update)
+				continue;
+
+			// primitive_draws is either parallel to the model primitives or empty (nothing uploaded).
+			const GameObject& object = *game_objects[j];
+			// the transform table was full when it was uploaded.
+			if (object.transform_start == UINT32_MAX)
+				continue;
+			for (size_t k = 0; k < object.primitive_draws.size(); k++)
 			{
-				auto model_primitive_count =
-					game_objects[j]->object_model.primitives.size();
-
-				vkCmdBindPipeline(command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
-								  graphics_pipelines[index].get_api_pipeline());
-
-				Material* mat = game_objects[j]->get_material();
-				VkDescriptorSet materialSet =
-					graphics_pipelines[1].get_resource_collection(1)->get_api_set(mat->gpuInfo.setIndex);
-
-				ResourceCollection* scene_collection = graphics_pipelines[1].get_resource_collection(2);
-				VkDescriptorSet sceneSet = scene_collection->get_api_set(scene->get_index(scene_collection));
+				uint32_t material = k < object.primitive_materials.size()
+					? object.primitive_materials[k]
+					: object.material_index;
+				forward_draws.push_back({ material, static_cast<uint32_t>(j), static_cast<uint32_t>(k) });
+			}
+		}
+		std::sort(forward_draws.begin(), forward_draws.end(),
+			[](const ForwardDraw& a, const ForwardDraw& b)
+			{
+				if (a.material != b.material)
+					return a.material < b.material;
+				if (a.object != b.object)
+					return a.object < b.object;
+				return a.primitive < b.primitive;
+			});
+
+		auto layout = graphics_pipelines[index].get_api_layout();
+
+		ResourceCollection* scene_collection = graphics_pipelines[index].get_resource_collection(2);
+		VkDescriptorSet sceneSet = scene_collection->get_api_set(scene->get_index(scene_collection));
+		vkCmdBindDescriptorSets(command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 2, 1,
+			&sceneSet, 1, &ring_offset);
+
+		// every node's transform is in the one set, draws only push which slot they use.
+		VkDescriptorSet transformSet =
+			graphics_pipelines[index].get_resource_collection(0)->get_api_set(transform_set);
+		vkCmdBindDescriptorSets(command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1,
+			&transformSet, 1, &ring_offset);
+
+		ResourceCollection* material_collection = graphics_pipelines[index].get_resource_collection(1);
+		if (bindless_materials)
+		{
+			// every material and texture is in the one set, draws only push which material they use.
+			VkDescriptorSet tableSet = material_collection->get_api_set(bindless_set);
+			vkCmdBindDescriptorSets(command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1, 1,
+				&tableSet, 0, nullptr);
+		}
+		uint32_t bound_material = UINT32_MAX;
+		uint32_t bound_transform = UINT32_MAX;
+		bool bound_skinned = false;
+		for (const ForwardDraw& forward_draw : forward_draws)
+		{
+			GameObject& object = *game_objects[forward_draw.object];
+			const Primitive& prim = object.object_model.primitives[forward_draw.primitive];
 
-				for (size_t k = 0; k < model_primitive_count; k++)
+			if (forward_draw.material != bound_material)
+			{
+				if (bindless_materials)
 				{
+					// the material in this image's region of the table.
+					uint32_t table_index = static_cast<uint32_t>(i) * material_table_capacity +
+						materials[forward_draw.material]->gpuInfo.tableIndex;
+					vkCmdPushConstants(command_buffers[i], layout, VK_SHADER_STAGE_FRAGMENT_BIT,
+						sizeof(light) + sizeof(glm::vec4) + sizeof(uint32_t), sizeof(uint32_t), &table_index);
+				}
+				else
+				{
+					VkDescriptorSet materialSet =
+						material_collection->get_api_set(materials[forward_draw.material]->gpuInfo.setIndex);
+					vkCmdBindDescriptorSets(command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1, 1,
+						&materialSet, 0, nullptr);
+				}
+				bound_material = forward_draw.material;
+			}
 
-					Primitive prim = game_objects[j]->object_model.primitives[k];
-
-					auto descriptor_1 = std::vector<VkDescriptorSet>();
-					auto descriptor_2 = std::vector<VkDescriptorSet>();
-					auto descriptors = std::vector<std::vector<VkDescriptorSet>>();
-
-					descriptor_1.resize(3);
-					descriptor_2.resize(3);
-
-					//descriptor_1[0] = light_ubo[j].get_api_set(prim.transform_index);
-					descriptor_1[1] = uboSets[j][prim.transform_index];
-					//descriptor_1[3] = shadowmap_set;
-					// TODO: currently we update all our descriptor sets once at the
-					// beginning of the frame. however, if we want to have per-material
-					// descriptors, then we need to update more frequently (whenever the
-					// material changes).
-					descriptor_1[2] = materialSet;
-
-					descriptor_2[0] = descriptor_1[1];
-					descriptor_2[1] = descriptor_1[2];
-					descriptor_2[2] = sceneSet;
-
-					auto layout = graphics_pipelines[index].get_api_layout();
+			uint32_t transform = object.transform_start + prim.transform_index;
+			if (transform != bound_transform)
+			{
+				vkCmdPushConstants(command_buffers[i], layout, VK_SHADER_STAGE_VERTEX_BIT,
+					sizeof(light) + sizeof(glm::vec4), sizeof(uint32_t), &transform);
+				bound_transform = transform;
+			}
 
-					descriptors.push_back(descriptor_1);
-					descriptors.push_back(descriptor_2);
+			// skinned objects read this image's skinned vertices, laid out like
+			// their range of vertex_buffer.
+			bool skinned = object.skinned_vertex_start != UINT32_MAX;
+			int32_t skinned_offset = 0;
+			if (skinned != bound_skinned)
+			{
+				if (skinned)
+					command_buffers[i].bindVertexBuffers(0, 1, &skinned_vertex_buffers[i].get(), offset);
+				else
+					command_buffers[i].bindVertexBuffers(0, 1, &vertex_buffer.buffer, offset);
+				bound_skinned = skinned;
+			}
+			if (skinned)
+			{
+				skinned_offset = static_cast<int32_t>(object.skinned_vertex_start) -
+					static_cast<int32_t>(object.buffer_vertex_offset);
+			}
 
-					vkCmdBindDescriptorSets(
-						command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0,
-						descriptors[index].size(), descriptors[index].data(), 0, nullptr);
+			const PrimitiveDraw& draw = object.primitive_draws[forward_draw.primitive];
+			if (draw.index_type != bound_index_type)
+			{
+				vkCmdBindIndexBuffer(command_buffers[i], index_buffer.buffer, 0, draw.index_type);
+				bound_index_type = draw.index_type;
+			}
 
-					vkCmdDrawIndexed(
-						command_buffers[i], prim.index_count, 1,
-						prim.index_start + game_objects[j]->buffer_index_offset,
-						game_objects[j]->buffer_vertex_offset, // indices refer to all vertices in model, then no
-									   // vertex offsets are required.
-						static_cast<uint32_t>(0));
+			if (cluster_cull_mode != ClusterCullMode::Off && draw.lod == 0 &&
+				draw.command_slot != UINT32_MAX)
+			{
+				// the commands are rewritten every frame, unused slots have no indices.
+				VkDeviceSize command_offset = draw.command_slot * sizeof(VkDrawIndexedIndirectCommand);
+				if (p_device->supports_multi_draw_indirect())
+				{
+					vkCmdDrawIndexedIndirect(command_buffers[i], cluster_command_buffers[i].get(),
+											 command_offset, draw.cluster_count,
+											 sizeof(VkDrawIndexedIndirectCommand));
+				}
+				else
+				{
+					for (uint32_t c = 0; c < draw.cluster_count; c++)
+					{
+						vkCmdDrawIndexedIndirect(command_buffers[i], cluster_command_buffers[i].get(),
+												 command_offset + c * sizeof(VkDrawIndexedIndirectCommand),
+												 1, sizeof(VkDrawIndexedIndirectCommand));
+					}
 				}
 			}
-
-			index_offset += static_cast<uint32_t>(
-				game_objects[j]->object_model.model_indices.size());
-			vertex_offset += static_cast<uint32_t>(
-				game_objects[j]->object_model.model_vertices.size());
+			else
+			{
+				vkCmdDrawIndexed(
+					command_buffers[i], draw.index_count, 1,
+					draw.first_index,
+					draw.vertex_offset + skinned_offset,
+					static_cast<uint32_t>(0));
+			}
 		}
 		vkCmdEndRenderPass(command_buffers[i]);
 
@@ -1700,43 +2137,67 @@ void GraphicsImpl::render_to_screen(size_t i, vk::CommandBuffer command_buffer)
 void GraphicsImpl::create_uniform_buffer()
 {
 	mem::BufferCreateInfo buffer_info{};
-	buffer_info.size = (VkDeviceSize)BUFFER_SIZE;
+	buffer_info.size = (VkDeviceSize)UNIFORM_BLOCK_SIZE;
 	buffer_info.usage = vk::BufferUsageFlagBits::eUniformBuffer;
 	buffer_info.sharing_mode = vk::SharingMode::eExclusive;
 	buffer_info.queue_family_index_count = 1;
 	buffer_info.p_queue_family_indices = &p_device->get_graphics_family();
 	buffer_info.memory_properties = vk::MemoryPropertyFlagBits::eHostVisible |
 		vk::MemoryPropertyFlagBits::eHostCoherent;
+	buffer_info.category = mem::MemoryCategory::Uniform;
+	buffer_info.name = "uniform buffer";
 
 	uniform_buffer.init(*p_physical_device, *p_device, buffer_info);
 }
 
+void GraphicsImpl::create_uniform_ring()
+{
+	uniform_ring.init(*p_physical_device, *p_device, UNIFORM_RING_REGION_SIZE,
+		swapchain.getSwapchainSize());
+}
+
+void GraphicsImpl::create_staging_ring()
+{
+	staging_ring.init(*p_physical_device, *p_device, STAGING_RING_SIZE, STAGING_FRAME_BUDGET);
+}
+
+void GraphicsImpl::create_frame_arena()
+{
+	frame_arena.init(FRAME_ARENA_BLOCK_SIZE, MAX_FRAMES_IN_FLIGHT);
+}
+
 void GraphicsImpl::create_vertex_buffer()
 {
 	mem::BufferCreateInfo buffer_info{};
-	buffer_info.size = (VkDeviceSize)BUFFER_SIZE;
+	buffer_info.size = (VkDeviceSize)GEOMETRY_BUFFER_SIZE;
 	buffer_info.usage = vk::BufferUsageFlagBits::eVertexBuffer |
 		vk::BufferUsageFlagBits::eTransferDst;
 	buffer_info.sharing_mode = vk::SharingMode::eExclusive;
 	buffer_info.queue_family_index_count = 1;
 	buffer_info.p_queue_family_indices = &p_device->get_graphics_family();
 	buffer_info.memory_properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+	buffer_info.category = mem::MemoryCategory::Geometry;
+	buffer_info.name = "vertex buffer";
 
 	vertex_buffer.init(*p_physical_device, *p_device, buffer_info);
+	vertex_buffer.set_staging(&staging_ring);
 }
 
 void GraphicsImpl::create_index_buffer()
 {
 	mem::BufferCreateInfo buffer_info{};
-	buffer_info.size = (VkDeviceSize)BUFFER_SIZE;
+	buffer_info.size = (VkDeviceSize)GEOMETRY_BUFFER_SIZE;
 	buffer_info.usage = vk::BufferUsageFlagBits::eIndexBuffer |
 		vk::BufferUsageFlagBits::eTransferDst;
 	buffer_info.sharing_mode = vk::SharingMode::eExclusive;
 	buffer_info.queue_family_index_count = 1;
 	buffer_info.p_queue_family_indices = &p_device->get_graphics_family();
 	buffer_info.memory_properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+	buffer_info.category = mem::MemoryCategory::Geometry;
+	buffer_info.name = "index buffer";
 
 	index_buffer.init(*p_physical_device, *p_device, buffer_info);
+	index_buffer.set_staging(&staging_ring);
 }
 
 // REQUIRES: indices_data is a list of indices corresponding
@@ -1745,14 +2206,14 @@ void GraphicsImpl::create_index_buffer()
 // EFFECTS: allocates memory and maps indices_data to index buffer,
 //          returns location in memory as int or '-1' if
 //          new data was mapped.
-int32_t GraphicsImpl::update_index_buffer(std::vector<uint32_t> indices_data)
+int32_t GraphicsImpl::update_index_buffer(const std::vector<uint32_t>& indices_data)
 {
 	if (check_data(indices_data.size() * sizeof(uint32_t)))
 	{
 		return -1;
 	}
 	uint32_t mem_location = index_buffer.map(
-		indices_data.size() * sizeof(uint32_t), indices_data.data());
+		indices_data.size() * sizeof(uint32_t), indices_data.data(), sizeof(uint32_t));
 
 	return mem_location;
 }
@@ -1770,44 +2231,1173 @@ bool GraphicsImpl::check_data(size_t data_size)
 }
 
 // MODIFIES: this
-// PURPOSE: adds given vertex_data to vertex buffer
+// PURPOSE: packs vertex_data with StandardVertexLayout and adds it to vertex buffer
 // RETURNS: memory location of where data was added or '-1' if no new data was
-// mapped
-int32_t GraphicsImpl::update_vertex_buffer(std::vector<Vertex> vertex_data)
+// mapped, the location is always a multiple of StandardVertexLayout::stride.
+int32_t GraphicsImpl::update_vertex_buffer(const std::vector<Vertex>& vertex_data)
 {
 	if (check_data(vertex_data.size() * sizeof(Vertex)))
 		return -1;
 
-	uint32_t mem_location = vertex_buffer.map(vertex_data.size() * sizeof(Vertex),
-											  vertex_data.data());
+	std::vector<unsigned char> packed(vertex_data.size() * StandardVertexLayout::stride);
+	StandardVertexLayout::pack(vertex_data.data(), vertex_data.size(), VertexQuantization{}, packed.data());
+
+	uint32_t mem_location = vertex_buffer.map(packed.size(), packed.data(),
+											  StandardVertexLayout::stride);
 	return mem_location;
 }
 
-void GraphicsImpl::copy_buffer(mem::Memory src_buffer, mem::Memory dst_buffer,
-							   VkDeviceSize dst_offset,
-							   VkDeviceSize data_size)
-{
-	auto transfer_buffer = begin_command_buffer(*p_device, command_pool);
+// MODIFIES: this, object
+// PURPOSE: packs the object's model with MeshVertexLayout and uploads it. every
+// primitive gets 16 bit indices when the vertices it references span less than
+// 65536 entries, the draw info for each primitive is stored in object.primitive_draws.
+// the levels of detail of a primitive are written right after it, they only use
+// vertices level 0 uses so they share its vertex offset and index type.
+// models built from the same source (same files with the same contents, the ones they reference
+// included) reuse the upload already in the buffers.
+void GraphicsImpl::upload_mesh(GameObject& object)
+{
+	const Model& model = object.object_model;
+	release_geometry(object);
+	release_clusters(object);
+	release_skinning(object);
+	release_transforms(object);
+	object.primitive_draws.clear();
+	object.cluster_bounds.clear();
+	object.dequantization = glm::mat4(1.0f);
+
+	if (check_data(model.model_vertices.size() * sizeof(Vertex)) ||
+		check_data(model.model_indices.size() * sizeof(uint32_t)))
+		return;
 
-	// transfer between buffers
-	VkBufferCopy copyData{};
-	copyData.srcOffset = 0;
-	copyData.dstOffset = dst_offset;
-	copyData.size = data_size;
+	GeometryKey key{ model.source_path, model.source_hash };
+	if (std::optional<uint32_t> shared = geometry_registry.acquire(key))
+	{
+		const SharedGeometry& geometry = geometry_registry.get(*shared);
+		object.geometry_id = *shared;
+		object.primitive_draws = geometry.primitive_draws;
+		object.dequantization = geometry.dequantization;
+		object.buffer_vertex_offset = geometry.buffer_vertex_offset;
+		object.buffer_index_offset = geometry.buffer_index_offset;
 
-	vkCmdCopyBuffer(transfer_buffer, src_buffer.buffer, dst_buffer.buffer, 1,
-					&copyData);
+		register_clusters(object);
+		register_skinning(object);
 
-	// destroy transfer buffer, shouldnt need it after copying the data.
-	end_command_buffer(*p_device, p_device->get_graphics_queue(), command_pool,
-					   transfer_buffer);
-}
+		upload_stats.shared++;
+		return;
+	}
 
-void GraphicsImpl::update_light_buffer(VkDeviceSize memory_offset,
-									   LightBufferObject lbo)
-{
-	uniform_buffer.writeLocal(p_device->get(), memory_offset, sizeof(lbo), &lbo);
-}
+	VertexQuantization quantization{};
+	if (MeshVertexLayout::quantized)
+	{
+		quantization = VertexQuantization::from_bounds(model.model_vertices.data(), model.model_vertices.size());
+		object.dequantization = quantization.get_dequantization();
+	}
+
+	std::vector<unsigned char> packed_vertices(model.model_vertices.size() * MeshVertexLayout::stride);
+	MeshVertexLayout::pack(model.model_vertices.data(), model.model_vertices.size(), quantization,
+						   packed_vertices.data());
+
+	// the buffers may move the ranges while compacting, see relocate_geometry.
+	VkDeviceSize vertex_location = vertex_buffer.map(packed_vertices.size(), packed_vertices.data(),
+													 MeshVertexLayout::stride, true);
+	int32_t vertex_base = static_cast<int32_t>(vertex_location / MeshVertexLayout::stride);
+
+	// every primitive starts on a 4 byte boundary so it can be addressed with either index type.
+	std::vector<unsigned char> packed_indices;
+	uint32_t narrow_primitives = 0;
+	for (const Primitive& prim : model.primitives)
+	{
+		auto begin = model.model_indices.begin() + prim.index_start;
+		auto end = begin + prim.index_count;
+		uint32_t min_index = prim.index_count > 0 ? *std::min_element(begin, end) : 0;
+		uint32_t max_index = prim.index_count > 0 ? *std::max_element(begin, end) : 0;
+
+		PrimitiveDraw draw{};
+		draw.vertex_offset = vertex_base + static_cast<int32_t>(min_index);
+		draw.index_type = max_index - min_index <= UINT16_MAX ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+		if (prim.index_count > 0)
+		{
+			glm::vec3 bounds_min = glm::vec3(model.model_vertices[*begin].position);
+			glm::vec3 bounds_max = bounds_min;
+			for (auto it = begin; it != end; ++it)
+			{
+				glm::vec3 position = glm::vec3(model.model_vertices[*it].position);
+				bounds_min = glm::min(bounds_min, position);
+				bounds_max = glm::max(bounds_max, position);
+			}
+			draw.center = (bounds_min + bounds_max) * 0.5f;
+			draw.radius = glm::length(bounds_max - bounds_min) * 0.5f;
+		}
+
+		size_t index_size = draw.index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+		size_t start = (packed_indices.size() + 3) & ~size_t(3);
+		packed_indices.resize(start);
+
+		draw.lod_count = 1 + prim.lod_count;
+		for (uint32_t l = 0; l < draw.lod_count; l++)
+		{
+			uint32_t source_start = l == 0 ? prim.index_start : prim.lods[l - 1].index_start;
+			uint32_t source_count = l == 0 ? prim.index_count : prim.lods[l - 1].index_count;
+
+			DrawLod& lod = draw.lods[l];
+			lod.first_index = static_cast<uint32_t>(packed_indices.size() / index_size);
+			lod.index_count = source_count;
+			lod.error = l == 0 ? 0.0f : prim.lods[l - 1].error;
+
+			size_t level_start = packed_indices.size();
+			packed_indices.resize(level_start + source_count * index_size);
+
+			unsigned char* out = packed_indices.data() + level_start;
+			for (uint32_t k = 0; k < source_count; k++)
+			{
+				uint32_t local = model.model_indices[source_start + k] - min_index;
+				if (draw.index_type == VK_INDEX_TYPE_UINT16)
+				{
+					uint16_t narrow = static_cast<uint16_t>(local);
+					memcpy(out + k * sizeof(uint16_t), &narrow, sizeof(uint16_t));
+				}
+				else
+				{
+					memcpy(out + k * sizeof(uint32_t), &local, sizeof(uint32_t));
+				}
+			}
+		}
+
+		draw.lod = 0;
+		draw.first_index = draw.lods[0].first_index;
+		draw.index_count = draw.lods[0].index_count;
+
+		narrow_primitives += draw.index_type == VK_INDEX_TYPE_UINT16 ? 1 : 0;
+		object.primitive_draws.push_back(draw);
+	}
+
+	VkDeviceSize index_location = index_buffer.map(packed_indices.size(), packed_indices.data(),
+												   sizeof(uint32_t), true);
+	for (PrimitiveDraw& draw : object.primitive_draws)
+	{
+		size_t index_size = draw.index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+		draw.first_index += static_cast<uint32_t>(index_location / index_size);
+		for (uint32_t l = 0; l < draw.lod_count; l++)
+		{
+			draw.lods[l].first_index += static_cast<uint32_t>(index_location / index_size);
+		}
+	}
+
+	object.buffer_vertex_offset = static_cast<uint32_t>(vertex_base);
+	object.buffer_index_offset = static_cast<uint32_t>(index_location / sizeof(uint32_t));
+
+	SharedGeometry geometry{};
+	geometry.vertex_location = vertex_location;
+	geometry.index_location = index_location;
+	geometry.buffer_vertex_offset = object.buffer_vertex_offset;
+	geometry.buffer_index_offset = object.buffer_index_offset;
+	geometry.dequantization = object.dequantization;
+	geometry.primitive_draws = object.primitive_draws;
+	geometry.vertex_bytes = packed_vertices.size();
+	geometry.index_bytes = packed_indices.size();
+	object.geometry_id = geometry_registry.add(key, std::move(geometry));
+
+	register_clusters(object);
+	register_skinning(object);
+
+	upload_stats.meshes++;
+	upload_stats.vertices += model.model_vertices.size();
+	upload_stats.vertex_bytes += packed_vertices.size();
+	upload_stats.cpu_vertex_bytes += model.model_vertices.size() * sizeof(Vertex);
+	upload_stats.index_bytes += packed_indices.size();
+	upload_stats.primitives += static_cast<uint32_t>(model.primitives.size());
+	upload_stats.narrow_primitives += narrow_primitives;
+}
+
+// MODIFIES: this, object
+// PURPOSE: drops the object's reference to its uploaded geometry, the vertex and
+// index ranges are handed back once no other object uses them.
+void GraphicsImpl::release_geometry(GameObject& object)
+{
+	if (object.geometry_id == UINT32_MAX)
+		return;
+
+	SharedGeometry released;
+	if (geometry_registry.release(object.geometry_id, released))
+	{
+		// the buffers hold on to the ranges until the frames in flight that
+		// could still be drawing them are done.
+		vertex_buffer.free(released.vertex_location);
+		index_buffer.free(released.index_location);
+	}
+	object.geometry_id = UINT32_MAX;
+}
+
+// MODIFIES: this, object
+// PURPOSE: releases the geometry, cluster ranges, skinning ranges and transform slots of an object
+// that is about to be destroyed. the command buffers are recorded again, they refer to objects by
+// index.
+void GraphicsImpl::release_object(GameObject& object)
+{
+	release_geometry(object);
+	release_clusters(object);
+	release_skinning(object);
+	release_transforms(object);
+	object.primitive_draws.clear();
+	object.cluster_bounds.clear();
+	update_command_buffers = true;
+}
+
+// MODIFIES: this, game_objects
+// PURPOSE: points the geometry the buffers moved while compacting at its new
+// ranges. a move keeps the alignment the range was mapped with, so vertices
+// shift by whole strides and indices by whole 32 bit words. the old ranges stay
+// readable for the frames already recorded, the new ones are drawn from once the
+// command buffers are recorded again.
+void GraphicsImpl::relocate_geometry(std::vector<std::unique_ptr<GameObject>>& game_objects)
+{
+	std::vector<mem::Relocation> vertex_moves = vertex_buffer.take_relocations();
+	std::vector<mem::Relocation> index_moves = index_buffer.take_relocations();
+	if (vertex_moves.empty() && index_moves.empty())
+		return;
+
+	auto shift_vertices = [](std::vector<PrimitiveDraw>& draws, int32_t vertices)
+	{
+		for (PrimitiveDraw& draw : draws)
+			draw.vertex_offset += vertices;
+	};
+	auto shift_indices = [](std::vector<PrimitiveDraw>& draws, int64_t bytes)
+	{
+		for (PrimitiveDraw& draw : draws)
+		{
+			int64_t index_size = draw.index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+			draw.first_index = static_cast<uint32_t>(draw.first_index + bytes / index_size);
+			for (uint32_t l = 0; l < draw.lod_count; l++)
+				draw.lods[l].first_index = static_cast<uint32_t>(draw.lods[l].first_index + bytes / index_size);
+		}
+	};
+
+	// geometry id to how far its vertices (in vertices) and indices (in bytes) moved.
+	std::unordered_map<uint32_t, int32_t> vertex_shifts;
+	std::unordered_map<uint32_t, int64_t> index_shifts;
+	for (const mem::Relocation& move : vertex_moves)
+	{
+		std::optional<uint32_t> id = geometry_registry.find_vertices(move.from);
+		if (!id)
+		{
+			WARN("vertices moved from {} belong to no upload", move.from);
+			continue;
+		}
+
+		int32_t vertices = static_cast<int32_t>(
+			(static_cast<int64_t>(move.to) - static_cast<int64_t>(move.from)) /
+			static_cast<int64_t>(MeshVertexLayout::stride));
+		SharedGeometry& geometry = geometry_registry.get(*id);
+		geometry.vertex_location = move.to;
+		geometry.buffer_vertex_offset = static_cast<uint32_t>(geometry.buffer_vertex_offset + vertices);
+		shift_vertices(geometry.primitive_draws, vertices);
+		vertex_shifts[*id] += vertices;
+	}
+	for (const mem::Relocation& move : index_moves)
+	{
+		std::optional<uint32_t> id = geometry_registry.find_indices(move.from);
+		if (!id)
+		{
+			WARN("indices moved from {} belong to no upload", move.from);
+			continue;
+		}
+
+		int64_t bytes = static_cast<int64_t>(move.to) - static_cast<int64_t>(move.from);
+		SharedGeometry& geometry = geometry_registry.get(*id);
+		geometry.index_location = move.to;
+		geometry.buffer_index_offset = static_cast<uint32_t>(
+			geometry.buffer_index_offset + bytes / static_cast<int64_t>(sizeof(uint32_t)));
+		shift_indices(geometry.primitive_draws, bytes);
+		index_shifts[*id] += bytes;
+	}
+
+	for (auto& object : game_objects)
+	{
+		auto vertex_shift = vertex_shifts.find(object->geometry_id);
+		auto index_shift = index_shifts.find(object->geometry_id);
+		if (vertex_shift == vertex_shifts.end() && index_shift == index_shifts.end())
+			continue;
+
+		if (vertex_shift != vertex_shifts.end())
+		{
+			object->buffer_vertex_offset = static_cast<uint32_t>(object->buffer_vertex_offset + vertex_shift->second);
+			shift_vertices(object->primitive_draws, vertex_shift->second);
+		}
+		if (index_shift != index_shifts.end())
+		{
+			int64_t bytes = index_shift->second;
+			object->buffer_index_offset = static_cast<uint32_t>(
+				object->buffer_index_offset + bytes / static_cast<int64_t>(sizeof(uint32_t)));
+			shift_indices(object->primitive_draws, bytes);
+
+			for (const PrimitiveDraw& draw : object->primitive_draws)
+			{
+				int64_t index_size = draw.index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+				for (uint32_t m = 0; m < draw.cluster_count; m++)
+				{
+					uint32_t& first_index = object->cluster_bounds.first_index[draw.cluster_start + m];
+					first_index = static_cast<uint32_t>(first_index + bytes / index_size);
+				}
+			}
+		}
+
+		for (size_t k = 0; k < object->primitive_draws.size(); k++)
+		{
+			if (object->primitive_draws[k].command_slot != UINT32_MAX)
+				write_gpu_clusters(*object, k);
+		}
+	}
+
+	update_command_buffers = true;
+
+	// reported once the pass is done, see update_draw.
+	compaction_vertex_moves += vertex_moves.size();
+	compaction_index_moves += index_moves.size();
+}
+
+// MODIFIES: object
+// PURPOSE: projects the error of every level of detail onto the screen and keeps
+// the coarsest one that stays under LOD_PIXEL_ERROR. only the index range of the
+// draw changes, buffers and descriptors stay the same.
+bool GraphicsImpl::select_lods(GameObject& object)
+{
+	const Model& model = object.object_model;
+	glm::vec3 eye = glm::vec3(camera_pos);
+	// pixels covered by something one unit large, one unit away from the camera.
+	float pixels_per_unit = std::abs(camera_projection[1][1]) * 0.5f *
+		static_cast<float>(swapchain.get_extent().height);
+
+	bool changed = false;
+	for (size_t k = 0; k < object.primitive_draws.size(); k++)
+	{
+		PrimitiveDraw& draw = object.primitive_draws[k];
+		if (draw.lod_count <= 1)
+			continue;
+
+		glm::mat4 to_world = object.transform * model.nodes.get_world(model.primitives[k].transform_index);
+		float scale = std::max(glm::length(glm::vec3(to_world[0])),
+							   std::max(glm::length(glm::vec3(to_world[1])), glm::length(glm::vec3(to_world[2]))));
+		glm::vec3 center = glm::vec3(to_world * glm::vec4(draw.center, 1.0f));
+		// distance to the closest point of the bounds, clamped for when the camera is inside them.
+		float distance = std::max(glm::length(center - eye) - draw.radius * scale, 1e-3f);
+
+		auto get_pixel_error = [&](uint32_t lod) {
+			return draw.lods[lod].error * scale / distance * pixels_per_unit;
+		};
+
+		uint32_t lod = draw.lod;
+		while (lod > 0 && get_pixel_error(lod) > LOD_PIXEL_ERROR)
+			lod--;
+		while (lod + 1 < draw.lod_count &&
+			   get_pixel_error(lod + 1) <= LOD_PIXEL_ERROR * (1.0f - LOD_HYSTERESIS))
+			lod++;
+
+		if (lod != draw.lod)
+		{
+			draw.lod = lod;
+			draw.first_index = draw.lods[lod].first_index;
+			draw.index_count = draw.lods[lod].index_count;
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+void GraphicsImpl::set_cluster_cull_mode(ClusterCullMode mode)
+{
+	if (mode == cluster_cull_mode)
+		return;
+
+	cluster_cull_mode = mode;
+	update_command_buffers = true;
+}
+
+void GraphicsImpl::create_cluster_culling()
+{
+	uint32_t image_count = static_cast<uint32_t>(swapchain.getSwapchainSize());
+
+	// written by the cpu every frame and read by the gpu, small enough to live
+	// in host visible memory.
+	mem::BufferCreateInfo buffer_info{};
+	buffer_info.sharing_mode = vk::SharingMode::eExclusive;
+	buffer_info.queue_family_index_count = 1;
+	buffer_info.p_queue_family_indices = &p_device->get_graphics_family();
+	buffer_info.memory_properties = vk::MemoryPropertyFlagBits::eHostVisible |
+		vk::MemoryPropertyFlagBits::eHostCoherent;
+
+	cluster_command_buffers.resize(image_count);
+	cluster_job_buffers.resize(image_count);
+	for (uint32_t i = 0; i < image_count; i++)
+	{
+		buffer_info.size = MAX_CLUSTER_COMMANDS * sizeof(VkDrawIndexedIndirectCommand);
+		buffer_info.usage = vk::BufferUsageFlagBits::eIndirectBuffer |
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+		buffer_info.name = "cluster commands";
+		cluster_command_buffers[i].init(*p_physical_device, *p_device, buffer_info);
+
+		buffer_info.size = MAX_CLUSTER_JOBS * sizeof(GpuClusterJob);
+		buffer_info.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+		buffer_info.name = "cluster jobs";
+		cluster_job_buffers[i].init(*p_physical_device, *p_device, buffer_info);
+	}
+
+	buffer_info.size = MAX_CLUSTER_COMMANDS * sizeof(GpuCluster);
+	buffer_info.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+	buffer_info.category = mem::MemoryCategory::Geometry;
+	buffer_info.name = "gpu clusters";
+	gpu_cluster_buffer.init(*p_physical_device, *p_device, buffer_info);
+
+	VkPushConstantRange push_range{};
+	push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_range.offset = 0;
+	push_range.size = sizeof(uint32_t);
+
+	PipelineConfig config{};
+	config.compute_shader_path = SHADER_PATH + "cluster_cull.comp";
+	config.push_ranges = { push_range };
+
+	cluster_cull_pipeline.init(p_device, set_pool, config);
+
+	std::vector<VkBuffer> cluster_buffers(image_count, gpu_cluster_buffer.get());
+	std::vector<VkBuffer> job_buffers;
+	std::vector<VkBuffer> indirect_buffers;
+	for (uint32_t i = 0; i < image_count; i++)
+	{
+		job_buffers.push_back(cluster_job_buffers[i].get());
+		indirect_buffers.push_back(cluster_command_buffers[i].get());
+	}
+	std::vector<VkDeviceSize> offsets(image_count, 0);
+	std::vector<VkDeviceSize> ranges(image_count, VK_WHOLE_SIZE);
+
+	ResourceCollection* cull_collection = cluster_cull_pipeline.get_resource_collection(0);
+	cull_collection->addSets(image_count, *set_pool);
+	cull_collection->addBufferPerSet(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, cluster_buffers, offsets, ranges);
+	cull_collection->addBufferPerSet(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, job_buffers, offsets, ranges);
+	cull_collection->addBufferPerSet(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, indirect_buffers, offsets, ranges);
+	cull_collection->updateSets();
+}
+
+void GraphicsImpl::destroy_cluster_culling()
+{
+	cluster_cull_pipeline.destroy();
+
+	for (mem::CPUBuffer& buffer : cluster_command_buffers)
+	{
+		buffer.destroy();
+	}
+	for (mem::CPUBuffer& buffer : cluster_job_buffers)
+	{
+		buffer.destroy();
+	}
+	gpu_cluster_buffer.destroy();
+}
+
+// MODIFIES: this, object
+// PURPOSE: copies the meshlet bounds of object into its cluster_bounds and hands
+// every primitive a range of indirect command slots and a cull job, reusing what
+// released objects gave back first. primitives that don't fit into what is left
+// of MAX_CLUSTER_COMMANDS/MAX_CLUSTER_JOBS keep being drawn whole.
+void GraphicsImpl::register_clusters(GameObject& object)
+{
+	const Model& model = object.object_model;
+	object.cluster_bounds.clear();
+
+	for (size_t k = 0; k < object.primitive_draws.size(); k++)
+	{
+		const Primitive& prim = model.primitives[k];
+		PrimitiveDraw& draw = object.primitive_draws[k];
+
+		draw.cluster_start = static_cast<uint32_t>(object.cluster_bounds.size());
+		draw.cluster_count = prim.meshlet_count;
+		for (uint32_t m = 0; m < prim.meshlet_count; m++)
+		{
+			const Meshlet& meshlet = model.meshlets[prim.meshlet_start + m];
+			// level 0 is packed in the same order, only its start moved.
+			uint32_t first_index = draw.lods[0].first_index + (meshlet.index_start - prim.index_start);
+			object.cluster_bounds.push_back(meshlet, first_index, meshlet.index_count);
+		}
+
+		// meshlet bounds are in the bind pose, skinned models are drawn whole.
+		if (draw.cluster_count == 0 || model.is_skinned())
+			continue;
+		if (free_cluster_jobs.empty() && cluster_job_count >= MAX_CLUSTER_JOBS)
+			continue;
+		if (!allocate_range(free_cluster_commands, draw.cluster_count, MAX_CLUSTER_COMMANDS,
+							cluster_command_count, draw.command_slot))
+			continue;
+
+		if (!free_cluster_jobs.empty())
+		{
+			draw.cull_job = free_cluster_jobs.back();
+			free_cluster_jobs.pop_back();
+		}
+		else
+		{
+			draw.cull_job = cluster_job_count++;
+		}
+
+		write_gpu_clusters(object, k);
+	}
+
+	cluster_commands.resize(cluster_command_count, VkDrawIndexedIndirectCommand{});
+	cluster_jobs.resize(cluster_job_count, GpuClusterJob{});
+}
+
+// MODIFIES: this, object
+// PURPOSE: gives the command slots and cull jobs of object's primitives back.
+// the released clusters lose their job, so the compute pass skips them until
+// the range is handed out again.
+void GraphicsImpl::release_clusters(GameObject& object)
+{
+	for (PrimitiveDraw& draw : object.primitive_draws)
+	{
+		if (draw.cull_job == UINT32_MAX)
+			continue;
+
+		GpuCluster released{};
+		released.job = UINT32_MAX;
+		mem::FrameVector<GpuCluster> clusters(draw.cluster_count, released, frame_arena);
+		gpu_cluster_buffer.map(clusters.size() * sizeof(GpuCluster),
+							   draw.command_slot * sizeof(GpuCluster), clusters.data());
+
+		cluster_jobs[draw.cull_job].enabled = 0;
+		free_cluster_jobs.push_back(draw.cull_job);
+
+		release_range(free_cluster_commands, draw.command_slot, draw.cluster_count);
+
+		draw.command_slot = UINT32_MAX;
+		draw.cull_job = UINT32_MAX;
+	}
+}
+
+// REQUIRES: the primitive has command slots.
+// PURPOSE: writes the meshlets of one primitive of object to its command slots
+// of gpu_cluster_buffer, for the compute pass to cull.
+void GraphicsImpl::write_gpu_clusters(const GameObject& object, size_t primitive)
+{
+	const Model& model = object.object_model;
+	const Primitive& prim = model.primitives[primitive];
+	const PrimitiveDraw& draw = object.primitive_draws[primitive];
+
+	mem::FrameVector<GpuCluster> gpu_clusters(frame_arena);
+	gpu_clusters.reserve(draw.cluster_count);
+	for (uint32_t m = 0; m < draw.cluster_count; m++)
+	{
+		const Meshlet& meshlet = model.meshlets[prim.meshlet_start + m];
+
+		GpuCluster cluster{};
+		cluster.sphere = glm::vec4(meshlet.center, meshlet.radius);
+		cluster.cone = glm::vec4(meshlet.cone_axis, meshlet.cone_cutoff);
+		cluster.first_index = object.cluster_bounds.first_index[draw.cluster_start + m];
+		cluster.index_count = meshlet.index_count;
+		cluster.vertex_offset = draw.vertex_offset;
+		cluster.job = draw.cull_job;
+		gpu_clusters.push_back(cluster);
+	}
+	gpu_cluster_buffer.map(gpu_clusters.size() * sizeof(GpuCluster),
+						   draw.command_slot * sizeof(GpuCluster), gpu_clusters.data());
+}
+
+// MODIFIES: this
+// PURPOSE: culls the meshlets of every primitive drawn at level 0 against the
+// camera. on the cpu the visible neighbours are merged into commands right away,
+// in gpu mode only the jobs (frustum and eye in model space) are filled in for
+// the compute pass.
+void GraphicsImpl::update_cluster_culling(std::vector<std::unique_ptr<GameObject>>& game_objects)
+{
+	ClusterCullStats stats{};
+	if (cluster_cull_mode == ClusterCullMode::Off)
+	{
+		cluster_stats = stats;
+		return;
+	}
+
+	glm::mat4 view_projection = camera_projection * camera_view;
+	glm::vec4 eye_world = glm::vec4(glm::vec3(camera_pos), 1.0f);
+
+	for (auto& object : game_objects)
+	{
+		if (object->update)
+			continue;
+
+		const Model& model = object->object_model;
+		for (size_t k = 0; k < object->primitive_draws.size(); k++)
+		{
+			const PrimitiveDraw& draw = object->primitive_draws[k];
+			if (draw.cull_job == UINT32_MAX)
+				continue;
+
+			GpuClusterJob& job = cluster_jobs[draw.cull_job];
+			job.command_slot = draw.command_slot;
+			job.visible_count = 0;
+			// coarser levels are drawn whole, nothing reads the commands then.
+			job.enabled = draw.lod == 0 ? 1 : 0;
+			if (!job.enabled)
+				continue;
+
+			// testing in model space keeps the bounds untouched, planes and eye
+			// are moved instead.
+			glm::mat4 to_world = object->transform * model.nodes.get_world(model.primitives[k].transform_index);
+			glm::vec4 planes[6];
+			extract_frustum_planes(view_projection * to_world, planes);
+			glm::vec3 eye = glm::vec3(glm::inverse(to_world) * eye_world);
+			// a mirroring transform flips the winding the rasterizer sees.
+			bool test_cones = glm::determinant(glm::mat3(to_world)) > 0.0f;
+
+			if (cluster_cull_mode == ClusterCullMode::Gpu)
+			{
+				std::copy(planes, planes + 6, job.planes);
+				job.eye = glm::vec4(eye, test_cones ? 1.0f : 0.0f);
+				stats.tested += draw.cluster_count;
+				continue;
+			}
+
+			if (cluster_visibility.size() < draw.cluster_count)
+				cluster_visibility.resize(draw.cluster_count);
+
+			cull_clusters(object->cluster_bounds, draw.cluster_start, draw.cluster_count, planes, eye,
+						  test_cones, cluster_visibility.data(), stats);
+			write_cluster_commands(object->cluster_bounds, draw.cluster_start, draw.cluster_count,
+								   cluster_visibility.data(), draw.vertex_offset,
+								   cluster_commands.data() + draw.command_slot, stats);
+		}
+	}
+
+	// the compute pass only reports back how many clusters survived.
+	if (cluster_cull_mode == ClusterCullMode::Gpu)
+	{
+		stats.visible = cluster_stats.visible;
+		stats.commands = cluster_stats.commands;
+	}
+	else
+	{
+		stats.visible = stats.tested - stats.frustum_culled - stats.cone_culled;
+	}
+	cluster_stats = stats;
+
+	if (++cluster_frame % CLUSTER_STATS_INTERVAL == 0 && stats.tested > 0)
+	{
+		if (cluster_cull_mode == ClusterCullMode::Cpu)
+		{
+			INFO("clusters: {} tested, {} culled ({} frustum, {} back facing), {} indirect draws",
+				 stats.tested, stats.get_culled(), stats.frustum_culled, stats.cone_culled,
+				 stats.commands);
+		}
+		else
+		{
+			INFO("clusters: {} tested on the gpu, {} culled, {} drawn", stats.tested, stats.get_culled(),
+				 stats.commands);
+		}
+	}
+}
+
+// REQUIRES: the last submission reading image_index's buffers has finished.
+// MODIFIES: this
+// PURPOSE: hands this frame's culling results (cpu) or jobs (gpu) to the buffers
+// the command buffer of image_index reads.
+void GraphicsImpl::write_cluster_draws(uint32_t image_index)
+{
+	if (cluster_cull_mode == ClusterCullMode::Cpu && cluster_command_count > 0)
+	{
+		cluster_command_buffers[image_index].map(
+			cluster_command_count * sizeof(VkDrawIndexedIndirectCommand), 0, cluster_commands.data());
+	}
+	else if (cluster_cull_mode == ClusterCullMode::Gpu && cluster_job_count > 0)
+	{
+		VkDeviceSize size = cluster_job_count * sizeof(GpuClusterJob);
+
+		// the jobs still hold the counts the last frame drawn to this image ended with.
+		mem::FrameVector<GpuClusterJob> finished(cluster_job_count, frame_arena);
+		cluster_job_buffers[image_index].read(size, 0, finished.data());
+		uint32_t visible = 0;
+		for (const GpuClusterJob& job : finished)
+		{
+			visible += job.enabled ? job.visible_count : 0;
+		}
+		cluster_stats.visible = visible;
+		cluster_stats.commands = visible;
+
+		cluster_job_buffers[image_index].map(size, 0, cluster_jobs.data());
+	}
+}
+
+// MODIFIES: command_buffers[i]
+// PURPOSE: records the cluster culling compute pass, it clears the commands of
+// image i and refills them before the draws read them.
+void GraphicsImpl::record_cluster_cull(size_t i)
+{
+	if (cluster_cull_mode != ClusterCullMode::Gpu || cluster_command_count == 0)
+		return;
+
+	vkCmdFillBuffer(command_buffers[i], cluster_command_buffers[i].get(), 0,
+					cluster_command_count * sizeof(VkDrawIndexedIndirectCommand), 0);
+	memory_dependency(i, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+					  VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	VkDescriptorSet cull_set = cluster_cull_pipeline.get_resource_collection(0)->get_api_set(i);
+	vkCmdBindPipeline(command_buffers[i], VK_PIPELINE_BIND_POINT_COMPUTE,
+					  cluster_cull_pipeline.get_api_pipeline());
+	vkCmdBindDescriptorSets(command_buffers[i], VK_PIPELINE_BIND_POINT_COMPUTE,
+							cluster_cull_pipeline.get_api_layout(), 0, 1, &cull_set, 0, nullptr);
+	vkCmdPushConstants(command_buffers[i], cluster_cull_pipeline.get_api_layout(),
+					   VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &cluster_command_count);
+	vkCmdDispatch(command_buffers[i],
+				  (cluster_command_count + CLUSTER_CULL_GROUP_SIZE - 1) / CLUSTER_CULL_GROUP_SIZE, 1, 1);
+
+	memory_dependency(i, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+					  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+}
+
+void GraphicsImpl::set_skinning_mode(SkinningMode mode)
+{
+	if (mode == skinning_mode)
+		return;
+
+	skinning_mode = mode;
+	update_command_buffers = true;
+}
+
+void GraphicsImpl::create_skinning()
+{
+	uint32_t image_count = static_cast<uint32_t>(swapchain.getSwapchainSize());
+
+	// rewritten every frame (either by the cpu or the compute pass), kept in
+	// host visible memory like the cluster buffers.
+	mem::BufferCreateInfo buffer_info{};
+	buffer_info.sharing_mode = vk::SharingMode::eExclusive;
+	buffer_info.queue_family_index_count = 1;
+	buffer_info.p_queue_family_indices = &p_device->get_graphics_family();
+	buffer_info.memory_properties = vk::MemoryPropertyFlagBits::eHostVisible |
+		vk::MemoryPropertyFlagBits::eHostCoherent;
+
+	skinned_vertex_buffers.resize(image_count);
+	skin_joint_buffers.resize(image_count);
+	skin_job_buffers.resize(image_count);
+	for (uint32_t i = 0; i < image_count; i++)
+	{
+		buffer_info.size = MAX_SKINNED_VERTICES * MeshVertexLayout::stride;
+		buffer_info.usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer;
+		buffer_info.category = mem::MemoryCategory::Geometry;
+		buffer_info.name = "skinned vertices";
+		skinned_vertex_buffers[i].init(*p_physical_device, *p_device, buffer_info);
+
+		buffer_info.size = MAX_SKIN_JOINTS * sizeof(glm::mat4);
+		buffer_info.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+		buffer_info.category = mem::MemoryCategory::Other;
+		buffer_info.name = "skin joints";
+		skin_joint_buffers[i].init(*p_physical_device, *p_device, buffer_info);
+
+		buffer_info.size = MAX_SKIN_JOBS * sizeof(GpuSkinJob);
+		buffer_info.name = "skin jobs";
+		skin_job_buffers[i].init(*p_physical_device, *p_device, buffer_info);
+	}
+
+	buffer_info.size = MAX_SKINNED_VERTICES * sizeof(GpuSkinVertex);
+	buffer_info.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+	buffer_info.category = mem::MemoryCategory::Geometry;
+	buffer_info.name = "skin source vertices";
+	skin_source_buffer.init(*p_physical_device, *p_device, buffer_info);
+
+	VkPushConstantRange push_range{};
+	push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_range.offset = 0;
+	push_range.size = sizeof(uint32_t);
+
+	PipelineConfig config{};
+	config.compute_shader_path = SHADER_PATH + "skinning.comp";
+	config.push_ranges = { push_range };
+
+	skinning_pipeline.init(p_device, set_pool, config);
+
+	std::vector<VkBuffer> source_buffers(image_count, skin_source_buffer.get());
+	std::vector<VkBuffer> joint_buffers;
+	std::vector<VkBuffer> job_buffers;
+	std::vector<VkBuffer> output_buffers;
+	for (uint32_t i = 0; i < image_count; i++)
+	{
+		joint_buffers.push_back(skin_joint_buffers[i].get());
+		job_buffers.push_back(skin_job_buffers[i].get());
+		output_buffers.push_back(skinned_vertex_buffers[i].get());
+	}
+	std::vector<VkDeviceSize> offsets(image_count, 0);
+	std::vector<VkDeviceSize> ranges(image_count, VK_WHOLE_SIZE);
+
+	ResourceCollection* skin_collection = skinning_pipeline.get_resource_collection(0);
+	skin_collection->addSets(image_count, *set_pool);
+	skin_collection->addBufferPerSet(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, source_buffers, offsets, ranges);
+	skin_collection->addBufferPerSet(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, joint_buffers, offsets, ranges);
+	skin_collection->addBufferPerSet(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, job_buffers, offsets, ranges);
+	skin_collection->addBufferPerSet(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, output_buffers, offsets, ranges);
+	skin_collection->updateSets();
+}
+
+void GraphicsImpl::destroy_skinning()
+{
+	skinning_pipeline.destroy();
+
+	for (mem::CPUBuffer& buffer : skinned_vertex_buffers)
+	{
+		buffer.destroy();
+	}
+	for (mem::CPUBuffer& buffer : skin_joint_buffers)
+	{
+		buffer.destroy();
+	}
+	for (mem::CPUBuffer& buffer : skin_job_buffers)
+	{
+		buffer.destroy();
+	}
+	skin_source_buffer.destroy();
+}
+
+// MODIFIES: this, object
+// PURPOSE: hands a skinned object its range of skinned vertices, joint matrices
+// and a skinning job, reusing what released objects gave back first, and
+// uploads its bind pose for the compute pass. objects that don't fit into what
+// is left keep being drawn in their bind pose.
+void GraphicsImpl::register_skinning(GameObject& object)
+{
+	const Model& model = object.object_model;
+	object.skinned_vertex_start = UINT32_MAX;
+	object.skin_job = UINT32_MAX;
+	object.joint_bounds.clear();
+	object.morphed_vertices.clear();
+	object.morph_state = MorphState{};
+	if (!model.is_skinned())
+		return;
+
+	uint32_t vertex_count = static_cast<uint32_t>(model.model_vertices.size());
+	uint32_t joint_count = static_cast<uint32_t>(model.joint_nodes.size());
+	uint32_t vertex_start = 0;
+	uint32_t joint_start = 0;
+	bool has_job = !free_skin_jobs.empty() || skin_job_count < MAX_SKIN_JOBS;
+	if (!has_job ||
+		!allocate_range(free_skinned_vertices, vertex_count, MAX_SKINNED_VERTICES, skinned_vertex_count,
+						vertex_start))
+	{
+		WARN("out of room for skinned vertices, {} is drawn in its bind pose", model.source_path);
+		return;
+	}
+	if (!allocate_range(free_skin_joints, joint_count, MAX_SKIN_JOINTS, skin_joint_count, joint_start))
+	{
+		release_range(free_skinned_vertices, vertex_start, vertex_count);
+		WARN("out of room for skin joints, {} is drawn in its bind pose", model.source_path);
+		return;
+	}
+
+	object.skinned_vertex_start = vertex_start;
+	object.joint_start = joint_start;
+	if (!free_skin_jobs.empty())
+	{
+		object.skin_job = free_skin_jobs.back();
+		free_skin_jobs.pop_back();
+	}
+	else
+	{
+		object.skin_job = skin_job_count++;
+	}
+
+	// blend shapes move vertices away from the bind pose, the bounds grow by
+	// how far they can.
+	std::vector<float> morph_extents;
+	if (!model.morphs.empty())
+		compute_morph_extents(model.morphs, vertex_count, morph_extents);
+	compute_joint_bounds(model.model_vertices.data(), vertex_count, joint_count, object.joint_bounds,
+						 morph_extents.empty() ? nullptr : morph_extents.data());
+
+	// the compute pass reads the source at the same index it writes the output to.
+	std::vector<GpuSkinVertex> sources(vertex_count);
+	pack_skin_vertices(model.model_vertices.data(), vertex_count, sources.data());
+	skin_source_buffer.map(sources.size() * sizeof(GpuSkinVertex),
+						   object.skinned_vertex_start * sizeof(GpuSkinVertex), sources.data());
+
+	skinned_vertices.resize(static_cast<size_t>(skinned_vertex_count) * MeshVertexLayout::stride);
+	skin_joint_matrices.resize(skin_joint_count, glm::mat4(1.0f));
+	skin_jobs.resize(skin_job_count, GpuSkinJob{});
+	skin_job_vertices.resize(skin_job_count, 0);
+	skin_job_vertices[object.skin_job] = vertex_count;
+
+	// blend shapes are applied to a copy, only the vertices they touch are
+	// rewritten every frame.
+	if (!model.morphs.empty())
+		object.morphed_vertices = model.model_vertices;
+
+	GpuSkinJob& job = skin_jobs[object.skin_job];
+	job.source_start = object.skinned_vertex_start;
+	job.vertex_count = vertex_count;
+	job.output_start = object.skinned_vertex_start;
+	job.joint_start = object.joint_start;
+}
+
+// MODIFIES: this, object
+// PURPOSE: gives the skinned vertices, joint matrices and job of object back.
+// the released job is left with no vertices, so the compute pass dispatches
+// nothing for it until it is handed out again.
+void GraphicsImpl::release_skinning(GameObject& object)
+{
+	if (object.skinned_vertex_start == UINT32_MAX)
+		return;
+
+	// object_model may already be the one about to be uploaded, the sizes of
+	// the ranges are taken from what was registered.
+	release_range(free_skinned_vertices, object.skinned_vertex_start, skin_job_vertices[object.skin_job]);
+	release_range(free_skin_joints, object.joint_start, static_cast<uint32_t>(object.joint_bounds.size()));
+
+	skin_jobs[object.skin_job] = GpuSkinJob{};
+	skin_job_vertices[object.skin_job] = 0;
+	free_skin_jobs.push_back(object.skin_job);
+
+	object.skinned_vertex_start = UINT32_MAX;
+	object.skin_job = UINT32_MAX;
+}
+
+// MODIFIES: this, game_objects
+// PURPOSE: advances the animation of every uploaded object and poses its nodes,
+// then rebuilds the joint matrices and vertex quantization of skinned objects.
+// the vertices themselves are morphed and skinned here on the cpu, in gpu mode
+// only the jobs are filled in for the compute pass (apart from objects with
+// blend shapes in use, which are still done on the cpu).
+void GraphicsImpl::update_skinning(std::vector<std::unique_ptr<GameObject>>& game_objects)
+{
+	auto now = std::chrono::steady_clock::now();
+	float seconds = 0.0f;
+	if (last_animation_time != std::chrono::steady_clock::time_point{})
+	{
+		// a long stall (loading, dragging the window) shouldn't skip ahead.
+		seconds = std::min(std::chrono::duration<float>(now - last_animation_time).count(), 0.25f);
+	}
+	last_animation_time = now;
+
+	mem::FrameVector<GameObject*> posed(frame_arena);
+	posed.reserve(game_objects.size());
+	size_t skinned_count = 0;
+	for (auto& object : game_objects)
+	{
+		if (object->update)
+			continue;
+		if (object->animation.animation < 0 && object->skinned_vertex_start == UINT32_MAX)
+			continue;
+
+		posed.push_back(object.get());
+		skinned_count += object->object_model.model_vertices.size() *
+			(object->skinned_vertex_start != UINT32_MAX ? 1 : 0);
+	}
+
+	SkinningStats stats{};
+	if (posed.empty())
+	{
+		skinning_stats = stats;
+		return;
+	}
+
+	// handing work to the job system only pays off once there is enough to skin.
+	auto for_each_object = [&](auto&& function) {
+		if (skinned_count >= SKINNING_PARALLEL_VERTICES)
+		{
+			br::parallel_for(posed.size(), function);
+			return;
+		}
+		for (size_t i = 0; i < posed.size(); i++)
+		{
+			function(i);
+		}
+	};
+
+	auto animate_start = std::chrono::steady_clock::now();
+	for_each_object([&](size_t i) {
+		GameObject& object = *posed[i];
+		Model& model = object.object_model;
+
+		int32_t playing = object.animation.animation;
+		if (playing >= 0 && playing < static_cast<int32_t>(model.animations.size()))
+		{
+			const Animation& animation = model.animations[playing];
+			bool running = advance_animation(animation, seconds, object.animation);
+			apply_animation(animation, object.animation.time, model.nodes, model.morphs.weights);
+			model.nodes.update_world();
+			if (!running)
+				object.animation.animation = -1;
+		}
+
+		if (object.skinned_vertex_start == UINT32_MAX)
+			return;
+
+		uint32_t joint_count = static_cast<uint32_t>(model.joint_nodes.size());
+		glm::mat4* joints = skin_joint_matrices.data() + object.joint_start;
+		for (uint32_t j = 0; j < joint_count; j++)
+		{
+			joints[j] = model.nodes.get_world(model.joint_nodes[j]) * model.inverse_bind_matrices[j];
+		}
+		object.skin_quantization = get_skinned_quantization(object.joint_bounds.data(), joints, joint_count);
+
+		GpuSkinJob& job = skin_jobs[object.skin_job];
+		job.quantization = glm::vec4(object.skin_quantization.offset, 1.0f / object.skin_quantization.scale);
+	});
+	auto animate_end = std::chrono::steady_clock::now();
+
+	cpu_skinned.clear();
+	cpu_skinned_ranges.clear();
+	size_t cpu_vertices = 0;
+	for (GameObject* object : posed)
+	{
+		if (object->skinned_vertex_start == UINT32_MAX)
+			continue;
+
+		size_t active_targets = count_active_morphs(object->object_model.morphs);
+		stats.morph_targets += active_targets;
+
+		bool on_cpu = skinning_mode == SkinningMode::Cpu || active_targets > 0;
+		if (skinning_mode == SkinningMode::Gpu)
+		{
+			// the job stays recorded, it just has nothing to do this frame.
+			skin_jobs[object->skin_job].vertex_count = on_cpu ? 0 : skin_job_vertices[object->skin_job];
+		}
+		if (!on_cpu)
+			continue;
+
+		uint32_t vertex_count = static_cast<uint32_t>(object->object_model.model_vertices.size());
+		cpu_skinned.push_back(object);
+		cpu_skinned_ranges.emplace_back(object->skinned_vertex_start, vertex_count);
+		cpu_vertices += vertex_count;
+	}
+
+	auto skin_on_cpu = [&](size_t i) {
+		GameObject& object = *cpu_skinned[i];
+		const Model& model = object.object_model;
+
+		const Vertex* source = model.model_vertices.data();
+		if (!model.morphs.empty())
+		{
+			evaluate_morphs(model.morphs, model.model_vertices.data(), object.morphed_vertices.data(),
+							object.morph_state);
+			source = object.morphed_vertices.data();
+		}
+
+		skin_vertices(source, model.model_vertices.size(),
+					  skin_joint_matrices.data() + object.joint_start, object.skin_quantization,
+					  skinned_vertices.data() + static_cast<size_t>(object.skinned_vertex_start) * MeshVertexLayout::stride);
+	};
+	if (cpu_vertices >= SKINNING_PARALLEL_VERTICES)
+	{
+		br::parallel_for(cpu_skinned.size(), skin_on_cpu);
+	}
+	else
+	{
+		for (size_t i = 0; i < cpu_skinned.size(); i++)
+		{
+			skin_on_cpu(i);
+		}
+	}
+	stats.skin_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - animate_end).count();
+
+	stats.animate_ms = std::chrono::duration<double, std::milli>(animate_end - animate_start).count();
+	stats.vertices = skinned_count;
+	for (const GameObject* object : posed)
+	{
+		stats.objects += object->skinned_vertex_start != UINT32_MAX ? 1 : 0;
+	}
+	skinning_stats = stats;
+
+	if (++skinning_frame % SKINNING_STATS_INTERVAL == 0 && stats.objects > 0)
+	{
+		if (skinning_mode == SkinningMode::Cpu)
+		{
+			INFO("skinning: {} objects, {} vertices, {} morph targets, {:.3f} ms animating, {:.3f} ms skinning "
+				 "({:.1f} vertices/us)",
+				 stats.objects, stats.vertices, stats.morph_targets, stats.animate_ms, stats.skin_ms,
+				 stats.vertices / std::max(stats.skin_ms * 1000.0, 1e-3));
+		}
+		else
+		{
+			INFO("skinning: {} objects, {} vertices skinned on the gpu, {} morphed on the cpu ({} targets), "
+				 "{:.3f} ms animating, {:.3f} ms morphing",
+				 stats.objects, stats.vertices - cpu_vertices, cpu_vertices, stats.morph_targets,
+				 stats.animate_ms, stats.skin_ms);
+		}
+	}
+}
+
+// REQUIRES: the last submission reading image_index's buffers has finished.
+// MODIFIES: this
+// PURPOSE: hands this frame's skinned vertices (cpu) or joint matrices and jobs
+// (gpu) to the buffers the command buffer of image_index reads.
+void GraphicsImpl::write_skinning(uint32_t image_index)
+{
+	if (skin_job_count == 0)
+		return;
+
+	if (skinning_mode == SkinningMode::Cpu)
+	{
+		skinned_vertex_buffers[image_index].map(skinned_vertices.size(), 0, skinned_vertices.data());
+	}
+	else
+	{
+		skin_joint_buffers[image_index].map(skin_joint_count * sizeof(glm::mat4), 0, skin_joint_matrices.data());
+		skin_job_buffers[image_index].map(skin_job_count * sizeof(GpuSkinJob), 0, skin_jobs.data());
+
+		for (const auto& [start, count] : cpu_skinned_ranges)
+		{
+			VkDeviceSize offset = static_cast<VkDeviceSize>(start) * MeshVertexLayout::stride;
+			skinned_vertex_buffers[image_index].map(count * MeshVertexLayout::stride, offset,
+													skinned_vertices.data() + offset);
+		}
+	}
+}
+
+// MODIFIES: command_buffers[i]
+// PURPOSE: records the skinning compute pass, one dispatch per skinned object,
+// finished before the vertex input of the forward pass reads the output.
+void GraphicsImpl::record_skinning(size_t i)
+{
+	if (skinning_mode != SkinningMode::Gpu || skin_job_count == 0)
+		return;
+
+	VkDescriptorSet skin_set = skinning_pipeline.get_resource_collection(0)->get_api_set(i);
+	vkCmdBindPipeline(command_buffers[i], VK_PIPELINE_BIND_POINT_COMPUTE,
+					  skinning_pipeline.get_api_pipeline());
+	vkCmdBindDescriptorSets(command_buffers[i], VK_PIPELINE_BIND_POINT_COMPUTE,
+							skinning_pipeline.get_api_layout(), 0, 1, &skin_set, 0, nullptr);
+
+	for (uint32_t job = 0; job < skin_job_count; job++)
+	{
+		vkCmdPushConstants(command_buffers[i], skinning_pipeline.get_api_layout(),
+						   VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &job);
+		vkCmdDispatch(command_buffers[i],
+					  (skin_job_vertices[job] + SKINNING_GROUP_SIZE - 1) / SKINNING_GROUP_SIZE, 1, 1);
+	}
+
+	memory_dependency(i, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+					  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+}
+
+void GraphicsImpl::copy_buffer(mem::Memory src_buffer, mem::Memory dst_buffer,
+							   VkDeviceSize dst_offset,
+							   VkDeviceSize data_size)
+{
+	auto transfer_buffer = begin_command_buffer(*p_device, command_pool);
+
+	// transfer between buffers
+	VkBufferCopy copyData{};
+	copyData.srcOffset = 0;
+	copyData.dstOffset = dst_offset;
+	copyData.size = data_size;
+
+	vkCmdCopyBuffer(transfer_buffer, src_buffer.buffer, dst_buffer.buffer, 1,
+					&copyData);
+
+	// destroy transfer buffer, shouldnt need it after copying the data.
+	end_command_buffer(*p_device, p_device->get_graphics_queue(), command_pool,
+					   transfer_buffer);
+}
+
+void GraphicsImpl::update_light_buffer(VkDeviceSize memory_offset,
+									   LightBufferObject lbo)
+{
+	uniform_buffer.writeLocal(p_device->get(), memory_offset, sizeof(lbo), &lbo);
+}
 
 void GraphicsImpl::updateUniformBuffer(VkDeviceSize offset, VkDeviceSize size,
 									   void* data)
@@ -1823,11 +3413,12 @@ void GraphicsImpl::update_materials(VkDeviceSize memory_offset, Material mat)
 							  &mat_obj);
 }
 
+// PURPOSE: writes ubo to the uniform ring, it reaches an image's region once that image is
+// acquired again (see draw_frame).
 void GraphicsImpl::update_uniform_buffer(VkDeviceSize memory_offset,
 										 UniformBufferObject ubo)
 {
-// overwrite memory
-	uniform_buffer.writeLocal(p_device->get(), memory_offset, sizeof(ubo), &ubo);
+	uniform_ring.write(memory_offset, sizeof(ubo), &ubo);
 }
 
 /// <summary>
@@ -1899,6 +3490,12 @@ void GraphicsImpl::draw_frame()
 	// Mark the image as now being in use by this frame
 	images_in_flight[nextImage] = in_flight_fences[current_frame];
 
+	// nothing reads the image's region anymore, this frame's ubos can go in.
+	uniform_ring.flush(nextImage);
+	flush_material_table(nextImage);
+	write_cluster_draws(nextImage);
+	write_skinning(nextImage);
+
 	// add appropriate command buffer
 	auto wait_stages = std::array<vk::PipelineStageFlags, 1>(
 		{ vk::PipelineStageFlagBits::eColorAttachmentOutput });
@@ -2031,6 +3628,8 @@ void GraphicsImpl::create_vulkan_image(const ImageBuffer &image, size_t i,
   texture_buffer_info.sharing_mode = vk::SharingMode::eExclusive;
   texture_buffer_info.queue_family_index_count = 1;
   texture_buffer_info.p_queue_family_indices = &p_device->get_transfer_family();
+  texture_buffer_info.category = mem::MemoryCategory::Staging;
+  texture_buffer_info.name = "texture upload";
 
   // TODO: make buffer at runtime specifically for transfer commands
   auto buffer = mem::CPUBuffer();
@@ -2077,6 +3676,8 @@ void GraphicsImpl::create_texture_image(std::string texturePath, size_t object,
 		vk::MemoryPropertyFlagBits::eHostCoherent;
 	texture_buffer_info.queue_family_index_count = 1;
 	texture_buffer_info.p_queue_family_indices = &p_device->get_graphics_family();
+	texture_buffer_info.category = mem::MemoryCategory::Staging;
+	texture_buffer_info.name = "texture upload";
 
 	// TODO: make buffer at runtime specifically for transfer commands
 	auto buffer = mem::CPUBuffer();
@@ -2116,17 +3717,7 @@ void GraphicsImpl::create_texture_image(std::string texturePath, size_t object,
 	// mem::maAllocateMemory(dataSize, &newTextureImage);
 	// transfer the image to appropriate layout for copying
 
-	texture_images[texture_images.size() - 1][0].transfer(
-		vk::ImageLayout::eTransferDstOptimal, p_device->get_transfer_queue());
-
-	VkOffset3D image_offset = { 0, 0, 0 };
-	texture_images[texture_images.size() - 1][0].copy_from_buffer(
-		buffer.get(), image_offset, 1, dataSize, std::nullopt, p_device->get_transfer_queue());
-
-	texture_images[texture_images.size() - 1][0].transfer(
-		vk::ImageLayout::eShaderReadOnlyOptimal, p_device->get_graphics_queue());
-
-	// transfer the image again to a more optimal layout for texture sampling?
+	texture_images[texture_images.size() - 1][0].upload(buffer.get(), 1, static_cast<uint32_t>(dataSize));
 
 	// create image view for image
 	buffer.destroy();
@@ -233,6 +233,7 @@ void LUT::create_image()
 	info.usage = br::ImageUsage::RENDER_OUTPUT;
 
 	lut.init(name);
+	lut.set_memory_category(mem::MemoryCategory::Environment);
 
 	lut.load_blank(info, map_size, map_size, 1, mip_count);
 	lut.set_image_sampler(VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
@@ -20,11 +20,13 @@ void Material::init()
 
 void Material::setBaseColorTexture(std::string filePath) {
     baseColorTexturePath = filePath;
-    hasBaseTexture = true;
+    setBaseColorImage(Antuco::get_engine().get_backend()->get_texture_cache().load_file(filePath));
+}
 
-    baseColorImage.init("baseColorTexture");
-    baseColorImage.load_image(baseColorTexturePath, br::ImageFormat::RGBA_COLOR, br::ImageType::Image_2D);
-    baseColorImage.set_image_sampler(VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT);
+void Material::setBaseColorImage(br::Image* image)
+{
+	baseColorImage = image;
+	hasBaseTexture = image != nullptr;
 }
 
 //void Material::setRoughnessTexture(std::string filePath) {
@@ -38,20 +40,19 @@ void Material::setBaseColorTexture(std::string filePath) {
 
 void Material::setRoughnessMetallicTexture(std::string filePath)
 {
-	hasRoughnessTexture = true;
+	setRoughnessMetallicImage(Antuco::get_engine().get_backend()->get_texture_cache().load_file(filePath, br::ImageFormat::RGBA_LINEAR));
+}
 
-	roughnessMetallicTexture.init("roughnessMetallicTexture");
-	roughnessMetallicTexture.load_image(filePath, br::ImageFormat::RGBA_COLOR, br::ImageType::Image_2D);
-	roughnessMetallicTexture.set_image_sampler(VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT);
+void Material::setRoughnessMetallicImage(br::Image* image)
+{
+	roughnessMetallicTexture = image;
+	hasRoughnessTexture = image != nullptr;
 }
 
 void Material::setMetallicTexture(std::string& filePath)
 {
-	hasSeparateMetallic = true;
-
-	metallicTexture.init("metallicTexture");
-	metallicTexture.load_image(filePath, br::ImageFormat::RGBA_COLOR, br::ImageType::Image_2D);
-	metallicTexture.set_image_sampler(VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT);
+	metallicTexture = Antuco::get_engine().get_backend()->get_texture_cache().load_file(filePath, br::ImageFormat::RGBA_LINEAR);
+	hasSeparateMetallic = metallicTexture != nullptr;
 }
 
 void Material::UpdateGPU()
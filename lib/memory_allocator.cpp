@@ -5,6 +5,7 @@
 #include "vulkan/vulkan_core.h"
 #include "vulkan_wrapper/limits.hpp"
 
+#include <algorithm>
 #include <cstring>
 #include <stdexcept>
 
@@ -48,43 +49,88 @@ void SearchBuffer::init(v::PhysicalDevice &physical_device, v::Device &device,
 {
     api_device = &device;
 
-    auto create_info = vk::BufferCreateInfo(
-        {}, buffer_info.size, buffer_info.usage, buffer_info.sharing_mode,
-        buffer_info.queue_family_index_count, buffer_info.p_queue_family_indices);
-
-    buffer = device.get().createBuffer(create_info);
-
-    auto mem_req = device.get().getBufferMemoryRequirements(buffer);
-
-    auto mem_info = vk::MemoryAllocateInfo(
-        mem_req.size, findMemoryType(physical_device, mem_req.memoryTypeBits,
-                                    buffer_info.memory_properties));
-
-    buffer_memory = device.get().allocateMemory(mem_info);
-
-    device.get().bindBufferMemory(buffer, buffer_memory, 0);
+    block_size = buffer_info.size;
+    usage = buffer_info.usage;
+    sharing_mode = buffer_info.sharing_mode;
+    queue_families.assign(buffer_info.p_queue_family_indices,
+                          buffer_info.p_queue_family_indices +
+                              buffer_info.queue_family_index_count);
+    memory_properties = buffer_info.memory_properties;
+    category = buffer_info.category;
+    name = buffer_info.name ? buffer_info.name : "uniform buffer";
 
     memory_offset = 0;
+    add_block();
+}
+
+void SearchBuffer::add_block()
+{
+    auto create_info = vk::BufferCreateInfo(
+        {}, block_size, usage, sharing_mode,
+        static_cast<uint32_t>(queue_families.size()), queue_families.data());
+
+    Block block{};
+    block.buffer = api_device->get().createBuffer(create_info);
+
+    AllocationInfo allocation_info{};
+    allocation_info.required = memory_properties;
+    allocation_info.dedicated_buffer = block.buffer;
+    allocation_info.category = category;
+    allocation_info.name = name.c_str();
+    block.allocation = api_device->get_allocator().allocate(
+        api_device->get().getBufferMemoryRequirements(block.buffer),
+        allocation_info);
+
+    api_device->get().bindBufferMemory(block.buffer, block.allocation.memory,
+                                       block.allocation.offset);
+    blocks.push_back(block);
+
+    if (blocks.size() > 1)
+    {
+        INFO("uniform buffer grew to {} blocks of {:.2f} mb", blocks.size(),
+             block_size / 1e6);
+    }
 }
 
 void SearchBuffer::destroy() 
 {
     api_device->get().waitIdle();
-    api_device->get().free(buffer_memory);
-    api_device->get().destroyBuffer(buffer);
+    for (Block &block : blocks)
+    {
+        api_device->get().destroyBuffer(block.buffer);
+        api_device->get_allocator().free(block.allocation);
+    }
+    blocks.clear();
 }
 
 VkDeviceSize SearchBuffer::allocate(VkDeviceSize allocation_size, uint32_t alignment /* = 1 */) 
 {
-    VkDeviceSize offset = memory_offset;
-    memory_locations.push_back(offset);
+    if (allocation_size > block_size)
+    {
+        ERR("{} bytes don't fit a {} byte uniform block", allocation_size,
+            block_size);
+        throw std::runtime_error("uniform allocation larger than a block");
+    }
 
-    memory_offset += allocation_size;
-    if (allocation_size % alignment != 0)
+    VkDeviceSize offset = memory_offset;
+    if (offset % alignment != 0)
     {
-        memory_offset += (alignment - allocation_size % alignment);
+        offset += alignment - offset % alignment;
+    }
+    // ranges never straddle two blocks, the rest of this one is skipped.
+    VkDeviceSize last_byte = std::max<VkDeviceSize>(allocation_size, 1) - 1;
+    if (offset / block_size != (offset + last_byte) / block_size)
+    {
+        offset = (offset / block_size + 1) * block_size;
+    }
+    while (blocks.size() <= (offset + last_byte) / block_size)
+    {
+        add_block();
     }
 
+    memory_locations.push_back(offset);
+    memory_offset = offset + allocation_size;
+
     return offset;
 }
 
@@ -93,14 +139,12 @@ VkDeviceSize SearchBuffer::allocate(VkDeviceSize allocation_size, uint32_t align
 void SearchBuffer::writeLocal(VkDevice device, VkDeviceSize offset,
                               VkDeviceSize data_size, void *p_data) 
 {
-    void *pData;
-    if (vkMapMemory(device, buffer_memory, offset, data_size, 0, &pData) !=
-        VK_SUCCESS) 
+    const Block &block = blocks[offset / block_size];
+    if (!block.allocation.mapped)
     {
     throw std::runtime_error("could not map data to memory");
     }
-    memcpy(pData, p_data, data_size);
-    vkUnmapMemory(device, buffer_memory);
+    memcpy(block.allocation.mapped + get_offset(offset), p_data, data_size);
 }
 
 void SearchBuffer::writeDevice(VkDevice device, VkDeviceSize srcOffset,
@@ -109,10 +153,10 @@ void SearchBuffer::writeDevice(VkDevice device, VkDeviceSize srcOffset,
     // transfer between buffers
     VkBufferCopy copyData{};
     copyData.srcOffset = srcOffset;
-    copyData.dstOffset = dstOffset;
+    copyData.dstOffset = get_offset(dstOffset);
     copyData.size = dataSize;
 
-    vkCmdCopyBuffer(cmdBuffer, srcBuffer, buffer, 1, &copyData);
+    vkCmdCopyBuffer(cmdBuffer, srcBuffer, get_buffer(dstOffset), 1, &copyData);
 }
 
 // this almost never needed when dealing with uniform buffer, so i'm not gonna
@@ -120,8 +164,8 @@ void SearchBuffer::writeDevice(VkDevice device, VkDeviceSize srcOffset,
 void SearchBuffer::free(VkDeviceSize offset) {}
 
 void CPUBuffer::destroy() {
-    device->get().freeMemory(memory);
     device->get().destroyBuffer(buffer);
+    device->get_allocator().free(allocation);
 }
 
 void CPUBuffer::init(v::PhysicalDevice &physical_device, v::Device &device,
@@ -135,30 +179,64 @@ void CPUBuffer::init(v::PhysicalDevice &physical_device, v::Device &device,
 
     buffer = device.get().createBuffer(create_info);
 
-    auto mem_req = device.get().getBufferMemoryRequirements(buffer);
-
-    auto mem_info = vk::MemoryAllocateInfo(
-        mem_req.size, findMemoryType(physical_device, mem_req.memoryTypeBits,
-                                    vk::MemoryPropertyFlagBits::eHostVisible));
+    // writes are never flushed, so the memory has to be coherent.
+    AllocationInfo allocation_info{};
+    allocation_info.required = buffer_info.memory_properties |
+                               vk::MemoryPropertyFlagBits::eHostVisible |
+                               vk::MemoryPropertyFlagBits::eHostCoherent;
+    allocation_info.dedicated_buffer = buffer;
+    allocation_info.category = buffer_info.category;
+    allocation_info.name = buffer_info.name;
+    allocation = device.get_allocator().allocate(
+        device.get().getBufferMemoryRequirements(buffer), allocation_info);
+
+    device.get().bindBufferMemory(buffer, allocation.memory, allocation.offset);
+}
 
-    memory = device.get().allocateMemory(mem_info);
+void CPUBuffer::map(vk::DeviceSize size, vk::DeviceSize offset, const void *data) 
+{
+    memcpy(allocation.mapped + offset, data, size);
+}
 
-    device.get().bindBufferMemory(buffer, memory, 0);
+void CPUBuffer::read(vk::DeviceSize size, vk::DeviceSize offset, void *data)
+{
+    memcpy(data, allocation.mapped + offset, size);
 }
 
-void CPUBuffer::map(vk::DeviceSize size, vk::DeviceSize offset, const void *data) 
+void *CPUBuffer::map_range(vk::DeviceSize size, vk::DeviceSize offset)
 {
-    auto p_data = device->get().mapMemory(memory, offset, size);
-    memcpy(p_data, data, size);
-    device->get().unmapMemory(memory);
+    return allocation.mapped + offset;
+}
+
+// blocks stay mapped, there is nothing to undo.
+void CPUBuffer::unmap() {}
+
+// EFFECTS: offset moved up to the next multiple of alignment, which doesn't
+//          have to be a power of 2.
+static VkDeviceSize align_offset(VkDeviceSize offset, VkDeviceSize alignment) {
+  return offset + (alignment - offset % alignment) % alignment;
 }
 
 void StackBuffer::destroy() {
-  device->get().free(inter_memory);
-  device->get().free(buffer_memory);
+  if (!device)
+    return;
+
+  finish_moves(true);
+  for (MoveBatch &batch : idle_batches) {
+    device->get().destroyFence(batch.fence);
+  }
+  idle_batches.clear();
+
+  for (RetiredBuffer &retired_buffer : retired_buffers) {
+    device->get().destroyBuffer(retired_buffer.buffer);
+    device->get_allocator().free(retired_buffer.allocation);
+  }
+  retired_buffers.clear();
+
   device->get().destroyBuffer(buffer);
-  device->get().destroyBuffer(inter_buffer);
+  device->get_allocator().free(allocation);
   device->get().destroyCommandPool(command_pool);
+  device = nullptr;
 }
 
 void StackBuffer::init(v::PhysicalDevice &physical_device, v::Device &device,
@@ -167,189 +245,473 @@ void StackBuffer::init(v::PhysicalDevice &physical_device, v::Device &device,
   StackBuffer::device = &device;
   StackBuffer::phys_device = &physical_device;
 
-  StackBuffer::command_pool =
-      tuco::create_command_pool(device, device.get_transfer_family());
-
-  auto create_info = vk::BufferCreateInfo(
-      {}, buffer_info.size, buffer_info.usage, buffer_info.sharing_mode,
-      buffer_info.queue_family_index_count, buffer_info.p_queue_family_indices);
-
-  buffer = device.get().createBuffer(create_info);
-
-  auto mem_req = device.get().getBufferMemoryRequirements(buffer);
-
-  auto mem_info = vk::MemoryAllocateInfo(
-      mem_req.size, findMemoryType(physical_device, mem_req.memoryTypeBits,
-                                   buffer_info.memory_properties));
-
-  buffer_memory = device.get().allocateMemory(mem_info);
-
-  device.get().bindBufferMemory(buffer, buffer_memory, 0);
+  // copies into the buffer have to come from the family that owns it.
+  queue_family = buffer_info.queue_family_index_count > 0
+                     ? buffer_info.p_queue_family_indices[0]
+                     : device.get_graphics_family();
+  queue = device.get().getQueue(queue_family, 0);
+
+  auto pool_info = vk::CommandPoolCreateInfo(
+      vk::CommandPoolCreateFlagBits::eResetCommandBuffer, queue_family);
+  command_pool = device.get().createCommandPool(pool_info);
+
+  // growing and compaction copy from and into the buffer.
+  usage = buffer_info.usage | vk::BufferUsageFlagBits::eTransferSrc |
+          vk::BufferUsageFlagBits::eTransferDst;
+  sharing_mode = buffer_info.sharing_mode;
+  queue_families.assign(buffer_info.p_queue_family_indices,
+                        buffer_info.p_queue_family_indices +
+                            buffer_info.queue_family_index_count);
+  memory_properties = buffer_info.memory_properties;
+  category = buffer_info.category;
+  name = buffer_info.name ? buffer_info.name : "geometry buffer";
 
   buffer_size = buffer_info.size;
-  offset = 0;
+  create_buffer(buffer_size, buffer, allocation);
+  insert_free(0, buffer_size);
+}
 
-  // setup command buffer pool for defragmentation
-  setup_queues();
+void StackBuffer::create_buffer(VkDeviceSize size, vk::Buffer &buffer,
+                                Allocation &allocation) {
+  auto create_info = vk::BufferCreateInfo(
+      {}, size, usage, sharing_mode,
+      static_cast<uint32_t>(queue_families.size()), queue_families.data());
 
-  create_inter_buffer(INTER_BUFFER_SIZE,
-                      vk::MemoryPropertyFlagBits::eDeviceLocal, inter_buffer,
-                      inter_memory);
-}
+  buffer = device->get().createBuffer(create_info);
 
-void StackBuffer::setup_queues() {
-  tuco::QueueData indices(*phys_device);
-  transfer_family = indices.transferFamily.value();
+  AllocationInfo allocation_info{};
+  allocation_info.required = memory_properties;
+  allocation_info.dedicated_buffer = buffer;
+  allocation_info.category = category;
+  allocation_info.name = name.c_str();
+  allocation = device->get_allocator().allocate(
+      device->get().getBufferMemoryRequirements(buffer), allocation_info);
 
-  transfer_queue = device->get().getQueue(transfer_family, 0);
+  device->get().bindBufferMemory(buffer, allocation.memory, allocation.offset);
 }
 
 void StackBuffer::create_inter_buffer(vk::DeviceSize buffer_size,
                                       vk::MemoryPropertyFlags memory_properties,
                                       vk::Buffer &buffer,
-                                      vk::DeviceMemory &memory) {
+                                      Allocation &allocation) {
   auto create_info =
       vk::BufferCreateInfo({}, buffer_size,
                            vk::BufferUsageFlagBits::eTransferSrc |
                                vk::BufferUsageFlagBits::eTransferDst,
-                           vk::SharingMode::eExclusive, 1, &transfer_family);
+                           vk::SharingMode::eExclusive, 1, &queue_family);
 
   buffer = device->get().createBuffer(create_info);
 
-  auto mem_req = device->get().getBufferMemoryRequirements(buffer);
+  AllocationInfo allocation_info{};
+  allocation_info.required = memory_properties;
+  allocation_info.dedicated_buffer = buffer;
+  allocation_info.category = MemoryCategory::Staging;
+  allocation_info.name = "geometry upload";
+  allocation = device->get_allocator().allocate(
+      device->get().getBufferMemoryRequirements(buffer), allocation_info);
+
+  device->get().bindBufferMemory(buffer, allocation.memory, allocation.offset);
+}
 
-  auto mem_info = vk::MemoryAllocateInfo(
-      mem_req.size,
-      findMemoryType(*phys_device, mem_req.memoryTypeBits, memory_properties));
+VkDeviceSize StackBuffer::allocate(VkDeviceSize allocation_size,
+                                   VkDeviceSize alignment, bool relocatable) {
+  // empty allocations still take a byte, so every offset stays unique.
+  VkDeviceSize size = std::max<VkDeviceSize>(allocation_size, 1);
+  alignment = std::max<VkDeviceSize>(alignment, 1);
 
-  memory = device->get().allocateMemory(mem_info);
+  VkDeviceSize offset = 0;
+  if (!take_free(size, alignment, buffer_size, offset)) {
+    grow(size, alignment);
+    take_free(size, alignment, buffer_size, offset);
+  }
 
-  device->get().bindBufferMemory(buffer, memory, 0);
+  allocations[offset] = Range{size, alignment, relocatable, false};
+  return offset;
 }
 
 ///
-/// This function will sort the stack buffer so that data is compacted and
-/// memory efficient, in terms of complexity this functions runs at O(n) but the
-/// actual constant time moves are going to be a somewhat
-/// expensive process so it would recommended to use during downtime in the
-/// application (perhaps tracking CPU/GPU usage?)\
+/// Growing waits for the copy into the new buffer, the old one can't be
+/// written after its contents were taken. It only happens when the buffer is
+/// full and doubles it every time, so it stays rare.
 ///
-void StackBuffer::sort() {
-  // complexity: we must touch each element at least once to check if it needs
-  // to be moved
-  //             after which we must perform a fairly expensive move operation
-  //             thats dependent on the size of the allocation rather than the
-  //             number of allocations
-
-  // sort through allocations
-
-  // check if ((next allocation offset) - (allocation offset + allocation size)
-  // > MINIMUM_DISTANCE) MINIMUM_DISTANCE will check whether the amount of space
-  // between the two allocations is large enough to be worth doing this
-  // expensive operation in the first place
-
-  // if the above statement passes then we must transfer our data from the stack
-  // buffer into an intermediary buffer, we can accomplish this with
-  // vkCmdCopyBuffer() command. once this data is in the buffer we can make a
-  // second vkCmdCopyBuffer() call that will push our data back into the main
-  // buffer at a new offset
+void StackBuffer::grow(VkDeviceSize size, VkDeviceSize alignment) {
+  // a free range at the end joins the new space.
+  VkDeviceSize tail = 0;
+  if (!free_ranges.empty()) {
+    auto last = std::prev(free_ranges.end());
+    if (last->first + last->second == buffer_size)
+      tail = last->second;
+  }
 
-  auto transfer_buffer = tuco::begin_command_buffer(*device, command_pool);
+  VkDeviceSize new_size = buffer_size * 2;
+  while (new_size - buffer_size + tail < size + alignment - 1)
+    new_size *= 2;
+
+  vk::Buffer new_buffer;
+  Allocation new_allocation;
+  create_buffer(new_size, new_buffer, new_allocation);
+
+  // copies staged into the old buffer have to land before it is copied.
+  if (staging)
+    staging->flush();
+
+  auto command_buffer = tuco::begin_command_buffer(*device, command_pool);
+
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+
+  VkBufferCopy region{};
+  region.size = buffer_size;
+  vkCmdCopyBuffer(command_buffer, buffer, new_buffer, 1, &region);
+
+  barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                          VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT |
+                          VK_ACCESS_TRANSFER_READ_BIT |
+                          VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                           VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+  tuco::end_command_buffer(*device, queue, command_pool, command_buffer);
+
+  // frames recorded before this keep drawing from the old buffer.
+  retired_buffers.push_back(RetiredBuffer{buffer, allocation, frame});
+  buffer = new_buffer;
+  allocation = new_allocation;
+
+  INFO("buffer grew from {:.2f} mb to {:.2f} mb", buffer_size / 1e6,
+       new_size / 1e6);
+  insert_free(buffer_size, new_size - buffer_size);
+  buffer_size = new_size;
+  stats.grows++;
+}
 
-  // copy to buffer
-
-  while (true) {
-    VkDeviceSize gap = 0;
-    VkDeviceSize current_offset = 0;
-    VkDeviceSize data_size = 0;
-    bool fragmented = false;
-    for (auto it = allocations.begin(); it != allocations.end(); it++) {
-      VkDeviceSize space_between =
-          (it->first + it->second) - (gap + it->second);
-      if (space_between < MINIMUM_SORT_DISTANCE) {
-        gap = it->first + it->second;
-      } else {
-        fragmented = true;
-        current_offset = it->first;
-        data_size = it->second;
-        break;
+bool StackBuffer::take_free(VkDeviceSize size, VkDeviceSize alignment,
+                            VkDeviceSize limit, VkDeviceSize &offset) {
+  // smallest ranges first, the first one the aligned data fits is the best.
+  auto it = free_sizes.lower_bound(std::make_pair(size, VkDeviceSize(0)));
+  for (; it != free_sizes.end(); it++) {
+    VkDeviceSize start = it->second;
+    VkDeviceSize end = start + it->first;
+    VkDeviceSize aligned = align_offset(start, alignment);
+    if (aligned + size > end || aligned + size > limit)
+      continue;
+
+    erase_free(free_ranges.find(start));
+    if (aligned > start)
+      insert_free(start, aligned - start);
+    if (aligned + size < end)
+      insert_free(aligned + size, end - aligned - size);
+
+    offset = aligned;
+    return true;
+  }
+  return false;
+}
+
+void StackBuffer::insert_free(VkDeviceSize offset, VkDeviceSize size) {
+  VkDeviceSize end = offset + size;
+
+  // merge with the free neighbours on either side.
+  auto next = free_ranges.lower_bound(offset);
+  if (next != free_ranges.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      offset = prev->first;
+      erase_free(prev);
+    }
+  }
+  if (next != free_ranges.end() && next->first == end) {
+    end += next->second;
+    erase_free(next);
+  }
+
+  free_ranges[offset] = end - offset;
+  free_sizes.insert(std::make_pair(end - offset, offset));
+}
+
+void StackBuffer::erase_free(
+    std::map<VkDeviceSize, VkDeviceSize>::iterator it) {
+  free_sizes.erase(std::make_pair(it->second, it->first));
+  free_ranges.erase(it);
+}
+
+void StackBuffer::retire(VkDeviceSize offset, VkDeviceSize size) {
+  retired.push_back(Retired{offset, size, frame});
+}
+
+void StackBuffer::free(VkDeviceSize delete_offset) {
+  auto it = allocations.find(delete_offset);
+  if (it == allocations.end()) {
+    WARN("freeing offset {}, nothing is allocated there", delete_offset);
+    return;
+  }
+
+  // a range that is being copied is handed back once the copy is done.
+  if (it->second.moving) {
+    for (MoveBatch &batch : moves_in_flight) {
+      for (Move &move : batch.moves) {
+        if (move.from == delete_offset)
+          move.cancelled = true;
       }
     }
+  } else {
+    retire(delete_offset, it->second.size);
+  }
+  allocations.erase(it);
+}
+
+void StackBuffer::begin_frame() {
+  frame++;
+  finish_moves(false);
+
+  // the last frame that could have read these has finished by now.
+  while (!retired.empty() &&
+         retired.front().frame + tuco::MAX_FRAMES_IN_FLIGHT <= frame) {
+    insert_free(retired.front().offset, retired.front().size);
+    retired.pop_front();
+  }
+
+  while (!retired_buffers.empty() &&
+         retired_buffers.front().frame + tuco::MAX_FRAMES_IN_FLIGHT <= frame) {
+    device->get().destroyBuffer(retired_buffers.front().buffer);
+    device->get_allocator().free(retired_buffers.front().allocation);
+    retired_buffers.pop_front();
+  }
+}
 
-    if (!fragmented) {
+void StackBuffer::finish_moves(bool wait) {
+  while (!moves_in_flight.empty()) {
+    MoveBatch &batch = moves_in_flight.front();
+    if (wait) {
+      (void)device->get().waitForFences(batch.fence, VK_TRUE, UINT64_MAX);
+    } else if (device->get().getFenceStatus(batch.fence) !=
+               vk::Result::eSuccess) {
       break;
     }
 
-    // TODO: if buffer is not large enough, make new inter_buffer
-    VkBufferCopy src_info{};
-    src_info.srcOffset = current_offset;
-    src_info.dstOffset = 0;
-    src_info.size = data_size;
+    for (const Move &move : batch.moves) {
+      retire(move.from, move.size);
+      if (move.cancelled) {
+        retire(move.to, move.size);
+        allocations.erase(move.to);
+        continue;
+      }
 
-    vkCmdCopyBuffer(transfer_buffer, buffer, inter_buffer, 1, &src_info);
+      allocations.erase(move.from);
+      relocations.push_back(Relocation{move.from, move.to});
+      stats.moves++;
+      stats.moved_bytes += move.size;
+    }
 
-    // copy back to src buffer
-    VkBufferCopy dst_info{};
-    dst_info.srcOffset = 0;
-    dst_info.dstOffset = gap;
-    dst_info.size = data_size;
+    batch.moves.clear();
+    idle_batches.push_back(std::move(batch));
+    moves_in_flight.pop_front();
+  }
+}
 
-    vkCmdCopyBuffer(transfer_buffer, inter_buffer, buffer, 1, &dst_info);
+///
+/// Compaction never copies onto data that could still be read: a move's
+/// destination is taken out of the free ranges before the copy is recorded
+/// and its source stays allocated until the copy finished, so the two never
+/// overlap and frames in flight keep drawing from the old offset.
+///
+/// The highest allocations go first, each into the best fitting hole below
+/// it. If none of them fits anywhere lower, the allocation right after the
+/// lowest hole is moved out of the way (wherever it fits) so the hole grows
+/// into its range and takes a larger allocation on a later call. Holes that
+/// are only alignment padding are left alone, so this settles once nothing
+/// can move down anymore.
+///
+bool StackBuffer::compact(VkDeviceSize max_bytes) {
+  if (!moves_in_flight.empty() || allocations.empty())
+    return !moves_in_flight.empty();
+
+  VkDeviceSize top =
+      allocations.rbegin()->first + allocations.rbegin()->second.size;
+  VkDeviceSize hole_bytes = 0;
+  for (const auto &range : free_ranges) {
+    if (range.first >= top)
+      break;
+    hole_bytes += range.second;
+  }
+  if (hole_bytes < MINIMUM_SORT_DISTANCE)
+    return false;
+
+  std::vector<VkDeviceSize> &candidates = compact_candidates;
+  candidates.clear();
+  for (auto it = allocations.rbegin(); it != allocations.rend(); it++) {
+    if (it->second.relocatable && !it->second.moving)
+      candidates.push_back(it->first);
   }
 
-  if (vkEndCommandBuffer(transfer_buffer) != VK_SUCCESS) {
-    throw std::runtime_error(
-        "could not create succesfully end transfer buffer");
-  };
+  std::vector<Move> &moves = compact_moves;
+  moves.clear();
+  VkDeviceSize moved = 0;
+  for (VkDeviceSize from : candidates) {
+    Range &range = allocations[from];
+    if (!moves.empty() && moved + range.size > max_bytes)
+      continue;
+
+    VkDeviceSize to = 0;
+    if (!take_free(range.size, range.alignment, from, to))
+      continue;
+
+    allocations[to] = Range{range.size, range.alignment, true, false};
+    range.moving = true;
+    moves.push_back(Move{from, to, range.size, false});
+    moved += range.size;
+    if (moved >= max_bytes)
+      break;
+  }
 
-  auto submit_info =
-      vk::SubmitInfo(0, nullptr, nullptr, 1, &transfer_buffer, 0, nullptr);
+  if (moves.empty()) {
+    for (const auto &hole : free_ranges) {
+      if (hole.first >= top)
+        break;
 
-  transfer_queue.submit(submit_info);
-  transfer_queue.waitIdle();
+      auto next = allocations.find(hole.first + hole.second);
+      if (next == allocations.end() || !next->second.relocatable ||
+          next->second.moving)
+        continue;
 
-  device->get().free(command_pool, transfer_buffer);
-}
+      // alignment padding, the allocation would land where it already is.
+      Range &range = next->second;
+      if (align_offset(hole.first, range.alignment) == next->first)
+        continue;
+
+      VkDeviceSize to = 0;
+      if (!take_free(range.size, range.alignment, buffer_size, to))
+        break;
+
+      range.moving = true;
+      moves.push_back(Move{next->first, to, range.size, false});
+      allocations[to] = Range{range.size, range.alignment, true, false};
+      break;
+    }
+  }
 
-VkDeviceSize StackBuffer::allocate(VkDeviceSize allocation_size) {
-  if (allocation_size > buffer_size) {
-    // not sure how to handle this case right now
-    // will most likely need to create new vertex buffer, copy all the old data,
-    // and destroy the old buffer.
+  if (moves.empty())
+    return false;
+
+  MoveBatch batch{};
+  if (!idle_batches.empty()) {
+    batch = std::move(idle_batches.back());
+    idle_batches.pop_back();
+    device->get().resetFences(batch.fence);
+    batch.command_buffer.reset();
+  } else {
+    batch.fence = device->get().createFence(vk::FenceCreateInfo());
+    auto alloc = vk::CommandBufferAllocateInfo(
+        command_pool, vk::CommandBufferLevel::ePrimary, 1);
+    batch.command_buffer = device->get().allocateCommandBuffers(alloc)[0];
+  }
 
-    printf("[ERROR] - COULD NOT ALLOCATE INTO BUFFER, OUT OF SPACE \n");
-    return 0;
+  batch.command_buffer.begin(vk::CommandBufferBeginInfo(
+      vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+  // uploads submitted earlier may still be writing the sources.
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+
+  std::vector<VkBufferCopy> &regions = compact_regions;
+  regions.clear();
+  for (const Move &move : moves) {
+    VkBufferCopy region{};
+    region.srcOffset = move.from;
+    region.dstOffset = move.to;
+    region.size = move.size;
+    regions.push_back(region);
   }
+  vkCmdCopyBuffer(batch.command_buffer, buffer, buffer,
+                  static_cast<uint32_t>(regions.size()), regions.data());
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                          VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT |
+                          VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                           VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+  batch.command_buffer.end();
+
+  auto submit_info =
+      vk::SubmitInfo(0, nullptr, nullptr, 1, &batch.command_buffer, 0, nullptr);
+  queue.submit(submit_info, batch.fence);
 
-  // TODO: proper check for whether enough space exists (sort if not enough)
-  buffer_size -= allocation_size;
-  VkDeviceSize push_to = offset;
-  offset += allocation_size;
-  allocations.push_back(std::make_pair(push_to, offset));
+  // the batch's vector kept its capacity from the last time it was used.
+  batch.moves.assign(moves.begin(), moves.end());
+  moves_in_flight.push_back(std::move(batch));
+  return true;
+}
 
-  return push_to;
+std::vector<Relocation> StackBuffer::take_relocations() {
+  std::vector<Relocation> finished;
+  finished.swap(relocations);
+  return finished;
+}
+
+GeometryHeapStats StackBuffer::get_stats() const {
+  GeometryHeapStats heap = stats;
+  heap.buffer_bytes = buffer_size;
+  heap.allocations = allocations.size();
+  heap.free_ranges = free_ranges.size();
+  for (const auto &range : allocations) {
+    heap.used_bytes += range.second.size;
+  }
+  for (const auto &range : free_ranges) {
+    heap.free_bytes += range.second;
+  }
+  for (const Retired &range : retired) {
+    heap.retired_bytes += range.size;
+  }
+  if (!free_sizes.empty())
+    heap.largest_free = free_sizes.rbegin()->first;
+  return heap;
 }
 
 // EFFECTS: maps a given chunk of data to this buffer and returns the memory
 // location of where it was mapped
-VkDeviceSize StackBuffer::map(VkDeviceSize data_size, void *data) {
-  VkDeviceSize memory_loc = allocate(data_size);
+VkDeviceSize StackBuffer::map(VkDeviceSize data_size, const void *data,
+                              VkDeviceSize alignment, bool relocatable) {
+  VkDeviceSize memory_loc = allocate(data_size, alignment, relocatable);
 
-  vk::Buffer temp_buffer;
-  vk::DeviceMemory temp_memory;
-  create_inter_buffer(data_size, vk::MemoryPropertyFlagBits::eHostVisible,
-                      temp_buffer, temp_memory);
+  if (staging) {
+    staging->copy(buffer, memory_loc, data_size, data);
+    return memory_loc;
+  }
 
-  auto p_data = device->get().mapMemory(temp_memory, 0, data_size);
+  vk::Buffer temp_buffer;
+  Allocation temp_allocation;
+  create_inter_buffer(data_size,
+                      vk::MemoryPropertyFlagBits::eHostVisible |
+                          vk::MemoryPropertyFlagBits::eHostCoherent,
+                      temp_buffer, temp_allocation);
 
-  memcpy(p_data, data, data_size);
+  memcpy(temp_allocation.mapped, data, data_size);
 
   // map memory to buffer
   copyBuffer(temp_buffer, buffer, memory_loc, data_size);
 
-  device->get().unmapMemory(temp_memory);
-  device->get().freeMemory(temp_memory);
   device->get().destroyBuffer(temp_buffer);
+  device->get_allocator().free(temp_allocation);
 
   return memory_loc;
 }
@@ -367,27 +729,412 @@ void StackBuffer::copyBuffer(VkBuffer src_buffer, VkBuffer dst_buffer,
 
   vkCmdCopyBuffer(transfer_buffer, src_buffer, dst_buffer, 1, &copyData);
 
-  tuco::end_command_buffer(*device, transfer_queue, command_pool,
-                           transfer_buffer);
+  tuco::end_command_buffer(*device, queue, command_pool, transfer_buffer);
 }
 
-void StackBuffer::free(VkDeviceSize delete_offset) {
-  // the only thing the user would have at this point is the offset
-  // this is fine for a free call, we won't actually delete the data, but by
-  // deleting the pointer to that data, when we sort the data later this "freed"
-  // data will be overwritten and disappear
-  for (auto it = allocations.begin(); it != allocations.end(); it++) {
-    if (delete_offset == it->first) {
-      // delete at location
-      allocations.erase(it);
+// copies are staged at this alignment, keeps memcpy and the copy regions on
+// friendly boundaries.
+const VkDeviceSize STAGING_ALIGNMENT = 16;
+
+void StagingRing::init(v::PhysicalDevice &physical_device, v::Device &device,
+                       VkDeviceSize size, VkDeviceSize frame_budget) {
+  StagingRing::device = &device;
+  StagingRing::frame_budget = frame_budget;
+  ring_size = size;
+
+  auto create_info = vk::BufferCreateInfo(
+      {}, size, vk::BufferUsageFlagBits::eTransferSrc,
+      vk::SharingMode::eExclusive, 1, &device.get_graphics_family());
+  buffer = device.get().createBuffer(create_info);
+
+  // plain system memory is preferred, device local host visible memory is
+  // small and better left to resources the gpu reads often.
+  AllocationInfo allocation_info{};
+  allocation_info.required = vk::MemoryPropertyFlagBits::eHostVisible |
+                             vk::MemoryPropertyFlagBits::eHostCoherent;
+  allocation_info.dedicated_buffer = buffer;
+  allocation_info.category = MemoryCategory::Staging;
+  allocation_info.name = "staging ring";
+  allocation = device.get_allocator().allocate(
+      device.get().getBufferMemoryRequirements(buffer), allocation_info);
+  device.get().bindBufferMemory(buffer, allocation.memory, allocation.offset);
+
+  mapped = allocation.mapped;
+
+  dedicated = device.has_dedicated_transfer();
+  auto pool_info = vk::CommandPoolCreateInfo(
+      vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+      dedicated ? device.get_transfer_family() : device.get_graphics_family());
+  command_pool = device.get().createCommandPool(pool_info);
+  if (dedicated) {
+    pool_info.queueFamilyIndex = device.get_graphics_family();
+    acquire_pool = device.get().createCommandPool(pool_info);
+  }
+}
+
+void StagingRing::copy(vk::Buffer dst, VkDeviceSize dst_offset,
+                       VkDeviceSize size, const void *data) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  // a quarter of the ring at a time, the rest stays free for the batches
+  // still in flight.
+  const VkDeviceSize chunk_size = std::max<VkDeviceSize>(
+      ring_size / 4 / STAGING_ALIGNMENT * STAGING_ALIGNMENT, STAGING_ALIGNMENT);
+
+  for (VkDeviceSize done = 0; done < size;) {
+    VkDeviceSize chunk = std::min(chunk_size, size - done);
+    VkDeviceSize src_offset = reserve(chunk);
+    memcpy(mapped + src_offset, bytes + done, chunk);
+
+    Copy copy{};
+    copy.dst = dst;
+    copy.region.srcOffset = src_offset;
+    copy.region.dstOffset = dst_offset + done;
+    copy.region.size = chunk;
+    pending.push_back(copy);
+    pending_staged += chunk;
+
+    done += chunk;
+  }
+
+  stats.frames += frame_bytes == 0 ? 1 : 0;
+  frame_bytes += size;
+  stats.bytes += size;
+  stats.copies++;
+  stats.peak_frame_bytes = std::max(stats.peak_frame_bytes, frame_bytes);
+}
+
+VkDeviceSize StagingRing::reserve(VkDeviceSize size) {
+  if (used == 0)
+    head = 0;
+
+  // the region either follows head or, if it doesn't fit before the end of
+  // the ring, starts over at 0 and the bytes in between are held as padding.
+  VkDeviceSize start =
+      (head + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+  VkDeviceSize padding = start - head;
+  if (start + size > ring_size) {
+    padding = ring_size - head;
+    start = 0;
+  }
+
+  while (used + padding + size > ring_size) {
+    if (in_flight.empty())
+      flush();
+    retire(true);
+    stats.stalls++;
+
+    if (used == 0) {
+      head = 0;
+      start = 0;
+      padding = 0;
+    }
+  }
+
+  head = start + size;
+  used += padding + size;
+  pending_bytes += padding + size;
+  return start;
+}
+
+void StagingRing::flush() {
+  if (pending.empty())
+    return;
+
+  retire(false);
+
+  Batch batch{};
+  if (!idle_batches.empty()) {
+    batch = idle_batches.back();
+    idle_batches.pop_back();
+    device->get().resetFences(batch.fence);
+    batch.command_buffer.reset();
+    if (dedicated)
+      batch.acquire_buffer.reset();
+  } else {
+    batch.fence = device->get().createFence(vk::FenceCreateInfo());
+    auto alloc = vk::CommandBufferAllocateInfo(
+        command_pool, vk::CommandBufferLevel::ePrimary, 1);
+    batch.command_buffer = device->get().allocateCommandBuffers(alloc)[0];
+    if (dedicated) {
+      alloc.commandPool = acquire_pool;
+      batch.acquire_buffer = device->get().allocateCommandBuffers(alloc)[0];
+      batch.semaphore = device->get().createSemaphore(vk::SemaphoreCreateInfo());
+    }
+  }
+
+  batch.command_buffer.begin(vk::CommandBufferBeginInfo(
+      vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+  // one copy command per destination, with every region queued for it. the
+  // regions are in offset order so the ranges they write are easy to merge.
+  std::sort(pending.begin(), pending.end(), [](const Copy &a, const Copy &b) {
+    if (a.dst != b.dst)
+      return static_cast<VkBuffer>(a.dst) < static_cast<VkBuffer>(b.dst);
+    return a.region.dstOffset < b.region.dstOffset;
+  });
+  std::vector<VkBufferCopy> regions;
+  for (size_t i = 0; i < pending.size();) {
+    regions.clear();
+    size_t j = i;
+    for (; j < pending.size() && pending[j].dst == pending[i].dst; j++) {
+      regions.push_back(pending[j].region);
+    }
+    vkCmdCopyBuffer(batch.command_buffer, buffer, pending[i].dst,
+                    static_cast<uint32_t>(regions.size()), regions.data());
+    i = j;
+  }
+
+  const VkAccessFlags reads =
+      VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+  const VkPipelineStageFlags read_stages =
+      VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+  if (dedicated) {
+    // the destinations are exclusive to the graphics family. the transfer
+    // family takes the written ranges over implicitly (their old contents
+    // don't matter) and releases them, graphics acquires them once the
+    // copies are done. the rest of the destination buffers stays with
+    // graphics throughout.
+    gather_ownership_barriers();
+    uint32_t barrier_count = static_cast<uint32_t>(ownership_barriers.size());
+
+    for (VkBufferMemoryBarrier &barrier : ownership_barriers) {
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask = 0;
+    }
+    vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                         barrier_count, ownership_barriers.data(), 0, nullptr);
+    batch.command_buffer.end();
+
+    auto release_info = vk::SubmitInfo(0, nullptr, nullptr, 1,
+                                       &batch.command_buffer, 1,
+                                       &batch.semaphore);
+    device->get_transfer_queue().submit(release_info);
+
+    // the wait only holds up this command buffer, later graphics work is
+    // ordered behind the acquire by the barrier.
+    batch.acquire_buffer.begin(vk::CommandBufferBeginInfo(
+        vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    for (VkBufferMemoryBarrier &barrier : ownership_barriers) {
+      barrier.srcAccessMask = 0;
+      barrier.dstAccessMask = reads;
+    }
+    vkCmdPipelineBarrier(batch.acquire_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         read_stages, 0, 0, nullptr, barrier_count,
+                         ownership_barriers.data(), 0, nullptr);
+    batch.acquire_buffer.end();
+
+    vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eTransfer;
+    auto acquire_info =
+        vk::SubmitInfo(1, &batch.semaphore, &wait_stage, 1,
+                       &batch.acquire_buffer, 0, nullptr);
+    device->get_graphics_queue().submit(acquire_info, batch.fence);
+    stats.released_ranges += barrier_count;
+  } else {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = reads;
+    vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         read_stages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    batch.command_buffer.end();
+
+    auto submit_info = vk::SubmitInfo(0, nullptr, nullptr, 1,
+                                      &batch.command_buffer, 0, nullptr);
+    device->get_graphics_queue().submit(submit_info, batch.fence);
+  }
+
+  batch.bytes = pending_bytes;
+  batch.staged = pending_staged;
+  batch.submitted = std::chrono::steady_clock::now();
+  in_flight.push_back(batch);
+
+  pending.clear();
+  pending_bytes = 0;
+  pending_staged = 0;
+  stats.batches++;
+}
+
+void StagingRing::gather_ownership_barriers() {
+  ownership_barriers.clear();
+  for (const Copy &copy : pending) {
+    VkDeviceSize begin = copy.region.dstOffset;
+    VkDeviceSize end = begin + copy.region.size;
+
+    if (!ownership_barriers.empty()) {
+      VkBufferMemoryBarrier &last = ownership_barriers.back();
+      if (last.buffer == static_cast<VkBuffer>(copy.dst) &&
+          begin <= last.offset + last.size) {
+        last.size = std::max(last.size, end - last.offset);
+        continue;
+      }
+    }
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = device->get_transfer_family();
+    barrier.dstQueueFamilyIndex = device->get_graphics_family();
+    barrier.buffer = copy.dst;
+    barrier.offset = begin;
+    barrier.size = end - begin;
+    ownership_barriers.push_back(barrier);
+  }
+}
+
+void StagingRing::retire(bool wait) {
+  while (!in_flight.empty()) {
+    Batch &batch = in_flight.front();
+    if (wait) {
+      (void)device->get().waitForFences(batch.fence, VK_TRUE, UINT64_MAX);
+      wait = false;
+    } else if (device->get().getFenceStatus(batch.fence) !=
+               vk::Result::eSuccess) {
       break;
     }
+
+    stats.busy_ms += std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - batch.submitted)
+                         .count();
+    used -= batch.bytes;
+    stats.completed_bytes += batch.staged;
+    idle_batches.push_back(batch);
+    in_flight.pop_front();
+  }
+}
+
+void StagingRing::begin_frame() {
+  retire(false);
+  frame_bytes = 0;
+}
+
+bool StagingRing::has_budget(VkDeviceSize size) const {
+  return frame_bytes == 0 || frame_bytes + size <= frame_budget;
+}
+
+void StagingRing::wait_idle() {
+  flush();
+  while (!in_flight.empty()) {
+    retire(true);
+  }
+}
+
+void StagingRing::destroy() {
+  if (!device)
+    return;
+
+  wait_idle();
+  for (Batch &batch : idle_batches) {
+    device->get().destroyFence(batch.fence);
+    if (batch.semaphore)
+      device->get().destroySemaphore(batch.semaphore);
+  }
+  idle_batches.clear();
+
+  device->get().destroyCommandPool(command_pool);
+  if (acquire_pool)
+    device->get().destroyCommandPool(acquire_pool);
+  acquire_pool = nullptr;
+  device->get().destroyBuffer(buffer);
+  device->get_allocator().free(allocation);
+  mapped = nullptr;
+  device = nullptr;
+}
+
+void UniformRing::init(v::PhysicalDevice &physical_device, v::Device &device,
+                       VkDeviceSize region_size, uint32_t region_count) {
+  UniformRing::device = &device;
+  // allocations are bound as uniform or storage buffers.
+  alignment = std::max<VkDeviceSize>(
+      {v::Limits::get().uniformBufferOffsetAlignment,
+       v::Limits::get().storageBufferOffsetAlignment, 1});
+  UniformRing::region_size = align_offset(region_size, alignment);
+  head = 0;
+
+  auto create_info = vk::BufferCreateInfo(
+      {}, UniformRing::region_size * region_count,
+      vk::BufferUsageFlagBits::eUniformBuffer |
+          vk::BufferUsageFlagBits::eStorageBuffer,
+      vk::SharingMode::eExclusive, 1, &device.get_graphics_family());
+  buffer = device.get().createBuffer(create_info);
+
+  // the gpu reads these every draw, device local host visible memory saves
+  // it the trip over the bus where there is some.
+  AllocationInfo allocation_info{};
+  allocation_info.required = vk::MemoryPropertyFlagBits::eHostVisible |
+                             vk::MemoryPropertyFlagBits::eHostCoherent;
+  allocation_info.preferred = vk::MemoryPropertyFlagBits::eDeviceLocal;
+  allocation_info.dedicated_buffer = buffer;
+  allocation_info.category = MemoryCategory::Uniform;
+  allocation_info.name = "uniform ring";
+  allocation = device.get_allocator().allocate(
+      device.get().getBufferMemoryRequirements(buffer), allocation_info);
+  device.get().bindBufferMemory(buffer, allocation.memory, allocation.offset);
+
+  shadow.assign(UniformRing::region_size, 0);
+  dirty.assign(region_count, Dirty{0, 0});
+
+  stats = UniformRingStats{};
+  stats.region_bytes = UniformRing::region_size;
+  stats.regions = region_count;
+}
+
+VkDeviceSize UniformRing::allocate(VkDeviceSize size) {
+  VkDeviceSize offset = align_offset(head, alignment);
+  if (offset + size > region_size) {
+    ERR("{} uniform bytes don't fit the {} left of a {} byte region", size,
+        region_size - std::min(offset, region_size), region_size);
+    throw std::runtime_error("uniform ring region is full");
+  }
+  head = offset + size;
+  stats.used_bytes = head;
+  return offset;
+}
+
+void UniformRing::write(VkDeviceSize offset, VkDeviceSize size,
+                        const void *data) {
+  memcpy(shadow.data() + offset, data, size);
+  for (Dirty &range : dirty) {
+    if (range.begin >= range.end) {
+      range = Dirty{offset, offset + size};
+    } else {
+      range.begin = std::min(range.begin, offset);
+      range.end = std::max(range.end, offset + size);
+    }
   }
 }
 
-Pool::Pool(std::shared_ptr<v::Device> device, std::vector<PoolCreateInfo> info) {
+void UniformRing::flush(uint32_t region) {
+  Dirty &range = dirty[region];
+  if (range.begin >= range.end)
+    return;
+
+  memcpy(allocation.mapped + region * region_size + range.begin,
+         shadow.data() + range.begin, range.end - range.begin);
+  stats.flushed_bytes += range.end - range.begin;
+  stats.flushes++;
+  range = Dirty{0, 0};
+}
+
+void UniformRing::destroy() {
+  if (!device)
+    return;
+
+  device->get().waitIdle();
+  device->get().destroyBuffer(buffer);
+  device->get_allocator().free(allocation);
+  shadow.clear();
+  dirty.clear();
+  device = nullptr;
+}
+
+Pool::Pool(std::shared_ptr<v::Device> device, std::vector<PoolCreateInfo> info,
+           VkDescriptorPoolCreateFlags flags) {
   api_device = device;
   poolInfo = info;
+  pool_flags = flags;
   createPool();
 }
 
@@ -401,9 +1148,14 @@ void Pool::destroyPool() {
     api_device->get().destroyDescriptorPool(pools[i]);
   }
   pools.clear();
+
+  // the sets went with their pools.
+  free_layout_sets.clear();
+  retired_sets.clear();
+  stats = DescriptorPoolStats{};
 }
 
-void Pool::createPool() {
+VkDescriptorPool Pool::create_descriptor_pool() {
   // create pool described by pool_info
   std::vector<VkDescriptorPoolSize> poolSizes;
   for (const auto &size : poolInfo) {
@@ -415,50 +1167,70 @@ void Pool::createPool() {
 
   VkDescriptorPoolCreateInfo poolInfo{};
   poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags = pool_flags;
   poolInfo.maxSets = POOL_MAX_SET_COUNT;
   poolInfo.poolSizeCount = poolSizes.size();
   poolInfo.pPoolSizes = poolSizes.data();
 
-  size_t current_size = pools.size();
-  pools.resize(current_size + 1);
-  pools[current_size] = api_device->get().createDescriptorPool(poolInfo);
+  return api_device->get().createDescriptorPool(poolInfo);
 }
 
-VkDescriptorPool &Pool::getCurrentPool() { return pools[pools.size() - 1]; }
+void Pool::createPool() {
+  pools.push_back(create_descriptor_pool());
+  stats.pools = static_cast<uint32_t>(pools.size());
+}
 
-VkResult Pool::attemptAllocation(v::Device &device, uint32_t setCount,
-                                 VkDescriptorSetLayout layout,
-                                 VkDescriptorSet *sets) {
-  std::vector<VkDescriptorSetLayout> layouts(setCount, layout);
+VkDescriptorPool &Pool::getCurrentPool() { return pools[pools.size() - 1]; }
 
+VkResult Pool::allocate_from(VkDescriptorPool pool, uint32_t set_count,
+                             const VkDescriptorSetLayout *layouts,
+                             VkDescriptorSet *sets) {
   VkDescriptorSetAllocateInfo allocateInfo{};
-  VkDescriptorPool pool = getCurrentPool();
-
   allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
   allocateInfo.descriptorPool = pool;
-  allocateInfo.descriptorSetCount = setCount;
-  allocateInfo.pSetLayouts = layouts.data();
+  allocateInfo.descriptorSetCount = set_count;
+  allocateInfo.pSetLayouts = layouts;
+
+  return vkAllocateDescriptorSets(api_device->get(), &allocateInfo, sets);
+}
 
-  return vkAllocateDescriptorSets(device.get(), &allocateInfo, sets);
+VkResult Pool::attemptAllocation(v::Device &device, uint32_t setCount,
+                                 VkDescriptorSetLayout layout,
+                                 VkDescriptorSet *sets) {
+  std::vector<VkDescriptorSetLayout> layouts(setCount, layout);
+  return allocate_from(getCurrentPool(), setCount, layouts.data(), sets);
 }
 
 void Pool::allocateDescriptorSets(v::Device &device, uint32_t setCount,
                                   VkDescriptorSetLayout layout,
                                   VkDescriptorSet *sets) {
+  // sets given back for the same layout go first.
+  auto free = free_layout_sets.find(layout);
+  if (free != free_layout_sets.end()) {
+    while (setCount > 0 && !free->second.empty()) {
+      *sets++ = free->second.back();
+      free->second.pop_back();
+      setCount--;
+      stats.free_sets--;
+      stats.recycled_sets++;
+    }
+  }
+  if (setCount == 0) {
+    return;
+  }
 
   VkResult result = attemptAllocation(device, setCount, layout, sets);
   if (result == VK_SUCCESS) {
     return;
   }
-  if (result != VK_ERROR_OUT_OF_POOL_MEMORY) {
+  if (result != VK_ERROR_OUT_OF_POOL_MEMORY &&
+      result != VK_ERROR_FRAGMENTED_POOL) {
     ERR("Failed to allocate memory for descriptor sets.");
     throw std::runtime_error("");
   }
 
-  // queue pool for deallocation..
-  // TODO...
-
-  // attempt to make second allocation.
+  // the full pool keeps the sets it has, they are recycled through
+  // free_sets() rather than freed.
   createPool();
   result = attemptAllocation(device, setCount, layout, sets);
   if (result != VK_SUCCESS) {
@@ -468,25 +1240,32 @@ void Pool::allocateDescriptorSets(v::Device &device, uint32_t setCount,
   }
 }
 
-size_t Pool::allocate(VkDeviceSize allocation_size) {
-  // decprecated, use allocateDescriptorSets().
-  return pools.size() - 1;
+void Pool::free_sets(VkDescriptorSetLayout layout, uint32_t count,
+                     const VkDescriptorSet *sets) {
+  for (uint32_t i = 0; i < count; i++) {
+    if (sets[i] != VK_NULL_HANDLE)
+      retired_sets.push_back(RetiredSet{layout, sets[i], frame});
+  }
+  stats.retired_sets = retired_sets.size();
 }
 
-uint32_t mem::findMemoryType(v::PhysicalDevice &physical_device,
-                             uint32_t typeFilter,
-                             vk::MemoryPropertyFlags properties) {
-  auto mem_prop = physical_device.get().getMemoryProperties();
+void Pool::begin_frame() {
+  frame++;
 
-  // uint32_t suitableMemoryForBuffer = 0;
-  for (uint32_t i = 0; i < mem_prop.memoryTypeCount; i++) {
-    if (typeFilter & (1 << i) &&
-        ((mem_prop.memoryTypes[i].propertyFlags & properties) == properties)) {
-      return i;
-    }
+  // the last frame that could have bound these has finished by now.
+  while (!retired_sets.empty() &&
+         retired_sets.front().frame + tuco::MAX_FRAMES_IN_FLIGHT <= frame) {
+    const RetiredSet &retired = retired_sets.front();
+    free_layout_sets[retired.layout].push_back(retired.set);
+    stats.free_sets++;
+    retired_sets.pop_front();
   }
+  stats.retired_sets = retired_sets.size();
+}
 
-  throw std::runtime_error("could not find appropriate memory type");
+size_t Pool::allocate(VkDeviceSize allocation_size) {
+  // decprecated, use allocateDescriptorSets().
+  return pools.size() - 1;
 }
 
 void CommandPool::init(std::shared_ptr<v::Device> device, uint32_t queue_family_index) {
@@ -0,0 +1,125 @@
+#include "mesh_cache.hpp"
+
+#include <bedrock/hash.hpp>
+#include <bedrock/mapped_file.hpp>
+
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+using namespace tuco;
+
+uint64_t tuco::hash_file(const std::string &path) {
+  br::MappedFile file;
+  if (!file.open(path))
+    return 0;
+
+  return br::hash_bytes(file.data(), file.size());
+}
+
+namespace {
+
+// EFFECTS: the json of a .glb (its first chunk) or of a .gltf (the whole
+//          file), empty if a .glb has no json chunk.
+std::string_view get_gltf_json(const unsigned char *data, size_t size) {
+  const uint32_t glb_magic = 0x46546C67;  // "glTF"
+  const uint32_t json_chunk = 0x4E4F534A; // "JSON"
+
+  uint32_t magic = 0;
+  if (size >= sizeof(magic))
+    memcpy(&magic, data, sizeof(magic));
+  if (magic != glb_magic)
+    return {reinterpret_cast<const char *>(data), size};
+
+  // 12 byte header, then the chunk length and type.
+  uint32_t chunk[2];
+  if (size < 12 + sizeof(chunk))
+    return {};
+  memcpy(chunk, data + 12, sizeof(chunk));
+  if (chunk[1] != json_chunk || chunk[0] > size - 12 - sizeof(chunk))
+    return {};
+  return {reinterpret_cast<const char *>(data) + 12 + sizeof(chunk), chunk[0]};
+}
+
+int get_hex_digit(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+// EFFECTS: the values of every "uri" key in json, json escapes and percent
+//          encoding undone the way the importer does. embedded (data:) uris
+//          are left out, they are part of the json already.
+std::vector<std::string> get_gltf_uris(std::string_view json) {
+  const std::string_view key = "\"uri\"";
+  std::vector<std::string> uris;
+
+  for (size_t at = json.find(key); at != std::string_view::npos;
+       at = json.find(key, at)) {
+    at += key.size();
+    size_t colon = json.find_first_not_of(" \t\r\n", at);
+    if (colon == std::string_view::npos || json[colon] != ':')
+      continue;
+    size_t quote = json.find_first_not_of(" \t\r\n", colon + 1);
+    if (quote == std::string_view::npos || json[quote] != '"')
+      continue;
+
+    std::string uri;
+    size_t i = quote + 1;
+    for (; i < json.size() && json[i] != '"'; i++) {
+      char c = json[i];
+      // \" and \/ are all that shows up in a path.
+      if (c == '\\' && i + 1 < json.size()) {
+        c = json[++i];
+      } else if (c == '%' && i + 2 < json.size() &&
+                 get_hex_digit(json[i + 1]) >= 0 &&
+                 get_hex_digit(json[i + 2]) >= 0) {
+        c = static_cast<char>(get_hex_digit(json[i + 1]) * 16 +
+                              get_hex_digit(json[i + 2]));
+        i += 2;
+      }
+      uri += c;
+    }
+    at = i;
+
+    if (uri.compare(0, 5, "data:") != 0)
+      uris.push_back(std::move(uri));
+  }
+  return uris;
+}
+
+} // namespace
+
+uint64_t tuco::hash_gltf(const std::string &path) {
+  br::MappedFile file;
+  if (!file.open(path))
+    return 0;
+
+  uint64_t hash = br::hash_bytes(file.data(), file.size());
+  std::filesystem::path directory = std::filesystem::path(path).parent_path();
+
+  // same mixing as hash_bytes, one word per referenced file in the order the
+  // json lists them.
+  const uint64_t prime = 0x100000001B3ull;
+  for (const std::string &uri :
+       get_gltf_uris(get_gltf_json(file.data(), file.size()))) {
+    uint64_t file_hash = hash_file((directory / uri).string());
+    if (file_hash == 0)
+      return 0;
+    hash = (hash ^ file_hash) * prime;
+    hash ^= hash >> 29;
+  }
+  return hash == 0 ? 1 : hash;
+}
+
+std::string tuco::get_mesh_cache_path(const std::string &source_path,
+                                      const std::string &name) {
+  std::filesystem::path path = std::filesystem::path(source_path).parent_path();
+  path /= name + MESH_CACHE_EXTENSION;
+  return path.string();
+}
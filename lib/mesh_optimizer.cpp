@@ -0,0 +1,382 @@
+#include "mesh_optimizer.hpp"
+
+#include <bedrock/parallel_for.hpp>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace tuco;
+
+namespace {
+
+uint32_t hash_vertex(const Vertex &vertex) {
+  uint32_t words[sizeof(Vertex) / sizeof(uint32_t)];
+  memcpy(words, &vertex, sizeof(words));
+
+  uint32_t hash = 2166136261u;
+  for (uint32_t word : words) {
+    hash = (hash ^ word) * 16777619u;
+  }
+  return hash ^ (hash >> 15);
+}
+
+// EFFECTS: returns a vertex that still has triangles to emit, first from the
+//          recently used ones, then by scanning forward from cursor. -1 when
+//          every triangle has been emitted.
+int64_t skip_dead_end(std::vector<uint32_t> &dead_end,
+                      const std::vector<uint32_t> &live, size_t &cursor) {
+  while (!dead_end.empty()) {
+    uint32_t vertex = dead_end.back();
+    dead_end.pop_back();
+    if (live[vertex] > 0)
+      return vertex;
+  }
+
+  while (cursor < live.size()) {
+    if (live[cursor] > 0)
+      return static_cast<int64_t>(cursor);
+    cursor++;
+  }
+
+  return -1;
+}
+
+} // namespace
+
+VertexCacheStats tuco::analyze_vertex_cache(const uint32_t *indices,
+                                            size_t index_count,
+                                            size_t vertex_count,
+                                            uint32_t cache_size) {
+  VertexCacheStats stats{};
+  stats.triangles = index_count / 3;
+
+  std::vector<uint32_t> cache_time(vertex_count, 0);
+  std::vector<bool> referenced(vertex_count, false);
+  uint32_t time = cache_size + 1;
+
+  for (size_t i = 0; i < index_count; i++) {
+    uint32_t vertex = indices[i];
+    if (time - cache_time[vertex] > cache_size) {
+      cache_time[vertex] = time++;
+      stats.misses++;
+    }
+    if (!referenced[vertex]) {
+      referenced[vertex] = true;
+      stats.vertices++;
+    }
+  }
+
+  return stats;
+}
+
+size_t tuco::weld_vertices(std::vector<Vertex> &vertices,
+                           std::vector<uint32_t> &indices) {
+  const uint32_t empty = UINT32_MAX;
+
+  size_t table_size = 1;
+  while (table_size < vertices.size() * 2) {
+    table_size <<= 1;
+  }
+  const size_t mask = table_size - 1;
+
+  std::vector<uint32_t> table(table_size, empty);
+  std::vector<uint32_t> remap(vertices.size());
+  std::vector<Vertex> unique;
+  unique.reserve(vertices.size());
+
+  for (size_t v = 0; v < vertices.size(); v++) {
+    size_t slot = hash_vertex(vertices[v]) & mask;
+    while (table[slot] != empty &&
+           memcmp(&unique[table[slot]], &vertices[v], sizeof(Vertex)) != 0) {
+      slot = (slot + 1) & mask;
+    }
+
+    if (table[slot] == empty) {
+      table[slot] = static_cast<uint32_t>(unique.size());
+      unique.push_back(vertices[v]);
+    }
+    remap[v] = table[slot];
+  }
+
+  for (uint32_t &index : indices) {
+    index = remap[index];
+  }
+
+  vertices.swap(unique);
+  return vertices.size();
+}
+
+void tuco::optimize_vertex_cache(std::vector<uint32_t> &indices,
+                                 size_t vertex_count, uint32_t cache_size,
+                                 std::vector<size_t> *clusters) {
+  const size_t triangle_count = indices.size() / 3;
+  if (triangle_count == 0)
+    return;
+
+  // vertex -> triangle adjacency, stored compressed.
+  std::vector<uint32_t> live(vertex_count, 0);
+  for (uint32_t index : indices) {
+    live[index]++;
+  }
+
+  std::vector<uint32_t> offsets(vertex_count + 1, 0);
+  for (size_t v = 0; v < vertex_count; v++) {
+    offsets[v + 1] = offsets[v] + live[v];
+  }
+
+  std::vector<uint32_t> adjacency(indices.size());
+  std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t t = 0; t < triangle_count; t++) {
+    for (size_t c = 0; c < 3; c++) {
+      adjacency[fill[indices[t * 3 + c]]++] = static_cast<uint32_t>(t);
+    }
+  }
+
+  std::vector<uint32_t> cache_time(vertex_count, 0);
+  std::vector<bool> emitted(triangle_count, false);
+  std::vector<uint32_t> dead_end;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> output;
+  dead_end.reserve(indices.size());
+  output.reserve(indices.size());
+
+  uint32_t time = cache_size + 1;
+  size_t cursor = 0;
+
+  int64_t fanning = skip_dead_end(dead_end, live, cursor);
+  if (clusters)
+    clusters->push_back(0);
+
+  while (fanning >= 0) {
+    candidates.clear();
+
+    // emit every remaining triangle around the fanning vertex.
+    for (uint32_t a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+      uint32_t triangle = adjacency[a];
+      if (emitted[triangle])
+        continue;
+
+      for (size_t c = 0; c < 3; c++) {
+        uint32_t vertex = indices[triangle * 3 + c];
+        output.push_back(vertex);
+        dead_end.push_back(vertex);
+        candidates.push_back(vertex);
+        live[vertex]--;
+        if (time - cache_time[vertex] > cache_size) {
+          cache_time[vertex] = time++;
+        }
+      }
+      emitted[triangle] = true;
+    }
+
+    // next fanning vertex is the oldest candidate that will still be in the
+    // cache after its own triangles are emitted.
+    int64_t best = -1;
+    int64_t best_priority = -1;
+    for (uint32_t vertex : candidates) {
+      if (live[vertex] == 0)
+        continue;
+
+      int64_t priority = 0;
+      if (time - cache_time[vertex] + 2 * live[vertex] <= cache_size) {
+        priority = time - cache_time[vertex];
+      }
+      if (priority > best_priority) {
+        best_priority = priority;
+        best = vertex;
+      }
+    }
+
+    if (best == -1) {
+      best = skip_dead_end(dead_end, live, cursor);
+      if (best >= 0 && clusters)
+        clusters->push_back(output.size());
+    }
+
+    fanning = best;
+  }
+
+  indices.swap(output);
+}
+
+void tuco::optimize_overdraw(std::vector<uint32_t> &indices,
+                             const std::vector<Vertex> &vertices,
+                             const std::vector<size_t> &clusters,
+                             uint32_t cache_size, float threshold) {
+  if (clusters.size() <= 1 || vertices.empty())
+    return;
+
+  glm::vec3 mesh_center = glm::vec3(0.0f);
+  for (const Vertex &vertex : vertices) {
+    mesh_center += glm::vec3(vertex.position);
+  }
+  mesh_center /= static_cast<float>(vertices.size());
+
+  struct Cluster {
+    size_t begin;
+    size_t end;
+    float key;
+  };
+  std::vector<Cluster> sorted(clusters.size());
+
+  for (size_t c = 0; c < clusters.size(); c++) {
+    Cluster &cluster = sorted[c];
+    cluster.begin = clusters[c];
+    cluster.end = c + 1 < clusters.size() ? clusters[c + 1] : indices.size();
+
+    glm::vec3 centroid = glm::vec3(0.0f);
+    glm::vec3 normal = glm::vec3(0.0f);
+    float area = 0.0f;
+    for (size_t i = cluster.begin; i + 2 < cluster.end; i += 3) {
+      glm::vec3 p0 = glm::vec3(vertices[indices[i + 0]].position);
+      glm::vec3 p1 = glm::vec3(vertices[indices[i + 1]].position);
+      glm::vec3 p2 = glm::vec3(vertices[indices[i + 2]].position);
+
+      glm::vec3 face = glm::cross(p1 - p0, p2 - p0);
+      float face_area = glm::length(face);
+
+      centroid += (p0 + p1 + p2) * (face_area / 3.0f);
+      normal += face;
+      area += face_area;
+    }
+
+    float normal_length = glm::length(normal);
+    if (area <= 0.0f || normal_length <= 0.0f) {
+      cluster.key = 0.0f;
+      continue;
+    }
+
+    // clusters facing away from the center are the ones most likely to occlude
+    // others, so they should be drawn first.
+    cluster.key =
+        glm::dot(centroid / area - mesh_center, normal / normal_length);
+  }
+
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const Cluster &a, const Cluster &b) {
+                     return a.key > b.key;
+                   });
+
+  std::vector<uint32_t> reordered;
+  reordered.reserve(indices.size());
+  for (const Cluster &cluster : sorted) {
+    reordered.insert(reordered.end(), indices.begin() + cluster.begin,
+                     indices.begin() + cluster.end);
+  }
+
+  float current = analyze_vertex_cache(indices.data(), indices.size(),
+                                       vertices.size(), cache_size)
+                      .get_acmr();
+  float candidate = analyze_vertex_cache(reordered.data(), reordered.size(),
+                                         vertices.size(), cache_size)
+                        .get_acmr();
+
+  if (candidate <= current * threshold) {
+    indices.swap(reordered);
+  }
+}
+
+size_t tuco::optimize_vertex_fetch(std::vector<Vertex> &vertices,
+                                   std::vector<uint32_t> &indices) {
+  const uint32_t unused = UINT32_MAX;
+
+  std::vector<uint32_t> remap(vertices.size(), unused);
+  std::vector<Vertex> ordered;
+  ordered.reserve(vertices.size());
+
+  for (uint32_t &index : indices) {
+    if (remap[index] == unused) {
+      remap[index] = static_cast<uint32_t>(ordered.size());
+      ordered.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+
+  vertices.swap(ordered);
+  return vertices.size();
+}
+
+MeshOptimizeStats tuco::optimize_mesh(std::vector<Vertex> &vertices,
+                                      std::vector<uint32_t> &indices,
+                                      std::vector<Primitive> &primitives,
+                                      size_t first_primitive,
+                                      size_t vertex_begin, size_t index_begin,
+                                      uint32_t cache_size) {
+  MeshOptimizeStats stats{};
+  if (first_primitive >= primitives.size())
+    return stats;
+
+  struct Work {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    VertexCacheStats before;
+    VertexCacheStats after;
+    size_t vertices_before = 0;
+  };
+
+  const size_t work_count = primitives.size() - first_primitive;
+  std::vector<Work> work(work_count);
+
+  br::parallel_for(work_count, [&](size_t w) {
+    const Primitive &prim = primitives[first_primitive + w];
+    Work &out = work[w];
+    if (prim.index_count == 0)
+      return;
+
+    auto begin = indices.begin() + prim.index_start;
+    auto end = begin + prim.index_count;
+    uint32_t min_index = *std::min_element(begin, end);
+    uint32_t max_index = *std::max_element(begin, end);
+
+    out.vertices.assign(vertices.begin() + min_index,
+                        vertices.begin() + max_index + 1);
+    out.indices.resize(prim.index_count);
+    for (uint32_t k = 0; k < prim.index_count; k++) {
+      out.indices[k] = indices[prim.index_start + k] - min_index;
+    }
+
+    out.vertices_before = out.vertices.size();
+    out.before = analyze_vertex_cache(out.indices.data(), out.indices.size(),
+                                      out.vertices.size(), cache_size);
+
+    // only triangle lists can be reordered.
+    if (prim.index_count % 3 == 0) {
+      weld_vertices(out.vertices, out.indices);
+
+      std::vector<size_t> clusters;
+      optimize_vertex_cache(out.indices, out.vertices.size(), cache_size,
+                            &clusters);
+      optimize_overdraw(out.indices, out.vertices, clusters, cache_size);
+    }
+    optimize_vertex_fetch(out.vertices, out.indices);
+
+    out.after = analyze_vertex_cache(out.indices.data(), out.indices.size(),
+                                     out.vertices.size(), cache_size);
+  });
+
+  // stitch the optimized primitives back together in their original order.
+  vertices.resize(vertex_begin);
+  indices.resize(index_begin);
+  for (size_t w = 0; w < work_count; w++) {
+    Primitive &prim = primitives[first_primitive + w];
+    Work &out = work[w];
+
+    uint32_t vertex_base = static_cast<uint32_t>(vertices.size());
+    prim.index_start = static_cast<uint32_t>(indices.size());
+    prim.index_count = static_cast<uint32_t>(out.indices.size());
+
+    vertices.insert(vertices.end(), out.vertices.begin(), out.vertices.end());
+    for (uint32_t index : out.indices) {
+      indices.push_back(index + vertex_base);
+    }
+
+    stats.before.add(out.before);
+    stats.after.add(out.after);
+    stats.vertices_before += out.vertices_before;
+    stats.vertices_after += out.vertices.size();
+  }
+
+  return stats;
+}
@@ -0,0 +1,351 @@
+#include "mesh_simplifier.hpp"
+
+#include "mesh_optimizer.hpp"
+
+#include <bedrock/parallel_for.hpp>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using namespace tuco;
+
+namespace {
+
+// symmetric 4x4 error matrix stored as its upper triangle. weight is the total
+// area the planes were accumulated over, so evaluate() returns a squared
+// distance rather than something that grows with the triangle size.
+struct Quadric {
+  double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+  double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+  double a22 = 0.0, a23 = 0.0;
+  double a33 = 0.0;
+  double weight = 0.0;
+
+  static Quadric from_plane(const glm::dvec3 &n, double d, double area) {
+    Quadric q{};
+    q.a00 = area * n.x * n.x;
+    q.a01 = area * n.x * n.y;
+    q.a02 = area * n.x * n.z;
+    q.a03 = area * n.x * d;
+    q.a11 = area * n.y * n.y;
+    q.a12 = area * n.y * n.z;
+    q.a13 = area * n.y * d;
+    q.a22 = area * n.z * n.z;
+    q.a23 = area * n.z * d;
+    q.a33 = area * d * d;
+    q.weight = area;
+    return q;
+  }
+
+  void add(const Quadric &other) {
+    a00 += other.a00;
+    a01 += other.a01;
+    a02 += other.a02;
+    a03 += other.a03;
+    a11 += other.a11;
+    a12 += other.a12;
+    a13 += other.a13;
+    a22 += other.a22;
+    a23 += other.a23;
+    a33 += other.a33;
+    weight += other.weight;
+  }
+
+  double evaluate(const glm::dvec3 &p) const {
+    if (weight <= 0.0)
+      return 0.0;
+
+    double error = a00 * p.x * p.x + 2.0 * a01 * p.x * p.y +
+                   2.0 * a02 * p.x * p.z + 2.0 * a03 * p.x +
+                   a11 * p.y * p.y + 2.0 * a12 * p.y * p.z + 2.0 * a13 * p.y +
+                   a22 * p.z * p.z + 2.0 * a23 * p.z + a33;
+    return std::max(error, 0.0) / weight;
+  }
+};
+
+struct Collapse {
+  uint32_t from;
+  uint32_t to;
+  double cost;
+};
+
+// EFFECTS: returns true if moving from onto to turns any of the triangles
+//          around from (that survive the collapse) upside down.
+bool collapse_flips(const Collapse &collapse,
+                    const std::vector<glm::dvec3> &positions,
+                    const std::vector<uint32_t> &triangles,
+                    const std::vector<uint32_t> &offsets,
+                    const std::vector<uint32_t> &adjacency) {
+  for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1];
+       a++) {
+    const uint32_t *triangle = &triangles[adjacency[a] * 3];
+    if (triangle[0] == collapse.to || triangle[1] == collapse.to ||
+        triangle[2] == collapse.to)
+      continue;
+
+    glm::dvec3 before[3];
+    glm::dvec3 after[3];
+    for (size_t c = 0; c < 3; c++) {
+      before[c] = positions[triangle[c]];
+      after[c] = triangle[c] == collapse.from ? positions[collapse.to]
+                                              : before[c];
+    }
+
+    glm::dvec3 normal_before =
+        glm::cross(before[1] - before[0], before[2] - before[0]);
+    glm::dvec3 normal_after =
+        glm::cross(after[1] - after[0], after[2] - after[0]);
+    if (glm::dot(normal_before, normal_after) <= 0.0)
+      return true;
+  }
+
+  return false;
+}
+
+} // namespace
+
+std::vector<SimplifiedLevel>
+tuco::simplify_mesh(const Vertex *vertices, size_t vertex_count,
+                    const std::vector<uint32_t> &indices, uint32_t level_count,
+                    float ratio) {
+  std::vector<SimplifiedLevel> levels;
+  if (level_count == 0 || indices.size() < 3 || ratio <= 0.0f ||
+      ratio >= 1.0f)
+    return levels;
+
+  std::vector<glm::dvec3> positions(vertex_count);
+  for (size_t v = 0; v < vertex_count; v++) {
+    positions[v] = glm::dvec3(glm::vec3(vertices[v].position));
+  }
+
+  std::vector<uint32_t> current(indices.begin(),
+                                indices.begin() + indices.size() / 3 * 3);
+
+  std::vector<Quadric> quadrics(vertex_count);
+  for (size_t i = 0; i < current.size(); i += 3) {
+    const glm::dvec3 &p0 = positions[current[i + 0]];
+    const glm::dvec3 &p1 = positions[current[i + 1]];
+    const glm::dvec3 &p2 = positions[current[i + 2]];
+
+    glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+    double area = glm::length(normal);
+    if (area <= 0.0)
+      continue;
+    normal /= area;
+
+    Quadric plane = Quadric::from_plane(normal, -glm::dot(normal, p0), area);
+    for (size_t c = 0; c < 3; c++) {
+      quadrics[current[i + c]].add(plane);
+    }
+  }
+
+  // vertices on open edges stay put, moving them would tear the surface.
+  // uv/normal seams are open edges as well since their vertices aren't shared.
+  std::vector<bool> locked(vertex_count, false);
+  {
+    std::vector<uint64_t> edges;
+    edges.reserve(current.size());
+    for (size_t i = 0; i < current.size(); i += 3) {
+      for (size_t c = 0; c < 3; c++) {
+        uint32_t a = current[i + c];
+        uint32_t b = current[i + (c + 1) % 3];
+        edges.push_back(uint64_t(std::min(a, b)) << 32 | std::max(a, b));
+      }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    for (size_t i = 0; i < edges.size();) {
+      size_t j = i + 1;
+      while (j < edges.size() && edges[j] == edges[i]) {
+        j++;
+      }
+      if (j - i == 1) {
+        locked[edges[i] >> 32] = true;
+        locked[edges[i] & UINT32_MAX] = true;
+      }
+      i = j;
+    }
+  }
+
+  std::vector<uint32_t> remap(vertex_count);
+  std::vector<bool> touched(vertex_count);
+  std::vector<uint32_t> offsets(vertex_count + 1);
+  std::vector<uint32_t> adjacency;
+  std::vector<uint32_t> fill;
+  std::vector<Collapse> collapses;
+
+  double max_error = 0.0;
+  double target = static_cast<double>(current.size());
+  bool stalled = false;
+
+  while (levels.size() < level_count && !stalled) {
+    target *= ratio;
+    size_t target_count = static_cast<size_t>(target) / 3 * 3;
+    if (target_count < 3)
+      break;
+
+    while (current.size() > target_count) {
+      // vertex -> triangle adjacency of what is left of the mesh.
+      std::fill(offsets.begin(), offsets.end(), 0);
+      for (uint32_t index : current) {
+        offsets[index + 1]++;
+      }
+      for (size_t v = 0; v < vertex_count; v++) {
+        offsets[v + 1] += offsets[v];
+      }
+      adjacency.resize(current.size());
+      fill.assign(offsets.begin(), offsets.end() - 1);
+      for (size_t i = 0; i < current.size(); i++) {
+        adjacency[fill[current[i]]++] = static_cast<uint32_t>(i / 3);
+      }
+
+      collapses.clear();
+      for (size_t i = 0; i < current.size(); i += 3) {
+        for (size_t c = 0; c < 3; c++) {
+          uint32_t a = current[i + c];
+          uint32_t b = current[i + (c + 1) % 3];
+          if (a == b)
+            continue;
+
+          for (uint32_t from : {a, b}) {
+            uint32_t to = from == a ? b : a;
+            if (locked[from])
+              continue;
+
+            Quadric sum = quadrics[from];
+            sum.add(quadrics[to]);
+            collapses.push_back({from, to, sum.evaluate(positions[to])});
+          }
+        }
+      }
+
+      std::sort(collapses.begin(), collapses.end(),
+                [](const Collapse &a, const Collapse &b) {
+                  return a.cost < b.cost;
+                });
+
+      // a collapse removes about two triangles, stop the pass once that is
+      // enough to reach the target so the level doesn't overshoot.
+      size_t collapse_limit =
+          std::max<size_t>(1, (current.size() - target_count) / 3 / 2);
+      size_t collapsed = 0;
+
+      std::iota(remap.begin(), remap.end(), 0);
+      std::fill(touched.begin(), touched.end(), false);
+
+      for (const Collapse &collapse : collapses) {
+        if (collapsed >= collapse_limit)
+          break;
+        // each vertex takes part in at most one collapse per pass, which keeps
+        // remap a single level deep.
+        if (touched[collapse.from] || touched[collapse.to])
+          continue;
+        if (collapse_flips(collapse, positions, current, offsets, adjacency))
+          continue;
+
+        remap[collapse.from] = collapse.to;
+        touched[collapse.from] = true;
+        touched[collapse.to] = true;
+        quadrics[collapse.to].add(quadrics[collapse.from]);
+        max_error = std::max(max_error, collapse.cost);
+        collapsed++;
+      }
+
+      if (collapsed == 0) {
+        stalled = true;
+        break;
+      }
+
+      size_t write = 0;
+      for (size_t i = 0; i < current.size(); i += 3) {
+        uint32_t a = remap[current[i + 0]];
+        uint32_t b = remap[current[i + 1]];
+        uint32_t c = remap[current[i + 2]];
+        if (a == b || b == c || a == c)
+          continue;
+
+        current[write++] = a;
+        current[write++] = b;
+        current[write++] = c;
+      }
+      current.resize(write);
+    }
+
+    // only keep levels that are a real reduction over the one before.
+    size_t previous =
+        levels.empty() ? indices.size() : levels.back().indices.size();
+    if (current.size() * 10 > previous * 9)
+      break;
+
+    SimplifiedLevel level;
+    level.indices = current;
+    level.error = static_cast<float>(std::sqrt(max_error));
+    levels.push_back(std::move(level));
+  }
+
+  return levels;
+}
+
+void tuco::generate_lods(const std::vector<Vertex> &vertices,
+                         std::vector<uint32_t> &indices,
+                         std::vector<Primitive> &primitives,
+                         size_t first_primitive, uint32_t lod_count,
+                         float ratio) {
+  lod_count = std::min(lod_count, MAX_LOD_COUNT - 1);
+  if (lod_count == 0 || first_primitive >= primitives.size())
+    return;
+
+  struct Work {
+    uint32_t min_index = 0;
+    std::vector<SimplifiedLevel> levels;
+  };
+
+  const size_t work_count = primitives.size() - first_primitive;
+  std::vector<Work> work(work_count);
+
+  br::parallel_for(work_count, [&](size_t w) {
+    const Primitive &prim = primitives[first_primitive + w];
+    Work &out = work[w];
+    if (prim.index_count < MIN_LOD_TRIANGLES * 3 || prim.index_count % 3 != 0)
+      return;
+
+    auto begin = indices.begin() + prim.index_start;
+    auto end = begin + prim.index_count;
+    uint32_t min_index = *std::min_element(begin, end);
+    uint32_t max_index = *std::max_element(begin, end);
+    size_t vertex_count = size_t(max_index - min_index) + 1;
+
+    std::vector<uint32_t> local(prim.index_count);
+    for (uint32_t k = 0; k < prim.index_count; k++) {
+      local[k] = indices[prim.index_start + k] - min_index;
+    }
+
+    out.min_index = min_index;
+    out.levels = simplify_mesh(vertices.data() + min_index, vertex_count,
+                               local, lod_count, ratio);
+    for (SimplifiedLevel &level : out.levels) {
+      optimize_vertex_cache(level.indices, vertex_count,
+                            DEFAULT_VERTEX_CACHE_SIZE);
+    }
+  });
+
+  for (size_t w = 0; w < work_count; w++) {
+    Primitive &prim = primitives[first_primitive + w];
+    const Work &out = work[w];
+
+    prim.lod_count = 0;
+    for (const SimplifiedLevel &level : out.levels) {
+      PrimitiveLod &lod = prim.lods[prim.lod_count++];
+      lod.index_start = static_cast<uint32_t>(indices.size());
+      lod.index_count = static_cast<uint32_t>(level.indices.size());
+      lod.error = level.error;
+
+      for (uint32_t index : level.indices) {
+        indices.push_back(index + out.min_index);
+      }
+    }
+  }
+}
@@ -0,0 +1,155 @@
+#include "meshlet.hpp"
+
+#include <bedrock/parallel_for.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace tuco;
+
+namespace {
+
+// normals spread wider than this (cos of the half angle) make the cone test
+// useless, it is disabled for those meshlets.
+const float MIN_CONE_SPREAD = 0.1f;
+
+void compute_bounds(const std::vector<Vertex> &vertices,
+                    const std::vector<uint32_t> &indices, Meshlet &meshlet) {
+  const uint32_t *first = &indices[meshlet.index_start];
+
+  glm::vec3 min = glm::vec3(vertices[first[0]].position);
+  glm::vec3 max = min;
+  for (uint32_t i = 1; i < meshlet.index_count; i++) {
+    glm::vec3 position = glm::vec3(vertices[first[i]].position);
+    min = glm::min(min, position);
+    max = glm::max(max, position);
+  }
+
+  meshlet.center = (min + max) * 0.5f;
+  float radius_squared = 0.0f;
+  for (uint32_t i = 0; i < meshlet.index_count; i++) {
+    glm::vec3 offset = glm::vec3(vertices[first[i]].position) - meshlet.center;
+    radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+  }
+  meshlet.radius = std::sqrt(radius_squared);
+
+  // the cone is built from the geometric normals, the shading normals don't
+  // decide what the rasterizer culls.
+  std::vector<glm::vec3> normals;
+  normals.reserve(meshlet.index_count / 3);
+  glm::vec3 axis = glm::vec3(0.0f);
+  for (uint32_t i = 0; i + 2 < meshlet.index_count; i += 3) {
+    glm::vec3 p0 = glm::vec3(vertices[first[i + 0]].position);
+    glm::vec3 p1 = glm::vec3(vertices[first[i + 1]].position);
+    glm::vec3 p2 = glm::vec3(vertices[first[i + 2]].position);
+
+    glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+    float length = glm::length(normal);
+    if (length <= 0.0f)
+      continue;
+
+    normals.push_back(normal / length);
+    axis += normals.back();
+  }
+
+  meshlet.cone_axis = glm::vec3(0.0f, 0.0f, 1.0f);
+  meshlet.cone_cutoff = 1.0f;
+
+  float axis_length = glm::length(axis);
+  if (normals.empty() || axis_length <= 0.0f)
+    return;
+  axis /= axis_length;
+
+  float min_dot = 1.0f;
+  for (const glm::vec3 &normal : normals) {
+    min_dot = std::min(min_dot, glm::dot(normal, axis));
+  }
+
+  meshlet.cone_axis = axis;
+  if (min_dot > MIN_CONE_SPREAD) {
+    // sin of the cone's half angle, the view direction has to be within
+    // 90 - angle degrees of the axis for every triangle to face away.
+    meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+  }
+}
+
+} // namespace
+
+void tuco::build_meshlets(const std::vector<Vertex> &vertices,
+                          const std::vector<uint32_t> &indices,
+                          std::vector<Primitive> &primitives,
+                          size_t first_primitive,
+                          std::vector<Meshlet> &meshlets) {
+  if (first_primitive >= primitives.size())
+    return;
+
+  const size_t work_count = primitives.size() - first_primitive;
+  std::vector<std::vector<Meshlet>> work(work_count);
+
+  br::parallel_for(work_count, [&](size_t w) {
+    const Primitive &prim = primitives[first_primitive + w];
+    std::vector<Meshlet> &out = work[w];
+    if (prim.index_count < 3 || prim.index_count % 3 != 0)
+      return;
+
+    auto begin = indices.begin() + prim.index_start;
+    auto end = begin + prim.index_count;
+    uint32_t min_index = *std::min_element(begin, end);
+    uint32_t max_index = *std::max_element(begin, end);
+
+    // which meshlet last counted a vertex, so uniqueness is a lookup.
+    std::vector<uint32_t> seen_in(size_t(max_index - min_index) + 1,
+                                  UINT32_MAX);
+
+    Meshlet current{};
+    current.index_start = prim.index_start;
+    uint32_t current_id = 0;
+
+    for (uint32_t i = 0; i < prim.index_count; i += 3) {
+      const uint32_t *triangle = &indices[prim.index_start + i];
+
+      uint32_t new_vertices = 0;
+      for (size_t c = 0; c < 3; c++) {
+        uint32_t local = triangle[c] - min_index;
+        bool repeated = (c > 0 && triangle[c] == triangle[0]) ||
+                        (c > 1 && triangle[c] == triangle[1]);
+        if (seen_in[local] != current_id && !repeated)
+          new_vertices++;
+      }
+
+      if (current.vertex_count + new_vertices > MESHLET_MAX_VERTICES ||
+          current.index_count / 3 + 1 > MESHLET_MAX_TRIANGLES) {
+        compute_bounds(vertices, indices, current);
+        out.push_back(current);
+
+        current = Meshlet{};
+        current.index_start = prim.index_start + i;
+        current_id++;
+        new_vertices = 0;
+        for (size_t c = 0; c < 3; c++) {
+          bool repeated = (c > 0 && triangle[c] == triangle[0]) ||
+                          (c > 1 && triangle[c] == triangle[1]);
+          new_vertices += repeated ? 0 : 1;
+        }
+      }
+
+      for (size_t c = 0; c < 3; c++) {
+        seen_in[triangle[c] - min_index] = current_id;
+      }
+      current.vertex_count += new_vertices;
+      current.index_count += 3;
+    }
+
+    if (current.index_count > 0) {
+      compute_bounds(vertices, indices, current);
+      out.push_back(current);
+    }
+  });
+
+  for (size_t w = 0; w < work_count; w++) {
+    Primitive &prim = primitives[first_primitive + w];
+    prim.meshlet_start = static_cast<uint32_t>(meshlets.size());
+    prim.meshlet_count = static_cast<uint32_t>(work[w].size());
+    meshlets.insert(meshlets.end(), work[w].begin(), work[w].end());
+  }
+}
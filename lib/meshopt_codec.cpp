@@ -0,0 +1,559 @@
+#include "meshopt_codec.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TUCO_MESHOPT_SSE 1
+#endif
+
+using namespace tuco;
+
+namespace {
+
+const unsigned char VERTEX_HEADER = 0xa0;
+const unsigned char INDEX_HEADER = 0xe0;
+const unsigned char SEQUENCE_HEADER = 0xd0;
+
+const size_t VERTEX_BLOCK_SIZE_BYTES = 8192;
+const size_t VERTEX_BLOCK_MAX_SIZE = 256;
+const size_t BYTE_GROUP_SIZE = 16;
+// largest encoded group (8 bytes of 4 bit values + 16 escapes), checked once
+// per group so the group decoders don't need bounds checks.
+const size_t BYTE_GROUP_DECODE_LIMIT = 24;
+const size_t TAIL_MAX_SIZE = 32;
+
+size_t get_vertex_block_size(size_t stride) {
+  size_t result = (VERTEX_BLOCK_SIZE_BYTES / stride) & ~(BYTE_GROUP_SIZE - 1);
+  return std::min(result, VERTEX_BLOCK_MAX_SIZE);
+}
+
+inline unsigned char unzigzag8(unsigned char v) {
+  return static_cast<unsigned char>(-(v & 1) ^ (v >> 1));
+}
+
+// 16 values of Bits bits packed msb first, a value of all ones means the real
+// byte follows in the escape area after the packed bits.
+template <unsigned Bits>
+const unsigned char *decode_bits(const unsigned char *data,
+                                 unsigned char *buffer) {
+  constexpr unsigned sentinel = (1u << Bits) - 1;
+  const unsigned char *escape = data + Bits * BYTE_GROUP_SIZE / 8;
+
+  for (unsigned i = 0; i < BYTE_GROUP_SIZE; i++) {
+    unsigned shift = 8 - Bits - (i * Bits) % 8;
+    unsigned value = (data[i * Bits / 8] >> shift) & sentinel;
+    if (value == sentinel) {
+      value = *escape++;
+    }
+    buffer[i] = static_cast<unsigned char>(value);
+  }
+  return escape;
+}
+
+const unsigned char *decode_bytes_group(const unsigned char *data,
+                                        unsigned char *buffer, int bitslog2) {
+  switch (bitslog2) {
+  case 0:
+    memset(buffer, 0, BYTE_GROUP_SIZE);
+    return data;
+  case 1:
+    return decode_bits<2>(data, buffer);
+  case 2:
+    return decode_bits<4>(data, buffer);
+  default:
+    memcpy(buffer, data, BYTE_GROUP_SIZE);
+    return data + BYTE_GROUP_SIZE;
+  }
+}
+
+// EFFECTS: decodes one byte channel of a vertex block (buffer_size is a
+//          multiple of 16), returns nullptr if the stream ends early.
+const unsigned char *decode_bytes(const unsigned char *data,
+                                  const unsigned char *end,
+                                  unsigned char *buffer, size_t buffer_size) {
+  size_t group_count = buffer_size / BYTE_GROUP_SIZE;
+  size_t header_size = (group_count + 3) / 4;
+  if (static_cast<size_t>(end - data) < header_size)
+    return nullptr;
+
+  const unsigned char *header = data;
+  data += header_size;
+
+  for (size_t group = 0; group < group_count; group++) {
+    if (static_cast<size_t>(end - data) < BYTE_GROUP_DECODE_LIMIT)
+      return nullptr;
+
+    int bitslog2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+    data = decode_bytes_group(data, buffer + group * BYTE_GROUP_SIZE, bitslog2);
+  }
+  return data;
+}
+
+using ChannelBuffers = unsigned char[4][VERTEX_BLOCK_MAX_SIZE];
+
+// MODIFIES: dst, last
+// EFFECTS: turns 4 decoded byte channels of zigzag deltas back into vertex
+//          bytes, writing them at dst + i * stride. last holds the previous
+//          vertex' bytes on entry and this block's last vertex on exit.
+#ifdef TUCO_MESHOPT_SSE
+void unpack_deltas(const ChannelBuffers &buffer, size_t count,
+                   unsigned char *dst, size_t stride, unsigned char *last) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi8(1);
+  const __m128i low7 = _mm_set1_epi8(127);
+
+  uint32_t seed;
+  memcpy(&seed, last, sizeof(seed));
+  __m128i prev = _mm_set1_epi32(static_cast<int>(seed));
+
+  // the buffers are padded to 16 values, so whole groups can always be read.
+  for (size_t i = 0; i < count; i += BYTE_GROUP_SIZE) {
+    __m128i channel[4];
+    for (int c = 0; c < 4; c++) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buffer[c] + i));
+      channel[c] = _mm_xor_si128(_mm_sub_epi8(zero, _mm_and_si128(v, one)),
+                                 _mm_and_si128(_mm_srli_epi16(v, 1), low7));
+    }
+
+    // transpose 4 channels x 16 vertices into 16 vertices x 4 bytes.
+    __m128i t0 = _mm_unpacklo_epi8(channel[0], channel[1]);
+    __m128i t1 = _mm_unpackhi_epi8(channel[0], channel[1]);
+    __m128i t2 = _mm_unpacklo_epi8(channel[2], channel[3]);
+    __m128i t3 = _mm_unpackhi_epi8(channel[2], channel[3]);
+    __m128i rows[4] = {
+        _mm_unpacklo_epi16(t0, t2),
+        _mm_unpackhi_epi16(t0, t2),
+        _mm_unpacklo_epi16(t1, t3),
+        _mm_unpackhi_epi16(t1, t3),
+    };
+
+    for (int r = 0; r < 4; r++) {
+      // prefix sum of the 4 deltas in the row, then carry in the previous row.
+      __m128i x = rows[r];
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+      x = _mm_add_epi8(x, prev);
+      prev = _mm_shuffle_epi32(x, 0xff);
+
+      size_t first = i + r * 4;
+      for (size_t j = 0; j < 4 && first + j < count; j++) {
+        uint32_t value = static_cast<uint32_t>(_mm_cvtsi128_si32(x));
+        memcpy(dst + (first + j) * stride, &value, sizeof(value));
+        x = _mm_srli_si128(x, 4);
+      }
+    }
+  }
+
+  memcpy(last, dst + (count - 1) * stride, 4);
+}
+#else
+void unpack_deltas(const ChannelBuffers &buffer, size_t count,
+                   unsigned char *dst, size_t stride, unsigned char *last) {
+  for (size_t c = 0; c < 4; c++) {
+    unsigned char p = last[c];
+    for (size_t i = 0; i < count; i++) {
+      p = static_cast<unsigned char>(p + unzigzag8(buffer[c][i]));
+      dst[i * stride + c] = p;
+    }
+    last[c] = p;
+  }
+}
+#endif
+
+const unsigned char *decode_vertex_block(const unsigned char *data,
+                                         const unsigned char *end,
+                                         unsigned char *dst, size_t count,
+                                         size_t stride,
+                                         unsigned char *last_vertex) {
+  ChannelBuffers buffer;
+  size_t aligned = (count + BYTE_GROUP_SIZE - 1) & ~(BYTE_GROUP_SIZE - 1);
+
+  // the stream stores every byte channel separately, they are decoded 4 at a
+  // time so the delta pass can work on whole 32 bit vertex words.
+  for (size_t k = 0; k < stride; k += 4) {
+    for (size_t c = 0; c < 4; c++) {
+      data = decode_bytes(data, end, buffer[c], aligned);
+      if (!data)
+        return nullptr;
+    }
+    unpack_deltas(buffer, count, dst + k, stride, last_vertex + k);
+  }
+  return data;
+}
+
+unsigned int decode_vbyte(const unsigned char *&data) {
+  unsigned char lead = *data++;
+  if (lead < 128)
+    return lead;
+
+  unsigned int result = lead & 127;
+  unsigned int shift = 7;
+  for (int i = 0; i < 4; i++) {
+    unsigned char group = *data++;
+    result |= static_cast<unsigned int>(group & 127) << shift;
+    shift += 7;
+    if (group < 128)
+      break;
+  }
+  return result;
+}
+
+unsigned int decode_index(const unsigned char *&data, unsigned int last) {
+  unsigned int v = decode_vbyte(data);
+  unsigned int d = (v >> 1) ^ -static_cast<int>(v & 1);
+  return last + d;
+}
+
+inline void write_index(unsigned char *dst, size_t i, size_t index_size,
+                        unsigned int value) {
+  if (index_size == 2) {
+    uint16_t narrow = static_cast<uint16_t>(value);
+    memcpy(dst + i * 2, &narrow, sizeof(narrow));
+  } else {
+    memcpy(dst + i * 4, &value, sizeof(value));
+  }
+}
+
+inline void write_triangle(unsigned char *dst, size_t i, size_t index_size,
+                           unsigned int a, unsigned int b, unsigned int c) {
+  write_index(dst, i + 0, index_size, a);
+  write_index(dst, i + 1, index_size, b);
+  write_index(dst, i + 2, index_size, c);
+}
+
+using EdgeFifo = unsigned int[16][2];
+using VertexFifo = unsigned int[16];
+
+inline void push_edge(EdgeFifo &fifo, unsigned int a, unsigned int b,
+                      size_t &offset) {
+  fifo[offset][0] = a;
+  fifo[offset][1] = b;
+  offset = (offset + 1) & 15;
+}
+
+inline void push_vertex(VertexFifo &fifo, unsigned int v, size_t &offset,
+                        int condition = 1) {
+  fifo[offset] = v;
+  offset = (offset + condition) & 15;
+}
+
+template <typename T> void decode_oct_filter(T *data, size_t count) {
+  const float max = static_cast<float>((1 << (sizeof(T) * 8 - 1)) - 1);
+
+  for (size_t i = 0; i < count; i++) {
+    // z is stored as 1 - |x| - |y| at the same bit count as x and y.
+    float x = static_cast<float>(data[i * 4 + 0]);
+    float y = static_cast<float>(data[i * 4 + 1]);
+    float z = static_cast<float>(data[i * 4 + 2]) - std::abs(x) - std::abs(y);
+
+    // fold the lower hemisphere back out.
+    float t = z < 0.0f ? z : 0.0f;
+    x += x >= 0.0f ? t : -t;
+    y += y >= 0.0f ? t : -t;
+
+    float length = std::sqrt(x * x + y * y + z * z);
+    float s = length > 0.0f ? max / length : 0.0f;
+
+    data[i * 4 + 0] = static_cast<T>(std::lround(x * s));
+    data[i * 4 + 1] = static_cast<T>(std::lround(y * s));
+    data[i * 4 + 2] = static_cast<T>(std::lround(z * s));
+  }
+}
+
+void decode_quat_filter(int16_t *data, size_t count) {
+  const float scale = 1.0f / std::sqrt(2.0f);
+
+  for (size_t i = 0; i < count; i++) {
+    // the low 2 bits of w select the dropped (largest) component, the rest is
+    // the scale the other three were stored with.
+    int sf = data[i * 4 + 3] | 3;
+    float ss = scale / static_cast<float>(sf);
+
+    float x = data[i * 4 + 0] * ss;
+    float y = data[i * 4 + 1] * ss;
+    float z = data[i * 4 + 2] * ss;
+    float ww = 1.0f - x * x - y * y - z * z;
+    float w = std::sqrt(std::max(ww, 0.0f));
+
+    int qc = data[i * 4 + 3] & 3;
+    data[i * 4 + ((qc + 1) & 3)] = static_cast<int16_t>(std::lround(x * 32767.0f));
+    data[i * 4 + ((qc + 2) & 3)] = static_cast<int16_t>(std::lround(y * 32767.0f));
+    data[i * 4 + ((qc + 3) & 3)] = static_cast<int16_t>(std::lround(z * 32767.0f));
+    data[i * 4 + ((qc + 0) & 3)] = static_cast<int16_t>(std::lround(w * 32767.0f));
+  }
+}
+
+void decode_exp_filter(unsigned char *data, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    uint32_t v;
+    memcpy(&v, data + i * 4, sizeof(v));
+
+    int32_t mantissa = static_cast<int32_t>(v << 8) >> 8;
+    int32_t exponent = static_cast<int32_t>(v) >> 24;
+
+    // ldexp(mantissa, exponent) without the libm call.
+    uint32_t bits = static_cast<uint32_t>(exponent + 127) << 23;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    value *= static_cast<float>(mantissa);
+    memcpy(data + i * 4, &value, sizeof(value));
+  }
+}
+
+} // namespace
+
+bool tuco::parse_meshopt_mode(const std::string &name, MeshoptMode &mode) {
+  if (name == "ATTRIBUTES")
+    mode = MeshoptMode::Attributes;
+  else if (name == "TRIANGLES")
+    mode = MeshoptMode::Triangles;
+  else if (name == "INDICES")
+    mode = MeshoptMode::Indices;
+  else
+    return false;
+  return true;
+}
+
+bool tuco::parse_meshopt_filter(const std::string &name,
+                                MeshoptFilter &filter) {
+  if (name.empty() || name == "NONE")
+    filter = MeshoptFilter::None;
+  else if (name == "OCTAHEDRAL")
+    filter = MeshoptFilter::Octahedral;
+  else if (name == "QUATERNION")
+    filter = MeshoptFilter::Quaternion;
+  else if (name == "EXPONENTIAL")
+    filter = MeshoptFilter::Exponential;
+  else
+    return false;
+  return true;
+}
+
+bool tuco::decode_vertex_buffer(unsigned char *dst, size_t count,
+                                size_t stride, const unsigned char *src,
+                                size_t size) {
+  if (stride == 0 || stride > VERTEX_BLOCK_MAX_SIZE || stride % 4 != 0)
+    return false;
+  if (size < 1 || (src[0] & 0xf0) != VERTEX_HEADER || (src[0] & 0x0f) > 0)
+    return false;
+
+  const unsigned char *data = src + 1;
+  const unsigned char *end = src + size;
+
+  // the first vertex is delta encoded against the tail, which ends with it
+  // (padded to TAIL_MAX_SIZE with zeros in front).
+  size_t tail_size = std::max(stride, TAIL_MAX_SIZE);
+  if (static_cast<size_t>(end - data) < tail_size)
+    return false;
+
+  unsigned char last_vertex[VERTEX_BLOCK_MAX_SIZE];
+  memcpy(last_vertex, end - stride, stride);
+
+  size_t block_size = get_vertex_block_size(stride);
+  for (size_t offset = 0; offset < count; offset += block_size) {
+    size_t block_count = std::min(block_size, count - offset);
+    data = decode_vertex_block(data, end, dst + offset * stride, block_count,
+                               stride, last_vertex);
+    if (!data)
+      return false;
+  }
+
+  return static_cast<size_t>(end - data) == tail_size;
+}
+
+bool tuco::decode_index_buffer(unsigned char *dst, size_t count,
+                               size_t index_size, const unsigned char *src,
+                               size_t size) {
+  if (count % 3 != 0 || (index_size != 2 && index_size != 4))
+    return false;
+  if (size < 1 + count / 3 + 16)
+    return false;
+  if ((src[0] & 0xf0) != INDEX_HEADER)
+    return false;
+  int version = src[0] & 0x0f;
+  if (version > 1)
+    return false;
+
+  EdgeFifo edge_fifo;
+  VertexFifo vertex_fifo;
+  memset(edge_fifo, -1, sizeof(edge_fifo));
+  memset(vertex_fifo, -1, sizeof(vertex_fifo));
+  size_t edge_offset = 0;
+  size_t vertex_offset = 0;
+
+  unsigned int next = 0;
+  unsigned int last = 0;
+  // version 1 spends codes 13 and 14 on +-1 deltas from the last free index.
+  int fecmax = version >= 1 ? 13 : 15;
+
+  // one code byte per triangle, then the variable length data, then a 16 byte
+  // table of common aux codes (which also pads the data for the reads below).
+  const unsigned char *code = src + 1;
+  const unsigned char *data = code + count / 3;
+  const unsigned char *data_safe_end = src + size - 16;
+  const unsigned char *codeaux_table = data_safe_end;
+
+  for (size_t i = 0; i < count; i += 3) {
+    if (data > data_safe_end)
+      return false;
+
+    unsigned char codetri = *code++;
+
+    if (codetri < 0xf0) {
+      // edge from the fifo plus a new, cached or free vertex.
+      int fe = codetri >> 4;
+      unsigned int a = edge_fifo[(edge_offset - 1 - fe) & 15][0];
+      unsigned int b = edge_fifo[(edge_offset - 1 - fe) & 15][1];
+
+      int fec = codetri & 15;
+      if (fec < fecmax) {
+        unsigned int cf = vertex_fifo[(vertex_offset - 1 - fec) & 15];
+        unsigned int c = fec == 0 ? next : cf;
+        int fec0 = fec == 0;
+        next += fec0;
+
+        write_triangle(dst, i, index_size, a, b, c);
+        push_vertex(vertex_fifo, c, vertex_offset, fec0);
+        push_edge(edge_fifo, c, b, edge_offset);
+        push_edge(edge_fifo, a, c, edge_offset);
+      } else {
+        // fec - (fec ^ 3) turns 13, 14 into -1, 1.
+        unsigned int c = fec != 15 ? last + (fec - (fec ^ 3))
+                                   : decode_index(data, last);
+        last = c;
+
+        write_triangle(dst, i, index_size, a, b, c);
+        push_vertex(vertex_fifo, c, vertex_offset);
+        push_edge(edge_fifo, c, b, edge_offset);
+        push_edge(edge_fifo, a, c, edge_offset);
+      }
+    } else if (codetri < 0xfe) {
+      // no shared edge, the aux code comes from the table.
+      unsigned char codeaux = codeaux_table[codetri & 15];
+      int feb = codeaux >> 4;
+      int fec = codeaux & 15;
+
+      // next is bumped for all three vertices before the fifo reads, the same
+      // order the encoder used.
+      unsigned int a = next++;
+
+      unsigned int bf = vertex_fifo[(vertex_offset - feb) & 15];
+      unsigned int b = feb == 0 ? next : bf;
+      int feb0 = feb == 0;
+      next += feb0;
+
+      unsigned int cf = vertex_fifo[(vertex_offset - fec) & 15];
+      unsigned int c = fec == 0 ? next : cf;
+      int fec0 = fec == 0;
+      next += fec0;
+
+      write_triangle(dst, i, index_size, a, b, c);
+      push_vertex(vertex_fifo, a, vertex_offset);
+      push_vertex(vertex_fifo, b, vertex_offset, feb0);
+      push_vertex(vertex_fifo, c, vertex_offset, fec0);
+      push_edge(edge_fifo, b, a, edge_offset);
+      push_edge(edge_fifo, c, b, edge_offset);
+      push_edge(edge_fifo, a, c, edge_offset);
+    } else {
+      // no shared edge, full aux byte in the data stream.
+      unsigned char codeaux = *data++;
+      int fea = codetri == 0xfe ? 0 : 15;
+      int feb = codeaux >> 4;
+      int fec = codeaux & 15;
+
+      // an aux byte of 0 restarts the new vertex counter.
+      if (codeaux == 0)
+        next = 0;
+
+      unsigned int a = fea == 0 ? next++ : 0;
+      unsigned int b =
+          feb == 0 ? next++ : vertex_fifo[(vertex_offset - feb) & 15];
+      unsigned int c =
+          fec == 0 ? next++ : vertex_fifo[(vertex_offset - fec) & 15];
+
+      if (fea == 15)
+        last = a = decode_index(data, last);
+      if (feb == 15)
+        last = b = decode_index(data, last);
+      if (fec == 15)
+        last = c = decode_index(data, last);
+
+      write_triangle(dst, i, index_size, a, b, c);
+      push_vertex(vertex_fifo, a, vertex_offset);
+      push_vertex(vertex_fifo, b, vertex_offset, (feb == 0) | (feb == 15));
+      push_vertex(vertex_fifo, c, vertex_offset, (fec == 0) | (fec == 15));
+      push_edge(edge_fifo, b, a, edge_offset);
+      push_edge(edge_fifo, c, b, edge_offset);
+      push_edge(edge_fifo, a, c, edge_offset);
+    }
+  }
+
+  return data == data_safe_end;
+}
+
+bool tuco::decode_index_sequence(unsigned char *dst, size_t count,
+                                 size_t index_size, const unsigned char *src,
+                                 size_t size) {
+  if (index_size != 2 && index_size != 4)
+    return false;
+  // header, at least a byte per index and a 4 byte tail.
+  if (size < 1 + count + 4)
+    return false;
+  if ((src[0] & 0xf0) != SEQUENCE_HEADER || (src[0] & 0x0f) > 1)
+    return false;
+
+  const unsigned char *data = src + 1;
+  const unsigned char *data_safe_end = src + size - 4;
+
+  // two baselines, the low bit of every value picks the one it's relative to.
+  unsigned int last[2] = {};
+
+  for (size_t i = 0; i < count; i++) {
+    if (data >= data_safe_end)
+      return false;
+
+    unsigned int v = decode_vbyte(data);
+    unsigned int current = v & 1;
+    v >>= 1;
+
+    unsigned int d = (v >> 1) ^ -static_cast<int>(v & 1);
+    unsigned int index = last[current] + d;
+    last[current] = index;
+
+    write_index(dst, i, index_size, index);
+  }
+
+  return data == data_safe_end;
+}
+
+bool tuco::apply_meshopt_filter(MeshoptFilter filter, unsigned char *data,
+                                size_t count, size_t stride) {
+  switch (filter) {
+  case MeshoptFilter::None:
+    return true;
+  case MeshoptFilter::Octahedral:
+    if (stride == 4) {
+      decode_oct_filter(reinterpret_cast<int8_t *>(data), count);
+      return true;
+    }
+    if (stride == 8) {
+      decode_oct_filter(reinterpret_cast<int16_t *>(data), count);
+      return true;
+    }
+    return false;
+  case MeshoptFilter::Quaternion:
+    if (stride != 8)
+      return false;
+    decode_quat_filter(reinterpret_cast<int16_t *>(data), count);
+    return true;
+  case MeshoptFilter::Exponential:
+    if (stride % 4 != 0)
+      return false;
+    decode_exp_filter(data, count * (stride / 4));
+    return true;
+  }
+  return false;
+}
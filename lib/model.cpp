@@ -5,13 +5,450 @@
 #include "config.hpp"
 #include "glm/gtc/type_ptr.hpp"
 #include "logger/interface.hpp"
+#include "mesh_cache.hpp"
+#include "meshopt_codec.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
+#include "texture_cache.hpp"
+
+#include <bedrock/mapped_file.hpp>
+#include <bedrock/parallel_for.hpp>
+#include <bedrock/texture_ingest.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <limits>
 #include <stdexcept>
+#include <thread>
+#include <type_traits>
 
 using namespace tuco;
 
+static_assert(std::is_trivially_copyable<Vertex>::value,
+              "vertices are written to/read from the mesh cache as raw bytes");
+
+namespace {
+
+// strided view over a gltf accessor, points directly into the loaded buffer so
+// nothing is copied until the converted value is written out.
+struct AccessorView {
+  const unsigned char *data = nullptr;
+  size_t stride = 0;
+  size_t count = 0;
+  int component_type = TINYGLTF_COMPONENT_TYPE_FLOAT;
+  int components = 0;
+  bool normalized = false;
+};
+
+std::optional<AccessorView> get_accessor_view(const tinygltf::Model &model,
+                                              int accessor_index,
+                                              bool sparse_handled = false) {
+  if (accessor_index < 0 ||
+      accessor_index >= static_cast<int>(model.accessors.size()))
+    return std::nullopt;
+
+  const tinygltf::Accessor &accessor = model.accessors[accessor_index];
+  if (accessor.bufferView < 0) {
+    WARN("accessor {} has no buffer view, skipping", accessor_index);
+    return std::nullopt;
+  }
+  if (accessor.sparse.isSparse && !sparse_handled) {
+    WARN("accessor {} is sparse, only the dense values will be read",
+         accessor_index);
+  }
+
+  const tinygltf::BufferView &view = model.bufferViews[accessor.bufferView];
+  const tinygltf::Buffer &buffer = model.buffers[view.buffer];
+
+  int stride = accessor.ByteStride(view);
+  if (stride <= 0) {
+    ERR("accessor {} has an invalid stride", accessor_index);
+    return std::nullopt;
+  }
+
+  AccessorView result{};
+  result.stride = static_cast<size_t>(stride);
+  result.count = accessor.count;
+  result.component_type = accessor.componentType;
+  result.components = tinygltf::GetNumComponentsInType(accessor.type);
+  result.normalized = accessor.normalized;
+
+  size_t start = accessor.byteOffset + view.byteOffset;
+  size_t element_size =
+      tinygltf::GetComponentSizeInBytes(accessor.componentType) *
+      result.components;
+  if (result.count > 0 &&
+      start + (result.count - 1) * result.stride + element_size >
+          buffer.data.size()) {
+    ERR("accessor {} reads past the end of its buffer", accessor_index);
+    return std::nullopt;
+  }
+
+  result.data = buffer.data.data() + start;
+  return result;
+}
+
+// decodes a single component to float, applying the normalization rules from
+// the gltf spec for integer types.
+inline float read_component(const unsigned char *p, int component_type,
+                            bool normalized) {
+  switch (component_type) {
+  case TINYGLTF_COMPONENT_TYPE_FLOAT: {
+    float v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  case TINYGLTF_COMPONENT_TYPE_BYTE: {
+    int8_t v;
+    memcpy(&v, p, sizeof(v));
+    return normalized ? std::max(v / 127.0f, -1.0f) : static_cast<float>(v);
+  }
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+    uint8_t v;
+    memcpy(&v, p, sizeof(v));
+    return normalized ? v / 255.0f : static_cast<float>(v);
+  }
+  case TINYGLTF_COMPONENT_TYPE_SHORT: {
+    int16_t v;
+    memcpy(&v, p, sizeof(v));
+    return normalized ? std::max(v / 32767.0f, -1.0f) : static_cast<float>(v);
+  }
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return normalized ? v / 65535.0f : static_cast<float>(v);
+  }
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return static_cast<float>(v);
+  }
+  default:
+    return 0.0f;
+  }
+}
+
+// EFFECTS: writes the first n components of element i into out, missing
+//          components are zeroed.
+inline void read_element(const AccessorView &view, size_t i, float *out,
+                         int n) {
+  const unsigned char *p = view.data + i * view.stride;
+  int available = std::min(n, view.components);
+
+  if (view.component_type == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+    memcpy(out, p, sizeof(float) * available);
+  } else {
+    int component_size = tinygltf::GetComponentSizeInBytes(view.component_type);
+    for (int c = 0; c < available; c++) {
+      out[c] = read_component(p + c * component_size, view.component_type,
+                              view.normalized);
+    }
+  }
+
+  for (int c = available; c < n; c++) {
+    out[c] = 0.0f;
+  }
+}
+
+// EFFECTS: the i-th sparse index of accessor, which the caller has bounds
+//          checked.
+inline uint32_t read_sparse_index(const unsigned char *p, int component_type) {
+  switch (component_type) {
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+    return *p;
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  default: {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  }
+}
+
+// MODIFIES: out
+// EFFECTS: reads a vec3 morph target accessor into out, both the dense values
+//          (if it has a buffer view) and its sparse substitutions. elements
+//          past the end of out are ignored.
+void read_morph_attribute(const tinygltf::Model &model, int accessor_index,
+                          std::vector<glm::vec3> &out) {
+  if (accessor_index < 0 ||
+      accessor_index >= static_cast<int>(model.accessors.size()))
+    return;
+
+  const tinygltf::Accessor &accessor = model.accessors[accessor_index];
+  // morph targets are commonly sparse without any dense data behind them.
+  if (accessor.bufferView >= 0) {
+    std::optional<AccessorView> view =
+        get_accessor_view(model, accessor_index, true);
+    if (view.has_value()) {
+      size_t count = std::min(view->count, out.size());
+      for (size_t i = 0; i < count; i++) {
+        read_element(*view, i, &out[i][0], 3);
+      }
+    }
+  }
+
+  const tinygltf::Accessor::Sparse &sparse = accessor.sparse;
+  if (!sparse.isSparse || sparse.count <= 0)
+    return;
+
+  int view_count = static_cast<int>(model.bufferViews.size());
+  if (sparse.indices.bufferView < 0 ||
+      sparse.indices.bufferView >= view_count ||
+      sparse.values.bufferView < 0 || sparse.values.bufferView >= view_count) {
+    ERR("sparse accessor {} has invalid buffer views", accessor_index);
+    return;
+  }
+
+  const tinygltf::BufferView &index_view =
+      model.bufferViews[sparse.indices.bufferView];
+  const tinygltf::BufferView &value_view =
+      model.bufferViews[sparse.values.bufferView];
+  const tinygltf::Buffer &index_buffer = model.buffers[index_view.buffer];
+  const tinygltf::Buffer &value_buffer = model.buffers[value_view.buffer];
+
+  size_t count = static_cast<size_t>(sparse.count);
+  size_t index_size =
+      tinygltf::GetComponentSizeInBytes(sparse.indices.componentType);
+  size_t index_start = index_view.byteOffset + sparse.indices.byteOffset;
+
+  AccessorView values{};
+  values.component_type = accessor.componentType;
+  values.components = 3;
+  values.normalized = accessor.normalized;
+  values.stride = tinygltf::GetComponentSizeInBytes(accessor.componentType) * 3;
+  values.count = count;
+  size_t value_start = value_view.byteOffset + sparse.values.byteOffset;
+
+  if (index_start + count * index_size > index_buffer.data.size() ||
+      value_start + count * values.stride > value_buffer.data.size()) {
+    ERR("sparse accessor {} reads past the end of its buffer", accessor_index);
+    return;
+  }
+  values.data = value_buffer.data.data() + value_start;
+
+  const unsigned char *indices = index_buffer.data.data() + index_start;
+  for (size_t i = 0; i < count; i++) {
+    uint32_t index = read_sparse_index(indices + i * index_size,
+                                       sparse.indices.componentType);
+    if (index < out.size()) {
+      read_element(values, i, &out[index][0], 3);
+    }
+  }
+}
+
+size_t get_extension_size(const tinygltf::Value &extension, const char *key,
+                          size_t fallback) {
+  if (!extension.Has(key) || !extension.Get(key).IsNumber())
+    return fallback;
+  return static_cast<size_t>(extension.Get(key).GetNumberAsDouble());
+}
+
+std::string get_extension_string(const tinygltf::Value &extension,
+                                 const char *key) {
+  if (!extension.Has(key) || !extension.Get(key).IsString())
+    return "";
+  return extension.Get(key).Get<std::string>();
+}
+
+// EFFECTS: decodes every EXT_meshopt_compression buffer view into a buffer of
+//          its own and points the view at it, so accessors read it like any
+//          other view. returns false if a view can't be decoded.
+bool decode_compressed_views(tinygltf::Model &model,
+                             const std::string &filepath) {
+  size_t view_count = 0;
+  size_t compressed_bytes = 0;
+  size_t decoded_bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  for (size_t v = 0; v < model.bufferViews.size(); v++) {
+    tinygltf::BufferView &view = model.bufferViews[v];
+    auto extension = view.extensions.find("EXT_meshopt_compression");
+    if (extension == view.extensions.end())
+      continue;
+
+    const tinygltf::Value &compression = extension->second;
+    size_t buffer = get_extension_size(
+        compression, "buffer", std::numeric_limits<size_t>::max());
+    size_t offset = get_extension_size(compression, "byteOffset", 0);
+    size_t length = get_extension_size(compression, "byteLength", 0);
+    size_t stride = get_extension_size(compression, "byteStride", 0);
+    size_t count = get_extension_size(compression, "count", 0);
+
+    MeshoptMode mode;
+    MeshoptFilter filter;
+    if (!parse_meshopt_mode(get_extension_string(compression, "mode"), mode) ||
+        !parse_meshopt_filter(get_extension_string(compression, "filter"),
+                              filter)) {
+      ERR("buffer view {} of {} uses an unknown meshopt mode/filter", v,
+          filepath);
+      return false;
+    }
+    if (buffer >= model.buffers.size() ||
+        offset + length > model.buffers[buffer].data.size()) {
+      ERR("buffer view {} of {} points outside its compressed buffer", v,
+          filepath);
+      return false;
+    }
+
+    const unsigned char *source = model.buffers[buffer].data.data() + offset;
+    std::vector<unsigned char> decoded(count * stride);
+
+    bool decoded_ok = false;
+    switch (mode) {
+    case MeshoptMode::Attributes:
+      decoded_ok =
+          decode_vertex_buffer(decoded.data(), count, stride, source, length) &&
+          apply_meshopt_filter(filter, decoded.data(), count, stride);
+      break;
+    case MeshoptMode::Triangles:
+      decoded_ok =
+          decode_index_buffer(decoded.data(), count, stride, source, length);
+      break;
+    case MeshoptMode::Indices:
+      decoded_ok =
+          decode_index_sequence(decoded.data(), count, stride, source, length);
+      break;
+    }
+    if (!decoded_ok) {
+      ERR("could not decode meshopt buffer view {} of {}", v, filepath);
+      return false;
+    }
+
+    view_count++;
+    compressed_bytes += length;
+    decoded_bytes += decoded.size();
+
+    // the fallback buffer the view used to point at is never loaded, the
+    // decoded data replaces it.
+    tinygltf::Buffer decoded_buffer;
+    decoded_buffer.data = std::move(decoded);
+    view.buffer = static_cast<int>(model.buffers.size());
+    view.byteOffset = 0;
+    view.byteLength = decoded_buffer.data.size();
+    if (mode == MeshoptMode::Attributes)
+      view.byteStride = stride;
+    model.buffers.push_back(std::move(decoded_buffer));
+    view.extensions.erase(extension);
+  }
+
+  if (view_count > 0) {
+    std::chrono::duration<double> seconds =
+        std::chrono::steady_clock::now() - start;
+    INFO("decoded {} meshopt buffer views of {}: {} -> {} bytes in {:.2f} ms "
+         "({:.1f} MB/s)",
+         view_count, filepath, compressed_bytes, decoded_bytes,
+         seconds.count() * 1000.0,
+         decoded_bytes / std::max(seconds.count(), 1e-9) / (1024.0 * 1024.0));
+  }
+  return true;
+}
+
+// EFFECTS: moves the influences of a skinned primitive from its skin's joints
+//          into the model's joint palette, starting at offset. influences on
+//          joints the skin doesn't have are dropped.
+void rebase_skin_joints(Vertex *vertices, size_t count, uint32_t offset,
+                        size_t skin_joints) {
+  for (size_t v = 0; v < count; v++) {
+    for (int k = 0; k < 4; k++) {
+      uint32_t joint = vertices[v].joints[k];
+      if (joint >= skin_joints ||
+          offset + joint > std::numeric_limits<uint16_t>::max()) {
+        vertices[v].joints[k] = 0;
+        vertices[v].weights[k] = 0.0f;
+        continue;
+      }
+      vertices[v].joints[k] = static_cast<uint16_t>(offset + joint);
+    }
+  }
+}
+
+// the forward pass only draws triangle lists, strips and fans are turned into
+// lists on import. a primitive without a mode is a list.
+bool is_triangle_mode(int mode) {
+  return mode == -1 || mode == TINYGLTF_MODE_TRIANGLES ||
+         mode == TINYGLTF_MODE_TRIANGLE_STRIP ||
+         mode == TINYGLTF_MODE_TRIANGLE_FAN;
+}
+
+// MODIFIES: indices
+// EFFECTS: rewrites the indices from base on, a strip or fan of the given
+//          mode, as a triangle list (the winding of every triangle kept as
+//          the strip/fan orders it) and drops a trailing partial triangle of
+//          a list. returns how many indices there are from base on now.
+size_t convert_to_triangle_list(std::vector<uint32_t> &indices, size_t base,
+                                int mode) {
+  const size_t count = indices.size() - base;
+  if (mode != TINYGLTF_MODE_TRIANGLE_STRIP &&
+      mode != TINYGLTF_MODE_TRIANGLE_FAN) {
+    indices.resize(base + count / 3 * 3);
+    return count / 3 * 3;
+  }
+
+  std::vector<uint32_t> source(indices.begin() + base, indices.end());
+  indices.resize(base);
+  for (size_t i = 0; i + 2 < source.size(); i++) {
+    uint32_t a = mode == TINYGLTF_MODE_TRIANGLE_FAN ? source[0] : source[i];
+    uint32_t b = source[i + 1];
+    uint32_t c = source[i + 2];
+    // every other triangle of a strip is wound the other way.
+    if (mode == TINYGLTF_MODE_TRIANGLE_STRIP && i % 2 == 1)
+      std::swap(a, b);
+    // strips joined by repeated indices.
+    if (a == b || b == c || a == c)
+      continue;
+    indices.insert(indices.end(), {a, b, c});
+  }
+  return indices.size() - base;
+}
+
+// counts the geometry referenced by a node (and its children) so the model
+// vectors can be sized once up front.
+void count_node_geometry(const tinygltf::Model &model,
+                         const tinygltf::Node &node, size_t &vertex_count,
+                         size_t &index_count) {
+  for (int child : node.children) {
+    count_node_geometry(model, model.nodes[child], vertex_count, index_count);
+  }
+
+  if (node.mesh < 0)
+    return;
+
+  for (const auto &primitive : model.meshes[node.mesh].primitives) {
+    auto position = primitive.attributes.find("POSITION");
+    if (position == primitive.attributes.end() ||
+        !is_triangle_mode(primitive.mode))
+      continue;
+
+    size_t vertices = model.accessors[position->second].count;
+    vertex_count += vertices;
+    index_count += primitive.indices > -1
+                       ? model.accessors[primitive.indices].count
+                       : vertices;
+  }
+}
+
+// keeps the encoded bytes of every image, process_gltf_textures then decodes
+// all of them at once instead of tinygltf decoding them one after another.
+bool defer_image_decode(tinygltf::Image *image, const int, std::string *,
+                        std::string *, int, int, const unsigned char *bytes,
+                        int size, void *) {
+  image->image.assign(bytes, bytes + size);
+  image->component = 0; // still encoded
+  return true;
+}
+
+} // namespace
+
 bool Model::check_gltf(const std::string &filepath) {
   std::string ext = get_extension_from_file_path(filepath);
 
@@ -21,13 +458,14 @@ bool Model::check_gltf(const std::string &filepath) {
   return false;
 }
 
-void Model::add_gltf_model(const std::string &filepath) {
+bool Model::add_gltf_model(const std::string &filepath) {
   tinygltf::Model model;
   tinygltf::TinyGLTF loader;
   std::string warn;
   std::string err;
 
   std::string ext = get_extension_from_file_path(filepath);
+  loader.SetImageLoader(defer_image_decode, nullptr);
 
   bool ret;
   if (ext == "gltf")
@@ -42,592 +480,1133 @@ void Model::add_gltf_model(const std::string &filepath) {
   if (!err.empty()) {
     ERR(err.c_str());
   }
-  if (!ret) {
+  if (!ret || model.scenes.empty()) {
     ERR("something went wrong while trying to import GLTF model");
+    return false;
+  }
+
+  // quantized attributes (KHR_mesh_quantization) go through read_component
+  // like any other integer type, compressed views are decoded up front.
+  for (const std::string &extension : model.extensionsRequired) {
+    if (extension != "KHR_mesh_quantization" &&
+        extension != "EXT_meshopt_compression") {
+      WARN("{} requires unsupported extension {}", filepath, extension);
+    }
+  }
+  if (!decode_compressed_views(model, filepath)) {
+    return false;
   }
 
   // get scene
   const tinygltf::Scene &scene = model.scenes[0]; // use model.defaultScene?
 
-  // process materials
-  // process_gltf_materials(model, model_materials);
+  // process images, then the materials referring to them.
+  const uint32_t image_start = static_cast<uint32_t>(model_images.size());
+  process_gltf_textures(model, filepath, model_images);
+  const uint32_t material_start =
+      static_cast<uint32_t>(model_materials.size());
+  process_gltf_materials(model, image_start);
+
+  // size the geometry once, primitives are then converted in place.
+  size_t vertex_count = 0;
+  size_t index_count = 0;
+  for (int node : scene.nodes) {
+    count_node_geometry(model, model.nodes[node], vertex_count, index_count);
+  }
+  model_vertices.reserve(model_vertices.size() + vertex_count);
+  model_indices.reserve(model_indices.size() + index_count);
+  nodes.reserve(nodes.size() + model.nodes.size());
 
-  // process images
-  process_gltf_textures(model, model_images);
+  GltfNodeContext context;
+  context.material_start = material_start;
+  context.node_map.assign(model.nodes.size(), -1);
+  context.node_weights.assign(model.nodes.size(), -1);
+  context.node_weight_counts.assign(model.nodes.size(), 0);
+  process_gltf_skins(model, context);
 
   // process nodes
   for (size_t i = 0; i < scene.nodes.size(); i++) {
-    process_gltf_nodes(model.nodes[scene.nodes[i]], model);
+    process_gltf_nodes(scene.nodes[i], model, context);
+  }
+  nodes.update_world();
+
+  resolve_gltf_joints(model, context);
+  process_gltf_animations(model, context);
+  // morphed vertices are drawn through the skinning path as well.
+  if (is_skinned() || !morphs.empty()) {
+    assign_rigid_joints();
+  }
+
+  return true;
+}
+
+void Model::process_gltf_skins(const tinygltf::Model &model,
+                               GltfNodeContext &context) {
+  context.skin_offsets.resize(model.skins.size());
+  for (size_t s = 0; s < model.skins.size(); s++) {
+    const tinygltf::Skin &skin = model.skins[s];
+    size_t offset = joint_nodes.size();
+    context.skin_offsets[s] = static_cast<uint32_t>(offset);
+
+    // joint nodes are filled in by resolve_gltf_joints.
+    joint_nodes.resize(offset + skin.joints.size(), 0);
+    inverse_bind_matrices.resize(offset + skin.joints.size(), glm::mat4(1.0f));
+
+    // without inverse bind matrices the joints are taken as identity.
+    std::optional<AccessorView> view =
+        get_accessor_view(model, skin.inverseBindMatrices);
+    if (!view.has_value())
+      continue;
+
+    size_t count = std::min(view->count, skin.joints.size());
+    for (size_t j = 0; j < count; j++) {
+      read_element(*view, j, &inverse_bind_matrices[offset + j][0][0], 16);
+    }
   }
 }
 
-void Model::process_gltf_nodes(tinygltf::Node &node, tinygltf::Model &model,
-                               model::Node *parent_node) {
+void Model::resolve_gltf_joints(const tinygltf::Model &model,
+                                const GltfNodeContext &context) {
+  for (size_t s = 0; s < model.skins.size(); s++) {
+    const tinygltf::Skin &skin = model.skins[s];
+    for (size_t j = 0; j < skin.joints.size(); j++) {
+      int joint = skin.joints[j];
+      int32_t node = joint >= 0 && joint < static_cast<int>(model.nodes.size())
+                         ? context.node_map[joint]
+                         : -1;
+      if (node < 0) {
+        WARN("joint {} of skin {} is not part of the scene, it won't move",
+             joint, s);
+        node = 0;
+        inverse_bind_matrices[context.skin_offsets[s] + j] = glm::mat4(1.0f);
+      }
+      joint_nodes[context.skin_offsets[s] + j] = static_cast<uint32_t>(node);
+    }
+  }
+}
+
+void Model::process_gltf_animations(const tinygltf::Model &model,
+                                    const GltfNodeContext &context) {
+  size_t skipped_channels = 0;
+
+  for (const tinygltf::Animation &source : model.animations) {
+    Animation animation{};
+    animation.name = source.name;
 
-  auto unique_node = std::make_unique<model::Node>();
-  unique_node->add_parent(parent_node);
+    animation.samplers.resize(source.samplers.size());
+    for (size_t s = 0; s < source.samplers.size(); s++) {
+      const tinygltf::AnimationSampler &sampler = source.samplers[s];
+      AnimationSampler &out = animation.samplers[s];
 
-  // uint32_t index_point = model_indices.size();
-  // uint32_t vertex_point = model_vertices.size();
-  auto index_point = uint32_t(0);
-  auto vertex_point = uint32_t(0);
-  uint32_t index_count = 0;
+      if (sampler.interpolation == "STEP") {
+        out.interpolation = AnimationInterpolation::Step;
+      } else if (sampler.interpolation == "CUBICSPLINE") {
+        out.interpolation = AnimationInterpolation::CubicSpline;
+      } else {
+        out.interpolation = AnimationInterpolation::Linear;
+      }
+
+      std::optional<AccessorView> input =
+          get_accessor_view(model, sampler.input);
+      std::optional<AccessorView> output =
+          get_accessor_view(model, sampler.output);
+      if (!input.has_value() || !output.has_value())
+        continue;
+
+      out.times.resize(input->count);
+      for (size_t k = 0; k < input->count; k++) {
+        read_element(*input, k, &out.times[k], 1);
+      }
+      out.values.resize(output->count);
+      for (size_t k = 0; k < output->count; k++) {
+        read_element(*output, k, &out.values[k][0], 4);
+      }
 
-  auto matrix = glm::mat4(1.0f);
+      if (!out.times.empty()) {
+        animation.duration = std::max(animation.duration, out.times.back());
+      }
+    }
 
-  // process translations for nodes
-  if (node.translation.size() == 3) {
-    matrix = glm::translate(matrix,
-                            glm::vec3(glm::make_vec3(node.translation.data())));
+    for (const tinygltf::AnimationChannel &channel : source.channels) {
+      int target = channel.target_node;
+      bool in_scene = target >= 0 &&
+                      target < static_cast<int>(model.nodes.size()) &&
+                      context.node_map[target] >= 0;
+      bool valid_sampler = channel.sampler >= 0 &&
+                           channel.sampler <
+                               static_cast<int>(animation.samplers.size());
+
+      AnimationChannel out{};
+      if (channel.target_path == "translation") {
+        out.path = AnimationPath::Translation;
+      } else if (channel.target_path == "rotation") {
+        out.path = AnimationPath::Rotation;
+      } else if (channel.target_path == "scale") {
+        out.path = AnimationPath::Scale;
+      } else if (channel.target_path == "weights") {
+        out.path = AnimationPath::Weights;
+        // only nodes whose mesh has morph targets have weights.
+        in_scene = in_scene && context.node_weights[target] >= 0;
+      } else {
+        in_scene = false;
+      }
+
+      if (!in_scene || !valid_sampler) {
+        skipped_channels++;
+        continue;
+      }
+
+      if (out.path == AnimationPath::Weights) {
+        out.weight_start = static_cast<uint32_t>(context.node_weights[target]);
+        out.weight_count = context.node_weight_counts[target];
+        animation.samplers[channel.sampler].width = out.weight_count;
+      }
+
+      out.sampler = static_cast<uint32_t>(channel.sampler);
+      out.node = static_cast<uint32_t>(context.node_map[target]);
+      animation.channels.push_back(out);
+    }
+
+    animations.push_back(std::move(animation));
   }
-  if (node.rotation.size() == 4) {
-    // auto v = ;
-    glm::quat q = glm::make_quat(node.rotation.data());
-    matrix *= glm::mat4(q);
+
+  if (skipped_channels > 0) {
+    WARN("skipped {} animation channels that target unknown paths or nodes "
+         "outside the scene",
+         skipped_channels);
   }
-  if (node.scale.size() == 3) {
-    matrix = glm::scale(matrix, glm::vec3(glm::make_vec3(node.scale.data())));
+}
+
+void Model::assign_rigid_joints() {
+  // rigid entries have an identity inverse bind matrix, so any entry like that
+  // already following a node can be shared.
+  std::vector<int32_t> node_joints(nodes.size(), -1);
+  for (size_t j = joint_nodes.size(); j-- > 0;) {
+    if (inverse_bind_matrices[j] == glm::mat4(1.0f)) {
+      node_joints[joint_nodes[j]] = static_cast<int32_t>(j);
+    }
   }
-  if (node.matrix.size() == 16) {
-    matrix = glm::make_mat4x4(node.matrix.data());
+
+  size_t unassigned = 0;
+  for (const Primitive &prim : primitives) {
+    for (uint32_t i = prim.index_start; i < prim.index_start + prim.index_count;
+         i++) {
+      uint32_t v = model_indices[i];
+      if (v >= model_vertices.size())
+        continue;
+
+      Vertex &vertex = model_vertices[v];
+      if (vertex.weights != glm::vec4(0.0f))
+        continue;
+
+      int32_t &joint = node_joints[prim.transform_index];
+      if (joint < 0) {
+        if (joint_nodes.size() > std::numeric_limits<uint16_t>::max()) {
+          unassigned++;
+          continue;
+        }
+        joint = static_cast<int32_t>(joint_nodes.size());
+        joint_nodes.push_back(prim.transform_index);
+        inverse_bind_matrices.push_back(glm::mat4(1.0f));
+      }
+      vertex.joints = glm::u16vec4(static_cast<uint16_t>(joint), 0, 0, 0);
+      vertex.weights = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+    }
+  }
+
+  if (unassigned > 0) {
+    ERR("joint palette is full, {} vertices will stay in their bind pose",
+        unassigned);
+  }
+}
+
+void Model::process_gltf_morph_targets(const tinygltf::Model &model,
+                                       const tinygltf::Primitive &primitive,
+                                       uint32_t vertex_start,
+                                       uint32_t vertex_count,
+                                       uint32_t weight_start) {
+  MorphRange range{};
+  range.target_start = static_cast<uint32_t>(morphs.targets.size());
+  range.target_count = static_cast<uint32_t>(primitive.targets.size());
+  range.weight_start = weight_start;
+
+  // targets are expanded once here to find the vertices they move, only
+  // those are kept.
+  std::vector<glm::vec3> positions(vertex_count);
+  std::vector<glm::vec3> normals(vertex_count);
+  std::vector<uint8_t> touched(vertex_count, 0);
+  for (const std::map<std::string, int> &attributes : primitive.targets) {
+    std::fill(positions.begin(), positions.end(), glm::vec3(0.0f));
+    std::fill(normals.begin(), normals.end(), glm::vec3(0.0f));
+
+    auto position = attributes.find("POSITION");
+    if (position != attributes.end()) {
+      read_morph_attribute(model, position->second, positions);
+    }
+    auto normal = attributes.find("NORMAL");
+    if (normal != attributes.end()) {
+      read_morph_attribute(model, normal->second, normals);
+    }
+
+    MorphTarget target{};
+    target.delta_start = static_cast<uint32_t>(morphs.deltas.size());
+    for (uint32_t v = 0; v < vertex_count; v++) {
+      if (positions[v] == glm::vec3(0.0f) && normals[v] == glm::vec3(0.0f))
+        continue;
+
+      MorphDelta delta{};
+      delta.position = glm::vec4(positions[v], 0.0f);
+      delta.normal = glm::vec4(normals[v], 0.0f);
+      morphs.deltas.push_back(delta);
+      morphs.delta_vertices.push_back(vertex_start + v);
+      touched[v] = 1;
+    }
+    target.delta_count =
+        static_cast<uint32_t>(morphs.deltas.size()) - target.delta_start;
+    morphs.targets.push_back(target);
+  }
+
+  range.touched_start = static_cast<uint32_t>(morphs.touched_vertices.size());
+  for (uint32_t v = 0; v < vertex_count; v++) {
+    if (touched[v]) {
+      morphs.touched_vertices.push_back(vertex_start + v);
+    }
   }
+  range.touched_count =
+      static_cast<uint32_t>(morphs.touched_vertices.size()) -
+      range.touched_start;
+  morphs.ranges.push_back(range);
+}
 
-  unique_node->add_matrix(matrix);
+int32_t Model::find_animation(const std::string &name) const {
+  for (size_t i = 0; i < animations.size(); i++) {
+    if (animations[i].name == name)
+      return static_cast<int32_t>(i);
+  }
+  return -1;
+}
 
-  // each node may have children
-  for (auto &children : node.children) {
-    process_gltf_nodes(model.nodes[children], model, unique_node.get());
+void Model::process_gltf_nodes(int gltf_index, const tinygltf::Model &model,
+                               GltfNodeContext &context, int32_t parent) {
+  const tinygltf::Node &node = model.nodes[gltf_index];
+  // nodes are added before their children so the hierarchy stays sorted by
+  // parent, world transforms are resolved once everything is in.
+  uint32_t node_index;
+  if (node.matrix.size() == 16) {
+    node_index = nodes.add_node(
+        parent, glm::mat4(glm::make_mat4x4(node.matrix.data())));
+  } else {
+    glm::vec3 translation = glm::vec3(0.0f);
+    glm::quat rotation = glm::identity<glm::quat>();
+    glm::vec3 scale = glm::vec3(1.0f);
+    if (node.translation.size() == 3) {
+      translation = glm::vec3(glm::make_vec3(node.translation.data()));
+    }
+    if (node.rotation.size() == 4) {
+      rotation = glm::quat(glm::make_quat(node.rotation.data()));
+    }
+    if (node.scale.size() == 3) {
+      scale = glm::vec3(glm::make_vec3(node.scale.data()));
+    }
+    node_index = nodes.add_node(parent, translation, rotation, scale);
   }
+  context.node_map[gltf_index] = static_cast<int32_t>(node_index);
 
   if (node.mesh > -1) {
-    const tinygltf::Mesh mesh = model.meshes[node.mesh];
+    const tinygltf::Mesh &mesh = model.meshes[node.mesh];
+
+    // every instance of a mesh with morph targets gets its own weights,
+    // starting from the node's (or else the mesh's) defaults.
+    size_t target_count = 0;
+    for (const tinygltf::Primitive &primitive : mesh.primitives) {
+      target_count = std::max(target_count, primitive.targets.size());
+    }
+    uint32_t weight_start = static_cast<uint32_t>(morphs.weights.size());
+    if (target_count > 0) {
+      const std::vector<double> &defaults =
+          node.weights.size() == target_count ? node.weights : mesh.weights;
+      for (size_t t = 0; t < target_count; t++) {
+        morphs.weights.push_back(
+            t < defaults.size() ? static_cast<float>(defaults[t]) : 0.0f);
+      }
+      context.node_weights[gltf_index] = static_cast<int32_t>(weight_start);
+      context.node_weight_counts[gltf_index] =
+          static_cast<uint32_t>(target_count);
+    }
+
     for (size_t i = 0; i < mesh.primitives.size(); i++) {
       const tinygltf::Primitive &primitive = mesh.primitives[i];
-      index_point = static_cast<uint32_t>(model_indices.size());
-      vertex_point = static_cast<uint32_t>(model_vertices.size());
+      // points and lines, the optimizer, simplifier and meshlet builder only
+      // take triangles and the forward pass only draws them.
+      if (!is_triangle_mode(primitive.mode)) {
+        WARN("primitive {} of mesh {} is drawn as points or lines (mode {}), "
+             "it is left out",
+             i, mesh.name, primitive.mode);
+        continue;
+      }
+      auto index_point = static_cast<uint32_t>(model_indices.size());
+      auto vertex_point = static_cast<uint32_t>(model_vertices.size());
       // process vertices
       process_gltf_vertices(model, primitive, model_vertices);
+      if (model_vertices.size() == vertex_point) {
+        continue; // nothing to draw.
+      }
+      if (!primitive.targets.empty()) {
+        process_gltf_morph_targets(
+            model, primitive, vertex_point,
+            static_cast<uint32_t>(model_vertices.size()) - vertex_point,
+            weight_start);
+      }
+      if (node.skin > -1 &&
+          node.skin < static_cast<int>(model.skins.size())) {
+        rebase_skin_joints(model_vertices.data() + vertex_point,
+                           model_vertices.size() - vertex_point,
+                           context.skin_offsets[node.skin],
+                           model.skins[node.skin].joints.size());
+      }
 
       // process indices
-      index_count = 0;
+      uint32_t index_count = 0;
       process_gltf_indices(model, primitive, index_count, model_indices,
                            index_count, // can delete this from function
                            vertex_point);
 
-      // assign material to mesh
+      // assign material to mesh, primitives without one are drawn with the
+      // object's own material.
       Primitive prim{};
       prim.index_start = index_point;
       prim.index_count = index_count;
-      prim.mat_index = primitive.material;
-      if (prim.mat_index == -1) {
-        // prim.image_index = -1;
-        //  create new material
-        // auto mat = Material{};
-        // mat.ambient = glm::vec4(1.0);
-        // mat.diffuse = glm::vec4(1.0);
-        // mat.opacity = 1.0f;
-        // mat.specular = glm::vec4(0.0f);
-
-        // prim.mat_index = model_materials.size();
-        // model_materials.push_back(mat);
-      } else {
-        prim.image_index = -1; // model_materials[prim.mat_index].image_index;
+      prim.mat_index = -1;
+      prim.image_index = -1;
+      if (primitive.material >= 0 &&
+          primitive.material < static_cast<int>(model.materials.size())) {
+        prim.mat_index =
+            static_cast<int>(context.material_start) + primitive.material;
+        const MaterialDescription &material = model_materials[prim.mat_index];
+        prim.image_index = material.base_color_image;
+        prim.is_transparent = material.blend != 0;
       }
-      prim.transform_index = transforms.size();
+      prim.transform_index = node_index;
       primitives.push_back(prim);
     }
   }
 
-  // converge current transform with nodes parent transforms.
-  model::Node *prev_node = parent_node;
-  glm::mat4 final_matrix = matrix;
-  while (prev_node) {
-    final_matrix = prev_node->get_transform() * final_matrix;
-    prev_node = prev_node->get_parent();
-  }
-
-  transforms.push_back(final_matrix);
-
-  if (parent_node) {
-    parent_node->add_node(std::move(unique_node));
-  } else {
-    nodes.push_back(std::move(unique_node));
+  for (int child : node.children) {
+    process_gltf_nodes(child, model, context, static_cast<int32_t>(node_index));
   }
 }
 
-// NOTE: assumes model.images.size() == model.textures.size();
-void Model::process_gltf_textures(tinygltf::Model model,
+// images are appended in gltf order, a texture's source indexes them from
+// where this model's images start.
+void Model::process_gltf_textures(tinygltf::Model &model,
+                                  const std::string &filepath,
                                   std::vector<ImageBuffer> &images) {
-  images.resize(model.images.size());
-
-  for (size_t i = 0; i < images.size(); i++) {
-    tinygltf::Image &image = model.images[i];
-    uint32_t index = model.textures[i].source;
-    if (image.component == 3) {
-      images[index].buffer_size = image.width * image.height * 4;
-      unsigned char *rgba = new unsigned char[images[index].buffer_size];
-      unsigned char *rgb = &image.image[0];
-      for (size_t i = 0; i < image.width * image.height; i++) {
-        memcpy(rgba, rgb, sizeof(unsigned char) * 3);
-        rgba += 4;
-        rgb += 3;
+  std::filesystem::path directory =
+      std::filesystem::path(filepath).parent_path();
+
+  size_t image_start = images.size();
+  images.resize(image_start + model.images.size());
+
+  br::parallel_for(model.images.size(), [&](size_t i) {
+    tinygltf::Image &source = model.images[i];
+    ImageBuffer &image = images[image_start + i];
+
+    br::DecodedImage decoded;
+    const unsigned char *pixels = source.image.data();
+    uint32_t channels = static_cast<uint32_t>(source.component);
+    image.width = static_cast<uint32_t>(std::max(source.width, 0));
+    image.height = static_cast<uint32_t>(std::max(source.height, 0));
+    if (source.component <= 0) {
+      if (!br::decode_image(source.image.data(), source.image.size(), 0, false,
+                            decoded)) {
+        WARN("could not decode image {} ({})", i, source.name);
+        return;
       }
+      pixels = static_cast<const unsigned char *>(decoded.pixels);
+      channels = decoded.channels;
+      image.width = decoded.width;
+      image.height = decoded.height;
+    } else if (source.bits != 8) {
+      WARN("image {} ({}) has {} bit components, only 8 are supported", i,
+           source.name, source.bits);
+      return;
+    }
 
-      images[index].buffer.resize(1);
-      images[index].buffer[0] = *std::move(rgba);
+    size_t pixel_count = static_cast<size_t>(image.width) * image.height;
+    image.buffer_size = pixel_count * 4;
+    image.buffer.resize(image.buffer_size);
+    br::expand_to_rgba8(pixels, channels, pixel_count, image.buffer.data());
 
-      // delete[] rgba;
+    // images referenced by uri are known by their file, embedded ones by their
+    // pixels, either way the same image used by other models is shared.
+    if (!source.uri.empty() && source.uri.compare(0, 5, "data:") != 0) {
+      image.key = get_texture_key((directory / source.uri).string());
     } else {
-      // images[index].buffer.resize(1);
-      images[index].buffer = image.image;
-      images[index].buffer_size = image.image.size();
+      image.key = get_texture_key(image.buffer.data(), image.width,
+                                  image.height);
     }
 
-    images[index].width = image.width;
-    images[index].height = image.height;
-  }
+    br::free_decoded_image(decoded);
+    std::vector<unsigned char>().swap(source.image);
+  });
 }
 
-void Model::process_gltf_materials(tinygltf::Model model,
-                                   std::vector<Material> &materials) {
-  /*
-  materials.resize(model.materials.size());
-  for (size_t i = 0; i < materials.size(); i++) {
-      tinygltf::Material mat = model.materials[i];
-
-      //load diffuse
-      float alpha = 1.0f;
-      glm::vec4 diffuse = glm::vec4(1.0, 1.0, 1.0, 1.0);
-      if (mat.values.find("baseColorFactor") != mat.values.end()) {
-                      diffuse =
-  glm::make_vec4(mat.values["baseColorFactor"].ColorFactor().data());
-              }
-      materials[i].diffuse = diffuse;
-
-      materials[i].opacity = diffuse.w;
-      if (mat.alphaMode == "OPAQUE") {
-          materials[i].opacity = 1.0f;
-      }
-
-
-      materials[i].ambient = glm::vec4(1.0, 1.0, 1.0, 1.0); //not required
-  anymore
-
-      //load roughness
-      if (mat.values.find("roughnessFactor") != mat.values.end()) {
-          materials[i].specular.r = mat.values["roughnessFactor"].Factor();
-      }
-
-      //load metallic factor
-      if (mat.values.find("metallicFactor") != mat.values.end()) {
-          materials[i].specular.g = mat.values["metallicFactor"].Factor();
-      }
-
-      //get texture data
-      if (mat.values.find("baseColorTexture") != mat.values.end()) {
-          materials[i].image_index =
-  mat.values["baseColorTexture"].TextureIndex();
-      }
-      else {
-          materials[i].image_index = -1;
-      }
+void Model::process_gltf_materials(const tinygltf::Model &model,
+                                   uint32_t image_start) {
+  // EFFECTS: the model image behind a gltf texture index, -1 if there is none.
+  auto get_image = [&](int texture) -> int32_t {
+    if (texture < 0 || texture >= static_cast<int>(model.textures.size()))
+      return -1;
+    int source = model.textures[texture].source;
+    if (source < 0 || source >= static_cast<int>(model.images.size()))
+      return -1;
+    return static_cast<int32_t>(image_start) + source;
+  };
+
+  model_materials.reserve(model_materials.size() + model.materials.size());
+  for (const tinygltf::Material &material : model.materials) {
+    const tinygltf::PbrMetallicRoughness &pbr = material.pbrMetallicRoughness;
+
+    MaterialDescription description{};
+    for (size_t c = 0; c < 4 && c < pbr.baseColorFactor.size(); c++) {
+      description.base_color[c] = static_cast<float>(pbr.baseColorFactor[c]);
+    }
+    description.metallic = static_cast<float>(pbr.metallicFactor);
+    description.roughness = static_cast<float>(pbr.roughnessFactor);
+    description.base_color_image = get_image(pbr.baseColorTexture.index);
+    description.metallic_roughness_image =
+        get_image(pbr.metallicRoughnessTexture.index);
+    description.blend = material.alphaMode == "BLEND" ? 1 : 0;
+    model_materials.push_back(description);
   }
-  */
 }
 
-void Model::process_gltf_indices(tinygltf::Model model,
+void Model::process_gltf_indices(const tinygltf::Model &model,
                                  const tinygltf::Primitive &primitive,
                                  uint32_t &index_count,
                                  std::vector<uint32_t> &indices,
                                  uint32_t &index_start,
                                  uint32_t &vertex_start) {
-  const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
-  const tinygltf::BufferView &buffer_view =
-      model.bufferViews[accessor.bufferView];
-  const tinygltf::Buffer &buffer = model.buffers[buffer_view.buffer];
+  // non-indexed primitive, draw the vertices in order.
+  if (primitive.indices < 0) {
+    uint32_t vertex_count =
+        static_cast<uint32_t>(model_vertices.size()) - vertex_start;
+    size_t base = indices.size();
+    indices.resize(base + vertex_count);
+    for (uint32_t index = 0; index < vertex_count; index++) {
+      indices[base + index] = vertex_start + index;
+    }
+    index_count += static_cast<uint32_t>(
+        convert_to_triangle_list(indices, base, primitive.mode));
+    return;
+  }
 
-  index_count += static_cast<uint32_t>(accessor.count);
+  std::optional<AccessorView> view = get_accessor_view(model, primitive.indices);
+  if (!view.has_value()) {
+    return;
+  }
 
-  switch (accessor.componentType) {
+  size_t base = indices.size();
+  indices.resize(base + view->count);
+  uint32_t *out = indices.data() + base;
+
+  switch (view->component_type) {
   case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-    const uint32_t *buf = reinterpret_cast<const uint32_t *>(
-        &buffer.data[accessor.byteOffset + buffer_view.byteOffset]);
-    for (size_t index = 0; index < accessor.count; index++) {
-      indices.push_back(buf[index] + vertex_start);
+    for (size_t index = 0; index < view->count; index++) {
+      uint32_t value;
+      memcpy(&value, view->data + index * view->stride, sizeof(value));
+      out[index] = value + vertex_start;
     }
     break;
   }
   case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-    const uint16_t *buf = reinterpret_cast<const uint16_t *>(
-        &buffer.data[accessor.byteOffset + buffer_view.byteOffset]);
-    for (size_t index = 0; index < accessor.count; index++) {
-      indices.push_back(static_cast<uint32_t>(buf[index] + vertex_start));
+    for (size_t index = 0; index < view->count; index++) {
+      uint16_t value;
+      memcpy(&value, view->data + index * view->stride, sizeof(value));
+      out[index] = static_cast<uint32_t>(value) + vertex_start;
     }
     break;
   }
   case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-    const uint8_t *buf = reinterpret_cast<const uint8_t *>(
-        &buffer.data[accessor.byteOffset + buffer_view.byteOffset]);
-    for (size_t index = 0; index < accessor.count; index++) {
-      indices.push_back(static_cast<uint32_t>(buf[index] + vertex_start));
+    for (size_t index = 0; index < view->count; index++) {
+      out[index] =
+          static_cast<uint32_t>(view->data[index * view->stride]) + vertex_start;
     }
     break;
   }
   default:
-    std::cerr << "Index component type " << accessor.componentType
-              << " not supported!" << std::endl;
-    break;
+    ERR("index component type {} not supported!", view->component_type);
+    indices.resize(base);
+    return;
   }
+
+  index_count += static_cast<uint32_t>(
+      convert_to_triangle_list(indices, base, primitive.mode));
 }
 
-void Model::process_gltf_vertices(tinygltf::Model model,
+void Model::process_gltf_vertices(const tinygltf::Model &model,
                                   const tinygltf::Primitive &primitive,
                                   std::vector<Vertex> &vertices) {
-  const float *position_buffer = nullptr;
-  const float *normal_buffer = nullptr;
-  const float *tex_coord_buffer = nullptr;
-  size_t vertex_count = 0;
-
-  if (primitive.attributes.find("POSITION") != primitive.attributes.end()) {
-    const tinygltf::Accessor &accessor =
-        model.accessors[primitive.attributes.find("POSITION")->second];
-    const tinygltf::BufferView &view = model.bufferViews[accessor.bufferView];
-    position_buffer = reinterpret_cast<const float *>(
-        &(model.buffers[view.buffer]
-              .data[accessor.byteOffset + view.byteOffset]));
-    vertex_count = accessor.count;
+  auto find_view = [&](const char *attribute) -> std::optional<AccessorView> {
+    auto search = primitive.attributes.find(attribute);
+    if (search == primitive.attributes.end())
+      return std::nullopt;
+    return get_accessor_view(model, search->second);
+  };
+
+  std::optional<AccessorView> positions = find_view("POSITION");
+  if (!positions.has_value()) {
+    WARN("primitive has no positions, skipping");
+    return;
   }
+  std::optional<AccessorView> normals = find_view("NORMAL");
+  std::optional<AccessorView> tex_coords = find_view("TEXCOORD_0");
+  std::optional<AccessorView> joints = find_view("JOINTS_0");
+  std::optional<AccessorView> weights = find_view("WEIGHTS_0");
+
+  size_t vertex_count = positions->count;
+  size_t normal_count = normals ? normals->count : 0;
+  size_t tex_coord_count = tex_coords ? tex_coords->count : 0;
+  // influences only count if both halves are there.
+  size_t joint_count =
+      joints && weights ? std::min(joints->count, weights->count) : 0;
+
+  size_t base = vertices.size();
+  vertices.resize(base + vertex_count);
+  Vertex *out = vertices.data() + base;
+
+  float value[3];
+  for (size_t v = 0; v < vertex_count; v++) {
+    read_element(*positions, v, value, 3);
+    out[v].position = glm::vec4(value[0], value[1], value[2], 1.0f);
 
-  if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
-    const tinygltf::Accessor &accessor =
-        model.accessors[primitive.attributes.find("NORMAL")->second];
-    const tinygltf::BufferView &view = model.bufferViews[accessor.bufferView];
-    normal_buffer = reinterpret_cast<const float *>(
-        &(model.buffers[view.buffer]
-              .data[accessor.byteOffset + view.byteOffset]));
-  }
+    if (v < normal_count) {
+      read_element(*normals, v, value, 3);
+    } else {
+      value[0] = value[1] = value[2] = 0.0f;
+    }
+    out[v].normal = glm::vec4(value[0], value[1], value[2], 1.0f);
 
-  if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
-    const tinygltf::Accessor &accessor =
-        model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-    const tinygltf::BufferView &view = model.bufferViews[accessor.bufferView];
-    tex_coord_buffer = reinterpret_cast<const float *>(
-        &(model.buffers[view.buffer]
-              .data[accessor.byteOffset + view.byteOffset]));
+    if (v < tex_coord_count) {
+      read_element(*tex_coords, v, value, 2);
+    } else {
+      value[0] = value[1] = 0.0f;
+    }
+    out[v].tex_coord = glm::vec2(value[0], value[1]);
+
+    out[v].joints = glm::u16vec4(0);
+    out[v].weights = glm::vec4(0.0f);
+    if (v < joint_count) {
+      float joint[4];
+      read_element(*joints, v, joint, 4);
+      read_element(*weights, v, &out[v].weights[0], 4);
+      out[v].joints = glm::u16vec4(joint[0], joint[1], joint[2], joint[3]);
+    }
   }
+}
 
-  for (size_t v = 0; v < vertex_count; v++) {
-    glm::vec4 pos = glm::vec4(glm::make_vec3(&position_buffer[v * 3]), 1.0f);
-    glm::vec4 norm = glm::vec4(
-        glm::vec3(normal_buffer ? glm::make_vec3(&normal_buffer[v * 3])
-                                : glm::vec3(0.0f)),
-        1.0f);
-
-    glm::vec2 uv = tex_coord_buffer ? glm::make_vec2(&tex_coord_buffer[v * 2])
-                                    : glm::vec3(0.0f);
+uint32_t ModelImportOptions::get_cache_flags() const {
+  uint32_t lods = std::min(lod_count, MAX_LOD_COUNT - 1);
+  uint32_t ratio = static_cast<uint32_t>(
+      std::lround(std::clamp(lod_ratio, 0.0f, 1.0f) * 255.0f));
 
-    Vertex vertex(pos, norm, uv);
+  return (optimize ? MESH_CACHE_FLAG_OPTIMIZED : 0) |
+         (build_meshlets ? MESH_CACHE_FLAG_MESHLETS : 0) |
+         lods << MESH_CACHE_LOD_COUNT_SHIFT |
+         (lods > 0 ? ratio << MESH_CACHE_LOD_RATIO_SHIFT : 0);
+}
 
-    vertices.push_back(vertex);
+bool Model::add_mesh(const std::string &fileName,
+                     std::optional<std::string> name,
+                     const ModelImportOptions &options) {
+  if (!check_gltf(fileName)) {
+    ERR("could not add gltf model");
+    return false;
   }
-}
 
-void Model::add_mesh(const std::string &fileName,
-                     std::optional<std::string> name) {
-  // NOTE: disabled reading from files
-  /*
-      if (name.has_value() && file_exists(name.value())) {
-              model_name = name.value();
-              //read_from_file();
-              return;
+  uint64_t file_hash = hash_gltf(fileName);
+  uint32_t cache_flags = options.get_cache_flags();
+  // only cook models that were imported into an empty model, otherwise the
+  // cache would also contain whatever was loaded before.
+  bool was_empty = model_vertices.empty() && primitives.empty();
+
+  // named models are cooked into a .tucomesh next to the source the first
+  // time they are imported and read back from it afterwards.
+  std::string cache_path;
+  if (name.has_value()) {
+    model_name = name.value();
+    cache_path = get_mesh_cache_path(fileName, model_name);
+
+    if (file_hash != 0 && read_from_file(cache_path, file_hash, cache_flags)) {
+      if (is_skinned()) {
+        assign_rigid_joints();
       }
-  */
-
-  if (check_gltf(fileName)) {
-    add_gltf_model(fileName);
-    return;
-  } else {
-    ERR("could not add gltf model");
-    return;
+      add_source(fileName, file_hash, cache_flags, was_empty);
+      return true;
+    }
   }
-}
 
-Model::Model() {}
-Model::~Model() {}
+  size_t first_primitive = primitives.size();
+  size_t vertex_begin = model_vertices.size();
+  size_t index_begin = model_indices.size();
 
-void Model::read_from_file() {
-  std::string file_name = model_name + ".bin";
-  std::ifstream file(file_name, std::ios::in | std::ios::binary);
-  if (!file) {
-    ERR("file: [%s] could not be opened.", file_name);
-    return;
+  if (!add_gltf_model(fileName)) {
+    return false;
   }
 
-  //uint32_t index;
-  //glm::vec3 texture_opacity;
-  //glm::vec3 ambient;
-  //glm::vec3 diffuse;
-  //glm::vec3 specular;
+  // welding and reordering would move vertices out from under the morph
+  // targets' deltas.
+  if (options.optimize && !morphs.empty()) {
+    INFO("{} has morph targets, skipping the vertex optimizer", fileName);
+  } else if (options.optimize) {
+    MeshOptimizeStats stats =
+        optimize_mesh(model_vertices, model_indices, primitives,
+                      first_primitive, vertex_begin, index_begin);
+    INFO("optimized {}: vertices {} -> {}, acmr {:.3f} -> {:.3f}, atvr {:.3f} "
+         "-> {:.3f}",
+         fileName, stats.vertices_before, stats.vertices_after,
+         stats.before.get_acmr(), stats.after.get_acmr(),
+         stats.before.get_atvr(), stats.after.get_atvr());
+  }
 
-  while (file.peek() != EOF) {
-    // read current byte as float
-    // float f;
-    // file.read(reinterpret_cast<char*>(&f), sizeof(float));
+  if (options.build_meshlets) {
+    size_t meshlet_begin = meshlets.size();
+    build_meshlets(model_vertices, model_indices, primitives, first_primitive,
+                   meshlets);
+    INFO("built {} meshlets for {}", meshlets.size() - meshlet_begin,
+         fileName);
+  }
 
-    std::vector<Vertex> vertices = read_vertices(&file);
-    std::vector<uint32_t> indices = read_indices(&file);
-    std::vector<ImageBuffer> images = read_images(&file);
-    std::vector<Material> materials = read_materials(&file);
+  // levels are appended after the optimized index data, so this has to run
+  // last.
+  if (options.lod_count > 0) {
+    size_t lod_begin = model_indices.size();
+    generate_lods(model_vertices, model_indices, primitives, first_primitive,
+                  options.lod_count, options.lod_ratio);
+    INFO("generated lods for {}: {} -> {} indices", fileName,
+         lod_begin - index_begin, model_indices.size() - index_begin);
+  }
 
-    model_vertices = vertices;
-    model_indices = indices;
-    // model_materials = materials;
+  // the cache has no room for skins, morph targets and animations, those
+  // models are imported from the source every time.
+  bool animated = is_skinned() || !morphs.empty() || !animations.empty();
+  if (name.has_value() && file_hash != 0 && was_empty && !animated) {
+    write_to_file(cache_path, file_hash, cache_flags);
   }
 
-  file.close();
+  add_source(fileName, file_hash, cache_flags, was_empty);
+  return true;
 }
 
-std::vector<ImageBuffer> Model::read_images(std::ifstream *file) {
-  std::vector<ImageBuffer> images;
-
-  while (file->peek() != EOF) {
-    ImageBuffer ib;
-    // get buffer size
-    //uint32_t buffer_size;
-    file->read(reinterpret_cast<char *>(&ib.buffer_size), sizeof(uint32_t));
-
-    // if at end of image data, then buffer size will be uint32_t::max
-    if (ib.buffer_size == UINT32_MAX)
-      break;
-
-    // get image data
-    file->read(reinterpret_cast<char *>(&ib.buffer), sizeof(ib.buffer_size));
+void Model::add_source(const std::string &file_name, uint64_t file_hash,
+                       uint32_t flags, bool first) {
+  if (first) {
+    source_path = file_name;
+    source_hash = 0xCBF29CE484222325ull;
+  } else {
+    source_path += ";" + file_name;
+  }
 
-    // get image dimensions
-    file->read(reinterpret_cast<char *>(&ib.width), sizeof(uint32_t));
-    file->read(reinterpret_cast<char *>(&ib.height), sizeof(uint32_t));
+  if (file_hash == 0 || source_hash == 0) {
+    source_hash = 0;
+    return;
+  }
 
-    images.push_back(ib);
+  // same mixing as hash_file, the flags are part of the key since they change
+  // what ends up in the buffers.
+  const uint64_t prime = 0x100000001B3ull;
+  for (uint64_t word : {file_hash, static_cast<uint64_t>(flags)}) {
+    source_hash = (source_hash ^ word) * prime;
+    source_hash ^= source_hash >> 29;
   }
-  return images;
+  source_hash = source_hash == 0 ? 1 : source_hash;
 }
 
-std::string Model::get_texture(std::ifstream *file) {
-  std::string texture_path;
-  while (file->peek() != EOF) {
-    char c;
-    file->read(&c, 1);
+Model::Model() {}
+Model::~Model() {}
 
-    texture_path.push_back(c);
+bool Model::read_from_file(const std::string &cache_path,
+                           uint64_t file_hash, uint32_t flags) {
+  br::MappedFile file;
+  if (!file.open(cache_path))
+    return false;
+
+  const unsigned char *data = file.data();
+  const size_t size = file.size();
+
+  if (size < sizeof(MeshCacheHeader))
+    return false;
+
+  MeshCacheHeader header;
+  memcpy(&header, data, sizeof(header));
+  if (header.magic != MESH_CACHE_MAGIC ||
+      header.version != MESH_CACHE_VERSION ||
+      header.source_hash != file_hash || header.file_size != size ||
+      header.flags != flags) {
+    INFO("{} is out of date, re-cooking", cache_path);
+    return false;
   }
 
-  return texture_path;
-}
-
-std::vector<uint32_t> Model::read_indices(std::ifstream *file) {
-  bool stop = false;
-  uint32_t i;
-  std::vector<uint32_t> indices;
-  while (!stop && file->peek() != EOF) {
-    file->read(reinterpret_cast<char *>(&i), sizeof(uint32_t));
-
-    if (i == std::numeric_limits<uint32_t>::max()) {
-      stop = true;
-      break;
+  const uint64_t table_end = sizeof(MeshCacheHeader) +
+                             uint64_t(header.section_count) *
+                                 sizeof(MeshCacheSection);
+  if (table_end > size)
+    return false;
+
+  const MeshCacheSection *table = reinterpret_cast<const MeshCacheSection *>(
+      data + sizeof(MeshCacheHeader));
+
+  // EFFECTS: returns the section of the given type if it exists, matches the
+  //          expected element size and lies entirely within the file.
+  auto find_section = [&](MeshCacheSectionType type,
+                          size_t stride) -> const MeshCacheSection * {
+    for (uint32_t i = 0; i < header.section_count; i++) {
+      const MeshCacheSection &section = table[i];
+      if (section.type != static_cast<uint32_t>(type))
+        continue;
+      if (section.stride != stride || section.offset > size ||
+          section.count > (size - section.offset) / stride)
+        return nullptr;
+      return &section;
     }
-    indices.push_back(i);
+    return nullptr;
+  };
+
+  const MeshCacheSection *vertex_section =
+      find_section(MeshCacheSectionType::Vertices, sizeof(Vertex));
+  const MeshCacheSection *index_section =
+      find_section(MeshCacheSectionType::Indices, sizeof(uint32_t));
+  const MeshCacheSection *primitive_section =
+      find_section(MeshCacheSectionType::Primitives, sizeof(MeshCachePrimitive));
+  const MeshCacheSection *node_section =
+      find_section(MeshCacheSectionType::Nodes, sizeof(MeshCacheNode));
+  const MeshCacheSection *image_section =
+      find_section(MeshCacheSectionType::Images, sizeof(MeshCacheImage));
+  const MeshCacheSection *image_data_section =
+      find_section(MeshCacheSectionType::ImageData, 1);
+  const MeshCacheSection *meshlet_section =
+      find_section(MeshCacheSectionType::Meshlets, sizeof(Meshlet));
+  const MeshCacheSection *material_section = find_section(
+      MeshCacheSectionType::Materials, sizeof(MaterialDescription));
+
+  if (!vertex_section || !index_section || !primitive_section ||
+      !node_section || !image_section || !image_data_section ||
+      !meshlet_section || !material_section) {
+    WARN("{} is missing sections or has an incompatible layout", cache_path);
+    return false;
   }
 
-  return indices;
-}
-
-std::vector<Material> Model::read_materials(std::ifstream *file) {
-  //size_t read_state = 0;
-  //glm::vec4 t;
-  glm::vec4 ambience;
-  glm::vec4 diffuse;
-  glm::vec4 specular;
-
-  std::vector<Material> mats;
-
-  while (file->peek() != EOF) {
-    float f;
-    // read ambience
-    for (size_t i = 0; i < 3; i++) {
-      file->read(reinterpret_cast<char *>(&f), sizeof(float));
-      ambience[i] = f;
+  const MeshCachePrimitive *cached_primitives =
+      reinterpret_cast<const MeshCachePrimitive *>(data +
+                                                   primitive_section->offset);
+  for (uint64_t i = 0; i < primitive_section->count; i++) {
+    const MeshCachePrimitive &prim = cached_primitives[i];
+    bool valid =
+        uint64_t(prim.index_start) + prim.index_count <= index_section->count &&
+        prim.transform_index < node_section->count &&
+        prim.lod_count < MAX_LOD_COUNT;
+    for (uint32_t l = 0; valid && l < prim.lod_count; l++) {
+      valid = uint64_t(prim.lods[l].index_start) + prim.lods[l].index_count <=
+              index_section->count;
     }
-
-    // read diffuse
-    for (size_t i = 0; i < 3; i++) {
-      file->read(reinterpret_cast<char *>(&f), sizeof(float));
-      diffuse[i] = f;
+    valid = valid && uint64_t(prim.meshlet_start) + prim.meshlet_count <=
+                         meshlet_section->count;
+    valid = valid && prim.mat_index >= -1 &&
+            prim.mat_index < static_cast<int64_t>(material_section->count);
+    if (!valid) {
+      WARN("{} has an invalid primitive table", cache_path);
+      return false;
     }
+  }
 
-    // read specular
-    for (size_t i = 0; i < 3; i++) {
-      file->read(reinterpret_cast<char *>(&f), sizeof(float));
-      specular[i] = f;
+  // parents have to come first for the hierarchy to resolve in one pass.
+  const MeshCacheNode *checked_nodes =
+      reinterpret_cast<const MeshCacheNode *>(data + node_section->offset);
+  for (uint64_t i = 0; i < node_section->count; i++) {
+    if (checked_nodes[i].parent >= static_cast<int64_t>(i)) {
+      WARN("{} has an invalid node table", cache_path);
+      return false;
     }
   }
 
-  return mats;
-}
-
-std::vector<Vertex> Model::read_vertices(std::ifstream *file) {
-  size_t read_state = 0;
-  glm::vec4 pos;
-  glm::vec4 norm;
-  glm::vec2 tex;
-
-  bool stop = false;
-  std::vector<Vertex> vertexes;
-
-  while (!stop && file->peek() != EOF) {
-    float f;
-    file->read(reinterpret_cast<char *>(&f), sizeof(float));
-
-    switch (read_state) {
-    case 0:
-      if (f > 3.4e10) {
-        stop = true;
-        break;
-      }
-      pos.x = f;
-      read_state++;
-      break;
-
-    case 1:
-      pos.y = f;
-      read_state++;
-      break;
-
-    case 2:
-      pos.z = f;
-      read_state++;
-      break;
-
-    case 3:
-      norm.x = f;
-      read_state++;
-      break;
-
-    case 4:
-      norm.y = f;
-      read_state++;
-      break;
+  const Meshlet *cached_meshlets =
+      reinterpret_cast<const Meshlet *>(data + meshlet_section->offset);
+  for (uint64_t i = 0; i < meshlet_section->count; i++) {
+    if (uint64_t(cached_meshlets[i].index_start) +
+            cached_meshlets[i].index_count >
+        index_section->count) {
+      WARN("{} has an invalid meshlet table", cache_path);
+      return false;
+    }
+  }
 
-    case 5:
-      norm.z = f;
-      read_state++;
-      break;
+  const MeshCacheImage *cached_images =
+      reinterpret_cast<const MeshCacheImage *>(data + image_section->offset);
+  for (uint64_t i = 0; i < image_section->count; i++) {
+    if (cached_images[i].data_offset > image_data_section->count ||
+        cached_images[i].size >
+            image_data_section->count - cached_images[i].data_offset) {
+      WARN("{} has an invalid image table", cache_path);
+      return false;
+    }
+  }
 
-    case 6:
-      tex.x = f;
-      read_state++;
-      break;
+  const MaterialDescription *cached_materials =
+      reinterpret_cast<const MaterialDescription *>(data +
+                                                    material_section->offset);
+  for (uint64_t i = 0; i < material_section->count; i++) {
+    const MaterialDescription &material = cached_materials[i];
+    if (material.base_color_image < -1 ||
+        material.base_color_image >= int64_t(image_section->count) ||
+        material.metallic_roughness_image < -1 ||
+        material.metallic_roughness_image >= int64_t(image_section->count)) {
+      WARN("{} has an invalid material table", cache_path);
+      return false;
+    }
+  }
 
-    case 7: {
-      tex.y = f;
+  // everything checked out, the blobs can be taken as is.
+  const uint32_t vertex_start = static_cast<uint32_t>(model_vertices.size());
+  const uint32_t index_start = static_cast<uint32_t>(model_indices.size());
+  const uint32_t node_start = static_cast<uint32_t>(nodes.size());
+  const uint32_t meshlet_start = static_cast<uint32_t>(meshlets.size());
+  const int32_t image_start = static_cast<int32_t>(model_images.size());
+  const int32_t material_start = static_cast<int32_t>(model_materials.size());
+
+  model_vertices.resize(vertex_start + vertex_section->count);
+  memcpy(model_vertices.data() + vertex_start, data + vertex_section->offset,
+         vertex_section->count * sizeof(Vertex));
+
+  model_indices.resize(index_start + index_section->count);
+  memcpy(model_indices.data() + index_start, data + index_section->offset,
+         index_section->count * sizeof(uint32_t));
+  // indices were rebased against an empty model when cooked.
+  if (vertex_start > 0) {
+    for (size_t i = index_start; i < model_indices.size(); i++) {
+      model_indices[i] += vertex_start;
+    }
+  }
 
-      pos.w = 0;
-      norm.w = 0;
-      Vertex vertex(pos, norm, tex);
-      vertexes.push_back(vertex);
-      read_state = 0;
-      break;
+  const MeshCacheNode *cached_nodes = checked_nodes;
+  nodes.reserve(node_start + node_section->count);
+  for (uint64_t i = 0; i < node_section->count; i++) {
+    const MeshCacheNode &cached = cached_nodes[i];
+    int32_t parent = cached.parent < 0 ? model::NO_PARENT
+                                       : cached.parent + int32_t(node_start);
+    if (cached.has_trs) {
+      glm::quat rotation;
+      rotation.x = cached.rotation[0];
+      rotation.y = cached.rotation[1];
+      rotation.z = cached.rotation[2];
+      rotation.w = cached.rotation[3];
+      nodes.add_node(parent, glm::make_vec3(cached.translation), rotation,
+                     glm::make_vec3(cached.scale));
+    } else {
+      nodes.add_node(parent, glm::make_mat4(cached.local));
     }
+  }
+  nodes.update_world();
+
+  primitives.reserve(primitives.size() + primitive_section->count);
+  for (uint64_t i = 0; i < primitive_section->count; i++) {
+    const MeshCachePrimitive &cached = cached_primitives[i];
+    Primitive prim{};
+    prim.index_start = cached.index_start + index_start;
+    prim.index_count = cached.index_count;
+    prim.transform_index = cached.transform_index + node_start;
+    prim.mat_index =
+        cached.mat_index < 0 ? -1 : cached.mat_index + material_start;
+    prim.image_index =
+        cached.image_index < 0 ? -1 : cached.image_index + image_start;
+    prim.is_transparent = cached.is_transparent != 0;
+    prim.lod_count = cached.lod_count;
+    for (uint32_t l = 0; l < cached.lod_count; l++) {
+      prim.lods[l].index_start = cached.lods[l].index_start + index_start;
+      prim.lods[l].index_count = cached.lods[l].index_count;
+      prim.lods[l].error = cached.lods[l].error;
     }
+    prim.meshlet_start = cached.meshlet_start + meshlet_start;
+    prim.meshlet_count = cached.meshlet_count;
+    primitives.push_back(prim);
   }
 
-  return vertexes;
-}
-
-bool Model::file_exists(std::string name) {
-  std::fstream file;
-  std::string file_name = name + ".bin";
-  file.open(file_name, std::ios::in);
-
-  if (file.is_open()) {
-    INFO("file [%s] exists.", file_name.c_str());
+  meshlets.insert(meshlets.end(), cached_meshlets,
+                  cached_meshlets + meshlet_section->count);
+  for (size_t i = meshlet_start; i < meshlets.size(); i++) {
+    meshlets[i].index_start += index_start;
   }
 
-  return file.is_open();
-}
+  const unsigned char *pixels = data + image_data_section->offset;
+  model_images.resize(image_start + image_section->count);
+  for (uint64_t i = 0; i < image_section->count; i++) {
+    const MeshCacheImage &cached = cached_images[i];
+    ImageBuffer &image = model_images[image_start + i];
+    image.width = cached.width;
+    image.height = cached.height;
+    image.buffer_size = cached.size;
+    image.buffer.assign(pixels + cached.data_offset,
+                        pixels + cached.data_offset + cached.size);
+    image.key = cached.key;
+  }
 
-std::vector<uint32_t> Model::linearlize_primitive(Primitive primitive) {
-  std::vector<uint32_t> lin;
-  lin.push_back(primitive.image_index);
-  lin.push_back(primitive.index_count);
-  lin.push_back(primitive.index_start);
-  lin.push_back(primitive.mat_index);
-  lin.push_back(static_cast<uint32_t>(primitive.is_transparent));
+  model_materials.reserve(model_materials.size() + material_section->count);
+  for (uint64_t i = 0; i < material_section->count; i++) {
+    MaterialDescription material = cached_materials[i];
+    if (material.base_color_image >= 0)
+      material.base_color_image += image_start;
+    if (material.metallic_roughness_image >= 0)
+      material.metallic_roughness_image += image_start;
+    model_materials.push_back(material);
+  }
 
-  return lin;
+  return true;
 }
 
-// [TODO 08/2024] - Proper asset loading/saving.
-void Model::write_to_file() {
-  std::ofstream file;
-  file.open(model_name + ".bin", std::ios::out | std::ios::binary);
-
-  // file.write(model_name.c_str(), sizeof(model_name.c_str()));
-  uint32_t c = std::numeric_limits<uint32_t>::max();
-  float f = std::numeric_limits<float>::max();
-
-  // save vertices
-  for (Vertex &vertex : model_vertices) {
-    std::vector<float> vertex_linearlized = vertex.linearlize();
-    for (float &num : vertex_linearlized) {
-      file.write(reinterpret_cast<char *>(&num), sizeof(float));
+void Model::write_to_file(const std::string &cache_path, uint64_t file_hash,
+                          uint32_t flags) {
+  std::vector<MeshCachePrimitive> cached_primitives(primitives.size());
+  for (size_t i = 0; i < primitives.size(); i++) {
+    cached_primitives[i].index_start = primitives[i].index_start;
+    cached_primitives[i].index_count = primitives[i].index_count;
+    cached_primitives[i].transform_index = primitives[i].transform_index;
+    cached_primitives[i].mat_index = primitives[i].mat_index;
+    cached_primitives[i].image_index = primitives[i].image_index;
+    cached_primitives[i].is_transparent = primitives[i].is_transparent ? 1 : 0;
+    cached_primitives[i].lod_count = primitives[i].lod_count;
+    for (uint32_t l = 0; l < primitives[i].lod_count; l++) {
+      const PrimitiveLod &lod = primitives[i].lods[l];
+      cached_primitives[i].lods[l] = {lod.index_start, lod.index_count,
+                                      lod.error};
     }
+    cached_primitives[i].meshlet_start = primitives[i].meshlet_start;
+    cached_primitives[i].meshlet_count = primitives[i].meshlet_count;
   }
-  file.write(reinterpret_cast<char *>(&f), sizeof(float));
-
-  // save indices
-  for (uint32_t &index : model_indices) {
-    file.write(reinterpret_cast<char *>(&index), sizeof(uint32_t));
-  }
-  file.write(reinterpret_cast<char *>(&c), sizeof(uint32_t));
 
-  // save image data
-  // TODO: load image with stb_image.h and save image buffer data to file
-  // (faster at runtime) and consistent with gltf importing
-
-  // save primitives
-  for (Primitive &prim : primitives) {
-    std::vector<uint32_t> lin = linearlize_primitive(prim);
-    for (uint32_t &u_int : lin) {
-      file.write(reinterpret_cast<char *>(&lin), sizeof(uint32_t));
-    }
+  std::vector<MeshCacheNode> cached_nodes(nodes.size());
+  for (uint32_t i = 0; i < nodes.size(); i++) {
+    MeshCacheNode &cached = cached_nodes[i];
+    const glm::vec3 &translation = nodes.get_translation(i);
+    const glm::quat &rotation = nodes.get_rotation(i);
+    const glm::vec3 &scale = nodes.get_scale(i);
+    const glm::mat4 &local = nodes.get_local(i);
+
+    cached.parent = nodes.get_parent(i);
+    cached.has_trs = nodes.has_trs(i) ? 1 : 0;
+    memcpy(cached.translation, &translation[0], sizeof(cached.translation));
+    cached.rotation[0] = rotation.x;
+    cached.rotation[1] = rotation.y;
+    cached.rotation[2] = rotation.z;
+    cached.rotation[3] = rotation.w;
+    memcpy(cached.scale, &scale[0], sizeof(cached.scale));
+    memcpy(cached.local, &local[0][0], sizeof(cached.local));
   }
 
-  // save images
+  std::vector<MeshCacheImage> cached_images(model_images.size());
+  uint64_t pixel_bytes = 0;
   for (size_t i = 0; i < model_images.size(); i++) {
-    unsigned char image_buffer = model_images[i].buffer[0];
-    uint32_t buffer_size = model_images[i].buffer_size;
-
-    uint32_t image_width = model_images[i].width;
-    uint32_t image_height = model_images[i].height;
+    cached_images[i].width = model_images[i].width;
+    cached_images[i].height = model_images[i].height;
+    cached_images[i].size = model_images[i].buffer.size();
+    cached_images[i].data_offset = pixel_bytes;
+    cached_images[i].key = model_images[i].key;
+    pixel_bytes += model_images[i].buffer.size();
+  }
 
-    file.write(reinterpret_cast<char *>(&buffer_size), sizeof(uint32_t));
-    file.write(reinterpret_cast<char *>(&image_buffer), buffer_size);
-    file.write(reinterpret_cast<char *>(image_width), sizeof(uint32_t));
-    file.write(reinterpret_cast<char *>(image_height), sizeof(uint32_t));
+  struct Blob {
+    MeshCacheSectionType type;
+    uint32_t stride;
+    uint64_t count;
+    const void *data;
+  };
+  const Blob blobs[] = {
+      {MeshCacheSectionType::Vertices, sizeof(Vertex), model_vertices.size(),
+       model_vertices.data()},
+      {MeshCacheSectionType::Indices, sizeof(uint32_t), model_indices.size(),
+       model_indices.data()},
+      {MeshCacheSectionType::Primitives, sizeof(MeshCachePrimitive),
+       cached_primitives.size(), cached_primitives.data()},
+      {MeshCacheSectionType::Nodes, sizeof(MeshCacheNode), cached_nodes.size(),
+       cached_nodes.data()},
+      {MeshCacheSectionType::Images, sizeof(MeshCacheImage),
+       cached_images.size(), cached_images.data()},
+      {MeshCacheSectionType::ImageData, 1, pixel_bytes, nullptr},
+      {MeshCacheSectionType::Meshlets, sizeof(Meshlet), meshlets.size(),
+       meshlets.data()},
+      {MeshCacheSectionType::Materials, sizeof(MaterialDescription),
+       model_materials.size(), model_materials.data()},
+  };
+  const uint32_t section_count = sizeof(blobs) / sizeof(blobs[0]);
+
+  std::vector<MeshCacheSection> table(section_count);
+  uint64_t offset = align_cache_offset(sizeof(MeshCacheHeader) +
+                                       section_count * sizeof(MeshCacheSection));
+  for (uint32_t i = 0; i < section_count; i++) {
+    table[i].type = static_cast<uint32_t>(blobs[i].type);
+    table[i].stride = blobs[i].stride;
+    table[i].count = blobs[i].count;
+    table[i].offset = offset;
+    offset = align_cache_offset(offset + blobs[i].count * blobs[i].stride);
   }
 
-  file.write(reinterpret_cast<char *>(&c), sizeof(uint32_t));
+  MeshCacheHeader header{};
+  header.magic = MESH_CACHE_MAGIC;
+  header.version = MESH_CACHE_VERSION;
+  header.source_hash = file_hash;
+  header.file_size = offset;
+  header.section_count = section_count;
+  header.flags = flags;
+
+  // write to a temporary file first so a crash (or another loader reading the
+  // same name) never sees a half written cache.
+  std::string temp_path =
+      cache_path + ".tmp" +
+      std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+  std::ofstream file(temp_path, std::ios::out | std::ios::binary);
+  if (!file) {
+    WARN("could not create mesh cache {}", cache_path);
+    return;
+  }
 
-  /*
-  // save materials
-  for (Material &mat : model_materials) {
-    std::vector<float> mat_floats = mat.linearlize();
-    for (float &num : mat_floats) {
-      file.write(reinterpret_cast<char *>(&num), sizeof(float));
+  const char padding[MESH_CACHE_ALIGNMENT] = {};
+  uint64_t written = 0;
+  auto pad_to = [&](uint64_t target) {
+    file.write(padding, static_cast<std::streamsize>(target - written));
+    written = target;
+  };
+
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(table.data()),
+             section_count * sizeof(MeshCacheSection));
+  written = sizeof(header) + section_count * sizeof(MeshCacheSection);
+
+  for (uint32_t i = 0; i < section_count; i++) {
+    pad_to(table[i].offset);
+    if (blobs[i].type == MeshCacheSectionType::ImageData) {
+      for (const ImageBuffer &image : model_images) {
+        file.write(reinterpret_cast<const char *>(image.buffer.data()),
+                   static_cast<std::streamsize>(image.buffer.size()));
+      }
+    } else if (blobs[i].count > 0) {
+      file.write(reinterpret_cast<const char *>(blobs[i].data),
+                 static_cast<std::streamsize>(blobs[i].count * blobs[i].stride));
     }
-    file.write(reinterpret_cast<char *>(&mat.image_index), sizeof(uint32_t));
+    written += blobs[i].count * blobs[i].stride;
   }
-  */
-
+  pad_to(header.file_size);
   file.close();
+
+  // a short or failed write never replaces the cache, the next import would
+  // map a truncated file.
+  std::error_code error;
+  if (!file) {
+    WARN("could not write mesh cache {}", cache_path);
+    std::filesystem::remove(temp_path, error);
+    return;
+  }
+
+  std::filesystem::rename(temp_path, cache_path, error);
+  if (error) {
+    WARN("could not replace mesh cache {} : {}", cache_path, error.message());
+    std::filesystem::remove(temp_path, error);
+  }
 }
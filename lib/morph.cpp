@@ -0,0 +1,91 @@
+#include "morph.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define TUCO_MORPH_SSE 1
+#endif
+
+using namespace tuco;
+
+void tuco::apply_morph_target(const MorphDelta *deltas,
+                              const uint32_t *vertices, size_t count,
+                              float weight, Vertex *out) {
+#ifdef TUCO_MORPH_SSE
+  __m128 w = _mm_set1_ps(weight);
+  for (size_t d = 0; d < count; d++) {
+    float *position = &out[vertices[d]].position[0];
+    float *normal = &out[vertices[d]].normal[0];
+    __m128 dp = _mm_loadu_ps(&deltas[d].position[0]);
+    __m128 dn = _mm_loadu_ps(&deltas[d].normal[0]);
+    _mm_storeu_ps(position,
+                  _mm_add_ps(_mm_loadu_ps(position), _mm_mul_ps(w, dp)));
+    _mm_storeu_ps(normal, _mm_add_ps(_mm_loadu_ps(normal), _mm_mul_ps(w, dn)));
+  }
+#else
+  for (size_t d = 0; d < count; d++) {
+    out[vertices[d]].position += weight * deltas[d].position;
+    out[vertices[d]].normal += weight * deltas[d].normal;
+  }
+#endif
+}
+
+size_t tuco::evaluate_morphs(const MorphData &morphs, const Vertex *base,
+                             Vertex *out, MorphState &state) {
+  state.dirty.resize(morphs.ranges.size(), 0);
+
+  size_t applied = 0;
+  for (size_t r = 0; r < morphs.ranges.size(); r++) {
+    const MorphRange &range = morphs.ranges[r];
+    const float *weights = morphs.weights.data() + range.weight_start;
+
+    bool active = false;
+    for (uint32_t t = 0; t < range.target_count && !active; t++) {
+      active = weights[t] != 0.0f;
+    }
+    if (!active && !state.dirty[r])
+      continue;
+
+    const uint32_t *touched =
+        morphs.touched_vertices.data() + range.touched_start;
+    for (uint32_t i = 0; i < range.touched_count; i++) {
+      out[touched[i]].position = base[touched[i]].position;
+      out[touched[i]].normal = base[touched[i]].normal;
+    }
+
+    for (uint32_t t = 0; t < range.target_count; t++) {
+      if (weights[t] == 0.0f)
+        continue;
+
+      const MorphTarget &target = morphs.targets[range.target_start + t];
+      apply_morph_target(morphs.deltas.data() + target.delta_start,
+                         morphs.delta_vertices.data() + target.delta_start,
+                         target.delta_count, weights[t], out);
+      applied++;
+    }
+    state.dirty[r] = active ? 1 : 0;
+  }
+  return applied;
+}
+
+size_t tuco::count_active_morphs(const MorphData &morphs) {
+  size_t active = 0;
+  for (const MorphRange &range : morphs.ranges) {
+    for (uint32_t t = 0; t < range.target_count; t++) {
+      active += morphs.weights[range.weight_start + t] != 0.0f ? 1 : 0;
+    }
+  }
+  return active;
+}
+
+void tuco::compute_morph_extents(const MorphData &morphs, size_t count,
+                                 std::vector<float> &extents) {
+  extents.assign(count, 0.0f);
+  for (const MorphTarget &target : morphs.targets) {
+    for (uint32_t d = 0; d < target.delta_count; d++) {
+      uint32_t vertex = morphs.delta_vertices[target.delta_start + d];
+      const MorphDelta &delta = morphs.deltas[target.delta_start + d];
+      if (vertex < count)
+        extents[vertex] += glm::length(glm::vec3(delta.position));
+    }
+  }
+}
@@ -1,32 +1,141 @@
 #include "node.hpp"
 
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define TUCO_NODE_SSE 1
+#endif
+
 using namespace model;
 
-Node::Node(const glm::mat4& matrix, Node* parent_node) {
-	Node::matrix = matrix;
-	Node::parent_node = parent_node;
+#ifdef TUCO_NODE_SSE
+void model::multiply_mat4(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+	// column major: column j of the result is a's columns weighted by b[j].
+	const float* pa = &a[0][0];
+	const float* pb = &b[0][0];
+	__m128 a0 = _mm_loadu_ps(pa + 0);
+	__m128 a1 = _mm_loadu_ps(pa + 4);
+	__m128 a2 = _mm_loadu_ps(pa + 8);
+	__m128 a3 = _mm_loadu_ps(pa + 12);
+
+	float result[16];
+	for (int j = 0; j < 4; j++) {
+		__m128 column = _mm_mul_ps(a0, _mm_set1_ps(pb[j * 4 + 0]));
+		column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(pb[j * 4 + 1])));
+		column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(pb[j * 4 + 2])));
+		column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(pb[j * 4 + 3])));
+		_mm_storeu_ps(result + j * 4, column);
+	}
+	std::copy(result, result + 16, &out[0][0]);
 }
+#else
+void model::multiply_mat4(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+	out = a * b;
+}
+#endif
 
-Node::Node(Node* parent_node) {
-	Node::parent_node = parent_node;
+glm::mat4 model::compose_trs(const glm::vec3& t, const glm::quat& r, const glm::vec3& s) {
+	glm::mat4 matrix = glm::mat4_cast(r);
+	matrix[0] *= s.x;
+	matrix[1] *= s.y;
+	matrix[2] *= s.z;
+	matrix[3] = glm::vec4(t, 1.0f);
+	return matrix;
 }
 
-void Node::add_parent(Node* parent_node) {
-	Node::parent_node = parent_node;
+uint32_t NodeHierarchy::add_node(int32_t parent, const glm::vec3& translation,
+	const glm::quat& rotation, const glm::vec3& scale) {
+	uint32_t index = add_node(parent, compose_trs(translation, rotation, scale));
+	translations[index] = translation;
+	rotations[index] = rotation;
+	scales[index] = scale;
+	trs[index] = 1;
+	return index;
 }
 
-void Node::add_matrix(const glm::mat4& matrix) { 
-	Node::matrix = matrix; 
+uint32_t NodeHierarchy::add_node(int32_t parent, const glm::mat4& local) {
+	uint32_t index = static_cast<uint32_t>(parents.size());
+	parents.push_back(parent < static_cast<int32_t>(index) ? parent : NO_PARENT);
+	translations.push_back(glm::vec3(0.0f));
+	rotations.push_back(glm::identity<glm::quat>());
+	scales.push_back(glm::vec3(1.0f));
+	locals.push_back(local);
+	worlds.push_back(local);
+	dirty.push_back(DIRTY_WORLD);
+	trs.push_back(0);
+	any_dirty = true;
+	return index;
 }
 
-void Node::add_node(std::unique_ptr<Node> node) {
-	children.push_back(std::move(node));
+void NodeHierarchy::reserve(size_t count) {
+	parents.reserve(count);
+	translations.reserve(count);
+	rotations.reserve(count);
+	scales.reserve(count);
+	locals.reserve(count);
+	worlds.reserve(count);
+	dirty.reserve(count);
+	trs.reserve(count);
 }
 
-Node* Node::get_parent() {
-	return parent_node;
+void NodeHierarchy::clear() {
+	parents.clear();
+	translations.clear();
+	rotations.clear();
+	scales.clear();
+	locals.clear();
+	worlds.clear();
+	dirty.clear();
+	trs.clear();
+	any_dirty = false;
 }
 
-glm::mat4 Node::get_transform() {
-	return matrix;
-}
\ No newline at end of file
+void NodeHierarchy::set_translation(uint32_t node, const glm::vec3& translation) {
+	translations[node] = translation;
+	dirty[node] |= DIRTY_LOCAL | DIRTY_WORLD;
+	any_dirty = true;
+}
+
+void NodeHierarchy::set_rotation(uint32_t node, const glm::quat& rotation) {
+	rotations[node] = rotation;
+	dirty[node] |= DIRTY_LOCAL | DIRTY_WORLD;
+	any_dirty = true;
+}
+
+void NodeHierarchy::set_scale(uint32_t node, const glm::vec3& scale) {
+	scales[node] = scale;
+	dirty[node] |= DIRTY_LOCAL | DIRTY_WORLD;
+	any_dirty = true;
+}
+
+size_t NodeHierarchy::update_world() {
+	if (!any_dirty)
+		return 0;
+
+	// parents come first, so by the time a node is visited its parent's world
+	// transform (and dirty state) is final.
+	size_t updated = 0;
+	size_t count = parents.size();
+	for (size_t i = 0; i < count; i++) {
+		int32_t parent = parents[i];
+		if (parent != NO_PARENT && (dirty[parent] & DIRTY_WORLD))
+			dirty[i] |= DIRTY_WORLD;
+
+		if (!dirty[i])
+			continue;
+
+		if (dirty[i] & DIRTY_LOCAL)
+			locals[i] = compose_trs(translations[i], rotations[i], scales[i]);
+
+		if (parent == NO_PARENT)
+			worlds[i] = locals[i];
+		else
+			multiply_mat4(worlds[parent], locals[i], worlds[i]);
+		updated++;
+	}
+
+	std::fill(dirty.begin(), dirty.end(), uint8_t(0));
+	any_dirty = false;
+	return updated;
+}
@@ -106,14 +106,14 @@ vk::PipelineShaderStageCreateInfo TucoPipeline::fill_shader_stage_struct(vk::Sha
 
 void TucoPipeline::create_compute_pipeline(const PipelineConfig& config)
 {
-	vk::ShaderModule compute_shader;
-	vk::PipelineShaderStageCreateInfo shader_info;
+	shader_compiler.compile(config.compute_shader_path.value(), br::ShaderKind::ComputeShader);
+	vk::ShaderModule compute_shader =
+		create_shader_module(shader_compiler.get_code(br::ShaderKind::ComputeShader));
+	vk::PipelineShaderStageCreateInfo shader_info =
+		fill_shader_stage_struct(vk::ShaderStageFlagBits::eCompute, compute_shader);
 
-	br::ShaderText compute_code(config.compute_shader_path.value(), br::ShaderKind::ComputeShader);
-	compute_shader = create_shader_module(compute_code.get_code(br::ShaderKind::ComputeShader));
-	shader_info = fill_shader_stage_struct(vk::ShaderStageFlagBits::eCompute, compute_shader);
-
-	//create_pipeline_layout(config.descriptor_layouts, config.push_ranges);
+	shader_compiler.create_layouts(api_device, config.dynamic_uniforms, config.descriptor_arrays);
+	create_pipeline_layout(config.push_ranges);
 
 	auto pipeline_info = vk::ComputePipelineCreateInfo(
 		{},
@@ -121,8 +121,10 @@ void TucoPipeline::create_compute_pipeline(const PipelineConfig& config)
 		layout_
 	);
 
-
 	pipeline_ = api_device->get().createComputePipeline(VK_NULL_HANDLE, pipeline_info).value;
+
+	//destroy the used shader object
+	api_device->get().destroyShaderModule(compute_shader);
 }
 
 VkPipelineColorBlendAttachmentState TucoPipeline::enable_alpha_blending()
@@ -167,7 +169,7 @@ void TucoPipeline::create_render_pipeline(const PipelineConfig& config)
 		shader_stages.push_back(frag_shader_info);
 	}
 
-	shader_compiler.create_layouts(api_device);
+	shader_compiler.create_layouts(api_device, config.dynamic_uniforms, config.descriptor_arrays);
 
 	auto viewport = vk::Viewport(
 		0,
@@ -0,0 +1,190 @@
+#include "skinning.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define TUCO_SKINNING_SSE 1
+#endif
+
+using namespace tuco;
+
+namespace {
+
+inline uint32_t pack_unorm16x2(float a, float b) {
+  auto quantize = [](float v) {
+    return static_cast<uint32_t>(
+        std::lround(std::clamp(v, 0.0f, 1.0f) * 65535.0f));
+  };
+  return quantize(a) | quantize(b) << 16;
+}
+
+// MODIFIES: out
+// EFFECTS: writes position/normal of vertex blended by its influences, keeps
+//          the vertex as is if it has none.
+#ifdef TUCO_SKINNING_SSE
+inline void blend_vertex(const Vertex &vertex, const glm::mat4 *joint_matrices,
+                         Vertex &out) {
+  __m128 c0 = _mm_setzero_ps();
+  __m128 c1 = _mm_setzero_ps();
+  __m128 c2 = _mm_setzero_ps();
+  __m128 c3 = _mm_setzero_ps();
+
+  bool influenced = false;
+  for (int k = 0; k < 4; k++) {
+    float weight = vertex.weights[k];
+    if (weight == 0.0f)
+      continue;
+
+    const float *m = &joint_matrices[vertex.joints[k]][0][0];
+    __m128 w = _mm_set1_ps(weight);
+    c0 = _mm_add_ps(c0, _mm_mul_ps(w, _mm_loadu_ps(m + 0)));
+    c1 = _mm_add_ps(c1, _mm_mul_ps(w, _mm_loadu_ps(m + 4)));
+    c2 = _mm_add_ps(c2, _mm_mul_ps(w, _mm_loadu_ps(m + 8)));
+    c3 = _mm_add_ps(c3, _mm_mul_ps(w, _mm_loadu_ps(m + 12)));
+    influenced = true;
+  }
+
+  out = vertex;
+  if (!influenced)
+    return;
+
+  __m128 position = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(vertex.position.x)),
+                 _mm_mul_ps(c1, _mm_set1_ps(vertex.position.y))),
+      _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(vertex.position.z)), c3));
+  __m128 normal = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(vertex.normal.x)),
+                 _mm_mul_ps(c1, _mm_set1_ps(vertex.normal.y))),
+      _mm_mul_ps(c2, _mm_set1_ps(vertex.normal.z)));
+
+  _mm_storeu_ps(&out.position[0], position);
+  _mm_storeu_ps(&out.normal[0], normal);
+}
+#else
+inline void blend_vertex(const Vertex &vertex, const glm::mat4 *joint_matrices,
+                         Vertex &out) {
+  glm::mat4 skin = glm::mat4(0.0f);
+  bool influenced = false;
+  for (int k = 0; k < 4; k++) {
+    if (vertex.weights[k] == 0.0f)
+      continue;
+    skin += joint_matrices[vertex.joints[k]] * vertex.weights[k];
+    influenced = true;
+  }
+
+  out = vertex;
+  if (!influenced)
+    return;
+
+  out.position = skin * glm::vec4(glm::vec3(vertex.position), 1.0f);
+  out.normal = skin * glm::vec4(glm::vec3(vertex.normal), 0.0f);
+}
+#endif
+
+} // namespace
+
+void tuco::compute_joint_bounds(const Vertex *vertices, size_t count,
+                                size_t joint_count,
+                                std::vector<glm::vec4> &bounds,
+                                const float *morph_extents) {
+  const float inf = std::numeric_limits<float>::infinity();
+  std::vector<glm::vec3> min(joint_count, glm::vec3(inf));
+  std::vector<glm::vec3> max(joint_count, glm::vec3(-inf));
+
+  for (size_t v = 0; v < count; v++) {
+    glm::vec3 position = glm::vec3(vertices[v].position);
+    glm::vec3 extent = glm::vec3(morph_extents ? morph_extents[v] : 0.0f);
+    for (int k = 0; k < 4; k++) {
+      uint32_t joint = vertices[v].joints[k];
+      if (vertices[v].weights[k] == 0.0f || joint >= joint_count)
+        continue;
+      min[joint] = glm::min(min[joint], position - extent);
+      max[joint] = glm::max(max[joint], position + extent);
+    }
+  }
+
+  bounds.resize(joint_count);
+  for (size_t j = 0; j < joint_count; j++) {
+    if (min[j].x > max[j].x) {
+      bounds[j] = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+      continue;
+    }
+    bounds[j] = glm::vec4((min[j] + max[j]) * 0.5f,
+                          glm::length(max[j] - min[j]) * 0.5f);
+  }
+}
+
+VertexQuantization tuco::get_skinned_quantization(
+    const glm::vec4 *bounds, const glm::mat4 *joint_matrices,
+    size_t joint_count) {
+  const float inf = std::numeric_limits<float>::infinity();
+  glm::vec3 min = glm::vec3(inf);
+  glm::vec3 max = glm::vec3(-inf);
+
+  for (size_t j = 0; j < joint_count; j++) {
+    if (bounds[j].w < 0.0f)
+      continue;
+
+    const glm::mat4 &matrix = joint_matrices[j];
+    float scale = std::max(glm::length(glm::vec3(matrix[0])),
+                           std::max(glm::length(glm::vec3(matrix[1])),
+                                    glm::length(glm::vec3(matrix[2]))));
+    glm::vec3 center =
+        glm::vec3(matrix * glm::vec4(glm::vec3(bounds[j]), 1.0f));
+    glm::vec3 radius = glm::vec3(bounds[j].w * scale);
+    min = glm::min(min, center - radius);
+    max = glm::max(max, center + radius);
+  }
+
+  VertexQuantization quantization{};
+  if (min.x > max.x)
+    return quantization;
+
+  glm::vec3 extent = max - min;
+  quantization.offset = min;
+  quantization.scale =
+      std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+  return quantization;
+}
+
+void tuco::pack_skin_vertices(const Vertex *vertices, size_t count,
+                              GpuSkinVertex *out) {
+  using Normal = vertex_attribute::Octahedral16<VertexSemantic::Normal>;
+  using TexCoord = vertex_attribute::Half2<VertexSemantic::TexCoord>;
+  static_assert(Normal::size == sizeof(uint32_t) &&
+                    TexCoord::size == sizeof(uint32_t),
+                "GpuSkinVertex stores both in a single word");
+
+  for (size_t v = 0; v < count; v++) {
+    const Vertex &vertex = vertices[v];
+    GpuSkinVertex &skin = out[v];
+
+    memcpy(skin.position, &vertex.position[0], sizeof(skin.position));
+    Normal::pack(vertex, VertexQuantization{},
+                 reinterpret_cast<unsigned char *>(&skin.normal));
+    TexCoord::pack(vertex, VertexQuantization{},
+                   reinterpret_cast<unsigned char *>(&skin.tex_coord));
+    skin.joints[0] =
+        uint32_t(vertex.joints[0]) | uint32_t(vertex.joints[1]) << 16;
+    skin.joints[1] =
+        uint32_t(vertex.joints[2]) | uint32_t(vertex.joints[3]) << 16;
+    skin.weights[0] = pack_unorm16x2(vertex.weights[0], vertex.weights[1]);
+    skin.weights[1] = pack_unorm16x2(vertex.weights[2], vertex.weights[3]);
+  }
+}
+
+void tuco::skin_vertices(const Vertex *vertices, size_t count,
+                         const glm::mat4 *joint_matrices,
+                         const VertexQuantization &quantization,
+                         unsigned char *dst) {
+  Vertex skinned;
+  for (size_t v = 0; v < count; v++) {
+    blend_vertex(vertices[v], joint_matrices, skinned);
+    MeshVertexLayout::pack(&skinned, 1, quantization,
+                           dst + v * MeshVertexLayout::stride);
+  }
+}
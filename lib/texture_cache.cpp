@@ -0,0 +1,108 @@
+#include "texture_cache.hpp"
+
+#include <bedrock/hash.hpp>
+#include <logger/interface.hpp>
+
+#include <filesystem>
+
+using namespace tuco;
+
+uint64_t tuco::get_texture_key(const std::string& path)
+{
+	std::error_code error;
+	std::filesystem::path absolute = std::filesystem::absolute(path, error);
+	std::string normalized = error ? path : absolute.lexically_normal().generic_string();
+	return br::hash_bytes(normalized.data(), normalized.size());
+}
+
+uint64_t tuco::get_texture_key(const unsigned char* pixels, uint32_t width, uint32_t height)
+{
+	const uint32_t extent[2] = { width, height };
+	uint64_t key = br::hash_bytes(pixels, static_cast<size_t>(width) * height * 4) * 0x100000001B3ull;
+	key ^= br::hash_bytes(extent, sizeof(extent));
+	return key == 0 ? 1 : key;
+}
+
+namespace
+{
+
+// the same image uploaded as colour and as data are two textures.
+uint64_t get_cache_key(uint64_t key, br::ImageFormat format)
+{
+	key ^= (static_cast<uint64_t>(format) + 1) * 0x9E3779B97F4A7C15ull;
+	return key == 0 ? 1 : key;
+}
+
+}
+
+br::Image* TextureCache::load_file(const std::string& path, br::ImageFormat format)
+{
+	uint64_t key = get_cache_key(get_texture_key(path), format);
+	br::Image* texture = nullptr;
+	if (find(key, texture))
+	{
+		return texture;
+	}
+
+	auto image = std::make_unique<br::Image>();
+	std::string file_path = path;
+	image->init(path);
+	image->load_image(file_path, format, br::ImageType::Image_2D);
+	return insert(key, std::move(image));
+}
+
+br::Image* TextureCache::load_image(const ImageBuffer& image, br::ImageFormat format)
+{
+	uint64_t key = get_cache_key(image.key, format);
+	br::Image* texture = nullptr;
+	if (find(key, texture))
+	{
+		return texture;
+	}
+
+	auto upload = std::make_unique<br::Image>();
+	upload->init("model texture");
+	if (!image.buffer.empty())
+	{
+		upload->load_pixels(image.buffer.data(), image.width, image.height, format);
+	}
+	return insert(key, std::move(upload));
+}
+
+void TextureCache::destroy()
+{
+	// the images release their vulkan objects when they are destroyed.
+	textures.clear();
+	lookup.clear();
+	stats = TextureCacheStats{};
+}
+
+bool TextureCache::find(uint64_t key, br::Image*& texture)
+{
+	auto search = lookup.find(key);
+	if (search == lookup.end())
+	{
+		stats.misses++;
+		return false;
+	}
+
+	stats.hits++;
+	texture = search->second < 0 ? nullptr : textures[search->second].get();
+	return true;
+}
+
+br::Image* TextureCache::insert(uint64_t key, std::unique_ptr<br::Image> texture)
+{
+	if (!texture->is_loaded())
+	{
+		WARN("texture could not be loaded, materials using it fall back to their factors");
+		lookup[key] = -1;
+		return nullptr;
+	}
+
+	texture->set_image_sampler(VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT);
+	lookup[key] = static_cast<int32_t>(textures.size());
+	textures.push_back(std::move(texture));
+	stats.textures++;
+	return textures.back().get();
+}
@@ -9,9 +9,13 @@ void DescriptorLayout::build(std::shared_ptr<v::Device> device)
 	p_device = device;
 
 	std::vector<VkDescriptorSetLayoutBinding> binding_data;
+	std::vector<VkDescriptorBindingFlagsEXT> binding_flags;
+	bool has_flags = false;
 	for (auto& binding : bindings)
 	{
 		binding_data.push_back(binding.info);
+		binding_flags.push_back(binding.flags);
+		has_flags = has_flags || binding.flags != 0;
 	}
 
 	VkDescriptorSetLayoutCreateInfo info{};
@@ -20,6 +24,24 @@ void DescriptorLayout::build(std::shared_ptr<v::Device> device)
 	info.bindingCount = binding_data.size();
 	info.pBindings = binding_data.data();
 
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flags_info{};
+	if (has_flags)
+	{
+		flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		flags_info.bindingCount = binding_flags.size();
+		flags_info.pBindingFlags = binding_flags.data();
+		info.pNext = &flags_info;
+
+		// sets with bindings written after they are bound come from pools made for them.
+		for (auto flags : binding_flags)
+		{
+			if (flags & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT)
+			{
+				info.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+			}
+		}
+	}
+
 	vkCreateDescriptorSetLayout(device->get(), &info, nullptr, &layout);
 
 	built = true;
@@ -2,8 +2,10 @@
 
 #include "queue.hpp"
 
+#include <algorithm>
 #include <vector>
 #include <set>
+#include <cstring>
 
 using namespace v;
 
@@ -13,6 +15,7 @@ Device::Device(std::shared_ptr<v::PhysicalDevice> phys_device, std::shared_ptr<v
     create_logical_device(phys_device.get(), surface.get(), print_debug);
 }
 Device::~Device() {
+    allocator.destroy();
     device.destroy();
 }
 
@@ -39,6 +42,16 @@ bool Device::check_device_extensions(PhysicalDevice* phys_device, std::vector<co
 
 }
 
+bool Device::supports_extension(PhysicalDevice* phys_device, const char* extension) {
+    auto properties = phys_device->get().enumerateDeviceExtensionProperties();
+    for (const auto& property : properties) {
+        if (strcmp(extension, property.extensionName) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void Device::create_logical_device(PhysicalDevice* physical_device, Surface* surface, bool print_debug) {
 #ifdef NDEBUG 
 const bool enableValidationLayers = false;
@@ -56,7 +69,7 @@ const bool enableValidationLayers = true;
     auto queue_data = std::vector<vk::DeviceQueueCreateInfo>();
 
 	//this way, if the graphics family and the present family are the same, then the set will only keep one value.
-	std::set<uint32_t> queue_indices = {graphics_family, present_family};
+	std::set<uint32_t> queue_indices = {graphics_family, present_family, transfer_family};
 	const float queue_priority = 1.0;
 
 	for (const auto& i : queue_indices) {
@@ -79,13 +92,55 @@ const bool enableValidationLayers = true;
 	    device_extensions.push_back("VK_KHR_shader_non_semantic_info"); //shader print debug extension
     }
 
+    // lets the allocator check its heaps against what the driver budgets for
+    // the process, it estimates without.
+    bool memory_budget = supports_extension(physical_device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (memory_budget) {
+        device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
+    // a single array of every texture and a storage buffer of every material
+    // replace the per material sets when the device can index descriptors.
+    vk::PhysicalDeviceDescriptorIndexingFeaturesEXT indexing_features;
+    if (supports_extension(physical_device, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+        vk::PhysicalDeviceDescriptorIndexingFeaturesEXT supported_indexing;
+        vk::PhysicalDeviceFeatures2 features2;
+        features2.pNext = &supported_indexing;
+        physical_device->get().getFeatures2(&features2);
+
+        descriptor_indexing = supported_indexing.runtimeDescriptorArray &&
+            supported_indexing.descriptorBindingPartiallyBound &&
+            supported_indexing.descriptorBindingSampledImageUpdateAfterBind &&
+            supported_indexing.descriptorBindingUpdateUnusedWhilePending;
+    }
+    if (descriptor_indexing) {
+        indexing_features.runtimeDescriptorArray = VK_TRUE;
+        indexing_features.descriptorBindingPartiallyBound = VK_TRUE;
+        indexing_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        indexing_features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        device_extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+        vk::PhysicalDeviceDescriptorIndexingPropertiesEXT indexing_properties;
+        vk::PhysicalDeviceProperties2 properties2;
+        properties2.pNext = &indexing_properties;
+        physical_device->get().getProperties2(&properties2);
+        max_bindless_textures = std::min(
+                indexing_properties.maxDescriptorSetUpdateAfterBindSampledImages,
+                indexing_properties.maxPerStageDescriptorUpdateAfterBindSampledImages);
+    }
+
     //check if device extension needed is supported
 	if (!check_device_extensions(physical_device, device_extensions, device_extensions.size())) {
 		printf("[ERROR] - create_logical_device: could not find support for neccessary device extensions");
 		throw std::runtime_error("");
 	}
 
+    // only turn on what is used and supported, the renderer falls back when a
+    // feature is missing.
+    vk::PhysicalDeviceFeatures supported_features = physical_device->get().getFeatures();
     vk::PhysicalDeviceFeatures device_features;
+    device_features.multiDrawIndirect = supported_features.multiDrawIndirect;
+    multi_draw_indirect = supported_features.multiDrawIndirect == VK_TRUE;
     auto device_info = vk::DeviceCreateInfo(
             {}, 
             queue_count, 
@@ -96,10 +151,18 @@ const bool enableValidationLayers = true;
             device_extensions.data(),
             &device_features
         );
+    if (descriptor_indexing) {
+        device_info.pNext = &indexing_features;
+    }
 
     device = physical_device->get().createDevice(device_info);
 
     graphics_queue = device.getQueue(graphics_family, 0);
     present_queue = device.getQueue(present_family, 0);
     transfer_queue = device.getQueue(transfer_family, 0);
+    if (has_dedicated_transfer()) {
+        INFO("uploads go through queue family {}, apart from graphics ({})", transfer_family, graphics_family);
+    }
+
+    allocator.init(physical_device->get(), device, memory_budget);
 }
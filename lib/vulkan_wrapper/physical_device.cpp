@@ -65,6 +65,7 @@ void PhysicalDevice::set_device_limits() {
 	vkGetPhysicalDeviceProperties(physical_device, &device_properties);
 
 	Limits::get().uniformBufferOffsetAlignment = device_properties.limits.minUniformBufferOffsetAlignment;
+	Limits::get().storageBufferOffsetAlignment = device_properties.limits.minStorageBufferOffsetAlignment;
 }
 
 uint32_t PhysicalDevice::score_physical_device(vk::PhysicalDevice physical_device) {
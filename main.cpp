@@ -92,6 +92,14 @@ int main() {
 
     tuco::SceneData* scene = antuco.create_scene();
 
+    // the scene's meshes are optimized, get levels of detail and are split
+    // into meshlets for cluster culling.
+    tuco::ModelImportOptions import_options;
+    import_options.optimize = true;
+    import_options.lod_count = MAX_LOD_COUNT - 1;
+    import_options.build_meshlets = true;
+    antuco.get_asset_manager().set_import_options(import_options);
+
     auto t1 = TIME_IT;
 
 #if defined(__APPLE__)
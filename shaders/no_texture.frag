@@ -156,16 +156,22 @@ void main(){
     vec3 materialBaseReflectivity = vec3(mat.pbrParameters.x); // visually good enough for dieletric materials.
 
     // Weird artifacts on the roughness texture...
-    float roughness = mat.hasTexture.z == 1.f ? texture(roughnessMetallicTexture, texCoord).y : mat.pbrParameters.y;
-    //float metallic = mat.hasTexture.z == 1.f ? texture(roughnessMetallicTexture, texCoord).z : mat.pbrParameters.z;
-    vec3 albedo = mat.hasTexture.x == 1.f ? texture(diffuseTexture, texCoord).xyz : mat.albedo; // surface color
+    // textures scale the material's factors, as gltf's metallic-roughness model defines them.
+    float roughness = mat.pbrParameters.y;
+    if (mat.hasTexture.z == 1.f) {
+        roughness *= texture(roughnessMetallicTexture, texCoord).y;
+    }
+    vec3 albedo = mat.albedo; // surface color
+    if (mat.hasTexture.x == 1.f) {
+        albedo *= texture(diffuseTexture, texCoord).xyz;
+    }
 
     float metallic = mat.pbrParameters.z;
     if (mat.hasTexture.y == 1.0) {
-        metallic = texture(metallicTexture, texCoord).x;
+        metallic *= texture(metallicTexture, texCoord).x;
     }
     else if (mat.hasTexture.z == 1.0) {
-        metallic = texture(roughnessMetallicTexture, texCoord).z;    
+        metallic *= texture(roughnessMetallicTexture, texCoord).z;
     }
 
     materialBaseReflectivity = mix(materialBaseReflectivity, albedo, metallic);
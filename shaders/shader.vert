@@ -1,16 +1,21 @@
 #version 450
 
-struct UniformBufferTemplate {
+// TransformObject (data_structures.hpp), one per node.
+struct Transform {
     mat4 modelToWorld;
-    mat4 worldToEye;
-    mat4 projection;
+    mat4 normalMatrix; // computed on the cpu, without the position dequantization
+};
+
+layout(std430, set=0, binding = 0) readonly buffer TransformTable {
+    Transform transforms[];
 };
 
-layout(set=0, binding = 0) uniform UniformBufferObject  {
+// the scene's ubo, shared with the skybox (modelToWorld is the skybox's).
+layout(set=2, binding = 3) uniform SceneBufferObject {
     mat4 modelToWorld;
     mat4 worldToCamera;
     mat4 projection;
-} ubo;
+} scene;
 
 //layout(set=0, binding = 1) uniform LightBufferObject {
 //	mat4 model_to_world;
@@ -24,12 +29,23 @@ layout(push_constant) uniform PushFragConstant {
   vec3 lightPosition;
   vec3 light_count;
   vec3 camera;
+  layout(offset = 80) uint transform; // slot of the node drawn
 } pfc;
 
+// inputs follow MeshVertexLayout (vertex_layout.hpp): positions are quantized to [0, 1]
+// (the dequantization is part of modelToWorld) and normals are octahedral encoded.
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
+layout(location = 1) in vec2 inNormal;
 layout(location = 2) in vec2 inTexCoord;
 
+vec3 decode_octahedral(vec2 e) {
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 //TODO: actually bring these in, probably through a push constant if we can
 
 
@@ -58,12 +74,13 @@ void main() {
     );
 
 
-    gl_Position = ubo.projection * ubo.worldToCamera * ubo.modelToWorld * vec4(inPosition, 1.0); //opengl automatically divids the components of the vector by 'w'
+    Transform transform = transforms[pfc.transform];
+
+    vPos = transform.modelToWorld * vec4(inPosition, 1.0);
+    gl_Position = scene.projection * scene.worldToCamera * vPos; //opengl automatically divids the components of the vector by 'w'
 
-    // TODO: likely faster to computer inverse CPU side.
-    surfaceNormal = normalize(vec3(transpose(inverse(ubo.modelToWorld)) * vec4(inNormal, 0.0)));
+    surfaceNormal = normalize(mat3(transform.normalMatrix) * decode_octahedral(inNormal));
 
-    vPos = ubo.modelToWorld * vec4(inPosition, 1.0);
     //light_perspective = (/*biasMat */ lbo.projection * lbo.world_to_light * lbo.model_to_world) * vec4(inPosition, 1.0);
     texCoord = inTexCoord;
     //light_perspective.xyz = light_perspective.xyz / light_perspective.w;
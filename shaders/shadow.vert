@@ -10,7 +10,8 @@ layout(binding = 1) uniform UniformBufferObject  {
 } ubo;
 
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
+// follows MeshVertexLayout (vertex_layout.hpp), see shader.vert
+layout(location = 1) in vec2 inNormal;
 layout(location = 2) in vec2 inTexCoord;
 
 layout(push_constant) uniform LightData {
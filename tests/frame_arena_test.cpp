@@ -0,0 +1,137 @@
+/* ------------------------ frame_arena_test.cpp ------------------------
+ * FrameArena on its own (frame_arena.hpp): synthetic FrameVector work
+ * shaped like the render loop's scratch lists, checking that once every
+ * frame slot has been warmed up a steady frame never reaches the heap.
+ * operator new is replaced to count what does. the render loop itself
+ * needs a device and isn't run here.
+ * -------------------------------------------------------------------
+ */
+#include "frame_arena.hpp"
+#include "test.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<uint64_t> heap_allocations{0};
+
+} // namespace
+
+void *operator new(size_t size) {
+  heap_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *memory = std::malloc(size > 0 ? size : 1))
+    return memory;
+  throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete[](void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, size_t) noexcept { std::free(memory); }
+
+namespace {
+
+const uint32_t SLOT_COUNT = 3; // MAX_FRAMES_IN_FLIGHT + 1, as GraphicsImpl
+const size_t BLOCK_SIZE = 16 << 10;
+
+struct Cluster {
+  float center[4];
+  uint32_t first_index;
+  uint32_t index_count;
+  uint32_t job;
+};
+
+// one frame of scratch work sized by objects: a reserved list of objects to
+// pose, a cluster upload built with the sized constructor, and a list that
+// grows without a reserve and is sorted afterwards.
+uint64_t run_frame(mem::FrameArena &arena, size_t objects) {
+  arena.begin_frame();
+
+  mem::FrameVector<const void *> posed(arena);
+  posed.reserve(objects);
+  for (size_t i = 0; i < objects; i++)
+    posed.push_back(&posed);
+
+  Cluster released{};
+  released.job = UINT32_MAX;
+  mem::FrameVector<Cluster> clusters(objects * 4, released, arena);
+
+  mem::FrameVector<uint32_t> moved(arena);
+  for (size_t i = 0; i < objects; i++) {
+    if (i % 3 != 0)
+      moved.push_back(static_cast<uint32_t>((i * 2654435761u) % 1000));
+  }
+  std::sort(moved.begin(), moved.end());
+
+  uint64_t sum = posed.size() + clusters.size();
+  for (uint32_t value : moved)
+    sum += value;
+  return sum;
+}
+
+void test_steady_frames() {
+  // a scene whose object count changes from frame to frame, the largest
+  // frames don't fit the first block of a slot.
+  const size_t sizes[] = {10, 200, 1500, 40, 900};
+  const size_t size_count = sizeof(sizes) / sizeof(sizes[0]);
+
+  mem::FrameArena arena;
+  arena.init(BLOCK_SIZE, SLOT_COUNT);
+
+  // every slot sees every size once. the blocks it takes are counted, which
+  // also shows the replaced operator new is the one in use.
+  uint64_t warm_up = heap_allocations.load();
+  uint64_t checksum = 0;
+  for (size_t frame = 0; frame < SLOT_COUNT * size_count; frame++)
+    checksum += run_frame(arena, sizes[frame % size_count]);
+  CHECK(arena.take_grows() > 0);
+  CHECK(heap_allocations.load() > warm_up);
+
+  uint64_t before = heap_allocations.load();
+  for (size_t frame = 0; frame < 600; frame++)
+    checksum += run_frame(arena, sizes[frame % size_count]);
+  uint64_t allocations = heap_allocations.load() - before;
+
+  CHECK(allocations == 0);
+  CHECK(arena.take_grows() == 0);
+  CHECK(checksum > 0);
+  if (allocations != 0)
+    std::fprintf(stderr, "%llu heap allocations in steady frames\n",
+                 static_cast<unsigned long long>(allocations));
+
+  arena.destroy();
+}
+
+// a frame larger than anything before takes another block, the next frame
+// of the slot reuses it.
+void test_growth() {
+  mem::FrameArena arena;
+  arena.init(BLOCK_SIZE, 1);
+
+  run_frame(arena, 10);
+  CHECK(arena.take_grows() == 0);
+  run_frame(arena, 4000);
+  CHECK(arena.take_grows() > 0);
+
+  uint64_t before = heap_allocations.load();
+  run_frame(arena, 4000);
+  CHECK(heap_allocations.load() == before);
+  CHECK(arena.take_grows() == 0);
+  CHECK(arena.get_stats().peak_bytes >= arena.get_stats().frame_bytes);
+
+  arena.destroy();
+}
+
+} // namespace
+
+int main() {
+  test_steady_frames();
+  test_growth();
+  return test::result();
+}
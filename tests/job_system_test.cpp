@@ -0,0 +1,95 @@
+/* ------------------------ job_system_test.cpp ------------------------
+ * parallel_for on the shared job system: every index runs exactly once,
+ * also when it is called from inside jobs that keep every worker busy,
+ * and an exception thrown by a call reaches the caller.
+ * -------------------------------------------------------------------
+ */
+#include "test.hpp"
+
+#include <bedrock/job_system.hpp>
+#include <bedrock/parallel_for.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+void test_every_index_once() {
+  std::vector<uint32_t> hits(100000, 0);
+  for (int run = 0; run < 50; run++)
+    br::parallel_for(hits.size(), [&](size_t i) { hits[i]++; });
+
+  bool once_per_run = true;
+  for (uint32_t count : hits)
+    once_per_run = once_per_run && count == 50;
+  CHECK(once_per_run);
+
+  // nothing to split, the calling thread does it.
+  size_t calls = 0;
+  br::parallel_for(0, [&](size_t) { calls++; });
+  br::parallel_for(1, [&](size_t) { calls++; });
+  CHECK(calls == 1);
+}
+
+// more jobs than workers, each splitting a loop of its own. a caller must not
+// wait on helpers that are queued behind it.
+void test_nested() {
+  br::JobSystem &jobs = br::JobSystem::get_shared();
+  const int job_count = static_cast<int>(jobs.get_thread_count()) * 4 + 4;
+
+  std::atomic<uint64_t> total{0};
+  for (int j = 0; j < job_count; j++) {
+    jobs.submit([&total]() {
+      br::parallel_for(1000, [&total](size_t i) { total += i; });
+    });
+  }
+  jobs.wait_idle();
+
+  CHECK(total.load() == static_cast<uint64_t>(job_count) * 999 * 1000 / 2);
+}
+
+// the caller rethrows only after every helper left the range, the locals the
+// loop uses are still alive for them. the pool keeps working afterwards.
+void test_exceptions() {
+  for (int run = 0; run < 50; run++) {
+    // one call throws, on whichever thread claims it.
+    std::atomic<uint32_t> calls{0};
+    bool caught = false;
+    try {
+      br::parallel_for(10000, [&](size_t i) {
+        calls++;
+        if (i == 5000)
+          throw std::runtime_error("5000");
+      });
+    } catch (const std::runtime_error &error) {
+      caught = std::string(error.what()) == "5000";
+    }
+    CHECK(caught);
+    CHECK(calls.load() <= 10000);
+
+    // every call throws, on the caller and on the helpers.
+    caught = false;
+    try {
+      br::parallel_for(1000, [&](size_t) { throw std::logic_error("all"); });
+    } catch (const std::logic_error &) {
+      caught = true;
+    }
+    CHECK(caught);
+  }
+
+  std::atomic<uint64_t> total{0};
+  br::parallel_for(1000, [&total](size_t i) { total += i; });
+  CHECK(total.load() == 999 * 1000 / 2);
+}
+
+} // namespace
+
+int main() {
+  test_every_index_once();
+  test_nested();
+  test_exceptions();
+  return test::result();
+}
@@ -0,0 +1,100 @@
+/* ------------------------ mesh_cache_test.cpp ------------------------
+ * the source hash of a .gltf/.glb (hash_gltf) has to change when any
+ * buffer or image it references changes, not only the json itself.
+ * -------------------------------------------------------------------
+ */
+#include "mesh_cache.hpp"
+#include "test.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace tuco;
+
+namespace {
+
+void write_file(const std::filesystem::path &path, const std::string &data) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+// a .glb holding only json, laid out as the spec has it (the chunk padded to
+// 4 bytes with spaces).
+std::string make_glb(std::string json) {
+  while (json.size() % 4 != 0)
+    json += ' ';
+  uint32_t header[5] = {0x46546C67, 2,
+                        static_cast<uint32_t>(20 + json.size()),
+                        static_cast<uint32_t>(json.size()), 0x4E4F534A};
+  std::string glb(reinterpret_cast<const char *>(header), sizeof(header));
+  return glb + json;
+}
+
+const char GLTF[] =
+    "{\"buffers\": [{\"byteLength\": 4, \"uri\" : \"mesh%20data.bin\"},\n"
+    "  {\"byteLength\": 4, \"uri\": \"data:application/octet-stream;"
+    "base64,AAAAAA==\"}],\n"
+    " \"images\": [{\"uri\": \"textures\\/albedo.png\"}],\n"
+    " \"asset\": {\"generator\": \"uri\", \"version\": \"2.0\"}}";
+
+void test_referenced_files(const std::filesystem::path &directory) {
+  std::filesystem::create_directories(directory / "textures");
+  write_file(directory / "mesh data.bin", "abcd");
+  write_file(directory / "textures" / "albedo.png", "png0");
+  write_file(directory / "model.gltf", GLTF);
+  const std::string gltf = (directory / "model.gltf").string();
+
+  uint64_t original = hash_gltf(gltf);
+  CHECK(original != 0);
+  CHECK(original != hash_file(gltf));
+  CHECK(hash_gltf(gltf) == original);
+
+  write_file(directory / "mesh data.bin", "abce");
+  uint64_t buffer_edited = hash_gltf(gltf);
+  CHECK(buffer_edited != original);
+
+  write_file(directory / "textures" / "albedo.png", "png1");
+  CHECK(hash_gltf(gltf) != buffer_edited);
+
+  write_file(directory / "mesh data.bin", "abcd");
+  write_file(directory / "textures" / "albedo.png", "png0");
+  CHECK(hash_gltf(gltf) == original);
+
+  // a missing buffer can't be hashed, the model isn't cached or shared.
+  std::filesystem::remove(directory / "mesh data.bin");
+  CHECK(hash_gltf(gltf) == 0);
+  write_file(directory / "mesh data.bin", "abcd");
+}
+
+void test_glb(const std::filesystem::path &directory) {
+  write_file(directory / "model.glb", make_glb(GLTF));
+  const std::string glb = (directory / "model.glb").string();
+
+  uint64_t original = hash_gltf(glb);
+  CHECK(original != 0);
+  write_file(directory / "textures" / "albedo.png", "png2");
+  CHECK(hash_gltf(glb) != original);
+
+  // no external files, the hash is the file's.
+  write_file(directory / "embedded.glb", make_glb("{\"asset\": {}}"));
+  const std::string embedded = (directory / "embedded.glb").string();
+  CHECK(hash_gltf(embedded) == hash_file(embedded));
+}
+
+} // namespace
+
+int main() {
+  std::filesystem::path directory =
+      std::filesystem::temp_directory_path() / "antuco_mesh_cache_test";
+  std::filesystem::remove_all(directory);
+
+  test_referenced_files(directory);
+  test_glb(directory);
+
+  std::filesystem::remove_all(directory);
+  return test::result();
+}
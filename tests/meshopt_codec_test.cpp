@@ -0,0 +1,396 @@
+/* ---------------------- meshopt_codec_test.cpp ----------------------
+ * checks the EXT_meshopt_compression decoders (meshopt_codec.hpp)
+ * against streams laid out the way meshoptimizer's encoder writes
+ * them, then round trips a small corpus of generated meshes through
+ * the encoders below and reports size and decode throughput.
+ * -------------------------------------------------------------------
+ */
+#include "meshopt_codec.hpp"
+#include "test.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace tuco;
+
+namespace {
+
+const size_t GROUP_SIZE = 16;
+const size_t TAIL_SIZE = 32;
+
+unsigned char zigzag8(unsigned char v) {
+  return static_cast<unsigned char>((static_cast<signed char>(v) >> 7) ^
+                                    (v << 1));
+}
+
+// bytes a group of 16 values takes at 1 << bitslog2 bits per value, values
+// that don't fit are escaped after the packed bits.
+size_t get_group_size(const unsigned char *values, int bitslog2) {
+  if (bitslog2 == 0) {
+    bool zero = std::all_of(values, values + GROUP_SIZE,
+                            [](unsigned char v) { return v == 0; });
+    return zero ? 0 : SIZE_MAX;
+  }
+  if (bitslog2 == 3)
+    return GROUP_SIZE;
+
+  unsigned bits = 1u << bitslog2;
+  unsigned sentinel = (1u << bits) - 1;
+  size_t escapes = std::count_if(values, values + GROUP_SIZE,
+                                 [&](unsigned char v) { return v >= sentinel; });
+  return bits * GROUP_SIZE / 8 + escapes;
+}
+
+void encode_group(std::vector<unsigned char> &out,
+                  const unsigned char *values, int bitslog2) {
+  if (bitslog2 == 0)
+    return;
+  if (bitslog2 == 3) {
+    out.insert(out.end(), values, values + GROUP_SIZE);
+    return;
+  }
+
+  unsigned bits = 1u << bitslog2;
+  unsigned sentinel = (1u << bits) - 1;
+  size_t start = out.size();
+  out.resize(start + bits * GROUP_SIZE / 8, 0);
+  for (size_t i = 0; i < GROUP_SIZE; i++) {
+    unsigned value = std::min<unsigned>(values[i], sentinel);
+    out[start + i * bits / 8] |=
+        static_cast<unsigned char>(value << (8 - bits - (i * bits) % 8));
+  }
+  for (size_t i = 0; i < GROUP_SIZE; i++) {
+    if (values[i] >= sentinel)
+      out.push_back(values[i]);
+  }
+}
+
+// meshoptimizer's vertex codec (version 0): every byte of a block of
+// vertices is delta coded against the vertex before it, zigzagged and packed
+// in groups of 16 at the smallest of 0, 2, 4 or 8 bits. the first vertex ends
+// the stream.
+std::vector<unsigned char> encode_vertex_buffer(const unsigned char *vertices,
+                                                size_t count, size_t stride) {
+  std::vector<unsigned char> out = {0xa0};
+  size_t block_size = std::min<size_t>((8192 / stride) & ~(GROUP_SIZE - 1),
+                                       256);
+  std::vector<unsigned char> last(vertices, vertices + stride);
+
+  for (size_t offset = 0; offset < count; offset += block_size) {
+    size_t block_count = std::min(block_size, count - offset);
+    size_t aligned = (block_count + GROUP_SIZE - 1) & ~(GROUP_SIZE - 1);
+
+    for (size_t k = 0; k < stride; k++) {
+      std::vector<unsigned char> deltas(aligned, 0);
+      unsigned char previous = last[k];
+      for (size_t i = 0; i < block_count; i++) {
+        unsigned char value = vertices[(offset + i) * stride + k];
+        deltas[i] = zigzag8(static_cast<unsigned char>(value - previous));
+        previous = value;
+      }
+      last[k] = previous;
+
+      size_t group_count = aligned / GROUP_SIZE;
+      size_t header = out.size();
+      out.resize(header + (group_count + 3) / 4, 0);
+      for (size_t group = 0; group < group_count; group++) {
+        const unsigned char *values = deltas.data() + group * GROUP_SIZE;
+        int best = 3;
+        for (int bitslog2 = 2; bitslog2 >= 0; bitslog2--) {
+          if (get_group_size(values, bitslog2) <= get_group_size(values, best))
+            best = bitslog2;
+        }
+        out[header + group / 4] |=
+            static_cast<unsigned char>(best << ((group % 4) * 2));
+        encode_group(out, values, best);
+      }
+    }
+  }
+
+  size_t tail = std::max(stride, TAIL_SIZE);
+  out.insert(out.end(), tail - stride, 0);
+  out.insert(out.end(), vertices, vertices + stride);
+  return out;
+}
+
+void encode_vbyte(std::vector<unsigned char> &out, unsigned int v) {
+  do {
+    unsigned char group = v & 127;
+    v >>= 7;
+    out.push_back(v ? group | 128 : group);
+  } while (v);
+}
+
+// meshoptimizer's index sequence codec (version 1): zigzagged deltas against
+// one of two baselines, the low bit says which.
+std::vector<unsigned char> encode_index_sequence(const uint32_t *indices,
+                                                 size_t count) {
+  std::vector<unsigned char> out = {0xd1};
+  unsigned int last[2] = {};
+  for (size_t i = 0; i < count; i++) {
+    unsigned int index = indices[i];
+    int d0 = static_cast<int>(index - last[0]);
+    int d1 = static_cast<int>(index - last[1]);
+    unsigned int current = std::abs(d1) < std::abs(d0) ? 1 : 0;
+
+    unsigned int d = index - last[current];
+    unsigned int v = (d << 1) ^ static_cast<unsigned int>(static_cast<int>(d) >> 31);
+    encode_vbyte(out, (v << 1) | current);
+    last[current] = index;
+  }
+  out.insert(out.end(), 4, 0);
+  return out;
+}
+
+void test_reference_vertices() {
+  // 4 vertices of u16 position, 2 u8 normal bytes and u16 uv, encoded by
+  // hand the way meshoptimizer's encoder picks groups and escapes.
+  struct PackedVertex {
+    uint16_t px, py, pz;
+    uint8_t nu, nv;
+    uint16_t tx, ty;
+  };
+  static_assert(sizeof(PackedVertex) == 12, "no padding expected");
+  const PackedVertex expected[4] = {
+      {0, 0, 0, 0, 0, 0, 0},
+      {300, 0, 0, 0, 0, 500, 0},
+      {0, 300, 0, 0, 0, 0, 500},
+      {300, 300, 0, 0, 0, 500, 500},
+  };
+  const unsigned char stream[] = {
+      0xa0,
+      // px: 2 bit group, escapes for +44, -44, +44.
+      0x01, 0x3f, 0x00, 0x00, 0x00, 0x58, 0x57, 0x58,
+      0x01, 0x26, 0x00, 0x00, 0x00,
+      // py
+      0x01, 0x0c, 0x00, 0x00, 0x00, 0x58,
+      0x01, 0x08, 0x00, 0x00, 0x00,
+      // pz, nu and nv are all zero.
+      0x00, 0x00, 0x00, 0x00,
+      // tx: 500 = 0x1f4, deltas of 0xf4 are -12.
+      0x01, 0x3f, 0x00, 0x00, 0x00, 0x17, 0x18, 0x17,
+      0x01, 0x26, 0x00, 0x00, 0x00,
+      // ty
+      0x01, 0x0c, 0x00, 0x00, 0x00, 0x17,
+      0x01, 0x08, 0x00, 0x00, 0x00,
+      // tail, the first vertex padded to 32 bytes.
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  };
+
+  PackedVertex decoded[4];
+  CHECK(decode_vertex_buffer(reinterpret_cast<unsigned char *>(decoded), 4,
+                             sizeof(PackedVertex), stream, sizeof(stream)));
+  CHECK(memcmp(decoded, expected, sizeof(expected)) == 0);
+
+  // the stream is checked to end exactly with the tail.
+  CHECK(!decode_vertex_buffer(reinterpret_cast<unsigned char *>(decoded), 4,
+                              sizeof(PackedVertex), stream,
+                              sizeof(stream) - 1));
+  unsigned char bad_header[sizeof(stream)];
+  memcpy(bad_header, stream, sizeof(stream));
+  bad_header[0] = 0xa1;
+  CHECK(!decode_vertex_buffer(reinterpret_cast<unsigned char *>(decoded), 4,
+                              sizeof(PackedVertex), bad_header,
+                              sizeof(bad_header)));
+}
+
+void test_vertex_tail() {
+  // one vertex, delta coded against itself. the encoder writes it at the very
+  // end of the tail, after the zero padding.
+  unsigned char stream[1 + 4 + TAIL_SIZE] = {0xa0};
+  const unsigned char vertex[4] = {1, 2, 3, 4};
+  memcpy(stream + sizeof(stream) - 4, vertex, 4);
+
+  unsigned char decoded[4] = {};
+  CHECK(decode_vertex_buffer(decoded, 1, 4, stream, sizeof(stream)));
+  CHECK(memcmp(decoded, vertex, 4) == 0);
+}
+
+void test_reference_indices() {
+  // meshoptimizer's index codec test data (version 0).
+  const uint32_t expected[] = {0, 1, 2, 2, 1, 3, 4, 6, 5, 7, 8, 9};
+  const unsigned char stream[] = {
+      0xe0, 0xf0, 0x10, 0xfe, 0xff, 0xf0, 0x0c, 0xff, 0x02,
+      0x02, 0x02, 0x00, 0x76, 0x87, 0x56, 0x67, 0x78, 0xa9,
+      0x86, 0x65, 0x89, 0x68, 0x98, 0x01, 0x69, 0x00, 0x00,
+  };
+
+  uint32_t decoded[12];
+  CHECK(decode_index_buffer(reinterpret_cast<unsigned char *>(decoded), 12, 4,
+                            stream, sizeof(stream)));
+  CHECK(memcmp(decoded, expected, sizeof(expected)) == 0);
+
+  uint16_t narrow[12];
+  CHECK(decode_index_buffer(reinterpret_cast<unsigned char *>(narrow), 12, 2,
+                            stream, sizeof(stream)));
+  CHECK(std::equal(narrow, narrow + 12, expected));
+
+  CHECK(!decode_index_buffer(reinterpret_cast<unsigned char *>(decoded), 12, 4,
+                             stream, sizeof(stream) - 4));
+}
+
+void test_exponential_filter() {
+  // mantissa 3, exponent -1.
+  uint32_t value = 0xff000003u;
+  unsigned char data[4];
+  memcpy(data, &value, sizeof(value));
+  CHECK(apply_meshopt_filter(MeshoptFilter::Exponential, data, 1, 4));
+
+  float decoded;
+  memcpy(&decoded, data, sizeof(decoded));
+  CHECK(decoded == 1.5f);
+}
+
+struct CorpusMesh {
+  std::string name;
+  size_t stride;
+  std::vector<unsigned char> vertices;
+  std::vector<uint32_t> indices;
+};
+
+void put_u16(unsigned char *out, float value) {
+  uint16_t quantized = static_cast<uint16_t>(
+      std::lround(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f));
+  memcpy(out, &quantized, sizeof(quantized));
+}
+
+// a side x side grid of u16x4 positions, i8x4 normals and u16x2 uvs, the
+// layout quantized glTF assets are usually compressed in.
+CorpusMesh make_grid(size_t side) {
+  CorpusMesh mesh{"grid", 16, {}, {}};
+  mesh.vertices.resize(side * side * mesh.stride, 0);
+  for (size_t y = 0; y < side; y++) {
+    for (size_t x = 0; x < side; x++) {
+      unsigned char *out = mesh.vertices.data() + (y * side + x) * mesh.stride;
+      float u = static_cast<float>(x) / (side - 1);
+      float v = static_cast<float>(y) / (side - 1);
+      put_u16(out + 0, u);
+      put_u16(out + 2, 0.5f + 0.1f * std::sin(u * 12.0f) * std::cos(v * 9.0f));
+      put_u16(out + 4, v);
+      out[8] = 0;
+      out[9] = 127;
+      out[10] = 0;
+      put_u16(out + 12, u);
+      put_u16(out + 14, v);
+    }
+  }
+  for (size_t y = 0; y + 1 < side; y++) {
+    for (size_t x = 0; x + 1 < side; x++) {
+      uint32_t i = static_cast<uint32_t>(y * side + x);
+      uint32_t row = static_cast<uint32_t>(side);
+      mesh.indices.insert(mesh.indices.end(),
+                          {i, i + row, i + 1, i + 1, i + row, i + row + 1});
+    }
+  }
+  return mesh;
+}
+
+// the same layout on a sphere, normals vary from vertex to vertex.
+CorpusMesh make_sphere(size_t rings, size_t segments) {
+  CorpusMesh mesh{"sphere", 16, {}, {}};
+  mesh.vertices.resize(rings * segments * mesh.stride, 0);
+  for (size_t r = 0; r < rings; r++) {
+    for (size_t s = 0; s < segments; s++) {
+      unsigned char *out =
+          mesh.vertices.data() + (r * segments + s) * mesh.stride;
+      float theta = 3.14159265f * r / (rings - 1);
+      float phi = 6.2831853f * s / segments;
+      float nx = std::sin(theta) * std::cos(phi);
+      float ny = std::cos(theta);
+      float nz = std::sin(theta) * std::sin(phi);
+      put_u16(out + 0, nx * 0.5f + 0.5f);
+      put_u16(out + 2, ny * 0.5f + 0.5f);
+      put_u16(out + 4, nz * 0.5f + 0.5f);
+      out[8] = static_cast<unsigned char>(static_cast<int8_t>(std::lround(nx * 127.0f)));
+      out[9] = static_cast<unsigned char>(static_cast<int8_t>(std::lround(ny * 127.0f)));
+      out[10] = static_cast<unsigned char>(static_cast<int8_t>(std::lround(nz * 127.0f)));
+      put_u16(out + 12, static_cast<float>(s) / segments);
+      put_u16(out + 14, static_cast<float>(r) / (rings - 1));
+    }
+  }
+  for (size_t r = 0; r + 1 < rings; r++) {
+    for (size_t s = 0; s < segments; s++) {
+      uint32_t a = static_cast<uint32_t>(r * segments + s);
+      uint32_t b = static_cast<uint32_t>(r * segments + (s + 1) % segments);
+      uint32_t c = a + static_cast<uint32_t>(segments);
+      uint32_t d = b + static_cast<uint32_t>(segments);
+      mesh.indices.insert(mesh.indices.end(), {a, c, b, b, c, d});
+    }
+  }
+  return mesh;
+}
+
+// incompressible bytes, the codec's worst case.
+CorpusMesh make_noise(size_t count) {
+  CorpusMesh mesh{"noise", 16, {}, {}};
+  std::mt19937 random(7);
+  mesh.vertices.resize(count * mesh.stride);
+  for (unsigned char &byte : mesh.vertices)
+    byte = static_cast<unsigned char>(random());
+  for (size_t i = 0; i < count; i++)
+    mesh.indices.push_back(static_cast<uint32_t>(random() % count));
+  return mesh;
+}
+
+void test_corpus() {
+  std::vector<CorpusMesh> corpus = {make_grid(256), make_sphere(128, 256),
+                                    make_noise(1 << 16)};
+
+  for (const CorpusMesh &mesh : corpus) {
+    size_t count = mesh.vertices.size() / mesh.stride;
+    std::vector<unsigned char> encoded =
+        encode_vertex_buffer(mesh.vertices.data(), count, mesh.stride);
+    std::vector<unsigned char> decoded(mesh.vertices.size());
+    CHECK(decode_vertex_buffer(decoded.data(), count, mesh.stride,
+                               encoded.data(), encoded.size()));
+    CHECK(decoded == mesh.vertices);
+
+    std::vector<unsigned char> encoded_indices =
+        encode_index_sequence(mesh.indices.data(), mesh.indices.size());
+    std::vector<uint32_t> decoded_indices(mesh.indices.size());
+    CHECK(decode_index_sequence(
+        reinterpret_cast<unsigned char *>(decoded_indices.data()),
+        decoded_indices.size(), 4, encoded_indices.data(),
+        encoded_indices.size()));
+    CHECK(decoded_indices == mesh.indices);
+
+    // decode for a while, the numbers are only reported.
+    size_t runs = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed{};
+    do {
+      decode_vertex_buffer(decoded.data(), count, mesh.stride, encoded.data(),
+                           encoded.size());
+      runs++;
+      elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed.count() < 0.2);
+
+    std::printf("%-6s %7zu vertices: %8zu -> %8zu bytes (%5.1f%%), indices "
+                "%8zu -> %8zu bytes, vertex decode %7.1f mb/s\n",
+                mesh.name.c_str(), count, mesh.vertices.size(), encoded.size(),
+                100.0 * encoded.size() / mesh.vertices.size(),
+                mesh.indices.size() * sizeof(uint32_t), encoded_indices.size(),
+                runs * mesh.vertices.size() / 1e6 / elapsed.count());
+  }
+}
+
+} // namespace
+
+int main() {
+  test_reference_vertices();
+  test_vertex_tail();
+  test_reference_indices();
+  test_exponential_filter();
+  test_corpus();
+  return test::result();
+}
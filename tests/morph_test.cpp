@@ -0,0 +1,188 @@
+/* --------------------------- morph_test.cpp ---------------------------
+ * compares the sparse morph evaluation (morph.hpp) with a dense blend of
+ * every target over every vertex, and checks that joint bounds grown by
+ * the morph extents still hold the morphed vertices.
+ * -------------------------------------------------------------------
+ */
+#include "morph.hpp"
+#include "skinning.hpp"
+#include "test.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace tuco;
+
+namespace {
+
+const size_t VERTEX_COUNT = 5000;
+const size_t TARGET_COUNT = 6;
+const size_t JOINT_COUNT = 4;
+
+// a single range of TARGET_COUNT targets, each moving about every 7th vertex
+// of base. dense_positions/dense_normals get the same deltas per target and
+// vertex, zero where the target doesn't move it.
+struct Blend {
+  std::vector<Vertex> base;
+  MorphData morphs;
+  std::vector<std::vector<glm::vec4>> dense_positions;
+  std::vector<std::vector<glm::vec4>> dense_normals;
+};
+
+Blend make_blend(std::mt19937 &random) {
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  auto random_vec4 = [&](float w) {
+    return glm::vec4(unit(random), unit(random), unit(random), w);
+  };
+
+  Blend blend;
+  blend.base.resize(VERTEX_COUNT);
+  for (Vertex &vertex : blend.base) {
+    vertex.position = random_vec4(1.0f);
+    vertex.normal = random_vec4(0.0f);
+    vertex.tex_coord = glm::vec2(0.0f);
+    // two influences out of JOINT_COUNT.
+    uint16_t joint = static_cast<uint16_t>(random() % JOINT_COUNT);
+    vertex.joints = glm::u16vec4(joint, (joint + 1) % JOINT_COUNT, 0, 0);
+    vertex.weights = glm::vec4(0.75f, 0.25f, 0.0f, 0.0f);
+  }
+
+  blend.dense_positions.assign(
+      TARGET_COUNT, std::vector<glm::vec4>(VERTEX_COUNT, glm::vec4(0.0f)));
+  blend.dense_normals = blend.dense_positions;
+
+  MorphData &morphs = blend.morphs;
+  std::vector<uint8_t> touched(VERTEX_COUNT, 0);
+  for (size_t t = 0; t < TARGET_COUNT; t++) {
+    MorphTarget target{static_cast<uint32_t>(morphs.deltas.size()), 0};
+    for (uint32_t v = 0; v < VERTEX_COUNT; v++) {
+      if (random() % 7 != 0)
+        continue;
+      MorphDelta delta{random_vec4(0.0f), random_vec4(0.0f)};
+      morphs.deltas.push_back(delta);
+      morphs.delta_vertices.push_back(v);
+      blend.dense_positions[t][v] = delta.position;
+      blend.dense_normals[t][v] = delta.normal;
+      target.delta_count++;
+      touched[v] = 1;
+    }
+    morphs.targets.push_back(target);
+  }
+  for (uint32_t v = 0; v < VERTEX_COUNT; v++) {
+    if (touched[v])
+      morphs.touched_vertices.push_back(v);
+  }
+
+  MorphRange range{};
+  range.target_count = TARGET_COUNT;
+  range.touched_count = static_cast<uint32_t>(morphs.touched_vertices.size());
+  morphs.ranges.push_back(range);
+  morphs.weights.assign(TARGET_COUNT, 0.0f);
+  return blend;
+}
+
+void random_weights(std::mt19937 &random, std::vector<float> &weights) {
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  for (float &weight : weights)
+    weight = random() % 3 == 0 ? 0.0f : unit(random);
+}
+
+// random weights, a frame with every weight at zero in between so a range
+// left dirty has to be restored.
+void test_dense_blend() {
+  std::mt19937 random(3);
+  Blend blend = make_blend(random);
+  std::vector<Vertex> out = blend.base;
+  MorphState state;
+
+  float max_error = 0.0f;
+  for (int frame = 0; frame < 20; frame++) {
+    random_weights(random, blend.morphs.weights);
+    if (frame == 10)
+      std::fill(blend.morphs.weights.begin(), blend.morphs.weights.end(), 0.0f);
+    evaluate_morphs(blend.morphs, blend.base.data(), out.data(), state);
+
+    for (size_t v = 0; v < VERTEX_COUNT; v++) {
+      glm::vec4 position = blend.base[v].position;
+      glm::vec4 normal = blend.base[v].normal;
+      for (size_t t = 0; t < TARGET_COUNT; t++) {
+        position += blend.morphs.weights[t] * blend.dense_positions[t][v];
+        normal += blend.morphs.weights[t] * blend.dense_normals[t][v];
+      }
+      for (int c = 0; c < 4; c++) {
+        max_error = std::max(max_error,
+                             std::fabs(position[c] - out[v].position[c]));
+        max_error =
+            std::max(max_error, std::fabs(normal[c] - out[v].normal[c]));
+      }
+    }
+  }
+  CHECK(max_error < 1e-5f);
+}
+
+void test_morph_extents() {
+  MorphData morphs;
+  morphs.targets = {{0, 2}, {2, 1}};
+  morphs.deltas = {
+      {glm::vec4(3.0f, 4.0f, 0.0f, 0.0f), glm::vec4(0.0f)},
+      {glm::vec4(0.0f, 0.0f, 2.0f, 0.0f), glm::vec4(0.0f)},
+      {glm::vec4(0.0f, -1.0f, 0.0f, 0.0f), glm::vec4(0.0f)},
+  };
+  morphs.delta_vertices = {0, 2, 0};
+
+  std::vector<float> extents;
+  compute_morph_extents(morphs, 3, extents);
+  CHECK(extents.size() == 3);
+  CHECK(extents[0] == 6.0f);
+  CHECK(extents[1] == 0.0f);
+  CHECK(extents[2] == 2.0f);
+}
+
+// every morphed vertex has to stay inside the bind pose sphere of each joint
+// it depends on, or the skinned quantization clamps it.
+void test_joint_bounds() {
+  std::mt19937 random(11);
+  Blend blend = make_blend(random);
+
+  std::vector<float> extents;
+  compute_morph_extents(blend.morphs, VERTEX_COUNT, extents);
+  std::vector<glm::vec4> bounds;
+  compute_joint_bounds(blend.base.data(), VERTEX_COUNT, JOINT_COUNT, bounds,
+                       extents.data());
+  CHECK(bounds.size() == JOINT_COUNT);
+
+  std::vector<Vertex> out = blend.base;
+  MorphState state;
+  size_t outside = 0;
+  for (int frame = 0; frame < 20; frame++) {
+    random_weights(random, blend.morphs.weights);
+    // the extremes, every weight at -1 or 1.
+    if (frame % 5 == 0) {
+      for (float &weight : blend.morphs.weights)
+        weight = random() % 2 == 0 ? -1.0f : 1.0f;
+    }
+    evaluate_morphs(blend.morphs, blend.base.data(), out.data(), state);
+
+    for (size_t v = 0; v < VERTEX_COUNT; v++) {
+      for (int k = 0; k < 2; k++) {
+        const glm::vec4 &sphere = bounds[out[v].joints[k]];
+        float distance = glm::length(glm::vec3(out[v].position) -
+                                     glm::vec3(sphere));
+        outside += distance > sphere.w * 1.0001f ? 1 : 0;
+      }
+    }
+  }
+  CHECK(outside == 0);
+}
+
+} // namespace
+
+int main() {
+  test_dense_blend();
+  test_morph_extents();
+  test_joint_bounds();
+  return test::result();
+}
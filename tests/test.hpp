@@ -0,0 +1,30 @@
+/* ----------------------------- test.hpp -----------------------------
+ * the few helpers the tests share. a test is an executable that runs
+ * its checks from main and returns test::result(), ctest reports it
+ * failed when any check did.
+ * -------------------------------------------------------------------
+ */
+#pragma once
+
+#include <cstdio>
+
+namespace test {
+
+inline int failures = 0;
+
+inline int result() {
+  if (failures > 0)
+    std::fprintf(stderr, "%d checks failed\n", failures);
+  return failures > 0 ? 1 : 0;
+}
+
+} // namespace test
+
+#define CHECK(condition)                                                     \
+  do {                                                                       \
+    if (!(condition)) {                                                      \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                   #condition);                                              \
+      test::failures++;                                                      \
+    }                                                                        \
+  } while (0)